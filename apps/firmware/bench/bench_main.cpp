@@ -0,0 +1,270 @@
+// Native throughput benchmarks for the per-check content pipeline:
+//   pio run -e native_bench && .pio/build/native_bench/program [--mb=N] [--fixtures=dir]
+// Each fixture is repeated until roughly --mb megabytes have been processed
+// and the result is printed as JSON (MB/s per stage and fixture).
+#include <AllocProfile.h>
+#include <Arduino.h>
+#include <ContentChunker.h>
+#include <ContentNormalizer.h>
+#include <CssSelectMini.h>
+#include <HtmlScanner.h>
+#include <Lzf.h>
+#include <TextDiff.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../src/hmac_utils.h"
+#include "legacy_css_select.h"
+
+namespace {
+struct Fixture {
+  std::string name;
+  // A String so the legacy selector, which takes one, runs on it without a copy.
+  String body;
+};
+
+struct Options {
+  double megabytes = 64;
+  std::string fixturesDir = "sim/fixtures";
+  // Bytes handed to the pipeline per call, like one TCP segment.
+  size_t chunk = 1460;
+};
+
+const char kMissSelector[] = "div.no-existe:nth-of-type(3)";
+
+// Keeps results observable so the optimizer cannot drop the work.
+volatile size_t sink = 0;
+
+Options parseOptions(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    if (arg.rfind("--mb=", 0) == 0) {
+      options.megabytes = std::stod(arg.substr(5));
+    } else if (arg.rfind("--fixtures=", 0) == 0) {
+      options.fixturesDir = arg.substr(11);
+    } else if (arg.rfind("--chunk=", 0) == 0) {
+      options.chunk = std::stoul(arg.substr(8));
+    } else {
+      std::fprintf(stderr, "Argumento desconocido: %s\n", argv[i]);
+    }
+  }
+  return options;
+}
+
+std::vector<Fixture> loadFixtures(const std::string &dir) {
+  std::vector<Fixture> fixtures;
+  for (const char *name : {"article.html", "landing.html", "listing.html", "product.html", "status.html"}) {
+    std::ifstream file(dir + "/" + name, std::ios::binary);
+    if (!file) {
+      continue;
+    }
+    std::stringstream content;
+    content << file.rdbuf();
+    fixtures.push_back(Fixture{name, content.str()});
+  }
+  // The fixtures are tiny next to real pages, so one page of ~64 KB built from
+  // all of them shows steady-state throughput without per-call overhead.
+  if (!fixtures.empty()) {
+    Fixture combined{"combined_64k", ""};
+    while (combined.body.size() < 64 * 1024) {
+      for (const Fixture &fixture : fixtures) {
+        combined.body += fixture.body;
+      }
+    }
+    fixtures.push_back(combined);
+  }
+  return fixtures;
+}
+
+// Runs `pass` over the fixture until the byte budget is spent; returns MB/s.
+double throughput(const Fixture &fixture, const Options &options, const std::function<void(const Fixture &)> &pass) {
+  const size_t budget = static_cast<size_t>(options.megabytes * 1024 * 1024);
+  size_t processed = 0;
+  const auto start = std::chrono::steady_clock::now();
+  while (processed < budget) {
+    pass(fixture);
+    processed += fixture.body.size();
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return seconds > 0 ? static_cast<double>(processed) / (1024.0 * 1024.0) / seconds : 0;
+}
+
+void feedChunks(const Fixture &fixture, size_t chunk, const std::function<void(const char *, size_t)> &feed) {
+  const char *data = fixture.body.data();
+  const size_t length = fixture.body.size();
+  for (size_t offset = 0; offset < length; offset += chunk) {
+    feed(data + offset, std::min(chunk, length - offset));
+  }
+}
+
+std::function<void(const Fixture &)> normalizePass(NormalizeMode mode, const Options &options, bool hash) {
+  return [mode, &options, hash](const Fixture &fixture) {
+    NormalizeOptions normalizeOptions;
+    normalizeOptions.mode = mode;
+    security::Sha256Stream digest;
+    ContentNormalizer normalizer;
+    normalizer.begin(normalizeOptions, [&](const char *data, size_t length) {
+      if (hash) {
+        digest.update(data, length);
+      }
+    });
+    feedChunks(fixture, options.chunk, [&](const char *data, size_t length) { normalizer.update(data, length); });
+    normalizer.finish();
+    sink += normalizer.outputBytes() + digest.finishHex().size();
+  };
+}
+
+std::string normalizedText(const Fixture &fixture) {
+  NormalizeOptions normalizeOptions;
+  normalizeOptions.mode = NormalizeMode::Text;
+  std::string text;
+  ContentNormalizer normalizer;
+  normalizer.begin(normalizeOptions, [&](const char *data, size_t length) { text.append(data, length); });
+  normalizer.update(fixture.body.data(), fixture.body.size());
+  normalizer.finish();
+  text.resize(std::min<size_t>(text.size(), DIFF_MAX_CONTENT_BYTES));
+  return text;
+}
+
+// Microseconds per call of `pass`, repeated for about a tenth of a second.
+double microsPerCall(const std::function<void()> &pass) {
+  size_t calls = 0;
+  const auto start = std::chrono::steady_clock::now();
+  double seconds = 0;
+  do {
+    pass();
+    ++calls;
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (seconds < 0.1);
+  return seconds * 1e6 / static_cast<double>(calls);
+}
+
+// CHANGE_DETECTED diffs on the fixtures' visible text (what selector/marker
+// extraction feeds the snapshot store), with one digit changed halfway through
+// as in a price or stock update.
+void printDiffBench(const std::vector<Fixture> &fixtures) {
+  std::printf("  \"diff\": {\n");
+  for (size_t f = 0; f < fixtures.size(); ++f) {
+    const std::string before = normalizedText(fixtures[f]);
+    std::string after = before;
+    const size_t digit = after.find_first_of("0123456789", after.size() / 2);
+    if (digit != std::string::npos) {
+      after[digit] = after[digit] == '9' ? '1' : static_cast<char>(after[digit] + 1);
+    }
+    // Worst realistic case: a word changed every ~400 bytes, which runs the
+    // Myers pass over the whole text instead of a trimmed middle.
+    std::string scattered = before;
+    for (size_t i = 200; i < scattered.size(); i += 400) {
+      scattered[i] = scattered[i] == 'x' ? 'y' : 'x';
+    }
+    size_t hunks = 0;
+    const double diffMicros = microsPerCall([&]() {
+      hunks = diffWords(before.data(), before.size(), after.data(), after.size()).hunks.size();
+      sink += hunks;
+    });
+    bool scatteredExact = false;
+    const double scatteredMicros = microsPerCall([&]() {
+      scatteredExact = diffWords(before.data(), before.size(), scattered.data(), scattered.size()).exact;
+      sink += scatteredExact;
+    });
+    std::vector<uint8_t> packed(before.size());
+    size_t packedLength = 0;
+    const double lzfMicros = microsPerCall([&]() {
+      packedLength = lzf::compress(reinterpret_cast<const uint8_t *>(before.data()), before.size(), packed.data(),
+                                   packed.size());
+      sink += packedLength;
+    });
+    std::printf("    \"%s\": {\"bytes\": %zu, \"hunks\": %zu, \"diff_us\": %.1f, \"scattered_diff_us\": %.1f, "
+                "\"scattered_exact\": %s, \"lzf_us\": %.1f, \"lzf_ratio\": %.2f}%s\n",
+                fixtures[f].name.c_str(), before.size(), hunks, diffMicros, scatteredMicros,
+                scatteredExact ? "true" : "false", lzfMicros,
+                packedLength ? static_cast<double>(packedLength) / static_cast<double>(before.size()) : 1.0,
+                f + 1 < fixtures.size() ? "," : "");
+  }
+  std::printf("  }");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const Options options = parseOptions(argc, argv);
+  const std::vector<Fixture> fixtures = loadFixtures(options.fixturesDir);
+  if (fixtures.empty()) {
+    std::fprintf(stderr, "No hay fixtures en %s\n", options.fixturesDir.c_str());
+    return 1;
+  }
+
+  struct Stage {
+    const char *name;
+    std::function<void(const Fixture &)> pass;
+  };
+  const std::vector<Stage> stages = {
+      {"sha256_raw",
+       [&](const Fixture &fixture) {
+         security::Sha256Stream digest;
+         feedChunks(fixture, options.chunk, [&](const char *data, size_t length) { digest.update(data, length); });
+         sink += digest.finishHex().size();
+       }},
+      {"normalize_whitespace", normalizePass(NormalizeMode::Whitespace, options, false)},
+      {"normalize_text", normalizePass(NormalizeMode::Text, options, false)},
+      {"normalize_text_sha256", normalizePass(NormalizeMode::Text, options, true)},
+      {"cdc_chunk",
+       [&](const Fixture &fixture) {
+         static const std::vector<uint32_t> kNoPrevious;
+         ContentChunker chunker;
+         chunker.begin(kNoPrevious);
+         feedChunks(fixture, options.chunk, [&](const char *data, size_t length) { chunker.update(data, length); });
+         chunker.finish();
+         sink += chunker.digests().size();
+       }},
+      {"tag_scan",
+       [](const Fixture &fixture) {
+         HtmlTagScanner scanner(fixture.body.data(), fixture.body.size());
+         HtmlTag tag;
+         while (scanner.next(tag)) {
+           ++sink;
+         }
+       }},
+      // A selector that never matches walks the whole document.
+      {"select_css_miss",
+       [](const Fixture &fixture) {
+         CssSelectMini css;
+         size_t start = 0;
+         size_t length = 0;
+         sink += css.selectInnerSpan(fixture.body.data(), fixture.body.size(), kMissSelector, start, length);
+       }},
+      // Same walk through selectInnerText as it was before HtmlTagScanner.
+      {"select_css_miss_legacy",
+       [](const Fixture &fixture) {
+         LegacyCssSelect css;
+         String text;
+         sink += css.selectInnerText(fixture.body, kMissSelector, text);
+       }},
+  };
+
+  std::printf("{\n  \"megabytes_per_run\": %.1f,\n  \"chunk_bytes\": %zu,\n  \"stages\": {\n", options.megabytes,
+              options.chunk);
+  for (size_t s = 0; s < stages.size(); ++s) {
+    std::printf("    \"%s\": {", stages[s].name);
+    for (size_t f = 0; f < fixtures.size(); ++f) {
+      std::printf("%s\"%s\": %.1f", f ? ", " : "", fixtures[f].name.c_str(),
+                  throughput(fixtures[f], options, stages[s].pass));
+    }
+    std::printf("}%s\n", s + 1 < stages.size() ? "," : "");
+  }
+  std::printf("  },\n");
+  printDiffBench(fixtures);
+  if (ALLOC_PROFILE) {
+    std::printf(",\n  \"alloc\": %s", allocprofile::toJson().c_str());
+  }
+  std::printf("\n}\n");
+  return 0;
+}
@@ -0,0 +1,732 @@
+#include "MonitorDaemon.h"
+
+#include <NetSocket.h>
+
+#include <sys/sysinfo.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <strings.h>
+
+namespace {
+// Owned sites not configured here yet, listed by id in each LOAD report.
+constexpr size_t kLoadMissingIds = 16;
+constexpr uint32_t kEventDrainIntervalMs = 20;
+constexpr uint32_t kDnsPrefetchIntervalMs = 100;
+
+void logLine(const char *level, const String &message) { Serial.printf("[%s] %s\n", level, message.c_str()); }
+
+// The host has a real clock: history times are Unix seconds.
+uint32_t historyClock() { return static_cast<uint32_t>(std::time(nullptr)); }
+
+EventKind eventKindFor(const char *type) {
+  if (strcmp(type, "CHANGE_DETECTED") == 0) {
+    return EventKind::Change;
+  }
+  return strcmp(type, "ERROR") == 0 ? EventKind::Error : EventKind::Status;
+}
+
+// The LOAD contract speaks of heap; on Linux the closest figure is the
+// memory the kernel still has available.
+uint32_t availableMemory() {
+  struct sysinfo info {};
+  if (sysinfo(&info) != 0) {
+    return 0;
+  }
+  const uint64_t bytes = static_cast<uint64_t>(info.freeram + info.bufferram) * info.mem_unit;
+  return static_cast<uint32_t>(std::min<uint64_t>(bytes, UINT32_MAX));
+}
+}  // namespace
+
+// One check from fetch to merge: a copy of the site for the worker and the
+// buffered body. Idle ones are reused.
+class MonitorDaemon::Check : public FetchSink {
+ public:
+  explicit Check(MonitorDaemon &owner) : owner_(owner) {}
+
+  SiteRecord record;
+  CheckCapture capture;
+  std::string body;
+  size_t keepBytes = 0;
+  unsigned long startedAt = 0;
+
+  bool onHeader(const char *name, size_t nameLength, const char *value, size_t valueLength) override {
+    (void)valueLength;
+    if (nameLength == 14 && strncasecmp(name, "Content-Length", nameLength) == 0) {
+      const long contentLength = atol(value);
+      if (contentLength > 0) {
+        body.reserve(std::min(static_cast<size_t>(contentLength), keepBytes));
+      }
+    }
+    return true;
+  }
+
+  bool onBody(const char *data, size_t length) override {
+    capture.bodyBytes += length;
+    if (capture.truncated) {
+      return true;
+    }
+    const size_t take = std::min(length, keepBytes - std::min(body.size(), keepBytes));
+    body.append(data, take);
+    if (take < length) {
+      capture.truncated = true;
+      capture.cutBy = "memory";
+      capture.plan.strategy = FetchStrategy::Capped;
+    }
+    return true;
+  }
+
+  void onComplete(const FetchResult &result) override { owner_.submitCheck(*this, result); }
+
+ private:
+  MonitorDaemon &owner_;
+};
+
+struct MonitorDaemon::Outcome {
+  Check *check = nullptr;
+  const char *type = "ERROR";
+  String message;
+  bool snapshotFailed = false;
+  int statusCode = 0;
+  uint32_t fetchMs = 0;
+  HistoryEntry history;
+};
+
+MonitorDaemon::MonitorDaemon(DaemonOptions options)
+    : options_(std::move(options)), transport_(options_.mqttTls), mqtt_(transport_) {}
+
+MonitorDaemon::~MonitorDaemon() { stop(); }
+
+bool MonitorDaemon::begin() {
+  setenv("LITTLEFS_ROOT", options_.stateDir.c_str(), 1);
+  if (!storage_.begin()) {
+    logLine("ERROR", String("No se pudo abrir el directorio de estado ") + options_.stateDir);
+    return false;
+  }
+  if (!storage_.loadSites(sites_)) {
+    logLine("WARN", "No se pudieron cargar todos los sitios previos");
+  }
+  reindex();
+  const unsigned long now = millis();
+  for (auto &record : sites_) {
+    schedule(record, now);
+  }
+  logLine("INFO", String("Sitios cargados: ") + sites_.size());
+
+  options_.maxInFlight = std::max<size_t>(options_.maxInFlight, 1);
+  fetch_.begin(options_.maxInFlight, 0, FetchEngine::Backend::Epoll);
+  dns_.begin(options_.dnsCacheEntries);
+  fetch_.setDnsCache(&dns_);
+  if (fetch_.backend() != FetchEngine::Backend::Epoll) {
+    logLine("WARN", "epoll no disponible, se usará select()");
+  }
+  checks_.clear();
+  idleChecks_.clear();
+  for (size_t i = 0; i < options_.maxInFlight; ++i) {
+    checks_.emplace_back(new Check(*this));
+    idleChecks_.push_back(checks_.back().get());
+  }
+  workers_.start(options_.workers);
+  loadMonitor_.begin(options_.maxInFlight, LoadMonitor::Options());
+  eventQueue_.begin(options_.eventRamSlots, options_.maxEvents);
+  if (!eventQueue_.empty()) {
+    logLine("INFO", String("Eventos recuperados del disco: ") + eventQueue_.depth());
+  }
+
+  const std::string suffix = security::deriveTopicSuffix(options_.deviceId.c_str(), options_.deviceSecret);
+  const String base = String("devices/") + options_.deviceId + "-" + suffix.c_str();
+  commandTopic_ = base + "/commands";
+  eventsTopic_ = base + "/events";
+  loadTopic_ = base + "/load";
+  traceTopic_ = base + "/trace";
+  historyTopic_ = base + "/history";
+
+  MqttOptions mqttOptions;
+  mqttOptions.host = options_.mqttHost;
+  mqttOptions.port = options_.mqttPort;
+  mqttOptions.clientId = options_.deviceId;
+  mqttOptions.maxPacketBytes = options_.mqttMaxPacketBytes;
+  mqttOptions.inflightWindow = options_.mqttInflightWindow;
+  mqttOptions.outboxSlots = options_.mqttOutboxSlots;
+  mqtt_.onConnect([this]() {
+    logLine("INFO", String("MQTT conectado, suscrito a ") + commandTopic_);
+    TRACE(MqttConnected, 0, 0, eventQueue_.depth(), 0);
+    lastLoadReportAt_ = millis() - LOAD_REPORT_INTERVAL_MS;
+  });
+  mqtt_.onDisconnect([this](const char *error) {
+    logLine("ERROR", String("MQTT sin conexión: ") + error + " (" + mqtt_.pending() + " eventos sin confirmar)");
+    TRACE(MqttDisconnected, 0, 0, mqtt_.pending(), 0);
+  });
+  mqtt_.onMessage([this](const char *topic, size_t topicLength, char *payload, size_t length) {
+    handleMessage(topic, topicLength, payload, length);
+  });
+  mqtt_.subscribe(commandTopic_, 1);
+  mqtt_.begin(mqttOptions);
+  logLine("INFO", String("Conectando a MQTT en ") + options_.mqttHost + ":" + options_.mqttPort + " con " +
+                      workers_.threads() + " workers y " + options_.maxInFlight + " chequeos simultáneos");
+  lastPersistAt_ = now;
+  running_ = true;
+  TRACE(Boot, 0, 0, 0, availableMemory());
+  return true;
+}
+
+void MonitorDaemon::poll(uint32_t waitMs) {
+  if (!running_) {
+    return;
+  }
+  mqtt_.poll(0);
+  mergeOutcomes();
+  drainEventQueue();
+  publishLoadReport();
+  sendTraceDump();
+  sendHistoryPart();
+  prefetchDns();
+  dispatchDueChecks();
+  bool outcomesWaiting = false;
+  {
+    std::lock_guard<std::mutex> lock(outcomesMutex_);
+    outcomesWaiting = !outcomes_.empty();
+  }
+  fetch_.poll(outcomesWaiting ? 0 : waitMs);
+  persistIfDirty(false);
+}
+
+void MonitorDaemon::stop() {
+  if (!running_) {
+    return;
+  }
+  running_ = false;
+  fetch_.abortAll();
+  workers_.stop();
+  mergeOutcomes();
+  persistIfDirty(true);
+}
+
+SiteRecord *MonitorDaemon::findSite(const String &id) {
+  auto it = index_.find(id);
+  return it == index_.end() ? nullptr : &sites_[it->second.index];
+}
+
+void MonitorDaemon::reindex() {
+  std::unordered_map<std::string, Slot> rebuilt;
+  rebuilt.reserve(sites_.size());
+  for (size_t i = 0; i < sites_.size(); ++i) {
+    auto previous = index_.find(sites_[i].config.id);
+    rebuilt[sites_[i].config.id] = Slot{i, previous == index_.end() ? 0 : previous->second.ticket};
+  }
+  index_.swap(rebuilt);
+}
+
+// Supersedes any earlier entry of the site: the heap keeps it, but with a
+// stale ticket it is skipped when it comes up.
+void MonitorDaemon::schedule(SiteRecord &record, unsigned long at) {
+  auto it = index_.find(record.config.id);
+  if (it == index_.end()) {
+    return;
+  }
+  it->second.ticket = nextTicket_++;
+  dueHeap_.push(Due{at, it->second.ticket, record.config.id});
+}
+
+void MonitorDaemon::requestCheck(SiteRecord &record) {
+  if (!record.state.checkRequested) {
+    record.state.checkRequested = true;
+    requested_.push_back(record.config.id);
+  }
+}
+
+// CHECK_NOW requests first, then the heap in due order. A site in flight is
+// skipped; merging its check puts it back.
+void MonitorDaemon::dispatchDueChecks() {
+  const unsigned long now = millis();
+  while (!requested_.empty() && !idleChecks_.empty() && fetch_.canStart()) {
+    const String id = std::move(requested_.front());
+    requested_.pop_front();
+    SiteRecord *record = findSite(id);
+    if (record && record->state.checkRequested && !record->state.inFlight) {
+      startCheck(*record, 0);
+    }
+  }
+  while (!dueHeap_.empty() && !idleChecks_.empty() && fetch_.canStart()) {
+    if (dueHeap_.top().at > now) {
+      return;
+    }
+    const Due due = dueHeap_.top();
+    dueHeap_.pop();
+    auto it = index_.find(due.id);
+    if (it == index_.end() || it->second.ticket != due.ticket) {
+      continue;
+    }
+    SiteRecord &record = sites_[it->second.index];
+    if (!record.config.paused && !record.state.inFlight) {
+      startCheck(record, static_cast<uint32_t>(now - due.at));
+    }
+  }
+}
+
+bool MonitorDaemon::startCheck(SiteRecord &record, uint32_t lagMs) {
+  Check &check = *idleChecks_.back();
+  idleChecks_.pop_back();
+  const bool requested = record.state.checkRequested;
+  record.state.inFlight = true;
+  record.state.checkRequested = false;
+  check.record = record;
+  check.capture = CheckCapture();
+  check.keepBytes = record.config.maxBytes > 0 ? std::min<size_t>(record.config.maxBytes, options_.maxBodyBytes)
+                                               : options_.maxBodyBytes;
+  check.capture.plan.strategy = FetchStrategy::Buffered;
+  check.capture.plan.budgetBytes = check.keepBytes;
+  check.capture.fullPage = isFullPage(record.config);
+  check.startedAt = millis();
+  FetchRequest request;
+  request.url = fetchUrlFor(check.record);
+  request.headers = &check.record.config.headers;
+  request.maxBodyBytes = record.config.maxBytes;
+  request.traceSite = traceSiteTag(record.config.id);
+  if (!fetch_.start(request, check)) {
+    idleChecks_.push_back(&check);
+    record.state.inFlight = false;
+    record.state.checkRequested = requested;
+    return false;
+  }
+  TRACE(CheckStart, request.traceSite, check.capture.plan.strategy, lagMs, check.keepBytes);
+  loadMonitor_.checkStarted(lagMs);
+  return true;
+}
+
+// Called by the fetch engine; from here until mergeOutcomes() the check
+// belongs to a worker.
+void MonitorDaemon::submitCheck(Check &check, const FetchResult &result) {
+  if (result.truncated && !check.capture.truncated) {
+    check.capture.truncated = true;
+    check.capture.cutBy = "max_bytes";
+  }
+  const uint32_t depth = queueDepth_.load();
+  const uint32_t dropped = queueDropped_.load();
+  workers_.submit([this, &check, result, depth, dropped]() {
+    SiteRecord &record = check.record;
+    ContentDigest digest;
+    digest.begin(record.config, record.state, check.capture.fullPage);
+    ExtractionOutcome extraction;
+    if (result.ok) {
+      if (check.capture.fullPage) {
+        digest.update(check.body.data(), check.body.size());
+      } else {
+        extraction = extractContentForSite(record.config, check.body.data(), check.body.size());
+      }
+    }
+    const CheckReport report =
+        finishCheck(record, result, check.capture, extraction, check.body.data(), check.body.size(), digest);
+    StaticJsonDocument<2048> doc;
+    writeCheckEvent(doc, record, check.capture, report);
+    JsonObject queue = doc["payload"].createNestedObject("queue");
+    queue["depth"] = depth;
+    queue["dropped"] = dropped;
+    doc["ts"] = static_cast<uint32_t>(millis() / 1000);
+    Outcome outcome;
+    outcome.check = &check;
+    outcome.type = report.type;
+    outcome.snapshotFailed = report.snapshotFailed;
+    outcome.statusCode = report.statusCode;
+    outcome.fetchMs = result.elapsedMs;
+    outcome.history = historyEntryFor(record, result, report, historyClock());
+    serializeJson(doc, outcome.message);
+    std::lock_guard<std::mutex> lock(outcomesMutex_);
+    outcomes_.push_back(std::move(outcome));
+  });
+}
+
+// Copies the worker's fingerprint and counters back; the loop's scheduling
+// fields stay. Checks of sites deleted meanwhile publish nothing.
+void MonitorDaemon::mergeOutcomes() {
+  std::vector<Outcome> ready;
+  {
+    std::lock_guard<std::mutex> lock(outcomesMutex_);
+    ready.swap(outcomes_);
+  }
+  if (ready.empty()) {
+    return;
+  }
+  const unsigned long now = millis();
+  for (Outcome &outcome : ready) {
+    Check &check = *outcome.check;
+    loadMonitor_.checkFinished(static_cast<uint32_t>(now - check.startedAt));
+    ++stats_.checks;
+    stats_.bodyBytes += check.capture.bodyBytes;
+    stats_.changes += strcmp(outcome.type, "CHANGE_DETECTED") == 0 ? 1 : 0;
+    stats_.errors += strcmp(outcome.type, "ERROR") == 0 ? 1 : 0;
+    TRACE(CheckEnd, traceSiteTag(check.record.config.id), eventKindFor(outcome.type), outcome.fetchMs,
+          outcome.statusCode);
+    SiteRecord *record = findSite(check.record.config.id);
+    if (record) {
+      const bool requested = record->state.checkRequested;
+      record->state = std::move(check.record.state);
+      if (record->config.url != check.record.config.url) {
+        // Re-pointed by an UPSERT_SITE while the check ran.
+        record->state.resolvedUrl = String();
+      }
+      record->state.inFlight = false;
+      record->state.checkRequested = requested;
+      record->state.lastCheckAt = now;
+      record->state.checkedSinceBoot = true;
+      if (outcome.snapshotFailed) {
+        logLine("WARN", String("No se pudo guardar el contenido previo de ") + record->config.id);
+      }
+      // Appended here rather than on the worker so a HISTORY reply never
+      // reads a file being written.
+      if (!HistoryLog::append(record->config.id, outcome.history)) {
+        logLine("WARN", String("No se pudo registrar el historial de ") + record->config.id);
+      }
+      queueEvent(outcome.type, outcome.message);
+      if (requested) {
+        requested_.push_back(record->config.id);
+      } else {
+        schedule(*record, now + static_cast<unsigned long>(record->config.intervalSeconds) * 1000UL);
+      }
+      dirty_ = true;
+    }
+    std::string().swap(check.body);
+    idleChecks_.push_back(&check);
+  }
+}
+
+void MonitorDaemon::persistIfDirty(bool force) {
+  const unsigned long now = millis();
+  if (!dirty_ || (!force && now - lastPersistAt_ < options_.persistIntervalMs)) {
+    return;
+  }
+  lastPersistAt_ = now;
+  dirty_ = false;
+  ++stats_.persists;
+  const bool saved = storage_.saveSites(sites_);
+  TRACE(Persist, 0, saved, sites_.size(), millis() - now);
+  if (!saved) {
+    logLine("WARN", String("No se pudo persistir sitios en ") + options_.stateDir);
+  }
+}
+
+// Like the firmware's prefetch, but the lookups run on the workers so the loop
+// never blocks on the resolver. Each pass visits enough sites to cover the
+// list twice per DNS_PREFETCH_AHEAD_MS.
+void MonitorDaemon::prefetchDns() {
+  std::vector<DnsAnswer> answers;
+  {
+    std::lock_guard<std::mutex> lock(outcomesMutex_);
+    answers.swap(dnsAnswers_);
+  }
+  const unsigned long now = millis();
+  for (const DnsAnswer &answer : answers) {
+    dns_.storeLookup(answer.host.c_str(), answer.ok, answer.address, answer.lookupMs, now);
+    dnsPending_.erase(answer.host);
+  }
+  if (sites_.empty() || now - lastDnsPrefetchAt_ < kDnsPrefetchIntervalMs) {
+    return;
+  }
+  lastDnsPrefetchAt_ = now;
+  const size_t visits =
+      std::min(sites_.size(), sites_.size() * kDnsPrefetchIntervalMs / (DNS_PREFETCH_AHEAD_MS / 2) + 1);
+  for (size_t visited = 0; visited < visits; ++visited) {
+    dnsPrefetchCursor_ = (dnsPrefetchCursor_ + 1) % sites_.size();
+    const SiteRecord &record = sites_[dnsPrefetchCursor_];
+    if (record.config.paused || record.state.inFlight || !record.state.checkedSinceBoot) {
+      continue;
+    }
+    const unsigned long intervalMs = static_cast<unsigned long>(record.config.intervalSeconds) * 1000UL;
+    const unsigned long waited = now - record.state.lastCheckAt;
+    if (waited >= intervalMs || intervalMs - waited > DNS_PREFETCH_AHEAD_MS) {
+      continue;
+    }
+    const HttpUrl url = HttpUrl::parse(fetchUrlFor(record));
+    if (!url.valid || dnsPending_.count(url.host) || !dns_.needsRefresh(url.host.c_str(), now, DNS_PREFETCH_AHEAD_MS)) {
+      continue;
+    }
+    dnsPending_.insert(url.host);
+    workers_.submit([this, host = std::string(url.host.c_str())]() {
+      DnsAnswer answer{host, false, 0, 0};
+      const unsigned long startedAt = millis();
+      answer.ok = netio::resolveIpv4(host.c_str(), answer.address);
+      answer.lookupMs = static_cast<uint32_t>(millis() - startedAt);
+      std::lock_guard<std::mutex> lock(outcomesMutex_);
+      dnsAnswers_.push_back(std::move(answer));
+    });
+  }
+}
+
+bool MonitorDaemon::sendEvent(const String &message) {
+  if (mqtt_.publish(eventsTopic_, message, 1)) {
+    return true;
+  }
+  if (mqtt_.canPublish()) {
+    logLine("WARN", "Evento rechazado por el cliente MQTT, descartado");
+    return true;
+  }
+  return false;
+}
+
+void MonitorDaemon::queueEvent(const char *type, const String &message) {
+  // Anything already queued goes first so the broker sees events in order.
+  if (!eventQueue_.empty() || !mqtt_.canPublish() || !sendEvent(message)) {
+    eventQueue_.push(eventKindFor(type), message);
+  }
+  TRACE(EventQueued, 0, eventKindFor(type), eventQueue_.depth(), 0);
+  queueDepth_ = static_cast<uint32_t>(eventQueue_.depth());
+  queueDropped_ = eventQueue_.stats().dropped;
+}
+
+void MonitorDaemon::drainEventQueue() {
+  if (eventQueue_.empty() || !mqtt_.canPublish()) {
+    return;
+  }
+  const unsigned long now = millis();
+  if (now - lastDrainAt_ < kEventDrainIntervalMs) {
+    return;
+  }
+  lastDrainAt_ = now;
+  eventQueue_.drain([this](const String &message) { return sendEvent(message); }, options_.mqttOutboxSlots);
+  queueDepth_ = static_cast<uint32_t>(eventQueue_.depth());
+  if (eventQueue_.empty()) {
+    logLine("INFO", String("Cola de eventos vaciada (") + eventQueue_.stats().dropped + " descartados en total)");
+  }
+}
+
+void MonitorDaemon::publishLoadReport() {
+  const unsigned long now = millis();
+  if (now - lastLoadReportAt_ < LOAD_REPORT_INTERVAL_MS || !mqtt_.canPublish()) {
+    return;
+  }
+  lastLoadReportAt_ = now;
+  const uint32_t memory = availableMemory();
+  loadMonitor_.noteFreeHeap(memory);
+  const LoadReport report = loadMonitor_.report(sites_, now);
+  StaticJsonDocument<2048> doc;
+  doc["type"] = "LOAD";
+  JsonObject payload = doc.createNestedObject("payload");
+  payload["id"] = options_.deviceId;
+  payload["seq"] = report.seq;
+  payload["epoch"] = shard_.epoch();
+  payload["sites"] = static_cast<uint32_t>(report.sites);
+  payload["active"] = static_cast<uint32_t>(report.active);
+  const std::vector<String> missing = shard_.missing(sites_);
+  JsonArray missingIds = payload.createNestedArray("missing");
+  for (size_t i = 0; i < missing.size() && i < kLoadMissingIds; ++i) {
+    missingIds.add(missing[i]);
+  }
+  payload["missing_total"] = static_cast<uint32_t>(missing.size());
+  payload["checks"] = report.checks;
+  payload["check_ms"] = report.checkMs;
+  payload["cycle_ms"] = report.cycleMs;
+  payload["lag_ms"] = report.lagMs;
+  payload["utilization"] = report.utilizationPct;
+  payload["heap_free"] = memory;
+  payload["heap_min"] = static_cast<uint32_t>(report.minFreeHeap);
+  payload["largest_block"] = memory;
+  payload["queue_depth"] = static_cast<uint32_t>(eventQueue_.depth());
+  payload["in_flight"] = static_cast<uint32_t>(inFlight());
+  writeDnsStats(payload.createNestedObject("dns"), dns_);
+  payload["overloaded"] = report.overload != nullptr;
+  if (report.overload) {
+    payload["overload"] = report.overload;
+  }
+  doc["ts"] = static_cast<uint32_t>(now / 1000);
+  String message;
+  serializeJson(doc, message);
+  if (!mqtt_.publish(loadTopic_, message, 1, true)) {
+    logLine("WARN", "Reporte LOAD rechazado por el cliente MQTT");
+  }
+  TRACE(LoadReport, 0, report.overload != nullptr, report.utilizationPct, report.lagMs);
+}
+
+// One part per poll so a dump never holds up the loop or fills the outbox.
+void MonitorDaemon::sendTraceDump() {
+  if (!traceDumper_.active() || !mqtt_.canPublish()) {
+    return;
+  }
+  StaticJsonDocument<1536> doc;
+  doc["type"] = "TRACE";
+  if (!traceDumper_.next(traceRing, options_.deviceId.c_str(), doc.createNestedObject("payload"))) {
+    return;
+  }
+  doc["ts"] = static_cast<uint32_t>(millis() / 1000);
+  String message;
+  serializeJson(doc, message);
+  if (!mqtt_.publish(traceTopic_, message, 1)) {
+    traceDumper_.retry();
+  }
+}
+
+void MonitorDaemon::sendHistoryPart() {
+  if (!historyReply_.active() || !mqtt_.canPublish()) {
+    return;
+  }
+  StaticJsonDocument<3072> doc;
+  doc["type"] = "HISTORY";
+  if (!historyReply_.next(historyClock(), doc.createNestedObject("payload"))) {
+    return;
+  }
+  doc["ts"] = static_cast<uint32_t>(millis() / 1000);
+  String message;
+  serializeJson(doc, message);
+  if (!mqtt_.publish(historyTopic_, message, 1)) {
+    historyReply_.retry();
+  }
+}
+
+void MonitorDaemon::handleMessage(const char *topic, size_t topicLength, char *payload, size_t length) {
+  if (topicLength != static_cast<size_t>(commandTopic_.length()) ||
+      strncmp(topic, commandTopic_.c_str(), topicLength) != 0) {
+    return;
+  }
+  handleCommand(payload, length);
+}
+
+void MonitorDaemon::handleCommand(char *payload, size_t length) {
+  StaticJsonDocument<4096> doc;
+  DeserializationError err = deserializeJson(doc, payload, length);
+  if (err) {
+    ++stats_.rejectedCommands;
+    logLine("WARN", String("JSON inválido: ") + err.c_str());
+    return;
+  }
+  const char *incomingHmac = doc["hmac"];
+  std::string computed;
+  if (!incomingHmac ||
+      !security::computeHmacBase64(options_.deviceSecret, buildCanonicalCommand(doc).c_str(), computed) ||
+      !security::constantTimeEquals(std::string(incomingHmac), computed)) {
+    ++stats_.rejectedCommands;
+    logLine("WARN", "HMAC inválido, comando rechazado");
+    return;
+  }
+  ++stats_.commands;
+  const char *type = doc["type"] | "";
+  JsonObject payloadObj = doc["payload"].as<JsonObject>();
+  const String id = payloadObj["id"].as<String>();
+  TRACE(Command, traceSiteTag(id), traceCommandFor(type), length, 0);
+  if (strcmp(type, "UPSERT_SITE") == 0) {
+    handleUpsert(payloadObj);
+  } else if (strcmp(type, "DELETE_SITE") == 0) {
+    if (forgetSites([&](const SiteRecord &rec) { return rec.config.id == id; }) > 0) {
+      logLine("INFO", String("Sitio eliminado: ") + id);
+    }
+  } else if (strcmp(type, "PAUSE_SITE") == 0 || strcmp(type, "RESUME_SITE") == 0) {
+    SiteRecord *record = findSite(id);
+    if (!record) {
+      logLine("WARN", String("Sitio no encontrado para pausa: ") + id);
+      return;
+    }
+    record->config.paused = strcmp(type, "PAUSE_SITE") == 0;
+    if (!record->config.paused && !record->state.inFlight) {
+      schedule(*record, millis());
+    }
+    dirty_ = true;
+  } else if (strcmp(type, "CHECK_NOW") == 0) {
+    SiteRecord *record = findSite(id);
+    if (!record) {
+      logLine("WARN", String("CHECK_NOW sin sitio: ") + id);
+      return;
+    }
+    requestCheck(*record);
+  } else if (strcmp(type, "ASSIGN_SHARD") == 0) {
+    handleAssignShard(payloadObj);
+  } else if (strcmp(type, "DUMP_TRACE") == 0) {
+    handleDumpTrace();
+  } else if (strcmp(type, "HISTORY") == 0) {
+    if (!findSite(id)) {
+      logLine("WARN", String("HISTORY sin sitio: ") + id);
+      return;
+    }
+    historyReply_.begin(id, ++historyRequests_, payloadObj["from"] | 0u, payloadObj["limit"] | HISTORY_MAX_RECORDS);
+    logLine("INFO", String("Historial de ") + id + ": " + historyReply_.records() + " registros a " + historyTopic_);
+  } else {
+    logLine("INFO", String("Comando desconocido: ") + type);
+  }
+}
+
+void MonitorDaemon::handleDumpTrace() {
+  traceDumper_.begin(traceRing, ++traceDumps_);
+  const uint32_t records = traceRing.written() - traceRing.oldest();
+  TRACE(TraceDump, 0, 0, records, traceDumps_);
+  logLine("INFO", String("Volcando traza ") + traceDumps_ + " (" + records + " registros) a " + traceTopic_);
+}
+
+void MonitorDaemon::handleUpsert(JsonObject payload) {
+  SiteRecord incoming = buildRecordFromPayload(payload);
+  if (incoming.config.id.isEmpty() || incoming.config.url.isEmpty()) {
+    logLine("WARN", "Comando UPSERT_SITE incompleto");
+    return;
+  }
+  if (incoming.config.intervalSeconds == 0) {
+    incoming.config.intervalSeconds = 900;
+  }
+  if (incoming.config.mode.isEmpty()) {
+    incoming.config.mode = "selector";
+  }
+  if (incoming.config.extractMode != ExtractMode::Unknown && !extractModeEnabled(incoming.config.extractMode)) {
+    logLine("WARN", String("Modo ") + incoming.config.mode + " no incluido en este firmware, sitio " +
+                        incoming.config.id + " ignorado");
+    return;
+  }
+  SiteRecord *existing = findSite(incoming.config.id);
+  if (existing) {
+    if (existing->config.url != incoming.config.url) {
+      existing->state.resolvedUrl = String();
+    }
+    existing->config = incoming.config;
+  } else {
+    sites_.push_back(incoming);
+    index_[incoming.config.id] = Slot{sites_.size() - 1, 0};
+    existing = &sites_.back();
+  }
+  // A new interval applies from the last check on.
+  if (!existing->state.inFlight) {
+    schedule(*existing, existing->state.checkedSinceBoot
+                            ? existing->state.lastCheckAt + existing->config.intervalSeconds * 1000UL
+                            : millis());
+  }
+  dirty_ = true;
+}
+
+// Keeps only the sites the server assigned to this daemon, as the firmware does.
+void MonitorDaemon::handleAssignShard(JsonObject payload) {
+  const String deviceId = payload["id"].as<String>();
+  if (deviceId != options_.deviceId) {
+    logLine("WARN", String("ASSIGN_SHARD para otro dispositivo: ") + deviceId);
+    return;
+  }
+  const uint32_t epoch = payload["epoch"] | 0u;
+  std::vector<String> ids;
+  for (JsonVariant id : payload["sites"].as<JsonArray>()) {
+    ids.push_back(id.as<String>());
+  }
+  switch (shard_.add(epoch, payload["part"] | 0, payload["parts"] | 1, ids)) {
+    case ShardAssignment::Result::Collecting:
+      return;
+    case ShardAssignment::Result::Rejected:
+      logLine("WARN", String("ASSIGN_SHARD época ") + epoch + " descartado (parte fuera de orden o época vieja)");
+      return;
+    case ShardAssignment::Result::Applied:
+      break;
+  }
+  const size_t released = forgetSites([this](const SiteRecord &rec) { return !shard_.owns(rec.config.id); });
+  logLine("INFO", String("Shard época ") + epoch + ": " + sites_.size() + " sitios propios, " + released +
+                      " liberados, " + shard_.missing(sites_).size() + " pendientes de configuración");
+  lastLoadReportAt_ = millis() - LOAD_REPORT_INTERVAL_MS;
+}
+
+// Checks still in flight for forgotten sites finish without a record.
+template <typename Predicate>
+size_t MonitorDaemon::forgetSites(Predicate matches) {
+  auto it = std::stable_partition(sites_.begin(), sites_.end(), [&](const SiteRecord &rec) { return !matches(rec); });
+  const size_t removed = sites_.end() - it;
+  for (auto forgotten = it; forgotten != sites_.end(); ++forgotten) {
+    SnapshotStore::remove(forgotten->config.id);
+    HistoryLog::remove(forgotten->config.id);
+    index_.erase(forgotten->config.id);
+  }
+  sites_.erase(it, sites_.end());
+  if (removed > 0) {
+    reindex();
+    dirty_ = true;
+  }
+  return removed;
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <Arduino.h>
+#include <EventQueue.h>
+#include <FetchEngine.h>
+#include <LoadMonitor.h>
+#include <MqttEngine.h>
+#include <ShardAssignment.h>
+#include <StorageManager.h>
+#include <TraceRing.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../src/check_pipeline.h"
+#include "WorkerPool.h"
+
+// Checks fetching or waiting for a worker at once.
+#ifndef DAEMON_MAX_IN_FLIGHT
+#define DAEMON_MAX_IN_FLIGHT 1024
+#endif
+
+// Body bytes kept per check when the site sets no max_bytes; the rest is
+// counted and dropped, and the event reports a capped fetch.
+#ifndef DAEMON_MAX_BODY_BYTES
+#define DAEMON_MAX_BODY_BYTES (2 * 1024 * 1024)
+#endif
+
+// sites.json is rewritten at most this often instead of after every check.
+#ifndef DAEMON_PERSIST_INTERVAL_MS
+#define DAEMON_PERSIST_INTERVAL_MS 5000
+#endif
+
+struct DaemonOptions {
+  String deviceId;
+  std::string deviceSecret;
+  String mqttHost = "127.0.0.1";
+  uint16_t mqttPort = 1883;
+  bool mqttTls = false;
+  // sites.json, the event spill file and the /prev/ snapshots live here.
+  String stateDir = "state";
+  size_t maxInFlight = DAEMON_MAX_IN_FLIGHT;
+  // 0: one per core.
+  size_t workers = 0;
+  size_t maxBodyBytes = DAEMON_MAX_BODY_BYTES;
+  uint32_t persistIntervalMs = DAEMON_PERSIST_INTERVAL_MS;
+  size_t eventRamSlots = 4096;
+  size_t maxEvents = 100000;
+  size_t mqttInflightWindow = 64;
+  size_t mqttOutboxSlots = 256;
+  size_t mqttMaxPacketBytes = 4096;
+  size_t dnsCacheEntries = 4096;
+};
+
+// The firmware's monitor for a Linux host: the same commands, events and LOAD
+// reports over the same MqttEngine, with the FetchEngine on epoll and
+// extraction, fingerprinting and diffing (check_pipeline) on a WorkerPool.
+// Due sites come off a min-heap instead of a scan of the list, so the loop
+// only touches the sites it starts or finishes.
+//
+// Single-threaded like the firmware's loop(): the caller runs poll()
+// repeatedly. Workers get a copy of the site and return its new state and
+// the serialized event; the loop merges both.
+class MonitorDaemon {
+ public:
+  struct Stats {
+    uint64_t checks = 0;
+    uint64_t changes = 0;
+    uint64_t errors = 0;
+    uint64_t commands = 0;
+    uint64_t rejectedCommands = 0;
+    uint64_t bodyBytes = 0;
+    uint64_t persists = 0;
+  };
+
+  explicit MonitorDaemon(DaemonOptions options);
+  ~MonitorDaemon();
+  MonitorDaemon(const MonitorDaemon &) = delete;
+  MonitorDaemon &operator=(const MonitorDaemon &) = delete;
+
+  bool begin();
+  // Advances MQTT, merges finished checks, starts due ones and waits up to
+  // waitMs for sockets.
+  void poll(uint32_t waitMs);
+  // Cancels the fetches in flight, lets the workers finish and saves the sites.
+  void stop();
+
+  size_t sites() const { return sites_.size(); }
+  // Fetching or on a worker.
+  size_t inFlight() const { return options_.maxInFlight - idleChecks_.size(); }
+  bool mqttConnected() const { return mqtt_.connected(); }
+  const String &commandTopic() const { return commandTopic_; }
+  const String &eventsTopic() const { return eventsTopic_; }
+  const String &loadTopic() const { return loadTopic_; }
+  const String &traceTopic() const { return traceTopic_; }
+  const Stats &stats() const { return stats_; }
+  const EventQueue &events() const { return eventQueue_; }
+  const WorkerPool &workers() const { return workers_; }
+  const DnsCache &dns() const { return dns_; }
+
+ private:
+  class Check;
+  struct Outcome;
+
+  struct DnsAnswer {
+    std::string host;
+    bool ok;
+    uint32_t address;
+    uint32_t lookupMs;
+  };
+
+  struct Due {
+    unsigned long at;
+    uint64_t ticket;
+    String id;
+    bool operator<(const Due &other) const { return at > other.at; }
+  };
+
+  // Where a site sits in sites_, and the schedule entry that is still valid.
+  struct Slot {
+    size_t index;
+    uint64_t ticket;
+  };
+
+  SiteRecord *findSite(const String &id);
+  void reindex();
+  void schedule(SiteRecord &record, unsigned long at);
+  void requestCheck(SiteRecord &record);
+
+  void dispatchDueChecks();
+  bool startCheck(SiteRecord &record, uint32_t lagMs);
+  void submitCheck(Check &check, const FetchResult &result);
+  void mergeOutcomes();
+  void persistIfDirty(bool force);
+  void prefetchDns();
+
+  bool sendEvent(const String &message);
+  void queueEvent(const char *type, const String &message);
+  void drainEventQueue();
+  void publishLoadReport();
+  void sendTraceDump();
+  void sendHistoryPart();
+
+  void handleMessage(const char *topic, size_t topicLength, char *payload, size_t length);
+  void handleCommand(char *payload, size_t length);
+  void handleUpsert(JsonObject payload);
+  void handleAssignShard(JsonObject payload);
+  void handleDumpTrace();
+  template <typename Predicate>
+  size_t forgetSites(Predicate matches);
+
+  DaemonOptions options_;
+  SocketTransport transport_;
+  MqttEngine mqtt_;
+  FetchEngine fetch_;
+  DnsCache dns_;
+  WorkerPool workers_;
+  StorageManager storage_;
+  EventQueue eventQueue_;
+  LoadMonitor loadMonitor_;
+  ShardAssignment shard_;
+
+  SiteList sites_;
+  std::unordered_map<std::string, Slot> index_;
+  std::priority_queue<Due> dueHeap_;
+  std::deque<String> requested_;
+  uint64_t nextTicket_ = 1;
+
+  std::vector<std::unique_ptr<Check>> checks_;
+  std::vector<Check *> idleChecks_;
+
+  std::mutex outcomesMutex_;
+  std::vector<Outcome> outcomes_;
+  // Prefetch lookups run on the workers; answers wait here for the loop.
+  std::vector<DnsAnswer> dnsAnswers_;
+  std::unordered_set<std::string> dnsPending_;
+  size_t dnsPrefetchCursor_ = 0;
+  unsigned long lastDnsPrefetchAt_ = 0;
+  // Read by workers for payload.queue.
+  std::atomic<uint32_t> queueDepth_{0};
+  std::atomic<uint32_t> queueDropped_{0};
+
+  String commandTopic_;
+  String eventsTopic_;
+  String loadTopic_;
+  String traceTopic_;
+  // Only the loop thread records into traceRing; workers never do.
+  TraceDumper traceDumper_;
+  uint32_t traceDumps_ = 0;
+  String historyTopic_;
+  HistoryReply historyReply_;
+  uint32_t historyRequests_ = 0;
+  unsigned long lastDrainAt_ = 0;
+  unsigned long lastLoadReportAt_ = 0;
+  unsigned long lastPersistAt_ = 0;
+  bool dirty_ = false;
+  bool running_ = false;
+  Stats stats_;
+};
@@ -0,0 +1,67 @@
+#include "WorkerPool.h"
+
+#include <time.h>
+
+namespace {
+uint64_t threadCpuMicros() {
+  timespec now{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000ULL + static_cast<uint64_t>(now.tv_nsec) / 1000;
+}
+}  // namespace
+
+WorkerPool::~WorkerPool() { stop(); }
+
+void WorkerPool::start(size_t threads) {
+  stop();
+  stopping_ = false;
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this]() { run(); });
+  }
+}
+
+void WorkerPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+void WorkerPool::submit(Job job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+  }
+  wake_.notify_one();
+}
+
+size_t WorkerPool::queued() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return jobs_.size();
+}
+
+void WorkerPool::run() {
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+      if (jobs_.empty()) {
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+    const uint64_t startedAt = threadCpuMicros();
+    job();
+    busyMicros_ += threadCpuMicros() - startedAt;
+  }
+}
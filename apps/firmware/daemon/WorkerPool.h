@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running extraction and hashing off the event loop.
+// Jobs must not touch the loop's state; they hand their results back through
+// whatever the caller's closure captures (a locked completion queue).
+class WorkerPool {
+ public:
+  using Job = std::function<void()>;
+
+  WorkerPool() = default;
+  ~WorkerPool();
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  // 0 uses one thread per core.
+  void start(size_t threads);
+  // Runs the queued jobs, then joins the threads.
+  void stop();
+  void submit(Job job);
+
+  size_t threads() const { return threads_.size(); }
+  size_t queued() const;
+  // CPU time the threads spent inside jobs.
+  uint64_t busyMicros() const { return busyMicros_.load(); }
+
+ private:
+  void run();
+
+  std::vector<std::thread> threads_;
+  std::deque<Job> jobs_;
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+  std::atomic<uint64_t> busyMicros_{0};
+};
@@ -0,0 +1,108 @@
+// Linux monitor daemon: the firmware's contract for hosts that check far more
+// sites than an ESP32 can. Settings come from the environment (DEVICE_ID,
+// DEVICE_SECRET, MQTT_HOST, MQTT_PORT, MQTT_TLS, STATE_DIR) and can be
+// overridden with --name=value flags of the same meaning.
+#include <Arduino.h>
+
+#include <csignal>
+#include <cstdlib>
+
+#include "MonitorDaemon.h"
+
+namespace {
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) { stopRequested = 1; }
+
+String envOr(const char *name, const char *fallback) {
+  const char *value = std::getenv(name);
+  return value && *value ? String(value) : String(fallback);
+}
+
+bool parseFlag(const String &arg, const char *name, String &out) {
+  const String prefix = String("--") + name + "=";
+  if (!arg.startsWith(prefix)) {
+    return false;
+  }
+  out = arg.substring(prefix.length());
+  return true;
+}
+
+void usage() {
+  std::fprintf(stderr,
+               "Uso: monitor-daemon [--device-id=ID] [--device-secret=S] [--mqtt-host=H] [--mqtt-port=P]\n"
+               "                    [--mqtt-tls=0|1] [--state-dir=DIR] [--workers=N] [--max-in-flight=N]\n"
+               "                    [--max-body-kb=N] [--persist-ms=N]\n");
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  DaemonOptions options;
+  options.deviceId = envOr("DEVICE_ID", "");
+  options.deviceSecret = envOr("DEVICE_SECRET", "").c_str();
+  options.mqttHost = envOr("MQTT_HOST", "127.0.0.1");
+  options.mqttPort = static_cast<uint16_t>(envOr("MQTT_PORT", "1883").toInt());
+  options.mqttTls = envOr("MQTT_TLS", "0") == "1";
+  options.stateDir = envOr("STATE_DIR", "state");
+  for (int i = 1; i < argc; ++i) {
+    const String arg(argv[i]);
+    String value;
+    if (parseFlag(arg, "device-id", value)) {
+      options.deviceId = value;
+    } else if (parseFlag(arg, "device-secret", value)) {
+      options.deviceSecret = value.c_str();
+    } else if (parseFlag(arg, "mqtt-host", value)) {
+      options.mqttHost = value;
+    } else if (parseFlag(arg, "mqtt-port", value)) {
+      options.mqttPort = static_cast<uint16_t>(value.toInt());
+    } else if (parseFlag(arg, "mqtt-tls", value)) {
+      options.mqttTls = value == "1";
+    } else if (parseFlag(arg, "state-dir", value)) {
+      options.stateDir = value;
+    } else if (parseFlag(arg, "workers", value)) {
+      options.workers = static_cast<size_t>(value.toInt());
+    } else if (parseFlag(arg, "max-in-flight", value)) {
+      options.maxInFlight = static_cast<size_t>(value.toInt());
+    } else if (parseFlag(arg, "max-body-kb", value)) {
+      options.maxBodyBytes = static_cast<size_t>(value.toInt()) * 1024;
+    } else if (parseFlag(arg, "persist-ms", value)) {
+      options.persistIntervalMs = static_cast<uint32_t>(value.toInt());
+    } else {
+      std::fprintf(stderr, "Argumento desconocido: %s\n", argv[i]);
+      usage();
+      return 1;
+    }
+  }
+  if (options.deviceId.isEmpty() || options.deviceSecret.empty()) {
+    std::fprintf(stderr, "Faltan DEVICE_ID y DEVICE_SECRET\n");
+    usage();
+    return 1;
+  }
+
+  std::signal(SIGINT, requestStop);
+  std::signal(SIGTERM, requestStop);
+  std::signal(SIGPIPE, SIG_IGN);
+
+  MonitorDaemon daemon(options);
+  if (!daemon.begin()) {
+    return 1;
+  }
+  unsigned long lastStatsAt = millis();
+  uint64_t checksAtLastStats = 0;
+  while (!stopRequested) {
+    daemon.poll(10);
+    const unsigned long now = millis();
+    if (now - lastStatsAt >= 60000) {
+      const MonitorDaemon::Stats &stats = daemon.stats();
+      Serial.printf("[INFO] %lu sitios, %llu chequeos en el último minuto, %u en curso, %u eventos en cola\n",
+                    static_cast<unsigned long>(daemon.sites()),
+                    static_cast<unsigned long long>(stats.checks - checksAtLastStats),
+                    static_cast<unsigned>(daemon.inFlight()), static_cast<unsigned>(daemon.events().depth()));
+      checksAtLastStats = stats.checks;
+      lastStatsAt = now;
+    }
+  }
+  Serial.printf("[INFO] Deteniendo, guardando estado en %s\n", options.stateDir.c_str());
+  daemon.stop();
+  return 0;
+}
@@ -0,0 +1,309 @@
+// Load harness for the Linux daemon: runs a MonitorDaemon in-process against
+// the loopback fixture server and MQTT broker of the firmware simulator,
+// drives it with signed commands like the server would, and prints a JSON
+// report with throughput, CPU time per check and memory. A restart from the
+// same state directory at the end checks that every site was persisted.
+#include <AllocProfile.h>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <sys/resource.h>
+#include <time.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+
+#include "../../sim/FixtureServer.h"
+#include "../../sim/MqttBroker.h"
+#include "../../sim/MqttBrokerServer.h"
+#include "../MonitorDaemon.h"
+
+namespace {
+
+const char *kDeviceId = "sim-daemon";
+const char *kDeviceSecret = "supersecret";
+
+struct Options {
+  size_t sites = 10000;
+  uint32_t rounds = 1;
+  size_t workers = 0;
+  size_t maxInFlight = 512;
+  uint16_t mqttPort = 18830;
+  String stateDir = ".pio/daemon_sim/state";
+  sim::FixtureServerOptions server;
+};
+
+struct FixtureProfile {
+  const char *file;
+  const char *mode;
+  const char *selector;
+  const char *startMarker;
+  const char *endMarker;
+  const char *regex;
+};
+
+const FixtureProfile kProfiles[] = {
+    {"product.html", "selector", "#price", "", "", ""},
+    {"listing.html", "selector", "li.item:nth-of-type(2)", "", "", ""},
+    {"article.html", "markers", "", "<!-- contenido:inicio -->", "<!-- contenido:fin -->", ""},
+    {"status.html", "regex", "", "", "", "Stock: (\\d+)"},
+    {"landing.html", "full", "", "", "", ""},
+};
+
+// Counted on the broker's connection thread as events arrive.
+std::atomic<uint32_t> received{0};
+std::atomic<uint32_t> changes{0};
+std::atomic<uint32_t> withDiff{0};
+std::atomic<uint32_t> errors{0};
+
+void onEvent(const String &, const String &message) {
+  StaticJsonDocument<2048> doc;
+  if (deserializeJson(doc, message)) {
+    return;
+  }
+  const char *type = doc["type"] | "";
+  if (strcmp(type, "CHANGE_DETECTED") == 0) {
+    ++changes;
+    withDiff += doc["payload"]["diff"]["hunks"].size() > 0 ? 1 : 0;
+  } else if (strcmp(type, "ERROR") == 0) {
+    ++errors;
+  }
+  ++received;
+}
+
+bool parseUint(const String &arg, const char *name, uint32_t &out) {
+  const String prefix = String("--") + name + "=";
+  if (!arg.startsWith(prefix)) {
+    return false;
+  }
+  out = static_cast<uint32_t>(arg.substring(prefix.length()).toInt());
+  return true;
+}
+
+Options parseOptions(int argc, char **argv) {
+  Options options;
+  options.server.latencyMs = 20;
+  options.server.jitterMs = 10;
+  options.server.changeEvery = 2;
+  for (int i = 1; i < argc; ++i) {
+    const String arg(argv[i]);
+    uint32_t value = 0;
+    if (parseUint(arg, "sites", value)) {
+      options.sites = value;
+    } else if (parseUint(arg, "rounds", value)) {
+      options.rounds = value;
+    } else if (parseUint(arg, "workers", value)) {
+      options.workers = value;
+    } else if (parseUint(arg, "max-in-flight", value)) {
+      options.maxInFlight = value;
+    } else if (parseUint(arg, "mqtt-port", value)) {
+      options.mqttPort = static_cast<uint16_t>(value);
+    } else if (parseUint(arg, "latency-ms", value)) {
+      options.server.latencyMs = value;
+    } else if (parseUint(arg, "jitter-ms", value)) {
+      options.server.jitterMs = value;
+    } else if (parseUint(arg, "change-every", value)) {
+      options.server.changeEvery = value;
+    } else if (arg.startsWith("--fixtures=")) {
+      options.server.fixturesDir = arg.substring(11);
+    } else if (arg.startsWith("--state-dir=")) {
+      options.stateDir = arg.substring(12);
+    } else {
+      std::fprintf(stderr, "Argumento desconocido: %s\n", argv[i]);
+    }
+  }
+  return options;
+}
+
+String signedCommand(const char *type, const std::function<void(JsonObject)> &fillPayload) {
+  StaticJsonDocument<1024> doc;
+  doc["type"] = type;
+  fillPayload(doc.createNestedObject("payload"));
+  doc["ts"] = static_cast<uint32_t>(millis() / 1000);
+  String canonical;
+  serializeJson(doc, canonical);
+  std::string hmac;
+  security::computeHmacBase64(kDeviceSecret, canonical.c_str(), hmac);
+  doc["hmac"] = hmac.c_str();
+  String message;
+  serializeJson(doc, message);
+  return message;
+}
+
+String siteId(size_t index) { return String("sim-") + index; }
+
+uint64_t threadCpuMicros() {
+  timespec now{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000ULL + static_cast<uint64_t>(now.tv_nsec) / 1000;
+}
+
+bool pumpUntil(MonitorDaemon &daemon, const std::function<bool()> &done, unsigned long timeoutMs) {
+  const unsigned long start = millis();
+  while (!done()) {
+    daemon.poll(1);
+    if (millis() - start > timeoutMs) {
+      return false;
+    }
+  }
+  return true;
+}
+
+long peakRssKb() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+DaemonOptions daemonOptions(const Options &options) {
+  DaemonOptions daemon;
+  daemon.deviceId = kDeviceId;
+  daemon.deviceSecret = kDeviceSecret;
+  daemon.mqttPort = options.mqttPort;
+  daemon.stateDir = options.stateDir;
+  daemon.workers = options.workers;
+  daemon.maxInFlight = options.maxInFlight;
+  return daemon;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const Options options = parseOptions(argc, argv);
+  std::system((String("rm -rf '") + options.stateDir + "'").c_str());
+  Serial.setMuted(true);
+
+  sim::FixtureServer server(options.server);
+  if (!server.start()) {
+    std::fprintf(stderr, "No se pudo iniciar el servidor de fixtures en %s\n", options.server.fixturesDir.c_str());
+    return 1;
+  }
+  auto &broker = sim::MqttBroker::instance();
+  sim::MqttBrokerServer brokerServer(broker);
+  if (!brokerServer.start(options.mqttPort)) {
+    std::fprintf(stderr, "No se pudo abrir el broker MQTT en 127.0.0.1:%u\n", options.mqttPort);
+    return 1;
+  }
+
+  DynamicJsonDocument report(ALLOC_PROFILE ? 16384 : 3072);
+  bool completed = true;
+  {
+    MonitorDaemon daemon(daemonOptions(options));
+    if (!daemon.begin()) {
+      return 1;
+    }
+    broker.addTap(daemon.eventsTopic(), onEvent);
+    if (!pumpUntil(daemon, [&]() { return broker.hasSubscriber(daemon.commandTopic()); }, 10000)) {
+      std::fprintf(stderr, "El daemon no se suscribió a %s\n", daemon.commandTopic().c_str());
+      return 1;
+    }
+
+    const unsigned long upsertStart = micros();
+    for (size_t i = 0; i < options.sites; ++i) {
+      const FixtureProfile &profile = kProfiles[i % (sizeof(kProfiles) / sizeof(kProfiles[0]))];
+      broker.publish(daemon.commandTopic(), signedCommand("UPSERT_SITE", [&](JsonObject payload) {
+                       payload["id"] = siteId(i);
+                       payload["url"] = server.urlFor(profile.file, i);
+                       payload["interval_s"] = 900;
+                       payload["mode"] = profile.mode;
+                       payload["selector_css"] = profile.selector;
+                       payload["start_marker"] = profile.startMarker;
+                       payload["end_marker"] = profile.endMarker;
+                       payload["regex"] = profile.regex;
+                     }));
+      if (i % 64 == 0) {
+        daemon.poll(0);
+      }
+    }
+    // New sites are due right away, so this is also the first cycle.
+    const bool firstCycle =
+        pumpUntil(daemon, [&]() { return received.load() >= static_cast<uint32_t>(options.sites); }, 600000);
+    const double firstCycleSeconds = static_cast<double>(micros() - upsertStart) / 1e6;
+    JsonObject first = report.createNestedObject("first_cycle");
+    first["completed"] = firstCycle;
+    first["seconds"] = firstCycleSeconds;
+    first["errors"] = errors.load();
+    completed = completed && firstCycle;
+
+    const uint32_t receivedBefore = received.load();
+    const uint32_t changesBefore = changes.load();
+    const uint32_t diffsBefore = withDiff.load();
+    const uint32_t errorsBefore = errors.load();
+    const uint64_t loopCpuBefore = threadCpuMicros();
+    const uint64_t workerCpuBefore = daemon.workers().busyMicros();
+    const unsigned long cycleStart = micros();
+    for (uint32_t round = 0; round < options.rounds; ++round) {
+      const uint32_t target = received.load() + static_cast<uint32_t>(options.sites);
+      for (size_t i = 0; i < options.sites; ++i) {
+        broker.publish(daemon.commandTopic(),
+                       signedCommand("CHECK_NOW", [&](JsonObject payload) { payload["id"] = siteId(i); }));
+        if (i % 64 == 0) {
+          daemon.poll(0);
+        }
+      }
+      completed = pumpUntil(daemon, [&]() { return received.load() >= target; }, 600000) && completed;
+    }
+    const double cycleSeconds = static_cast<double>(micros() - cycleStart) / 1e6;
+    const double loopCpuMs = static_cast<double>(threadCpuMicros() - loopCpuBefore) / 1000.0;
+    const double workerCpuMs = static_cast<double>(daemon.workers().busyMicros() - workerCpuBefore) / 1000.0;
+    const uint32_t checks = received.load() - receivedBefore;
+
+    JsonObject checksReport = report.createNestedObject("checks");
+    checksReport["events"] = checks;
+    checksReport["changed"] = changes.load() - changesBefore;
+    checksReport["changed_with_diff"] = withDiff.load() - diffsBefore;
+    checksReport["errors"] = errors.load() - errorsBefore;
+    checksReport["seconds"] = cycleSeconds;
+    checksReport["per_second"] = cycleSeconds > 0 ? checks / cycleSeconds : 0;
+    JsonObject cpu = report.createNestedObject("cpu");
+    // The loop thread also signs and publishes the harness's commands.
+    cpu["loop_ms"] = loopCpuMs;
+    cpu["workers_ms"] = workerCpuMs;
+    cpu["workers"] = static_cast<uint32_t>(daemon.workers().threads());
+    const double msPerCheck = checks > 0 ? (loopCpuMs + workerCpuMs) / checks : 0;
+    cpu["ms_per_check"] = msPerCheck;
+    // Sites one core keeps on the default 15-minute interval.
+    cpu["sites_per_core_900s"] = msPerCheck > 0 ? static_cast<uint32_t>(900000.0 / msPerCheck) : 0;
+    JsonObject daemonReport = report.createNestedObject("daemon");
+    daemonReport["commands"] = static_cast<uint32_t>(daemon.stats().commands);
+    daemonReport["rejected_commands"] = static_cast<uint32_t>(daemon.stats().rejectedCommands);
+    daemonReport["persists"] = static_cast<uint32_t>(daemon.stats().persists);
+    daemonReport["queue_depth"] = static_cast<uint32_t>(daemon.events().depth());
+    daemonReport["queue_dropped"] = daemon.events().stats().dropped;
+    daemonReport["max_in_flight"] = static_cast<uint32_t>(options.maxInFlight);
+    writeDnsStats(daemonReport.createNestedObject("dns"), daemon.dns());
+    daemon.stop();
+  }
+
+  // Same state directory, no commands: every site must come back.
+  size_t restored = 0;
+  {
+    MonitorDaemon restarted(daemonOptions(options));
+    restarted.begin();
+    restored = restarted.sites();
+    restarted.stop();
+  }
+  server.stop();
+  brokerServer.stop();
+
+  report["sites"] = static_cast<uint32_t>(options.sites);
+  report["rounds"] = options.rounds;
+  report["completed"] = completed;
+  JsonObject fixtures = report.createNestedObject("fixtures");
+  fixtures["latency_ms"] = options.server.latencyMs;
+  fixtures["jitter_ms"] = options.server.jitterMs;
+  fixtures["requests"] = static_cast<uint32_t>(server.requestsServed());
+  JsonObject restart = report.createNestedObject("restart");
+  restart["sites_restored"] = static_cast<uint32_t>(restored);
+  report["peak_rss_kb"] = peakRssKb();
+  DynamicJsonDocument alloc(ALLOC_PROFILE ? 12288 : 0);
+  if (ALLOC_PROFILE && !deserializeJson(alloc, allocprofile::toJson())) {
+    report["alloc"] = alloc.as<JsonObject>();
+  }
+
+  String serialized;
+  serializeJsonPretty(report, serialized);
+  std::printf("%s\n", serialized.c_str());
+  return completed && restored == options.sites ? 0 : 2;
+}
@@ -4,24 +4,97 @@
 #include <map>
 #include <vector>
 
+enum class ExtractMode : uint8_t { Full, Selector, Markers, Regex, List, Unknown };
+
+// Case-insensitive; an empty mode is "selector".
+inline ExtractMode parseExtractMode(const String &mode) {
+  if (mode.isEmpty() || mode.equalsIgnoreCase("selector")) {
+    return ExtractMode::Selector;
+  }
+  if (mode.equalsIgnoreCase("full")) {
+    return ExtractMode::Full;
+  }
+  if (mode.equalsIgnoreCase("markers")) {
+    return ExtractMode::Markers;
+  }
+  if (mode.equalsIgnoreCase("regex")) {
+    return ExtractMode::Regex;
+  }
+  return mode.equalsIgnoreCase("list") ? ExtractMode::List : ExtractMode::Unknown;
+}
+
 struct SiteConfig {
   String id;
   String url;
   uint32_t intervalSeconds = 900;
   String mode = "selector";
+  // parseExtractMode(mode), set wherever mode is, so checks never compare
+  // the string.
+  ExtractMode extractMode = ExtractMode::Selector;
   String selectorCss;
   String startMarker;
   String endMarker;
   String regex;
+  // "none" (default), "whitespace" or "text"; see ContentNormalizer.
+  String normalize;
+  String ignoreStartMarker;
+  String ignoreEndMarker;
+  // "sha256" (default): any change in the normalized content is a change.
+  // "simhash": only a SimHash more than simhashThreshold bits away is.
+  String fingerprint;
+  uint8_t simhashThreshold = 3;
+  // Body bytes downloaded per check at most; the rest is not read. 0 = no limit.
+  uint32_t maxBytes = 0;
+  // "list" sites: distinct items kept per check. 0 = LIST_MAX_ITEMS, which is
+  // also the most a site can ask for.
+  uint16_t maxItems = 0;
   std::map<String, String> headers;
   bool paused = false;
 };
 
 struct SiteState {
+  // SHA-256 hex for "sha256" sites; SimHash sites keep only `simhash`.
   String lastHash;
+  uint64_t simhash = 0;
+  bool hasSimhash = false;
+  uint8_t lastDistance = 0;
+  // Content-defined chunk digests of the last full-page check, and how many
+  // chunks the last check added/removed against the one before it.
+  std::vector<uint32_t> chunkDigests;
+  uint16_t chunksAdded = 0;
+  uint16_t chunksRemoved = 0;
+  // "list" sites: sorted digests of the items of the last check, how many
+  // items the page had and how many the last check added/removed.
+  std::vector<uint32_t> itemDigests;
+  uint16_t itemsSeen = 0;
+  uint16_t itemsAdded = 0;
+  uint16_t itemsRemoved = 0;
+  bool itemsTruncated = false;
   uint32_t lastStatus = 0;
   size_t lastSize = 0;
+  // Where the site's permanent redirects lead; checks fetch it directly until
+  // it answers 4xx/5xx or the site's URL changes. Empty when not redirected.
+  String resolvedUrl;
+  // "markers" sites: page offset and length of the markers and the text
+  // between them at the last check, and the page size, which decide the Range
+  // asked for next (markerBytes 0 = unknown). rangeRefused once the server
+  // answered a Range with the whole page.
+  uint32_t markerAt = 0;
+  uint32_t markerBytes = 0;
+  uint32_t pageBytes = 0;
+  bool rangeRefused = false;
   bool lastChanged = false;
+  // Body bytes downloaded by all checks of this site, and how many checks.
+  uint64_t bytesTotal = 0;
+  uint32_t checksTotal = 0;
+  // Scheduler bookkeeping, not persisted.
+  unsigned long lastCheckAt = 0;
+  bool checkedSinceBoot = false;
+  bool checkRequested = false;
+  bool inFlight = false;
+  // Held back by the fetch governor since deferredSince.
+  bool deferred = false;
+  unsigned long deferredSince = 0;
 };
 
 struct SiteRecord {
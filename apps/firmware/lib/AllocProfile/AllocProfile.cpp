@@ -0,0 +1,287 @@
+#include "AllocProfile.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+namespace allocprofile {
+namespace {
+
+// Constant-initialized so operator new can use them before any constructor
+// has run; nothing here allocates.
+struct Slot {
+  std::atomic<const char *> name{nullptr};
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> frees{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<int64_t> liveBytes{0};
+  std::atomic<int64_t> peakLiveBytes{0};
+  std::atomic<uint64_t> sizeClasses[kSizeClasses] = {};
+};
+
+Slot slots[kMaxTags];
+std::atomic<size_t> registered{1};
+std::mutex internMutex;
+thread_local uint8_t current = 0;
+
+const char *const kOther = "other";
+const char *const kOverflow = "overflow";
+
+char atExitPath[512] = {};
+
+const char *tagName(size_t tag) {
+  if (tag == 0) {
+    return kOther;
+  }
+  const char *name = slots[tag].name.load(std::memory_order_acquire);
+  return name ? name : kOverflow;
+}
+
+void appendStats(std::string &out, const TagStats &stats) {
+  char buffer[256];
+  std::snprintf(buffer, sizeof(buffer),
+                "{\"allocations\":%llu,\"frees\":%llu,\"bytes\":%llu,\"live_bytes\":%lld,\"peak_live_bytes\":%lld,"
+                "\"size_classes\":{",
+                static_cast<unsigned long long>(stats.allocations), static_cast<unsigned long long>(stats.frees),
+                static_cast<unsigned long long>(stats.bytes), static_cast<long long>(stats.liveBytes),
+                static_cast<long long>(stats.peakLiveBytes));
+  out += buffer;
+  bool first = true;
+  for (size_t i = 0; i < kSizeClasses; ++i) {
+    if (stats.sizeClasses[i] == 0) {
+      continue;
+    }
+    if (i + 1 == kSizeClasses) {
+      std::snprintf(buffer, sizeof(buffer), "%s\">%u\":%llu", first ? "" : ",", 16u << (kSizeClasses - 2),
+                    static_cast<unsigned long long>(stats.sizeClasses[i]));
+    } else {
+      std::snprintf(buffer, sizeof(buffer), "%s\"<=%u\":%llu", first ? "" : ",", 16u << i,
+                    static_cast<unsigned long long>(stats.sizeClasses[i]));
+    }
+    out += buffer;
+    first = false;
+  }
+  out += "}}";
+}
+
+void writeReport() {
+  FILE *file = std::fopen(atExitPath, "w");
+  if (!file) {
+    std::fprintf(stderr, "[WARN] No se pudo escribir el perfil de memoria en %s\n", atExitPath);
+    return;
+  }
+  const std::string json = toJson();
+  std::fwrite(json.data(), 1, json.size(), file);
+  std::fputc('\n', file);
+  std::fclose(file);
+}
+
+}  // namespace
+
+uint8_t intern(const char *name) {
+  std::lock_guard<std::mutex> lock(internMutex);
+  const size_t count = registered.load(std::memory_order_relaxed);
+  for (size_t i = 1; i < count; ++i) {
+    const char *known = slots[i].name.load(std::memory_order_relaxed);
+    if (known && std::strcmp(known, name) == 0) {
+      return static_cast<uint8_t>(i);
+    }
+  }
+  if (count == kMaxTags) {
+    return static_cast<uint8_t>(kMaxTags - 1);
+  }
+  // The last slot stays unnamed and reports as "overflow".
+  if (count + 1 < kMaxTags) {
+    slots[count].name.store(name, std::memory_order_release);
+  }
+  registered.store(count + 1, std::memory_order_release);
+  return static_cast<uint8_t>(count);
+}
+
+uint8_t currentTag() { return current; }
+
+size_t sizeClassOf(size_t bytes) {
+  size_t index = 0;
+  size_t limit = 16;
+  while (index + 1 < kSizeClasses && bytes > limit) {
+    limit <<= 1;
+    ++index;
+  }
+  return index;
+}
+
+void recordAlloc(uint8_t tag, size_t bytes) {
+  Slot &slot = slots[tag < kMaxTags ? tag : 0];
+  slot.allocations.fetch_add(1, std::memory_order_relaxed);
+  slot.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  slot.sizeClasses[sizeClassOf(bytes)].fetch_add(1, std::memory_order_relaxed);
+  const int64_t live = slot.liveBytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed) +
+                       static_cast<int64_t>(bytes);
+  int64_t peak = slot.peakLiveBytes.load(std::memory_order_relaxed);
+  while (live > peak && !slot.peakLiveBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+  }
+}
+
+void recordFree(uint8_t tag, size_t bytes) {
+  Slot &slot = slots[tag < kMaxTags ? tag : 0];
+  slot.frees.fetch_add(1, std::memory_order_relaxed);
+  slot.liveBytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+}
+
+void reset() {
+  for (Slot &slot : slots) {
+    slot.allocations.store(0, std::memory_order_relaxed);
+    slot.frees.store(0, std::memory_order_relaxed);
+    slot.bytes.store(0, std::memory_order_relaxed);
+    slot.liveBytes.store(0, std::memory_order_relaxed);
+    slot.peakLiveBytes.store(0, std::memory_order_relaxed);
+    for (auto &sizeClass : slot.sizeClasses) {
+      sizeClass.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+size_t tagCount() { return registered.load(std::memory_order_acquire); }
+
+TagStats snapshot(uint8_t tag) {
+  TagStats stats;
+  if (tag >= kMaxTags) {
+    return stats;
+  }
+  const Slot &slot = slots[tag];
+  stats.name = tagName(tag);
+  stats.allocations = slot.allocations.load(std::memory_order_relaxed);
+  stats.frees = slot.frees.load(std::memory_order_relaxed);
+  stats.bytes = slot.bytes.load(std::memory_order_relaxed);
+  stats.liveBytes = slot.liveBytes.load(std::memory_order_relaxed);
+  stats.peakLiveBytes = slot.peakLiveBytes.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < kSizeClasses; ++i) {
+    stats.sizeClasses[i] = slot.sizeClasses[i].load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+std::string toJson() {
+  // Read everything before building the string so its own allocations are
+  // not part of the report.
+  TagStats tags[kMaxTags];
+  TagStats total;
+  const size_t count = tagCount();
+  for (size_t i = 0; i < count; ++i) {
+    tags[i] = snapshot(static_cast<uint8_t>(i));
+    total.allocations += tags[i].allocations;
+    total.frees += tags[i].frees;
+    total.bytes += tags[i].bytes;
+    total.liveBytes += tags[i].liveBytes;
+    // Peaks of different tags need not coincide; the sum is an upper bound.
+    total.peakLiveBytes += tags[i].peakLiveBytes;
+    for (size_t j = 0; j < kSizeClasses; ++j) {
+      total.sizeClasses[j] += tags[i].sizeClasses[j];
+    }
+  }
+  std::string out;
+  out.reserve(512 + count * 320);
+  out += "{\"enabled\":";
+  out += ALLOC_PROFILE ? "true" : "false";
+  out += ",\"total\":";
+  appendStats(out, total);
+  out += ",\"tags\":{";
+  bool first = true;
+  for (size_t i = 0; i < count; ++i) {
+    if (tags[i].allocations == 0 && tags[i].frees == 0) {
+      continue;
+    }
+    if (!first) {
+      out += ",";
+    }
+    out += "\"";
+    out += tags[i].name;
+    out += "\":";
+    appendStats(out, tags[i]);
+    first = false;
+  }
+  out += "}}";
+  return out;
+}
+
+void writeAtExit(const char *path) {
+  const bool registeredBefore = atExitPath[0] != '\0';
+  std::snprintf(atExitPath, sizeof(atExitPath), "%s", path);
+  if (!registeredBefore) {
+    std::atexit(writeReport);
+  }
+}
+
+Scope::Scope(uint8_t tag) : previous_(current) { current = tag; }
+
+Scope::~Scope() { current = previous_; }
+
+}  // namespace allocprofile
+
+#if ALLOC_PROFILE && !defined(ESP_PLATFORM)
+// Every block carries its size and tag in a header so the free is charged to
+// the subsystem that allocated it. The aligned overloads keep the library's
+// implementation; nothing in the firmware uses over-aligned types.
+namespace {
+constexpr size_t kHeaderBytes = 16;
+
+struct Header {
+  size_t bytes;
+  uint8_t tag;
+};
+static_assert(sizeof(Header) <= kHeaderBytes, "la cabecera no cabe");
+
+void *profiledAlloc(size_t bytes) {
+  auto *block = static_cast<unsigned char *>(std::malloc(bytes + kHeaderBytes));
+  if (!block) {
+    return nullptr;
+  }
+  auto *header = reinterpret_cast<Header *>(block);
+  header->bytes = bytes;
+  header->tag = allocprofile::currentTag();
+  allocprofile::recordAlloc(header->tag, bytes);
+  return block + kHeaderBytes;
+}
+
+void profiledFree(void *pointer) {
+  if (!pointer) {
+    return;
+  }
+  auto *block = static_cast<unsigned char *>(pointer) - kHeaderBytes;
+  const auto *header = reinterpret_cast<const Header *>(block);
+  allocprofile::recordFree(header->tag, header->bytes);
+  std::free(block);
+}
+
+void *profiledAllocOrThrow(size_t bytes) {
+  void *pointer = profiledAlloc(bytes);
+  if (!pointer) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+struct AtExitFromEnv {
+  AtExitFromEnv() {
+    const char *path = std::getenv("ALLOC_PROFILE_OUT");
+    if (path && *path) {
+      allocprofile::writeAtExit(path);
+    }
+  }
+} atExitFromEnv;
+}  // namespace
+
+void *operator new(size_t bytes) { return profiledAllocOrThrow(bytes); }
+void *operator new[](size_t bytes) { return profiledAllocOrThrow(bytes); }
+void *operator new(size_t bytes, const std::nothrow_t &) noexcept { return profiledAlloc(bytes); }
+void *operator new[](size_t bytes, const std::nothrow_t &) noexcept { return profiledAlloc(bytes); }
+void operator delete(void *pointer) noexcept { profiledFree(pointer); }
+void operator delete[](void *pointer) noexcept { profiledFree(pointer); }
+void operator delete(void *pointer, size_t) noexcept { profiledFree(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { profiledFree(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { profiledFree(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { profiledFree(pointer); }
+#endif
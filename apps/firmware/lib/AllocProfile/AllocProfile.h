@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 1 replaces the global operator new/delete on the host build and turns
+// ALLOC_SCOPE into a real tag; 0 (default, and always on the ESP32) leaves
+// both untouched.
+#ifndef ALLOC_PROFILE
+#define ALLOC_PROFILE 0
+#endif
+
+// Allocation profile per subsystem for native runs. Each heap block is
+// charged to the innermost ALLOC_SCOPE active on the allocating thread
+// ("other" outside any), and its free to the same subsystem wherever it
+// happens, so live and peak bytes stay per owner. The shim String is a
+// std::string, so its buffers are counted like any other allocation.
+namespace allocprofile {
+
+constexpr size_t kMaxTags = 24;
+// Power-of-two size classes: <=16, <=32, ... <=64 KB, then everything larger.
+constexpr size_t kSizeClasses = 14;
+
+struct TagStats {
+  const char *name = nullptr;
+  uint64_t allocations = 0;
+  uint64_t frees = 0;
+  uint64_t bytes = 0;
+  int64_t liveBytes = 0;
+  int64_t peakLiveBytes = 0;
+  uint64_t sizeClasses[kSizeClasses] = {};
+};
+
+// Index of `name`, registering it on first use; the last slot absorbs
+// anything past kMaxTags.
+uint8_t intern(const char *name);
+uint8_t currentTag();
+
+void recordAlloc(uint8_t tag, size_t bytes);
+void recordFree(uint8_t tag, size_t bytes);
+size_t sizeClassOf(size_t bytes);
+
+// Zeroes every counter, keeping the registered tags; blocks allocated before
+// are still freed against their tag, so live bytes may go negative.
+void reset();
+TagStats snapshot(uint8_t tag);
+size_t tagCount();
+// {"total": {...}, "tags": {"css_select": {...}, ...}}, tags with no traffic left out.
+std::string toJson();
+// Writes toJson() to `path` when the process exits.
+void writeAtExit(const char *path);
+
+class Scope {
+ public:
+  explicit Scope(uint8_t tag);
+  ~Scope();
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+ private:
+  uint8_t previous_;
+};
+
+}  // namespace allocprofile
+
+#if ALLOC_PROFILE
+#define ALLOC_SCOPE_CONCAT2(a, b) a##b
+#define ALLOC_SCOPE_CONCAT(a, b) ALLOC_SCOPE_CONCAT2(a, b)
+#define ALLOC_SCOPE(name)                                                      \
+  static const uint8_t ALLOC_SCOPE_CONCAT(allocTag_, __LINE__) = allocprofile::intern(name); \
+  allocprofile::Scope ALLOC_SCOPE_CONCAT(allocScope_, __LINE__)(ALLOC_SCOPE_CONCAT(allocTag_, __LINE__))
+#else
+#define ALLOC_SCOPE(name) (void)0
+#endif
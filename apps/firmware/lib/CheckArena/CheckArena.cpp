@@ -0,0 +1,211 @@
+#include "CheckArena.h"
+
+#include <cstring>
+
+CheckArena *CheckArena::active_ = nullptr;
+CheckArena *CheckArena::registered_ = nullptr;
+
+namespace {
+size_t alignUp(size_t value, size_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+}  // namespace
+
+CheckArena::Scope::Scope(CheckArena &arena) : arena_(arena), previous_(CheckArena::active_) {
+  CheckArena::active_ = &arena_;
+}
+
+CheckArena::Scope::~Scope() {
+  CheckArena::active_ = previous_;
+  arena_.reset();
+}
+
+CheckArena::~CheckArena() {
+  for (CheckArena **link = &registered_; *link; link = &(*link)->nextRegistered_) {
+    if (*link == this) {
+      *link = nextRegistered_;
+      break;
+    }
+  }
+  if (active_ == this) {
+    active_ = nullptr;
+  }
+  std::free(base_);
+}
+
+bool CheckArena::begin(size_t capacity) {
+  if (base_) {
+    return capacity_ == capacity;
+  }
+  base_ = static_cast<uint8_t *>(std::malloc(capacity));
+  if (!base_) {
+    return false;
+  }
+  capacity_ = capacity;
+  offset_ = 0;
+  lastOffset_ = 0;
+  nextRegistered_ = registered_;
+  registered_ = this;
+  return true;
+}
+
+bool CheckArena::owns(const void *ptr) const {
+  const uint8_t *bytes = static_cast<const uint8_t *>(ptr);
+  return base_ && bytes >= base_ && bytes < base_ + capacity_;
+}
+
+void *CheckArena::allocate(size_t bytes, size_t alignment) {
+  if (!base_ || bytes == 0) {
+    return nullptr;
+  }
+  const size_t start = alignUp(offset_, alignment);
+  if (start > capacity_ || bytes > capacity_ - start) {
+    return nullptr;
+  }
+  lastOffset_ = start;
+  offset_ = start + bytes;
+  if (offset_ > stats_.highWater) {
+    stats_.highWater = offset_;
+  }
+  return base_ + start;
+}
+
+void *CheckArena::acquire(size_t bytes, size_t alignment) {
+  void *ptr = allocate(bytes, alignment);
+  if (ptr) {
+    return ptr;
+  }
+  ptr = std::malloc(bytes == 0 ? 1 : bytes);
+  if (ptr) {
+    overflowed_ = true;
+    ++stats_.fallbackAllocations;
+    stats_.fallbackBytes += bytes;
+    ++outstandingFallback_;
+  }
+  return ptr;
+}
+
+void CheckArena::release(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  if (owns(ptr)) {
+    if (static_cast<uint8_t *>(ptr) == base_ + lastOffset_) {
+      offset_ = lastOffset_;
+    }
+    return;
+  }
+  std::free(ptr);
+  if (outstandingFallback_ > 0) {
+    --outstandingFallback_;
+  }
+}
+
+void CheckArena::releaseAny(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  for (CheckArena *arena = registered_; arena; arena = arena->nextRegistered_) {
+    if (arena->owns(ptr)) {
+      arena->release(ptr);
+      return;
+    }
+  }
+  if (active_) {
+    active_->release(ptr);
+    return;
+  }
+  std::free(ptr);
+}
+
+bool CheckArena::extend(void *ptr, size_t oldBytes, size_t newBytes) {
+  if (!owns(ptr) || static_cast<uint8_t *>(ptr) != base_ + lastOffset_ || lastOffset_ + oldBytes != offset_) {
+    return false;
+  }
+  if (newBytes > capacity_ - lastOffset_) {
+    return false;
+  }
+  offset_ = lastOffset_ + newBytes;
+  if (offset_ > stats_.highWater) {
+    stats_.highWater = offset_;
+  }
+  return true;
+}
+
+void CheckArena::reset() {
+  ++stats_.checks;
+  stats_.lastCheckUsed = offset_;
+  if (overflowed_) {
+    ++stats_.overflowChecks;
+  }
+  overflowed_ = false;
+  offset_ = 0;
+  lastOffset_ = 0;
+}
+
+ArenaBuffer::~ArenaBuffer() { releaseStorage(); }
+
+void ArenaBuffer::release() {
+  releaseStorage();
+  size_ = 0;
+}
+
+void ArenaBuffer::releaseStorage() {
+  if (!data_) {
+    return;
+  }
+  if (arena_) {
+    arena_->release(data_);
+  } else {
+    CheckArena::releaseAny(data_);
+  }
+  data_ = nullptr;
+  capacity_ = 0;
+}
+
+bool ArenaBuffer::growInPlace(size_t bytes) {
+  if (bytes <= capacity_) {
+    return true;
+  }
+  if (data_ && arena_ && arena_->extend(data_, capacity_, bytes)) {
+    capacity_ = bytes;
+    return true;
+  }
+  return false;
+}
+
+bool ArenaBuffer::reserve(size_t bytes) {
+  if (growInPlace(bytes)) {
+    return true;
+  }
+  CheckArena *arena = bound_ ? bound_ : CheckArena::active();
+  char *next = static_cast<char *>(arena ? arena->acquire(bytes, 1) : std::malloc(bytes));
+  if (!next) {
+    return false;
+  }
+  if (size_ > 0) {
+    std::memcpy(next, data_, size_);
+  }
+  releaseStorage();
+  data_ = next;
+  capacity_ = bytes;
+  arena_ = arena;
+  return true;
+}
+
+bool ArenaBuffer::append(const char *data, size_t length) {
+  if (length == 0) {
+    return true;
+  }
+  if (size_ + length > capacity_) {
+    size_t target = capacity_ ? capacity_ * 2 : 1024;
+    while (target < size_ + length) {
+      target *= 2;
+    }
+    const size_t needed = size_ + length;
+    if (!growInPlace(target) && !growInPlace(needed) && !reserve(target) && !reserve(needed)) {
+      return false;
+    }
+  }
+  std::memcpy(data_ + size_, data, length);
+  size_ += length;
+  return true;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <Arduino.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Bump allocator reserved once at boot and rewound after every check, so the
+// transient buffers of fetch/extract/hash never fragment the general heap.
+// Requests that do not fit fall back to malloc and are counted.
+class CheckArena {
+ public:
+  struct Stats {
+    uint32_t checks = 0;
+    uint32_t overflowChecks = 0;
+    uint32_t fallbackAllocations = 0;
+    size_t fallbackBytes = 0;
+    size_t highWater = 0;
+    size_t lastCheckUsed = 0;
+  };
+
+  // Marks the duration of one check: activates the arena for ArenaAllocator and
+  // rewinds it on destruction. Declare it before any arena-backed object.
+  class Scope {
+   public:
+    explicit Scope(CheckArena &arena);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+   private:
+    CheckArena &arena_;
+    CheckArena *previous_;
+  };
+
+  CheckArena() = default;
+  ~CheckArena();
+  CheckArena(const CheckArena &) = delete;
+  CheckArena &operator=(const CheckArena &) = delete;
+
+  bool begin(size_t capacity);
+
+  // Arena memory or nullptr when it does not fit; never touches the heap.
+  void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+  // Arena memory, or a counted heap fallback. Pair with release().
+  void *acquire(size_t bytes, size_t alignment = alignof(std::max_align_t));
+  // Frees fallback blocks; for arena blocks only the most recent one is rewound.
+  void release(void *ptr);
+  // Grows the most recent allocation in place when it is the top of the arena.
+  bool extend(void *ptr, size_t oldBytes, size_t newBytes);
+  void reset();
+
+  bool owns(const void *ptr) const;
+  size_t capacity() const { return capacity_; }
+  size_t used() const { return offset_; }
+  size_t largestFree() const { return capacity_ - offset_; }
+  size_t outstandingFallbacks() const { return outstandingFallback_; }
+  const Stats &stats() const { return stats_; }
+
+  static CheckArena *active() { return active_; }
+  // Frees a block from acquire() whichever arena (if any) is active now.
+  static void releaseAny(void *ptr);
+
+ private:
+  uint8_t *base_ = nullptr;
+  size_t capacity_ = 0;
+  size_t offset_ = 0;
+  size_t lastOffset_ = 0;
+  size_t outstandingFallback_ = 0;
+  bool overflowed_ = false;
+  Stats stats_;
+  CheckArena *nextRegistered_ = nullptr;
+  static CheckArena *active_;
+  static CheckArena *registered_;
+};
+
+// Growable byte buffer carved from the active arena (heap fallback when it is
+// full or no check is running). A buffer bound to an arena fills that one
+// instead, e.g. a fetch slot receiving bytes outside any Scope.
+class ArenaBuffer {
+ public:
+  ArenaBuffer() = default;
+  explicit ArenaBuffer(CheckArena &arena) : bound_(&arena) {}
+  ~ArenaBuffer();
+  ArenaBuffer(const ArenaBuffer &) = delete;
+  ArenaBuffer &operator=(const ArenaBuffer &) = delete;
+
+  bool reserve(size_t bytes);
+  bool append(const char *data, size_t length);
+  void clear() { size_ = 0; }
+  void truncate(size_t length) { size_ = length < size_ ? length : size_; }
+  // Returns the storage; required before the owning arena is rewound.
+  void release();
+
+  const char *data() const { return data_ ? data_ : ""; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+ private:
+  bool growInPlace(size_t bytes);
+  void releaseStorage();
+
+  char *data_ = nullptr;
+  size_t size_ = 0;
+  size_t capacity_ = 0;
+  CheckArena *arena_ = nullptr;
+  CheckArena *bound_ = nullptr;
+};
+
+// STL allocator over CheckArena::active(); deallocation is a no-op for arena
+// memory because the whole arena is rewound at the end of the check.
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  ArenaAllocator() noexcept = default;
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &) noexcept {}
+
+  T *allocate(size_t count) {
+    CheckArena *arena = CheckArena::active();
+    void *ptr = arena ? arena->acquire(count * sizeof(T), alignof(T)) : std::malloc(count * sizeof(T));
+    if (!ptr) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(ptr);
+  }
+
+  void deallocate(T *ptr, size_t) noexcept { CheckArena::releaseAny(ptr); }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U> &) const noexcept {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U> &) const noexcept {
+    return false;
+  }
+};
@@ -0,0 +1,131 @@
+#include "ContentChunker.h"
+
+#include <algorithm>
+#include <array>
+
+namespace {
+constexpr uint32_t kFnvOffset = 0x811c9dc5u;
+constexpr uint32_t kFnvPrime = 0x01000193u;
+
+// Each shift pushes older bytes toward the top, so the high bits cover the
+// last 32 bytes; testing them (not the low bits) gives ~1 KiB past kMinChunk.
+constexpr uint32_t kBoundaryMask = 0xFFC00000u;
+
+constexpr uint64_t splitmix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+constexpr std::array<uint32_t, 256> makeGearTable() {
+  std::array<uint32_t, 256> table{};
+  for (size_t i = 0; i < table.size(); ++i) {
+    table[i] = static_cast<uint32_t>(splitmix(i) >> 32);
+  }
+  return table;
+}
+
+constexpr std::array<uint32_t, 256> kGear = makeGearTable();
+
+bool contains(const std::vector<uint32_t> &digests, uint32_t digest) {
+  return std::find(digests.begin(), digests.end(), digest) != digests.end();
+}
+}  // namespace
+
+void ContentChunker::begin(const std::vector<uint32_t> &previous) {
+  previous_ = previous;
+  digests_.clear();
+  rolling_ = 0;
+  digest_ = kFnvOffset;
+  chunkLength_ = 0;
+  headLength_ = 0;
+  added_ = 0;
+  removed_ = 0;
+  excerpt_ = String();
+}
+
+void ContentChunker::update(const char *data, size_t length) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < length; ++i) {
+    const uint8_t c = p[i];
+    digest_ = (digest_ ^ c) * kFnvPrime;
+    rolling_ = (rolling_ << 1) + kGear[c];
+    if (headLength_ < sizeof(head_)) {
+      head_[headLength_++] = static_cast<char>(c);
+    }
+    ++chunkLength_;
+    if (digests_.size() + 1 >= CDC_MAX_CHUNKS || chunkLength_ < kMinChunk) {
+      continue;
+    }
+    if ((rolling_ & kBoundaryMask) == 0 || chunkLength_ >= kMaxChunk) {
+      endChunk();
+    }
+  }
+}
+
+void ContentChunker::finish() {
+  if (chunkLength_ > 0) {
+    endChunk();
+  }
+  for (uint32_t digest : previous_) {
+    if (!contains(digests_, digest)) {
+      ++removed_;
+    }
+  }
+}
+
+void ContentChunker::endChunk() {
+  if (!previous_.empty() && !contains(previous_, digest_)) {
+    ++added_;
+    if (!excerpt_.isEmpty() && static_cast<size_t>(excerpt_.length()) < kExcerptBytes) {
+      excerpt_ += " … ";
+    }
+    const size_t excerptLength = excerpt_.length();
+    if (excerptLength < kExcerptBytes) {
+      excerpt_.concat(head_, std::min(headLength_, kExcerptBytes - excerptLength));
+    }
+  }
+  digests_.push_back(digest_);
+  rolling_ = 0;
+  digest_ = kFnvOffset;
+  chunkLength_ = 0;
+  headLength_ = 0;
+}
+
+String ContentChunker::toHex(const std::vector<uint32_t> &digests) {
+  String hex;
+  hex.reserve(digests.size() * 8);
+  char word[9];
+  for (uint32_t digest : digests) {
+    snprintf(word, sizeof(word), "%08x", static_cast<unsigned>(digest));
+    hex += word;
+  }
+  return hex;
+}
+
+bool ContentChunker::fromHex(const String &hex, std::vector<uint32_t> &digests) {
+  digests.clear();
+  const size_t length = hex.length();
+  if (length % 8 != 0) {
+    return false;
+  }
+  for (size_t i = 0; i < length; i += 8) {
+    uint32_t value = 0;
+    for (size_t j = i; j < i + 8; ++j) {
+      const char c = hex[j];
+      uint32_t digit = 0;
+      if (c >= '0' && c <= '9') {
+        digit = static_cast<uint32_t>(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        digit = static_cast<uint32_t>(c - 'a' + 10);
+      } else {
+        digests.clear();
+        return false;
+      }
+      value = (value << 4) | digit;
+    }
+    digests.push_back(value);
+  }
+  return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <vector>
+
+// Upper bound on the digests kept per site; the last chunk absorbs whatever
+// follows once it is reached.
+#ifndef CDC_MAX_CHUNKS
+#define CDC_MAX_CHUNKS 48
+#endif
+
+// Content-defined chunking with a gear hash (the rolling hash used by
+// FastCDC). Boundaries depend only on the bytes around them, so an edit
+// changes the digests of the chunks it touches and leaves the rest of the page
+// alone. Comparing against the previous check's digests tells which regions
+// are new; the head of each new chunk is kept as the excerpt. Memory is the
+// digest list plus a fixed excerpt buffer, whatever the input size.
+class ContentChunker {
+ public:
+  static constexpr size_t kMinChunk = 256;
+  static constexpr size_t kMaxChunk = 4096;
+  static constexpr size_t kExcerptBytes = 120;
+
+  // `previous` are the digests stored by the last check (possibly none).
+  void begin(const std::vector<uint32_t> &previous);
+  void update(const char *data, size_t length);
+  void finish();
+
+  const std::vector<uint32_t> &digests() const { return digests_; }
+  // Chunks whose digest was not in `previous`, and previous ones not seen now.
+  size_t addedChunks() const { return added_; }
+  size_t removedChunks() const { return removed_; }
+  // Heads of the added chunks, joined with " … ", at most kExcerptBytes.
+  const String &excerpt() const { return excerpt_; }
+
+  // Hex form kept in /sites.json (8 digits per chunk).
+  static String toHex(const std::vector<uint32_t> &digests);
+  static bool fromHex(const String &hex, std::vector<uint32_t> &digests);
+
+ private:
+  void endChunk();
+
+  std::vector<uint32_t> previous_;
+  std::vector<uint32_t> digests_;
+  uint32_t rolling_ = 0;
+  uint32_t digest_ = 0;
+  size_t chunkLength_ = 0;
+  char head_[kExcerptBytes];
+  size_t headLength_ = 0;
+  size_t added_ = 0;
+  size_t removed_ = 0;
+  String excerpt_;
+};
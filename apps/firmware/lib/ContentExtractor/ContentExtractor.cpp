@@ -1,110 +1,382 @@
 #include "ContentExtractor.h"
 
-#include <regex>
-#include <string>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+
+#include <AllocProfile.h>
 
+#if EXTRACT_MODE_SELECTOR || EXTRACT_MODE_LIST
 #include <CssSelectMini.h>
+#endif
 
-namespace {
-String trimmedCopy(String value) {
-  value.trim();
-  return value;
-}
+#if EXTRACT_MODE_REGEX
+#include <regex>
+#endif
 
+namespace {
 String lowerCopy(String value) {
   value.toLowerCase();
   return value;
 }
 
-ExtractionOutcome extractBySelector(const SiteConfig &config, const String &body) {
-  ExtractionOutcome outcome;
-  if (config.selectorCss.isEmpty()) {
-    outcome.errorMessage = F("selector_css vacío");
-    return outcome;
+ExtractionOutcome trimmedOutcome(const char *data, size_t length) {
+  size_t start = 0;
+  size_t end = length;
+  while (start < end && isspace(static_cast<unsigned char>(data[start]))) {
+    ++start;
   }
-  CssSelectMini css;
-  String extracted;
-  if (!css.selectInnerText(body, config.selectorCss, extracted)) {
-    outcome.errorMessage = F("Selector sin coincidencias");
-    return outcome;
+  while (end > start && isspace(static_cast<unsigned char>(data[end - 1]))) {
+    --end;
   }
+  ExtractionOutcome outcome;
   outcome.ok = true;
-  outcome.content = trimmedCopy(extracted);
+  outcome.data = data + start;
+  outcome.length = end - start;
   return outcome;
 }
 
-ExtractionOutcome extractByMarkers(const SiteConfig &config, const String &body) {
-  ExtractionOutcome outcome;
-  if (config.startMarker.isEmpty()) {
-    outcome.errorMessage = F("start_marker vacío");
-    return outcome;
-  }
-  int startIdx = body.indexOf(config.startMarker);
-  if (startIdx < 0) {
-    outcome.errorMessage = F("No se encontró start_marker");
-    return outcome;
+#if EXTRACT_MODE_MARKERS
+const char *findText(const char *haystack, size_t length, const String &needle, size_t from) {
+  const size_t needleLength = needle.length();
+  if (needleLength == 0 || from > length || length - from < needleLength) {
+    return nullptr;
   }
-  startIdx += config.startMarker.length();
-  int endIdx = config.endMarker.isEmpty() ? body.length() : body.indexOf(config.endMarker, startIdx);
-  if (!config.endMarker.isEmpty() && endIdx < 0) {
-    outcome.errorMessage = F("No se encontró end_marker");
-    return outcome;
+  const char *cursor = haystack + from;
+  const char *last = haystack + length - needleLength;
+  while (cursor <= last) {
+    cursor = static_cast<const char *>(memchr(cursor, needle[0], static_cast<size_t>(last - cursor) + 1));
+    if (!cursor) {
+      return nullptr;
+    }
+    if (memcmp(cursor, needle.c_str(), needleLength) == 0) {
+      return cursor;
+    }
+    ++cursor;
   }
-  String extracted = body.substring(startIdx, endIdx);
-  outcome.ok = true;
-  outcome.content = trimmedCopy(extracted);
-  return outcome;
+  return nullptr;
 }
+#endif
 
-ExtractionOutcome extractByRegex(const SiteConfig &config, const String &body) {
-  ExtractionOutcome outcome;
-  if (config.regex.isEmpty()) {
-    outcome.errorMessage = F("regex vacío");
+// One extractor per mode. extractAs() only instantiates the enabled ones, so
+// a mode left out of the build never reaches the linker.
+template <ExtractMode Mode>
+struct ModeExtractor;
+
+template <>
+struct ModeExtractor<ExtractMode::Full> {
+  static ExtractionOutcome extract(const SiteConfig &, const char *body, size_t length) {
+    ExtractionOutcome outcome;
+    outcome.ok = true;
+    outcome.data = body;
+    outcome.length = length;
     return outcome;
   }
-  try {
-    std::regex re(config.regex.c_str(), std::regex::ECMAScript);
-    std::smatch match;
-    std::string input(body.c_str());
-    if (!std::regex_search(input, match, re)) {
-      outcome.errorMessage = F("Regex sin coincidencias");
+};
+
+#if EXTRACT_MODE_SELECTOR
+template <>
+struct ModeExtractor<ExtractMode::Selector> {
+  static ExtractionOutcome extract(const SiteConfig &config, const char *body, size_t length) {
+    ExtractionOutcome outcome;
+    if (config.selectorCss.isEmpty()) {
+      outcome.errorMessage = F("selector_css vacío");
+      return outcome;
+    }
+    CssSelectMini css;
+    size_t start = 0;
+    size_t extractedLength = 0;
+    if (!css.selectInnerSpan(body, length, config.selectorCss, start, extractedLength)) {
+      outcome.errorMessage = F("Selector sin coincidencias");
+      return outcome;
+    }
+    return trimmedOutcome(body + start, extractedLength);
+  }
+};
+#endif
+
+#if EXTRACT_MODE_MARKERS
+template <>
+struct ModeExtractor<ExtractMode::Markers> {
+  static ExtractionOutcome extract(const SiteConfig &config, const char *body, size_t length) {
+    ExtractionOutcome outcome;
+    if (config.startMarker.isEmpty()) {
+      outcome.errorMessage = F("start_marker vacío");
+      return outcome;
+    }
+    const char *start = findText(body, length, config.startMarker, 0);
+    if (!start) {
+      outcome.errorMessage = F("No se encontró start_marker");
       return outcome;
     }
-    std::string selected;
-    if (match.size() > 1) {
-      selected = match[1].str();
-    } else {
-      selected = match[0].str();
+    start += config.startMarker.length();
+    const char *end = body + length;
+    if (!config.endMarker.isEmpty()) {
+      end = findText(body, length, config.endMarker, static_cast<size_t>(start - body));
+      if (!end) {
+        outcome.errorMessage = F("No se encontró end_marker");
+        return outcome;
+      }
+    }
+    return trimmedOutcome(start, static_cast<size_t>(end - start));
+  }
+};
+#endif
+
+#if EXTRACT_MODE_REGEX
+template <>
+struct ModeExtractor<ExtractMode::Regex> {
+  static ExtractionOutcome extract(const SiteConfig &config, const char *body, size_t length) {
+    ExtractionOutcome outcome;
+    if (config.regex.isEmpty()) {
+      outcome.errorMessage = F("regex vacío");
+      return outcome;
+    }
+    try {
+      std::regex re(config.regex.c_str(), std::regex::ECMAScript);
+      std::cmatch match;
+      if (!std::regex_search(body, body + length, match, re)) {
+        outcome.errorMessage = F("Regex sin coincidencias");
+        return outcome;
+      }
+      const auto &selected = match.size() > 1 ? match[1] : match[0];
+      if (!selected.matched) {
+        return trimmedOutcome(body, 0);
+      }
+      return trimmedOutcome(selected.first, static_cast<size_t>(selected.length()));
+    } catch (const std::regex_error &err) {
+      outcome.errorMessage = String(F("Regex inválida: ")) + err.what();
+      return outcome;
+    }
+  }
+};
+#endif
+
+#if EXTRACT_MODE_LIST
+template <>
+struct ModeExtractor<ExtractMode::List> {
+  static ExtractionOutcome extract(const SiteConfig &config, const char *body, size_t length) {
+    ExtractionOutcome outcome;
+    if (config.selectorCss.isEmpty()) {
+      outcome.errorMessage = F("selector_css vacío");
+      return outcome;
     }
     outcome.ok = true;
-    outcome.content = trimmedCopy(String(selected.c_str()));
+    outcome.data = body;
+    outcome.length = length;
     return outcome;
-  } catch (const std::regex_error &err) {
-    outcome.errorMessage = String(F("Regex inválida: ")) + err.what();
+  }
+
+  static size_t items(const SiteConfig &config, const char *body, size_t length, const ListItemFn &onItem,
+                      String &error) {
+    if (config.selectorCss.isEmpty()) {
+      error = F("selector_css vacío");
+      return 0;
+    }
+    CssSelectMini css;
+    size_t count = 0;
+    css.selectEach(body, length, config.selectorCss, [&](size_t start, size_t itemLength) {
+      onItem(body + start, itemLength);
+      ++count;
+      return true;
+    });
+    if (count == 0) {
+      error = F("Selector sin coincidencias");
+    }
+    return count;
+  }
+};
+#endif
+
+template <ExtractMode Mode>
+ExtractionOutcome extractAs(const SiteConfig &config, const char *body, size_t length) {
+  if constexpr (extractModeEnabled(Mode)) {
+    return ModeExtractor<Mode>::extract(config, body, length);
+  } else {
+    (void)body;
+    (void)length;
+    ExtractionOutcome outcome;
+    outcome.errorMessage = String(F("Modo no incluido en este firmware: ")) + lowerCopy(config.mode);
     return outcome;
   }
 }
 
 }  // namespace
 
-ExtractionOutcome extractContentForSite(const SiteConfig &config, const String &body) {
-  String mode = lowerCopy(config.mode);
-  if (mode == F("full")) {
-    ExtractionOutcome outcome;
-    outcome.ok = true;
-    outcome.content = body;
-    return outcome;
+ExtractionOutcome extractContentForSite(const SiteConfig &config, const char *body, size_t length) {
+  ALLOC_SCOPE("extractor");
+  switch (config.extractMode) {
+    case ExtractMode::Full:
+      return extractAs<ExtractMode::Full>(config, body, length);
+    case ExtractMode::Selector:
+      return extractAs<ExtractMode::Selector>(config, body, length);
+    case ExtractMode::Markers:
+      return extractAs<ExtractMode::Markers>(config, body, length);
+    case ExtractMode::Regex:
+      return extractAs<ExtractMode::Regex>(config, body, length);
+    case ExtractMode::List:
+      return extractAs<ExtractMode::List>(config, body, length);
+    case ExtractMode::Unknown:
+      break;
   }
-  if (mode == F("selector") || mode.isEmpty()) {
-    return extractBySelector(config, body);
+  ExtractionOutcome outcome;
+  outcome.errorMessage = String(F("Modo desconocido: ")) + lowerCopy(config.mode);
+  return outcome;
+}
+
+size_t extractListItems(const SiteConfig &config, const char *body, size_t length, const ListItemFn &onItem,
+                        String &error) {
+  ALLOC_SCOPE("extractor");
+#if EXTRACT_MODE_LIST
+  return ModeExtractor<ExtractMode::List>::items(config, body, length, onItem, error);
+#else
+  (void)body;
+  (void)length;
+  (void)onItem;
+  error = String(F("Modo no incluido en este firmware: ")) + lowerCopy(config.mode);
+  return 0;
+#endif
+}
+
+#if EXTRACT_MODE_MARKERS
+void MarkerStream::begin(const SiteConfig &config, ArenaBuffer &out, size_t maxBytes, size_t pageOffset) {
+  ALLOC_SCOPE("extractor");
+  position_ = pageOffset;
+  insideStart_ = 0;
+  markersStart_ = 0;
+  markersEnd_ = 0;
+  start_ = config.startMarker;
+  end_ = config.endMarker;
+  carry_ = String();
+  out_ = &out;
+  out_->clear();
+  maxBytes_ = maxBytes;
+  state_ = start_.isEmpty() ? State::Empty : State::Start;
+}
+
+size_t MarkerStream::findStart(const char *data, size_t length) {
+  const size_t markerLength = start_.length();
+  if (!carry_.isEmpty()) {
+    // carry_ is shorter than the marker, so a hit here straddles both pieces.
+    String window = carry_;
+    window.concat(data, std::min(length, markerLength - 1));
+    const char *hit = findText(window.c_str(), window.length(), start_, 0);
+    if (hit) {
+      const size_t offset = static_cast<size_t>(hit - window.c_str()) + markerLength - carry_.length();
+      carry_ = String();
+      return offset;
+    }
   }
-  if (mode == F("markers")) {
-    return extractByMarkers(config, body);
+  const char *hit = findText(data, length, start_, 0);
+  if (hit) {
+    carry_ = String();
+    return static_cast<size_t>(hit - data) + markerLength;
   }
-  if (mode == F("regex")) {
-    return extractByRegex(config, body);
+  const size_t keep = markerLength - 1;
+  if (length >= keep) {
+    carry_ = String(data + length - keep, keep);
+  } else {
+    carry_.concat(data, length);
+    if (static_cast<size_t>(carry_.length()) > keep) {
+      carry_ = carry_.substring(carry_.length() - keep);
+    }
   }
+  return SIZE_MAX;
+}
+
+void MarkerStream::appendInside(const char *data, size_t length) {
+  const size_t before = out_->size();
+  const size_t endLength = end_.length();
+  // Room for the end marker itself past maxBytes of content.
+  const size_t limit = maxBytes_ + endLength;
+  const size_t take = std::min(length, limit - before);
+  if (!out_->append(data, take)) {
+    state_ = State::Overflow;
+    return;
+  }
+  if (endLength > 0) {
+    const size_t from = before >= endLength ? before - (endLength - 1) : 0;
+    const char *hit = findText(out_->data(), out_->size(), end_, from);
+    if (hit) {
+      out_->truncate(static_cast<size_t>(hit - out_->data()));
+      markersEnd_ = insideStart_ + out_->size() + endLength;
+      state_ = State::Done;
+      return;
+    }
+  }
+  if (take < length) {
+    state_ = State::Overflow;
+  }
+}
+
+bool MarkerStream::update(const char *data, size_t length) {
+  ALLOC_SCOPE("extractor");
+  const size_t base = position_;
+  position_ += length;
+  if (state_ == State::Start) {
+    const size_t offset = findStart(data, length);
+    if (offset == SIZE_MAX) {
+      return true;
+    }
+    state_ = State::Inside;
+    insideStart_ = base + offset;
+    markersStart_ = insideStart_ - start_.length();
+    data += offset;
+    length -= offset;
+  }
+  if (state_ == State::Inside && length > 0) {
+    appendInside(data, length);
+  }
+  return state_ != State::Overflow;
+}
+
+ExtractionOutcome MarkerStream::finish() {
   ExtractionOutcome outcome;
-  outcome.errorMessage = String(F("Modo desconocido: ")) + mode;
-  return outcome;
+  switch (state_) {
+    case State::Empty:
+      outcome.errorMessage = F("start_marker vacío");
+      return outcome;
+    case State::Start:
+      outcome.errorMessage = F("No se encontró start_marker");
+      return outcome;
+    case State::Overflow:
+      outcome.errorMessage = String(F("Texto entre marcadores supera ")) + maxBytes_ + " bytes";
+      return outcome;
+    case State::Inside:
+      if (!end_.isEmpty()) {
+        outcome.errorMessage = F("No se encontró end_marker");
+        return outcome;
+      }
+      markersEnd_ = insideStart_ + out_->size();
+      break;
+    case State::Done:
+      break;
+  }
+  return trimmedOutcome(out_->data(), out_->size());
+}
+
+ByteWindow markerWindowFor(const SiteConfig &config, const SiteState &state) {
+  ByteWindow window;
+  if (config.extractMode != ExtractMode::Markers || state.rangeRefused || state.markerBytes == 0 ||
+      state.pageBytes == 0) {
+    return window;
+  }
+  // Without end_marker the text runs to the end of the page, wherever it is.
+  if (config.endMarker.isEmpty()) {
+    return window;
+  }
+  const size_t start = state.markerAt > MARKERS_RANGE_MARGIN ? state.markerAt - MARKERS_RANGE_MARGIN : 0;
+  size_t end = static_cast<size_t>(state.markerAt) + state.markerBytes + MARKERS_RANGE_MARGIN;
+  if (config.maxBytes > 0) {
+    end = std::min<size_t>(end, config.maxBytes);
+  }
+  // A miss costs a second request, so small savings are not worth it.
+  if (end <= start || (end - start) * 2 > state.pageBytes) {
+    return window;
+  }
+  window.start = start;
+  window.bytes = end - start;
+  return window;
 }
+#endif
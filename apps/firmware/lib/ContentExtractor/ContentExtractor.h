@@ -1,13 +1,130 @@
 #pragma once
 
 #include <Arduino.h>
+#include <CheckArena.h>
+
+#include <functional>
 
 #include "site_record.h"
 
+// Extraction modes built into the firmware. A build profile in platformio.ini
+// leaves out the modes its sites never use, and their code with them
+// (std::regex for regex, CssSelectMini for selector and list).
+#ifndef EXTRACT_MODE_FULL
+#define EXTRACT_MODE_FULL 1
+#endif
+
+#ifndef EXTRACT_MODE_SELECTOR
+#define EXTRACT_MODE_SELECTOR 1
+#endif
+
+#ifndef EXTRACT_MODE_MARKERS
+#define EXTRACT_MODE_MARKERS 1
+#endif
+
+#ifndef EXTRACT_MODE_REGEX
+#define EXTRACT_MODE_REGEX 1
+#endif
+
+#ifndef EXTRACT_MODE_LIST
+#define EXTRACT_MODE_LIST 1
+#endif
+
+struct ExtractModeInfo {
+  ExtractMode mode;
+  const char *name;
+  bool enabled;
+};
+
+constexpr ExtractModeInfo kExtractModes[] = {
+    {ExtractMode::Full, "full", EXTRACT_MODE_FULL != 0},
+    {ExtractMode::Selector, "selector", EXTRACT_MODE_SELECTOR != 0},
+    {ExtractMode::Markers, "markers", EXTRACT_MODE_MARKERS != 0},
+    {ExtractMode::Regex, "regex", EXTRACT_MODE_REGEX != 0},
+    {ExtractMode::List, "list", EXTRACT_MODE_LIST != 0},
+};
+
+constexpr bool extractModeEnabled(ExtractMode mode) {
+  for (const ExtractModeInfo &info : kExtractModes) {
+    if (info.mode == mode) {
+      return info.enabled;
+    }
+  }
+  return false;
+}
+
+// The extracted content is a view into the body passed to
+// extractContentForSite; it stays valid while that buffer is alive.
 struct ExtractionOutcome {
   bool ok = false;
-  String content;
+  const char *data = nullptr;
+  size_t length = 0;
   String errorMessage;
 };
 
-ExtractionOutcome extractContentForSite(const SiteConfig &config, const String &body);
+// Dispatches on config.extractMode; a mode left out of the build fails the
+// check with an error instead of extracting. For "list" the outcome is the
+// whole body: its items are read by extractListItems.
+ExtractionOutcome extractContentForSite(const SiteConfig &config, const char *body, size_t length);
+
+// "list" mode: calls onItem with the trimmed inner HTML of each element that
+// matches config.selectorCss, in page order, in a single pass over the body.
+// Returns how many there were; 0 with `error` set when there were none.
+using ListItemFn = std::function<void(const char *data, size_t length)>;
+size_t extractListItems(const SiteConfig &config, const char *body, size_t length, const ListItemFn &onItem,
+                        String &error);
+
+struct ByteWindow {
+  size_t start = 0;
+  // 0: fetch the whole page.
+  size_t bytes = 0;
+};
+
+#if EXTRACT_MODE_MARKERS
+// Room left around the markers when a "markers" site is fetched with Range.
+#ifndef MARKERS_RANGE_MARGIN
+#define MARKERS_RANGE_MARGIN 2048
+#endif
+
+// Markers extraction over a body that arrives in pieces (markers may be split
+// between them): only the text between the markers is kept, in `out`, so the
+// page itself is never buffered. finish() gives the same outcome as
+// extractContentForSite on the whole body, pointing into `out`.
+class MarkerStream {
+ public:
+  // `pageOffset` is where the body starts in the page (a Range response).
+  void begin(const SiteConfig &config, ArenaBuffer &out, size_t maxBytes, size_t pageOffset = 0);
+  // Returns false once the text between the markers exceeds maxBytes.
+  bool update(const char *data, size_t length);
+  ExtractionOutcome finish();
+  // After a successful finish(): page offsets of the start marker and just
+  // past the end marker (or the end of the body when there is none).
+  size_t markersStart() const { return markersStart_; }
+  size_t markersEnd() const { return markersEnd_; }
+
+ private:
+  enum class State { Empty, Start, Inside, Done, Overflow };
+
+  size_t findStart(const char *data, size_t length);
+  void appendInside(const char *data, size_t length);
+
+  State state_ = State::Empty;
+  String start_;
+  String end_;
+  // Tail of the data seen so far, shorter than start_.
+  String carry_;
+  ArenaBuffer *out_ = nullptr;
+  size_t maxBytes_ = 0;
+  // Page offset of the next byte update() receives.
+  size_t position_ = 0;
+  size_t insideStart_ = 0;
+  size_t markersStart_ = 0;
+  size_t markersEnd_ = 0;
+};
+
+// The part of a "markers" site's page worth asking for with Range: where the
+// last check found the markers, MARKERS_RANGE_MARGIN to each side. Whole page
+// when nothing was learned yet, the server ignored a Range before, or the
+// window would not save at least half of the page.
+ByteWindow markerWindowFor(const SiteConfig &config, const SiteState &state);
+#endif
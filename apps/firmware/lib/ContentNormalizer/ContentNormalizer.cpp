@@ -0,0 +1,365 @@
+#include "ContentNormalizer.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+struct NamedEntity {
+  const char *name;
+  uint32_t codepoint;
+};
+
+// The ones that show up in practice; anything else is kept verbatim, which is
+// still stable for hashing.
+const NamedEntity kNamedEntities[] = {
+    {"amp", '&'},      {"lt", '<'},       {"gt", '>'},      {"quot", '"'},    {"apos", '\''},
+    {"nbsp", ' '},     {"copy", 0xA9},    {"reg", 0xAE},    {"euro", 0x20AC}, {"hellip", 0x2026},
+    {"ndash", 0x2013}, {"mdash", 0x2014}, {"laquo", 0xAB},  {"raquo", 0xBB},  {"middot", 0xB7},
+};
+
+std::vector<size_t> failureTable(const String &marker) {
+  const size_t length = marker.length();
+  std::vector<size_t> table(length, 0);
+  size_t k = 0;
+  for (size_t i = 1; i < length; ++i) {
+    while (k > 0 && marker[i] != marker[k]) {
+      k = table[k - 1];
+    }
+    if (marker[i] == marker[k]) {
+      ++k;
+    }
+    table[i] = k;
+  }
+  return table;
+}
+
+bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\v'; }
+
+char lower(char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); }
+}  // namespace
+
+NormalizeOptions normalizeOptionsForSite(const SiteConfig &config) {
+  NormalizeOptions options;
+  if (config.normalize.equalsIgnoreCase("text")) {
+    options.mode = NormalizeMode::Text;
+  } else if (config.normalize.equalsIgnoreCase("whitespace")) {
+    options.mode = NormalizeMode::Whitespace;
+  } else if (config.normalize.isEmpty() && config.fingerprint.equalsIgnoreCase("simhash")) {
+    // Shingles of markup would mostly track attribute churn, not the text.
+    options.mode = NormalizeMode::Text;
+  }
+  options.ignoreStart = config.ignoreStartMarker;
+  options.ignoreEnd = config.ignoreEndMarker;
+  return options;
+}
+
+void ContentNormalizer::begin(const NormalizeOptions &options, Output output) {
+  options_ = options;
+  output_ = std::move(output);
+  startFailure_ = failureTable(options_.ignoreStart);
+  endFailure_ = failureTable(options_.ignoreEnd);
+  markerMatched_ = 0;
+  ignoring_ = false;
+  state_ = State::Text;
+  tagNameLength_ = 0;
+  closingTag_ = false;
+  quote_ = 0;
+  dashes_ = 0;
+  rawTextEnd_ = nullptr;
+  rawTextMatched_ = 0;
+  entityLength_ = 0;
+  pendingSpace_ = false;
+  wroteText_ = false;
+  bufferLength_ = 0;
+  inputBytes_ = 0;
+  outputBytes_ = 0;
+}
+
+void ContentNormalizer::update(const char *data, size_t length) {
+  inputBytes_ += length;
+  if (options_.mode == NormalizeMode::None && options_.ignoreStart.isEmpty()) {
+    flush();
+    outputBytes_ += length;
+    if (output_) {
+      output_(data, length);
+    }
+    return;
+  }
+  if (options_.ignoreStart.isEmpty()) {
+    for (size_t i = 0; i < length; ++i) {
+      step(data[i]);
+    }
+    return;
+  }
+  for (size_t i = 0; i < length; ++i) {
+    filterIgnored(data[i]);
+  }
+}
+
+void ContentNormalizer::finish() {
+  if (!ignoring_) {
+    releaseMarker(markerMatched_);
+  }
+  markerMatched_ = 0;
+  if (state_ == State::Entity) {
+    flushEntity();
+  } else if (state_ == State::TagOpen) {
+    emitText('<');
+  }
+  state_ = State::Text;
+  flush();
+}
+
+// Bytes that might begin a marker are held back (as a match count) until the
+// marker either completes or fails; on failure the bytes that can no longer
+// be part of it are replayed from the marker text itself.
+void ContentNormalizer::filterIgnored(char c) {
+  const String &marker = ignoring_ ? options_.ignoreEnd : options_.ignoreStart;
+  if (marker.isEmpty()) {
+    return;
+  }
+  const std::vector<size_t> &failure = ignoring_ ? endFailure_ : startFailure_;
+  while (markerMatched_ > 0 && marker[markerMatched_] != c) {
+    const size_t fallback = failure[markerMatched_ - 1];
+    if (!ignoring_) {
+      releaseMarker(markerMatched_ - fallback);
+    }
+    markerMatched_ = fallback;
+  }
+  if (marker[markerMatched_] != c) {
+    if (!ignoring_) {
+      step(c);
+    }
+    return;
+  }
+  if (++markerMatched_ < static_cast<size_t>(marker.length())) {
+    return;
+  }
+  markerMatched_ = 0;
+  ignoring_ = !ignoring_;
+  if (options_.mode == NormalizeMode::Text) {
+    boundary();
+  }
+}
+
+void ContentNormalizer::releaseMarker(size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    step(options_.ignoreStart[i]);
+  }
+}
+
+void ContentNormalizer::step(char c) {
+  if (options_.mode == NormalizeMode::None) {
+    put(c);
+    return;
+  }
+  if (options_.mode == NormalizeMode::Whitespace) {
+    emitText(c);
+    return;
+  }
+  switch (state_) {
+    case State::Text:
+      if (c == '<') {
+        state_ = State::TagOpen;
+      } else if (c == '&') {
+        entityLength_ = 0;
+        state_ = State::Entity;
+      } else {
+        emitText(c);
+      }
+      return;
+    case State::Entity:
+      if (c == ';') {
+        if (!decodeEntity()) {
+          flushEntity();
+          emitText(';');
+        }
+        state_ = State::Text;
+      } else if ((isalnum(static_cast<unsigned char>(c)) || c == '#') && entityLength_ < sizeof(entity_)) {
+        entity_[entityLength_++] = c;
+      } else {
+        flushEntity();
+        state_ = State::Text;
+        step(c);
+      }
+      return;
+    case State::TagOpen:
+      if (c == '/' || isalpha(static_cast<unsigned char>(c))) {
+        closingTag_ = c == '/';
+        tagNameLength_ = 0;
+        if (!closingTag_) {
+          tagName_[tagNameLength_++] = lower(c);
+        }
+        state_ = State::TagName;
+      } else if (c == '!') {
+        dashes_ = 0;
+        state_ = State::Bang;
+      } else if (c == '?') {
+        state_ = State::Declaration;
+      } else {
+        // A bare '<' in text, e.g. "a < b".
+        state_ = State::Text;
+        emitText('<');
+        step(c);
+      }
+      return;
+    case State::TagName:
+      if (c == '>') {
+        endTag();
+      } else if (isSpace(c) || c == '/') {
+        state_ = State::Tag;
+      } else if (tagNameLength_ < sizeof(tagName_)) {
+        tagName_[tagNameLength_++] = lower(c);
+      }
+      return;
+    case State::Tag:
+      if (c == '"' || c == '\'') {
+        quote_ = c;
+        state_ = State::TagQuote;
+      } else if (c == '>') {
+        endTag();
+      }
+      return;
+    case State::TagQuote:
+      if (c == quote_) {
+        state_ = State::Tag;
+      }
+      return;
+    case State::Bang:
+      if (c == '-' && ++dashes_ == 2) {
+        dashes_ = 0;
+        state_ = State::Comment;
+      } else if (c != '-') {
+        state_ = c == '>' ? State::Text : State::Declaration;
+      }
+      return;
+    case State::Comment:
+      if (c == '>' && dashes_ >= 2) {
+        state_ = State::Text;
+        boundary();
+      } else {
+        dashes_ = c == '-' ? static_cast<uint8_t>(dashes_ + 1) : 0;
+      }
+      return;
+    case State::Declaration:
+      if (c == '>') {
+        state_ = State::Text;
+        boundary();
+      }
+      return;
+    case State::RawText:
+      // rawTextEnd_ is "</script" or "</style"; only its leading '<' can
+      // restart a failed match.
+      if (lower(c) == rawTextEnd_[rawTextMatched_]) {
+        if (rawTextEnd_[++rawTextMatched_] == '\0') {
+          closingTag_ = true;
+          state_ = State::Tag;
+        }
+      } else {
+        rawTextMatched_ = c == '<' ? 1 : 0;
+      }
+      return;
+  }
+}
+
+void ContentNormalizer::endTag() {
+  boundary();
+  state_ = State::Text;
+  if (closingTag_) {
+    return;
+  }
+  if (tagNameLength_ == 6 && memcmp(tagName_, "script", 6) == 0) {
+    rawTextEnd_ = "</script";
+  } else if (tagNameLength_ == 5 && memcmp(tagName_, "style", 5) == 0) {
+    rawTextEnd_ = "</style";
+  } else {
+    return;
+  }
+  rawTextMatched_ = 0;
+  state_ = State::RawText;
+}
+
+void ContentNormalizer::flushEntity() {
+  emitText('&');
+  for (uint8_t i = 0; i < entityLength_; ++i) {
+    emitText(entity_[i]);
+  }
+  entityLength_ = 0;
+}
+
+bool ContentNormalizer::decodeEntity() {
+  if (entityLength_ == 0 || entityLength_ >= sizeof(entity_)) {
+    return false;
+  }
+  entity_[entityLength_] = '\0';
+  if (entity_[0] == '#') {
+    const bool hex = entity_[1] == 'x' || entity_[1] == 'X';
+    const char *digits = entity_ + (hex ? 2 : 1);
+    char *end = nullptr;
+    const unsigned long codepoint = strtoul(digits, &end, hex ? 16 : 10);
+    if (*digits == '\0' || *end != '\0' || codepoint == 0 || codepoint > 0x10FFFF) {
+      return false;
+    }
+    emitCodepoint(codepoint == 0xA0 ? ' ' : static_cast<uint32_t>(codepoint));
+    entityLength_ = 0;
+    return true;
+  }
+  for (const NamedEntity &named : kNamedEntities) {
+    if (strcmp(named.name, entity_) == 0) {
+      emitCodepoint(named.codepoint);
+      entityLength_ = 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ContentNormalizer::emitText(char c) {
+  if (isSpace(c)) {
+    pendingSpace_ = wroteText_;
+    return;
+  }
+  if (pendingSpace_) {
+    put(' ');
+    pendingSpace_ = false;
+  }
+  put(c);
+  wroteText_ = true;
+}
+
+void ContentNormalizer::emitCodepoint(uint32_t codepoint) {
+  if (codepoint < 0x80) {
+    emitText(static_cast<char>(codepoint));
+  } else if (codepoint < 0x800) {
+    emitText(static_cast<char>(0xC0 | (codepoint >> 6)));
+    emitText(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  } else if (codepoint < 0x10000) {
+    emitText(static_cast<char>(0xE0 | (codepoint >> 12)));
+    emitText(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+    emitText(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  } else {
+    emitText(static_cast<char>(0xF0 | (codepoint >> 18)));
+    emitText(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+    emitText(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+    emitText(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  }
+}
+
+void ContentNormalizer::put(char c) {
+  buffer_[bufferLength_++] = c;
+  if (bufferLength_ == sizeof(buffer_)) {
+    flush();
+  }
+}
+
+void ContentNormalizer::flush() {
+  if (bufferLength_ == 0) {
+    return;
+  }
+  outputBytes_ += bufferLength_;
+  if (output_) {
+    output_(buffer_, bufferLength_);
+  }
+  bufferLength_ = 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <functional>
+#include <vector>
+
+#include "site_record.h"
+
+enum class NormalizeMode : uint8_t {
+  // Content is hashed byte for byte (the historical behaviour).
+  None,
+  // Runs of whitespace become one space; leading/trailing space is dropped.
+  Whitespace,
+  // Markup is reduced to its visible text: tags, comments and <script>/<style>
+  // bodies are dropped, entities decoded, then whitespace is collapsed.
+  Text,
+};
+
+struct NormalizeOptions {
+  NormalizeMode mode = NormalizeMode::None;
+  // Everything between these markers (inclusive) is skipped, in any mode. An
+  // empty end marker skips to the end of the content.
+  String ignoreStart;
+  String ignoreEnd;
+};
+
+NormalizeOptions normalizeOptionsForSite(const SiteConfig &config);
+
+// Single-pass normalizer that sits between extraction and hashing. Input may
+// be split at any byte; memory use is a fixed output buffer plus the ignore
+// markers' match tables, independent of the content size.
+class ContentNormalizer {
+ public:
+  using Output = std::function<void(const char *data, size_t length)>;
+
+  void begin(const NormalizeOptions &options, Output output);
+  void update(const char *data, size_t length);
+  // Flushes held-back bytes (partial entities or markers) and the buffer.
+  void finish();
+
+  size_t inputBytes() const { return inputBytes_; }
+  size_t outputBytes() const { return outputBytes_; }
+
+ private:
+  enum class State : uint8_t {
+    Text,
+    Entity,
+    TagOpen,
+    TagName,
+    Tag,
+    TagQuote,
+    Bang,
+    Comment,
+    Declaration,
+    RawText,
+  };
+
+  void filterIgnored(char c);
+  void releaseMarker(size_t count);
+  void step(char c);
+  void endTag();
+  void flushEntity();
+  bool decodeEntity();
+  void emitText(char c);
+  void emitCodepoint(uint32_t codepoint);
+  void boundary() { pendingSpace_ = wroteText_; }
+  void put(char c);
+  void flush();
+
+  NormalizeOptions options_;
+  Output output_;
+  std::vector<size_t> startFailure_;
+  std::vector<size_t> endFailure_;
+  size_t markerMatched_ = 0;
+  bool ignoring_ = false;
+
+  State state_ = State::Text;
+  char tagName_[8];
+  uint8_t tagNameLength_ = 0;
+  bool closingTag_ = false;
+  char quote_ = 0;
+  uint8_t dashes_ = 0;
+  const char *rawTextEnd_ = nullptr;
+  uint8_t rawTextMatched_ = 0;
+  char entity_[12];
+  uint8_t entityLength_ = 0;
+
+  bool pendingSpace_ = false;
+  bool wroteText_ = false;
+  char buffer_[128];
+  size_t bufferLength_ = 0;
+  size_t inputBytes_ = 0;
+  size_t outputBytes_ = 0;
+};
@@ -1,7 +1,12 @@
 #include "CssSelectMini.h"
 
+#include <AllocProfile.h>
+#include <CheckArena.h>
+
+#include "HtmlScanner.h"
+
 #include <cctype>
-#include <map>
+#include <cstring>
 
 namespace {
 String trimCopy(String value) {
@@ -9,36 +14,86 @@ String trimCopy(String value) {
   return value;
 }
 
-void splitClasses(const String &value, std::vector<String> &out) {
-  int start = 0;
-  while (start < value.length()) {
-    while (start < value.length() && isspace(static_cast<unsigned char>(value[start]))) {
-      ++start;
-    }
-    if (start >= value.length()) {
-      break;
-    }
-    int end = start;
-    while (end < value.length() && !isspace(static_cast<unsigned char>(value[end]))) {
-      ++end;
+struct TypeCounter {
+  size_t level;
+  const char *name;
+  size_t nameLength;
+  int count;
+};
+
+using TypeCounters = std::vector<TypeCounter, ArenaAllocator<TypeCounter>>;
+
+bool isSpace(char c) { return isspace(static_cast<unsigned char>(c)) != 0; }
+
+bool equalsIgnoreCase(const char *a, size_t aLength, const char *b, size_t bLength) {
+  if (aLength != bLength) {
+    return false;
+  }
+  for (size_t i = 0; i < aLength; ++i) {
+    if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) {
+      return false;
     }
-    String token = value.substring(start, end);
-    token.trim();
-    if (!token.isEmpty()) {
-      token.toLowerCase();
-      out.push_back(token);
+  }
+  return true;
+}
+
+void trimSpan(const char *data, size_t &start, size_t &end) {
+  while (start < end && isSpace(data[start])) {
+    ++start;
+  }
+  while (end > start && isSpace(data[end - 1])) {
+    --end;
+  }
+}
+
+int nextTypeIndex(TypeCounters &counters, size_t level, const char *name, size_t nameLength) {
+  for (auto it = counters.rbegin(); it != counters.rend() && it->level == level; ++it) {
+    if (equalsIgnoreCase(it->name, it->nameLength, name, nameLength)) {
+      return ++it->count;
     }
-    start = end;
   }
+  counters.push_back({level, name, nameLength, 1});
+  return 1;
 }
 }  // namespace
 
 bool CssSelectMini::selectInnerText(const String &html, const String &selector, String &outText) const {
+  ALLOC_SCOPE("css_select");
+  size_t start = 0;
+  size_t length = 0;
+  if (!selectInnerSpan(html.c_str(), html.length(), selector, start, length)) {
+    return false;
+  }
+  outText = String(html.c_str() + start, length);
+  return true;
+}
+
+bool CssSelectMini::selectInnerSpan(const char *html, size_t length, const String &selector, size_t &outStart,
+                                    size_t &outLength) const {
+  ALLOC_SCOPE("css_select");
   SelectorQuery query;
   if (!parseSelector(selector, query)) {
     return false;
   }
-  return extractByQuery(html, query, outText);
+  bool found = false;
+  scanMatches(html, length, query, [&](size_t start, size_t matchLength) {
+    outStart = start;
+    outLength = matchLength;
+    found = true;
+    return false;
+  });
+  return found;
+}
+
+bool CssSelectMini::selectEach(const char *html, size_t length, const String &selector,
+                               const MatchFn &onMatch) const {
+  ALLOC_SCOPE("css_select");
+  SelectorQuery query;
+  if (!parseSelector(selector, query)) {
+    return false;
+  }
+  scanMatches(html, length, query, onMatch);
+  return true;
 }
 
 String CssSelectMini::toLowerCopy(const String &value) const {
@@ -104,21 +159,26 @@ bool CssSelectMini::parseSelector(const String &selector, SelectorQuery &query)
   return !(query.tag.isEmpty() && query.id.isEmpty() && query.classes.empty());
 }
 
-bool CssSelectMini::matches(const SelectorQuery &query, const String &tag, const String &id,
-                            const std::vector<String> &classes, int nthOfType) const {
-  if (!query.tag.isEmpty() && query.tag != tag) {
+bool CssSelectMini::matches(const SelectorQuery &query, Span tag, Span id, Span classAttr, int nthOfType) const {
+  if (!query.tag.isEmpty() && !equalsIgnoreCase(query.tag.c_str(), query.tag.length(), tag.data, tag.length)) {
     return false;
   }
-  if (!query.id.isEmpty() && query.id != id) {
+  if (!query.id.isEmpty() && !equalsIgnoreCase(query.id.c_str(), query.id.length(), id.data, id.length)) {
     return false;
   }
   for (const auto &cls : query.classes) {
     bool found = false;
-    for (const auto &candidate : classes) {
-      if (cls == candidate) {
-        found = true;
-        break;
+    size_t i = 0;
+    while (!found && i < classAttr.length) {
+      while (i < classAttr.length && isSpace(classAttr.data[i])) {
+        ++i;
+      }
+      size_t end = i;
+      while (end < classAttr.length && !isSpace(classAttr.data[end])) {
+        ++end;
       }
+      found = end > i && equalsIgnoreCase(cls.c_str(), cls.length(), classAttr.data + i, end - i);
+      i = end;
     }
     if (!found) {
       return false;
@@ -130,141 +190,119 @@ bool CssSelectMini::matches(const SelectorQuery &query, const String &tag, const
   return true;
 }
 
-bool CssSelectMini::extractByQuery(const String &html, const SelectorQuery &query, String &outText) const {
-  std::vector<std::map<String, int>> typeCounters;
-  typeCounters.emplace_back();
-  size_t pos = 0;
-  std::vector<String> tagStack;
+void CssSelectMini::scanMatches(const char *html, size_t length, const SelectorQuery &query,
+                                const MatchFn &onMatch) const {
+  TypeCounters typeCounters;
+  size_t level = 0;
+  HtmlTagScanner scanner(html, length);
+  HtmlTag tag;
 
-  while (true) {
-    int open = html.indexOf('<', pos);
-    if (open < 0) {
-      break;
-    }
-    int close = html.indexOf('>', open + 1);
-    if (close < 0) {
-      break;
-    }
-    String tagContent = html.substring(open + 1, close);
-    if (tagContent.startsWith("/")) {
-      if (!tagStack.empty()) {
-        tagStack.pop_back();
-      }
-      if (typeCounters.size() > 1) {
+  const auto closeLevel = [&]() {
+    if (level > 0) {
+      while (!typeCounters.empty() && typeCounters.back().level > level - 1) {
         typeCounters.pop_back();
       }
-      pos = close + 1;
-      continue;
+      --level;
     }
-    if (tagContent.startsWith("!") || tagContent.startsWith("?")) {
-      pos = close + 1;
+  };
+
+  while (scanner.next(tag)) {
+    if (tag.closing) {
+      closeLevel();
       continue;
     }
-    bool selfClosing = false;
-    if (tagContent.endsWith("/")) {
-      selfClosing = true;
-      tagContent.remove(tagContent.length() - 1);
+    Span tagName{tag.name, tag.nameLength};
+    Span elementId{html, 0};
+    Span classAttr{html, 0};
+    parseAttributes(tag, elementId, classAttr);
+
+    int nth = nextTypeIndex(typeCounters, level, tagName.data, tagName.length);
+    const bool hasContent = !tag.selfClosing && !HtmlTagScanner::isVoidElement(tag.name, tag.nameLength);
+    if (hasContent) {
+      ++level;
     }
-    tagContent.trim();
-    int idx = 0;
-    String tagName;
-    while (idx < tagContent.length() && !isspace(tagContent[idx])) {
-      tagName += tagContent[idx++];
+    if (!matches(query, tagName, elementId, classAttr, nth)) {
+      continue;
     }
-    tagName = toLowerCopy(tagName);
-
-    std::vector<String> classes;
-    String elementId;
-    while (idx < tagContent.length()) {
-      while (idx < tagContent.length() && isspace(tagContent[idx])) {
-        ++idx;
-      }
-      if (idx >= tagContent.length()) {
-        break;
-      }
-      int equal = tagContent.indexOf('=', idx);
-      if (equal < 0) {
-        break;
+    if (!hasContent) {
+      if (!onMatch(tag.end, 0)) {
+        return;
       }
-      String key = tagContent.substring(idx, equal);
-      key.trim();
-      idx = equal + 1;
-      if (idx >= tagContent.length()) {
-        break;
+      continue;
+    }
+    // Only same-name tags change the depth, so unrelated children (and
+    // unclosed ones like <p> or <li>) cannot hide the closing tag.
+    HtmlTagScanner inner = scanner;
+    HtmlTag child;
+    int depth = 1;
+    bool closed = false;
+    while (!closed && inner.next(child)) {
+      if (!equalsIgnoreCase(child.name, child.nameLength, tagName.data, tagName.length)) {
+        continue;
       }
-      char quote = tagContent[idx];
-      if (quote == '\"' || quote == '\'') {
-        ++idx;
-        int endQuote = tagContent.indexOf(quote, idx);
-        if (endQuote < 0) {
-          break;
-        }
-        String value = tagContent.substring(idx, endQuote);
-        idx = endQuote + 1;
-        if (key.equalsIgnoreCase("id")) {
-          elementId = value;
-        } else if (key.equalsIgnoreCase("class")) {
-          splitClasses(value, classes);
-        }
-      } else {
-        while (idx < tagContent.length() && !isspace(tagContent[idx])) {
-          ++idx;
-        }
+      if (!child.closing) {
+        depth += child.selfClosing ? 0 : 1;
+      } else if (--depth == 0) {
+        closed = true;
       }
     }
-
-    elementId = toLowerCopy(elementId);
-    int nth = ++typeCounters.back()[tagName];
-    if (!selfClosing) {
-      typeCounters.emplace_back();
-      tagStack.push_back(tagName);
+    // Never closed: keep looking for a later match.
+    if (!closed) {
+      continue;
     }
+    size_t innerStart = tag.end;
+    size_t innerEnd = child.start;
+    trimSpan(html, innerStart, innerEnd);
+    if (!onMatch(innerStart, innerEnd - innerStart)) {
+      return;
+    }
+    // Carry on past the closing tag; the element's content was just scanned.
+    scanner = inner;
+    closeLevel();
+  }
+}
 
-    if (matches(query, tagName, elementId, classes, nth)) {
-      size_t contentStart = close + 1;
-      if (selfClosing) {
-        outText = "";
-        return true;
+void CssSelectMini::parseAttributes(const HtmlTag &tag, Span &id, Span &classAttr) const {
+  const char *p = tag.attributes;
+  const char *end = tag.attributes + tag.attributesLength;
+  while (p < end) {
+    while (p < end && (isSpace(*p) || *p == '/')) {
+      ++p;
+    }
+    const char *key = p;
+    while (p < end && !isSpace(*p) && *p != '=') {
+      ++p;
+    }
+    const size_t keyLength = static_cast<size_t>(p - key);
+    while (p < end && isSpace(*p)) {
+      ++p;
+    }
+    if (p >= end || *p != '=') {
+      continue;  // attribute without a value
+    }
+    ++p;
+    while (p < end && isSpace(*p)) {
+      ++p;
+    }
+    Span value{p, 0};
+    if (p < end && (*p == '"' || *p == '\'')) {
+      const char quote = *p++;
+      value.data = p;
+      p = htmlscan::findByte(p, end, quote);
+      value.length = static_cast<size_t>(p - value.data);
+      if (p < end) {
+        ++p;
       }
-      size_t search = contentStart;
-      int depth = 1;
-      while (search < static_cast<size_t>(html.length())) {
-        int next = html.indexOf('<', search);
-        if (next < 0) {
-          break;
-        }
-        if (next + 1 < html.length() && html[next + 1] == '/') {
-          int closingEnd = html.indexOf('>', next + 2);
-          if (closingEnd < 0) {
-            break;
-          }
-          String closingName = html.substring(next + 2, closingEnd);
-          closingName = toLowerCopy(trimCopy(closingName));
-          if (closingName == tagName) {
-            --depth;
-            if (depth == 0) {
-              outText = trimCopy(html.substring(contentStart, next));
-              return true;
-            }
-          }
-          search = closingEnd + 1;
-        } else if (next + 1 < html.length() && html[next + 1] != '!' && html[next + 1] != '?') {
-          int childEnd = html.indexOf('>', next + 1);
-          if (childEnd < 0) {
-            break;
-          }
-          depth++;
-          search = childEnd + 1;
-        } else {
-          int skipEnd = html.indexOf('>', next + 1);
-          if (skipEnd < 0) {
-            break;
-          }
-          search = skipEnd + 1;
-        }
+    } else {
+      while (p < end && !isSpace(*p)) {
+        ++p;
       }
+      value.length = static_cast<size_t>(p - value.data);
+    }
+    if (equalsIgnoreCase(key, keyLength, "id", 2)) {
+      id = value;
+    } else if (equalsIgnoreCase(key, keyLength, "class", 5)) {
+      classAttr = value;
     }
-    pos = close + 1;
   }
-  return false;
 }
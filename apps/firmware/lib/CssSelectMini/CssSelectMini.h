@@ -1,11 +1,24 @@
 #pragma once
 
 #include <Arduino.h>
+#include <functional>
 #include <vector>
 
+#include "HtmlScanner.h"
+
 class CssSelectMini {
  public:
   bool selectInnerText(const String &html, const String &selector, String &outText) const;
+  // Same match as selectInnerText but reports the trimmed inner HTML as an
+  // offset/length inside html, so callers can hash it without copying.
+  bool selectInnerSpan(const char *html, size_t length, const String &selector, size_t &outStart,
+                       size_t &outLength) const;
+  // Trimmed inner HTML of every match, in document order, in one pass: the
+  // scan resumes after each match's closing tag, so matches nested in another
+  // one are part of it. onMatch returns false to stop. False when the
+  // selector does not parse.
+  using MatchFn = std::function<bool(size_t start, size_t length)>;
+  bool selectEach(const char *html, size_t length, const String &selector, const MatchFn &onMatch) const;
 
  private:
   struct SelectorQuery {
@@ -15,9 +28,14 @@ class CssSelectMini {
     int nthOfType = -1;
   };
 
+  struct Span {
+    const char *data = nullptr;
+    size_t length = 0;
+  };
+
   bool parseSelector(const String &selector, SelectorQuery &query) const;
-  bool matches(const SelectorQuery &query, const String &tag, const String &id,
-               const std::vector<String> &classes, int nthOfType) const;
-  bool extractByQuery(const String &html, const SelectorQuery &query, String &outText) const;
+  bool matches(const SelectorQuery &query, Span tag, Span id, Span classAttr, int nthOfType) const;
+  void parseAttributes(const HtmlTag &tag, Span &id, Span &classAttr) const;
+  void scanMatches(const char *html, size_t length, const SelectorQuery &query, const MatchFn &onMatch) const;
   String toLowerCopy(const String &value) const;
 };
@@ -0,0 +1,268 @@
+#include "HtmlScanner.h"
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+using Word = uintptr_t;
+constexpr Word kOnes = ~Word(0) / 0xFF;
+constexpr Word kHighs = kOnes * 0x80;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+constexpr bool kSwar = true;
+#else
+constexpr bool kSwar = false;
+#endif
+
+// High bit set in every byte of v that is zero. Borrows can only mark bytes
+// above a real zero, so the lowest marked byte is always exact.
+inline Word zeroBytes(Word v) { return (v - kOnes) & ~v & kHighs; }
+
+inline Word loadWord(const char *p) {
+  Word w;
+  memcpy(&w, p, sizeof(w));
+  return w;
+}
+
+inline size_t lowestMarkedByte(Word mask) {
+  if (sizeof(Word) == sizeof(unsigned long long)) {
+    return static_cast<size_t>(__builtin_ctzll(static_cast<unsigned long long>(mask))) >> 3;
+  }
+  return static_cast<size_t>(__builtin_ctz(static_cast<unsigned int>(mask))) >> 3;
+}
+
+inline bool isAligned(const char *p) { return (reinterpret_cast<uintptr_t>(p) & (sizeof(Word) - 1)) == 0; }
+
+bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f'; }
+
+bool equalsIgnoreCase(const char *a, const char *b, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct ElementName {
+  const char *name;
+  size_t length;
+};
+
+template <size_t N>
+bool nameIn(const char *name, size_t length, const ElementName (&names)[N]) {
+  for (const ElementName &candidate : names) {
+    if (candidate.length == length && equalsIgnoreCase(name, candidate.name, length)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Ordered by length so the common short names fail fast.
+const ElementName kVoidElements[] = {{"br", 2},    {"hr", 2},    {"col", 3},    {"img", 3},    {"wbr", 3},
+                                     {"area", 4},  {"base", 4},  {"link", 4},   {"meta", 4},   {"embed", 5},
+                                     {"input", 5}, {"param", 5}, {"track", 5},  {"source", 6}};
+const ElementName kRawTextElements[] = {{"style", 5}, {"title", 5}, {"script", 6}, {"textarea", 8}};
+
+bool isRawTextElement(const char *name, size_t length) {
+  const char first = static_cast<char>(tolower(static_cast<unsigned char>(name[0])));
+  return (first == 's' || first == 't') && nameIn(name, length, kRawTextElements);
+}
+}  // namespace
+
+namespace htmlscan {
+
+const char *findAny(const char *p, const char *end, char a, char b, char c) {
+  // Spans shorter than a couple of words (most tag bodies) are cheaper bytewise.
+  if (kSwar && end - p >= static_cast<ptrdiff_t>(4 * sizeof(Word))) {
+    while (p < end && !isAligned(p)) {
+      if (*p == a || *p == b || *p == c) {
+        return p;
+      }
+      ++p;
+    }
+    const Word wa = kOnes * static_cast<uint8_t>(a);
+    const Word wb = kOnes * static_cast<uint8_t>(b);
+    const Word wc = kOnes * static_cast<uint8_t>(c);
+    while (static_cast<size_t>(end - p) >= sizeof(Word)) {
+      const Word w = loadWord(p);
+      const Word hits = zeroBytes(w ^ wa) | zeroBytes(w ^ wb) | zeroBytes(w ^ wc);
+      if (hits) {
+        return p + lowestMarkedByte(hits);
+      }
+      p += sizeof(Word);
+    }
+  }
+  for (; p < end; ++p) {
+    if (*p == a || *p == b || *p == c) {
+      return p;
+    }
+  }
+  return end;
+}
+
+const char *findByte(const char *p, const char *end, char c) {
+#if defined(__XTENSA__)
+  if (kSwar) {
+    while (p < end && !isAligned(p)) {
+      if (*p == c) {
+        return p;
+      }
+      ++p;
+    }
+    const Word wc = kOnes * static_cast<uint8_t>(c);
+    while (static_cast<size_t>(end - p) >= sizeof(Word)) {
+      const Word hits = zeroBytes(loadWord(p) ^ wc);
+      if (hits) {
+        return p + lowestMarkedByte(hits);
+      }
+      p += sizeof(Word);
+    }
+  }
+  for (; p < end; ++p) {
+    if (*p == c) {
+      return p;
+    }
+  }
+  return end;
+#else
+  if (p >= end) {
+    return end;
+  }
+  const void *hit = memchr(p, c, static_cast<size_t>(end - p));
+  return hit ? static_cast<const char *>(hit) : end;
+#endif
+}
+
+}  // namespace htmlscan
+
+bool HtmlTagScanner::isVoidElement(const char *name, size_t length) {
+  if (length < 2 || length > 6) {
+    return false;
+  }
+  // Every void element starts with one of these; skips the table for div/span/a/p/li.
+  switch (tolower(static_cast<unsigned char>(name[0]))) {
+    case 'a':
+    case 'b':
+    case 'c':
+    case 'e':
+    case 'h':
+    case 'i':
+    case 'l':
+    case 'm':
+    case 'p':
+    case 's':
+    case 't':
+    case 'w':
+      return nameIn(name, length, kVoidElements);
+    default:
+      return false;
+  }
+}
+
+bool HtmlTagScanner::next(HtmlTag &tag) {
+  const char *end = html_ + length_;
+  while (pos_ < length_) {
+    const char *open = htmlscan::findByte(html_ + pos_, end, '<');
+    if (end - open < 2) {
+      pos_ = length_;
+      return false;
+    }
+    const char kind = open[1];
+    if (kind == '!' || kind == '?') {
+      const char *close = nullptr;
+      if (kind == '!' && end - open >= 4 && open[2] == '-' && open[3] == '-') {
+        // A comment runs to the first "-->", not to the first '>'.
+        close = open + 4;
+        while ((close = htmlscan::findByte(close, end, '>')) != end && !(close[-1] == '-' && close[-2] == '-')) {
+          ++close;
+        }
+      } else {
+        close = htmlscan::findByte(open + 2, end, '>');
+      }
+      pos_ = close == end ? length_ : static_cast<size_t>(close - html_) + 1;
+      continue;
+    }
+    const bool closing = kind == '/';
+    const char *name = open + (closing ? 2 : 1);
+    if (name >= end || !isalpha(static_cast<unsigned char>(*name))) {
+      // A bare '<' in text.
+      pos_ = static_cast<size_t>(open - html_) + 1;
+      continue;
+    }
+    const char *nameEnd = name;
+    while (nameEnd < end && !isSpace(*nameEnd) && *nameEnd != '>' && *nameEnd != '/') {
+      ++nameEnd;
+    }
+    const char *close = findTagEnd(nameEnd);
+    if (close == end) {
+      pos_ = length_;
+      return false;
+    }
+    tag.start = static_cast<size_t>(open - html_);
+    tag.end = static_cast<size_t>(close - html_) + 1;
+    tag.name = name;
+    tag.nameLength = static_cast<size_t>(nameEnd - name);
+    tag.closing = closing;
+    const char *attributesEnd = close;
+    tag.selfClosing = !closing && close > nameEnd && close[-1] == '/';
+    if (tag.selfClosing) {
+      --attributesEnd;
+    }
+    tag.attributes = nameEnd;
+    tag.attributesLength = attributesEnd > nameEnd ? static_cast<size_t>(attributesEnd - nameEnd) : 0;
+    pos_ = tag.end;
+    if (!closing && !tag.selfClosing && isRawTextElement(tag.name, tag.nameLength)) {
+      pos_ = findRawTextEnd(tag.name, tag.nameLength, pos_);
+    }
+    return true;
+  }
+  return false;
+}
+
+// Quotes only delimit a value right after '=', so an apostrophe in an
+// unquoted value or attribute name does not swallow the rest of the page.
+// One pass for the '>' and any quote before it, rather than finding the '>'
+// and then rescanning the tag for quotes.
+const char *HtmlTagScanner::findTagEnd(const char *from) const {
+  const char *end = html_ + length_;
+  const char *p = from;
+  while (true) {
+    const char *hit = htmlscan::findAny(p, end, '>', '"', '\'');
+    if (hit == end || *hit == '>') {
+      return hit;
+    }
+    const char *before = hit - 1;
+    while (before > from && isSpace(*before)) {
+      --before;
+    }
+    if (before < from || *before != '=') {
+      p = hit + 1;
+      continue;
+    }
+    const char *closeQuote = htmlscan::findByte(hit + 1, end, *hit);
+    if (closeQuote == end) {
+      return end;
+    }
+    p = closeQuote + 1;
+  }
+}
+
+// Offset of the "</name" that ends a raw-text element, or the end of input.
+size_t HtmlTagScanner::findRawTextEnd(const char *name, size_t nameLength, size_t from) const {
+  const char *end = html_ + length_;
+  const char *p = html_ + from;
+  while ((p = htmlscan::findByte(p, end, '<')) != end) {
+    const char *candidate = p + 2;
+    if (candidate <= end && p[1] == '/' && static_cast<size_t>(end - candidate) >= nameLength &&
+        equalsIgnoreCase(candidate, name, nameLength) &&
+        (candidate + nameLength == end || isSpace(candidate[nameLength]) || candidate[nameLength] == '>' ||
+         candidate[nameLength] == '/')) {
+      return static_cast<size_t>(p - html_);
+    }
+    ++p;
+  }
+  return length_;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Delimiter search kernels. Both return `end` when nothing is found.
+namespace htmlscan {
+// memchr on hosts with a tuned libc; word-at-a-time (SWAR) on Xtensa, where
+// the ROM memchr walks byte by byte.
+const char *findByte(const char *p, const char *end, char c);
+// First occurrence of any of the three bytes, word-at-a-time everywhere.
+const char *findAny(const char *p, const char *end, char a, char b, char c);
+}  // namespace htmlscan
+
+struct HtmlTag {
+  size_t start = 0;  // offset of '<'
+  size_t end = 0;    // offset just past '>'
+  const char *name = nullptr;
+  size_t nameLength = 0;
+  // Raw attribute text between the name and '>' (without a trailing '/').
+  const char *attributes = nullptr;
+  size_t attributesLength = 0;
+  bool closing = false;
+  bool selfClosing = false;
+};
+
+// Pull tokenizer that yields start and end tags only. Comments, doctypes,
+// processing instructions and the bodies of raw-text elements (script, style,
+// textarea, title) are skipped by jumping straight to their terminators, and
+// '>' inside quoted attribute values does not end a tag.
+class HtmlTagScanner {
+ public:
+  HtmlTagScanner(const char *html, size_t length) : html_(html), length_(length) {}
+
+  bool next(HtmlTag &tag);
+  size_t position() const { return pos_; }
+
+  // Elements that never have content or a closing tag (<br>, <img>, ...).
+  static bool isVoidElement(const char *name, size_t length);
+
+ private:
+  const char *findTagEnd(const char *from) const;
+  size_t findRawTextEnd(const char *name, size_t nameLength, size_t from) const;
+
+  const char *html_;
+  size_t length_;
+  size_t pos_ = 0;
+};
@@ -0,0 +1,298 @@
+#include "EventQueue.h"
+
+#include <AllocProfile.h>
+
+namespace {
+constexpr char kTombstone = '-';
+constexpr uint32_t kCompactSlackBytes = 8192;
+
+char tagFor(EventKind kind) {
+  switch (kind) {
+    case EventKind::Status:
+      return 'S';
+    case EventKind::Error:
+      return 'E';
+    default:
+      return 'C';
+  }
+}
+
+bool kindFromTag(char tag, EventKind &kind) {
+  switch (tag) {
+    case 'S':
+      kind = EventKind::Status;
+      return true;
+    case 'E':
+      kind = EventKind::Error;
+      return true;
+    case 'C':
+      kind = EventKind::Change;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Records are "<tag><json>\n"; serialized JSON never contains a raw newline.
+bool writeRecord(File &file, EventKind kind, const String &message) {
+  const uint8_t tag = static_cast<uint8_t>(tagFor(kind));
+  const uint8_t newline = '\n';
+  const size_t length = message.length();
+  return file.write(&tag, 1) == 1 &&
+         file.write(reinterpret_cast<const uint8_t *>(message.c_str()), length) == length &&
+         file.write(&newline, 1) == 1;
+}
+}  // namespace
+
+bool EventQueue::begin(size_t ramSlots, size_t maxEvents, const char *spillPath) {
+  ramSlots_ = ramSlots == 0 ? 1 : ramSlots;
+  maxEvents_ = maxEvents < ramSlots_ ? ramSlots_ : maxEvents;
+  spillPath_ = spillPath;
+  ram_.clear();
+  spilled_.clear();
+  spillBytes_ = 0;
+  liveSpillBytes_ = 0;
+  recoverSpill();
+  return true;
+}
+
+bool EventQueue::push(EventKind kind, const String &message) {
+  ALLOC_SCOPE("event_queue");
+  ++stats_.enqueued;
+  if (depth() >= maxEvents_ && !evictFor(kind, false)) {
+    countDrop(kind);
+    return false;
+  }
+  if (ram_.size() >= ramSlots_ && !spillOldestRam() && !evictFor(kind, true)) {
+    countDrop(kind);
+    return false;
+  }
+  ram_.push_back(RamEntry{kind, message});
+  return true;
+}
+
+size_t EventQueue::drain(const Publisher &publish, size_t maxCount) {
+  ALLOC_SCOPE("event_queue");
+  size_t sent = 0;
+  while (sent < maxCount && !empty()) {
+    if (!spilled_.empty()) {
+      const SpillRef ref = spilled_.front();
+      String message;
+      if (!readSpilled(ref, message)) {
+        // Unreadable now; tombstoned all the same so a reboot does not bring it back.
+        popSpilled();
+        countDrop(ref.kind);
+        continue;
+      }
+      if (!publish(message)) {
+        break;
+      }
+      popSpilled();
+    } else {
+      if (!publish(ram_.front().message)) {
+        break;
+      }
+      ram_.pop_front();
+    }
+    ++sent;
+    ++stats_.published;
+  }
+  return sent;
+}
+
+void EventQueue::popSpilled() {
+  const SpillRef ref = spilled_.front();
+  spilled_.pop_front();
+  liveSpillBytes_ -= ref.length + 2;
+  if (spilled_.empty()) {
+    resetSpill();
+  } else {
+    tombstone(ref.offset);
+  }
+}
+
+bool EventQueue::spillOldestRam() {
+  if (ram_.empty()) {
+    return true;
+  }
+  File file = LittleFS.open(spillPath_, "a");
+  if (!file) {
+    return false;
+  }
+  const RamEntry &entry = ram_.front();
+  if (!writeRecord(file, entry.kind, entry.message)) {
+    file.close();
+    // A torn record would corrupt the framing of everything appended later.
+    compactSpill();
+    return false;
+  }
+  file.close();
+  const uint32_t recordBytes = entry.message.length() + 2;
+  spilled_.push_back(SpillRef{spillBytes_, static_cast<uint32_t>(entry.message.length()), entry.kind});
+  spillBytes_ += recordBytes;
+  liveSpillBytes_ += recordBytes;
+  ++stats_.spilled;
+  ram_.pop_front();
+  return true;
+}
+
+// Spilled entries are always older than RAM ones, so for each kind the
+// segment is searched first.
+bool EventQueue::evictFor(EventKind incoming, bool ramOnly) {
+  for (uint8_t level = 0; level <= static_cast<uint8_t>(incoming); ++level) {
+    const EventKind kind = static_cast<EventKind>(level);
+    if (!ramOnly) {
+      for (auto it = spilled_.begin(); it != spilled_.end(); ++it) {
+        if (it->kind == kind) {
+          const uint32_t offset = it->offset;
+          liveSpillBytes_ -= it->length + 2;
+          spilled_.erase(it);
+          if (spilled_.empty()) {
+            resetSpill();
+          } else {
+            tombstone(offset);
+            if (spillBytes_ > liveSpillBytes_ * 2 + kCompactSlackBytes) {
+              compactSpill();
+            }
+          }
+          countDrop(kind);
+          return true;
+        }
+      }
+    }
+    for (auto it = ram_.begin(); it != ram_.end(); ++it) {
+      if (it->kind == kind) {
+        ram_.erase(it);
+        countDrop(kind);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void EventQueue::countDrop(EventKind kind) {
+  ++stats_.dropped;
+  switch (kind) {
+    case EventKind::Status:
+      ++stats_.droppedStatus;
+      break;
+    case EventKind::Error:
+      ++stats_.droppedError;
+      break;
+    default:
+      ++stats_.droppedChange;
+      break;
+  }
+}
+
+bool EventQueue::readSpilled(const SpillRef &ref, String &out) {
+  File file = LittleFS.open(spillPath_, "r");
+  if (!file || !file.seek(ref.offset + 1)) {
+    return false;
+  }
+  out = String();
+  out.reserve(ref.length);
+  char buffer[256];
+  uint32_t remaining = ref.length;
+  while (remaining > 0) {
+    const size_t want = remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+    const size_t n = file.read(reinterpret_cast<uint8_t *>(buffer), want);
+    if (n == 0) {
+      return false;
+    }
+    out.concat(buffer, n);
+    remaining -= n;
+  }
+  return true;
+}
+
+void EventQueue::tombstone(uint32_t offset) {
+  File file = LittleFS.open(spillPath_, "r+");
+  if (!file || !file.seek(offset)) {
+    return;
+  }
+  const uint8_t tag = kTombstone;
+  file.write(&tag, 1);
+}
+
+void EventQueue::recoverSpill() {
+  if (!LittleFS.exists(spillPath_)) {
+    return;
+  }
+  File file = LittleFS.open(spillPath_, "r");
+  if (!file) {
+    return;
+  }
+  char buffer[256];
+  uint32_t offset = 0;
+  uint32_t recordStart = 0;
+  char tag = 0;
+  bool atRecordStart = true;
+  size_t n = 0;
+  while ((n = file.read(reinterpret_cast<uint8_t *>(buffer), sizeof(buffer))) > 0) {
+    for (size_t i = 0; i < n; ++i, ++offset) {
+      if (atRecordStart) {
+        recordStart = offset;
+        tag = buffer[i];
+        atRecordStart = false;
+      }
+      if (buffer[i] != '\n') {
+        continue;
+      }
+      EventKind kind;
+      if (kindFromTag(tag, kind) && offset > recordStart) {
+        const uint32_t length = offset - recordStart - 1;
+        spilled_.push_back(SpillRef{recordStart, length, kind});
+        liveSpillBytes_ += length + 2;
+      }
+      atRecordStart = true;
+    }
+  }
+  file.close();
+  spillBytes_ = offset;
+  const bool tornTail = !atRecordStart;
+  while (depth() > maxEvents_ && evictFor(EventKind::Change, false)) {
+  }
+  if (spilled_.empty()) {
+    resetSpill();
+  } else if (tornTail || spillBytes_ > liveSpillBytes_ * 2 + kCompactSlackBytes) {
+    compactSpill();
+  }
+}
+
+void EventQueue::compactSpill() {
+  const String tmpPath = spillPath_ + ".tmp";
+  File out = LittleFS.open(tmpPath, "w");
+  if (!out) {
+    return;
+  }
+  std::deque<SpillRef> kept;
+  uint32_t offset = 0;
+  for (const SpillRef &ref : spilled_) {
+    String message;
+    if (!readSpilled(ref, message) || !writeRecord(out, ref.kind, message)) {
+      countDrop(ref.kind);
+      continue;
+    }
+    kept.push_back(SpillRef{offset, ref.length, ref.kind});
+    offset += ref.length + 2;
+  }
+  out.close();
+  LittleFS.remove(spillPath_);
+  if (!LittleFS.rename(tmpPath, spillPath_)) {
+    kept.clear();
+    offset = 0;
+    LittleFS.remove(tmpPath);
+  }
+  spilled_.swap(kept);
+  spillBytes_ = offset;
+  liveSpillBytes_ = offset;
+}
+
+void EventQueue::resetSpill() {
+  spilled_.clear();
+  spillBytes_ = 0;
+  liveSpillBytes_ = 0;
+  LittleFS.remove(spillPath_);
+}
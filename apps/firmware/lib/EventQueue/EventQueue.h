@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+// Lower kinds are evicted first when the queue is full.
+enum class EventKind : uint8_t { Status = 0, Error = 1, Change = 2 };
+
+// Store-and-forward queue for outgoing MQTT events. The newest events live in
+// a small RAM ring; when it fills, the oldest spill to an append-only segment
+// file on LittleFS so an outage (or a reboot during one) loses nothing until
+// maxEvents is reached. Consumed or evicted records are tombstoned in place and
+// the segment is removed once it is fully drained.
+class EventQueue {
+ public:
+  struct Stats {
+    uint32_t enqueued = 0;
+    uint32_t published = 0;
+    uint32_t spilled = 0;
+    uint32_t dropped = 0;
+    uint32_t droppedStatus = 0;
+    uint32_t droppedError = 0;
+    uint32_t droppedChange = 0;
+  };
+
+  using Publisher = std::function<bool(const String &message)>;
+
+  bool begin(size_t ramSlots, size_t maxEvents, const char *spillPath = "/events.q");
+
+  // Queues one serialized event, evicting the oldest of the lowest kind when
+  // full. Returns false if the incoming event itself was the one dropped.
+  bool push(EventKind kind, const String &message);
+  // Publishes up to maxCount events oldest-first; stops at the first failure.
+  size_t drain(const Publisher &publish, size_t maxCount);
+
+  size_t depth() const { return ram_.size() + spilled_.size(); }
+  size_t spilledDepth() const { return spilled_.size(); }
+  bool empty() const { return depth() == 0; }
+  const Stats &stats() const { return stats_; }
+
+ private:
+  struct RamEntry {
+    EventKind kind;
+    String message;
+  };
+
+  struct SpillRef {
+    uint32_t offset;
+    uint32_t length;
+    EventKind kind;
+  };
+
+  bool spillOldestRam();
+  bool evictFor(EventKind incoming, bool ramOnly);
+  void countDrop(EventKind kind);
+  bool readSpilled(const SpillRef &ref, String &out);
+  // Drops the oldest spilled record from the index and the segment.
+  void popSpilled();
+  void tombstone(uint32_t offset);
+  void recoverSpill();
+  void compactSpill();
+  void resetSpill();
+
+  String spillPath_;
+  size_t ramSlots_ = 0;
+  size_t maxEvents_ = 0;
+  std::deque<RamEntry> ram_;
+  std::deque<SpillRef> spilled_;
+  uint32_t spillBytes_ = 0;
+  uint32_t liveSpillBytes_ = 0;
+  Stats stats_;
+};
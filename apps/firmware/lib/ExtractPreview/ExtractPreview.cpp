@@ -0,0 +1,65 @@
+#include "ExtractPreview.h"
+
+#include <ContentNormalizer.h>
+
+#include <algorithm>
+
+ExtractionPreview previewExtraction(const SiteConfig &config, const char *body, size_t length, size_t keepText) {
+  ExtractionPreview preview;
+  preview.truncated = config.maxBytes > 0 && length > config.maxBytes;
+  preview.bodyBytes = preview.truncated ? config.maxBytes : length;
+
+  const unsigned long startedAt = micros();
+  preview.outcome = extractContentForSite(config, body, preview.bodyBytes);
+  preview.elapsedUs = static_cast<uint32_t>(micros() - startedAt);
+  if (!preview.outcome.ok) {
+    preview.scannedBytes = preview.bodyBytes;
+    return preview;
+  }
+  preview.scannedBytes = static_cast<size_t>(preview.outcome.data + preview.outcome.length - body);
+
+  ContentNormalizer normalizer;
+  const NormalizeOptions options = normalizeOptionsForSite(config);
+  const ContentNormalizer::Output keep = [&](const char *chunk, size_t chunkLength) {
+    preview.normalizedBytes += chunkLength;
+    const size_t kept = preview.normalized.length();
+    if (kept < keepText) {
+      preview.normalized.concat(chunk, std::min(chunkLength, keepText - kept));
+    }
+  };
+  if (config.extractMode != ExtractMode::List) {
+    normalizer.begin(options, keep);
+    normalizer.update(preview.outcome.data, preview.outcome.length);
+    normalizer.finish();
+    return preview;
+  }
+
+  // The outcome becomes the span from the first item to the end of the last.
+  const char *first = nullptr;
+  const char *last = nullptr;
+  String error;
+  preview.items = extractListItems(
+      config, body, preview.bodyBytes,
+      [&](const char *item, size_t itemLength) {
+        if (!first) {
+          first = item;
+        } else {
+          keep("\n", 1);
+        }
+        last = item + itemLength;
+        normalizer.begin(options, keep);
+        normalizer.update(item, itemLength);
+        normalizer.finish();
+      },
+      error);
+  preview.elapsedUs = static_cast<uint32_t>(micros() - startedAt);
+  if (preview.items == 0) {
+    preview.outcome = ExtractionOutcome();
+    preview.outcome.errorMessage = error;
+    return preview;
+  }
+  preview.outcome.data = first;
+  preview.outcome.length = static_cast<size_t>(last - first);
+  preview.scannedBytes = preview.bodyBytes;
+  return preview;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ContentExtractor.h>
+
+#include "site_record.h"
+
+// Normalized text returned with a preview; the rest is only counted.
+#ifndef EXTRACT_PREVIEW_TEXT_BYTES
+#define EXTRACT_PREVIEW_TEXT_BYTES 4096
+#endif
+
+// What a check of `config` would extract from a body, for the web preview
+// (built to WebAssembly, see wasm/) and host tools. Runs the device's own
+// extraction and normalizer, so a selector that works here works on the board.
+struct ExtractionPreview {
+  // View into the body passed to previewExtraction().
+  ExtractionOutcome outcome;
+  // Body bytes the device would keep: all of them, or the first max_bytes.
+  size_t bodyBytes = 0;
+  bool truncated = false;
+  // How far into the body the device has to read: up to the end of the
+  // extracted content, or all of it when nothing matched.
+  size_t scannedBytes = 0;
+  uint32_t elapsedUs = 0;
+  // The start of the normalized content that would be fingerprinted; for
+  // "list" sites, each item on its own line.
+  String normalized;
+  size_t normalizedBytes = 0;
+  // "list" sites: items the selector matched.
+  size_t items = 0;
+};
+
+ExtractionPreview previewExtraction(const SiteConfig &config, const char *body, size_t length,
+                                    size_t keepText = EXTRACT_PREVIEW_TEXT_BYTES);
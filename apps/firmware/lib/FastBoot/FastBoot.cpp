@@ -0,0 +1,177 @@
+#include "FastBoot.h"
+
+#include <LittleFS.h>
+
+#include <cstring>
+
+namespace {
+constexpr uint32_t kWifiMagic = 0x57494631;  // "WIF1"
+constexpr uint32_t kScheduleMagic = 0x52534331;  // "RSC1"
+constexpr uint32_t kEntrySalt = 0xA5C3F00D;
+const char *kWifiCacheFile = "/wifi.bin";
+
+uint32_t fnv1a(const void *data, size_t length, uint32_t hash = 2166136261u) {
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+struct WifiBlock {
+  uint32_t magic;
+  WifiCache cache;
+  uint32_t check;
+};
+
+struct ScheduleEntry {
+  uint32_t idHash;
+  uint32_t lastCheck;
+  uint32_t check;
+};
+
+struct ScheduleBlock {
+  uint32_t magic;
+  uint32_t clock;
+  uint32_t headerCheck;
+  ScheduleEntry entries[RTC_SCHEDULE_MAX_SITES];
+};
+
+RTC_NOINIT_ATTR WifiBlock rtcWifi;
+RTC_NOINIT_ATTR ScheduleBlock rtcSchedule;
+uint32_t bootClock = 0;
+
+uint32_t wifiCheck(const WifiBlock &block) { return fnv1a(&block.cache, sizeof(block.cache), block.magic); }
+
+bool wifiValid(const WifiBlock &block) { return block.magic == kWifiMagic && block.check == wifiCheck(block); }
+
+uint32_t headerCheck(const ScheduleBlock &block) { return block.magic ^ block.clock ^ kEntrySalt; }
+
+uint32_t entryCheck(const ScheduleEntry &entry) { return entry.idHash ^ entry.lastCheck ^ kEntrySalt; }
+
+bool entryValid(const ScheduleEntry &entry) { return entry.idHash != 0 && entry.check == entryCheck(entry); }
+
+uint32_t idHash(const String &id) {
+  const uint32_t hash = fnv1a(id.c_str(), id.length());
+  return hash == 0 ? 1 : hash;
+}
+}  // namespace
+
+bool WifiCache::load(WifiCache &out) {
+  if (wifiValid(rtcWifi)) {
+    out = rtcWifi.cache;
+    return true;
+  }
+  File file = LittleFS.open(kWifiCacheFile, "r");
+  if (!file) {
+    return false;
+  }
+  WifiBlock block;
+  const bool complete = file.read(reinterpret_cast<uint8_t *>(&block), sizeof(block)) == sizeof(block);
+  file.close();
+  if (!complete || !wifiValid(block)) {
+    return false;
+  }
+  rtcWifi = block;
+  out = block.cache;
+  return true;
+}
+
+void WifiCache::store(const WifiCache &cache) {
+  WifiBlock block;
+  std::memset(&block, 0, sizeof(block));
+  block.magic = kWifiMagic;
+  block.cache = cache;
+  block.check = wifiCheck(block);
+  const bool unchanged = wifiValid(rtcWifi) && std::memcmp(&rtcWifi, &block, sizeof(block)) == 0;
+  rtcWifi = block;
+  if (unchanged && LittleFS.exists(kWifiCacheFile)) {
+    return;
+  }
+  File file = LittleFS.open(kWifiCacheFile, "w");
+  if (file) {
+    file.write(reinterpret_cast<const uint8_t *>(&block), sizeof(block));
+    file.close();
+  }
+}
+
+void WifiCache::clear() {
+  rtcWifi.magic = 0;
+  LittleFS.remove(kWifiCacheFile);
+}
+
+bool RtcSchedule::begin() {
+  if (rtcSchedule.magic == kScheduleMagic && rtcSchedule.headerCheck == headerCheck(rtcSchedule)) {
+    // The time between the last tick and the reset is lost, so sites come due
+    // up to a second late rather than early.
+    bootClock = rtcSchedule.clock;
+    return true;
+  }
+  std::memset(&rtcSchedule, 0, sizeof(rtcSchedule));
+  rtcSchedule.magic = kScheduleMagic;
+  rtcSchedule.headerCheck = headerCheck(rtcSchedule);
+  bootClock = 0;
+  return false;
+}
+
+uint32_t RtcSchedule::now() { return bootClock + static_cast<uint32_t>(millis() / 1000); }
+
+void RtcSchedule::tick() {
+  const uint32_t clock = now();
+  if (clock != rtcSchedule.clock) {
+    rtcSchedule.clock = clock;
+    rtcSchedule.headerCheck = headerCheck(rtcSchedule);
+  }
+}
+
+void RtcSchedule::sleepFor(uint32_t seconds) {
+  rtcSchedule.clock = now() + seconds;
+  rtcSchedule.headerCheck = headerCheck(rtcSchedule);
+}
+
+bool RtcSchedule::lookup(const String &id, uint32_t &secondsSinceCheck) {
+  const uint32_t hash = idHash(id);
+  for (const ScheduleEntry &entry : rtcSchedule.entries) {
+    if (entry.idHash == hash && entryValid(entry)) {
+      const uint32_t clock = now();
+      secondsSinceCheck = clock >= entry.lastCheck ? clock - entry.lastCheck : 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+void RtcSchedule::record(const String &id) {
+  const uint32_t hash = idHash(id);
+  ScheduleEntry *target = nullptr;
+  for (ScheduleEntry &entry : rtcSchedule.entries) {
+    if (entry.idHash == hash || !entryValid(entry)) {
+      target = &entry;
+      if (entry.idHash == hash) {
+        break;
+      }
+    }
+  }
+  if (!target) {
+    // Full: reuse the slot checked longest ago.
+    target = &rtcSchedule.entries[0];
+    for (ScheduleEntry &entry : rtcSchedule.entries) {
+      if (entry.lastCheck < target->lastCheck) {
+        target = &entry;
+      }
+    }
+  }
+  target->idHash = hash;
+  target->lastCheck = now();
+  target->check = entryCheck(*target);
+}
+
+void RtcSchedule::forget(const String &id) {
+  const uint32_t hash = idHash(id);
+  for (ScheduleEntry &entry : rtcSchedule.entries) {
+    if (entry.idHash == hash) {
+      std::memset(&entry, 0, sizeof(entry));
+    }
+  }
+}
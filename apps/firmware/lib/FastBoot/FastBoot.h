@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef RTC_SCHEDULE_MAX_SITES
+#define RTC_SCHEDULE_MAX_SITES 64
+#endif
+
+// Parameters of the last successful WiFi join. Kept in RTC memory for soft
+// resets and mirrored to LittleFS for power cycles, so the next boot can join
+// the known AP/channel directly and skip DHCP.
+struct WifiCache {
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+
+  static bool load(WifiCache &out);
+  // Only touches flash when the parameters changed.
+  static void store(const WifiCache &cache);
+  static void clear();
+};
+
+// Per-site "last checked" times in RTC memory, measured on a seconds clock that
+// keeps counting across soft resets, so a reboot resumes the schedule instead
+// of re-checking every site at once. Lost on power-on, like any RTC data.
+class RtcSchedule {
+ public:
+  // Validates the retained block; false on a cold boot.
+  static bool begin();
+  static bool lookup(const String &id, uint32_t &secondsSinceCheck);
+  static void record(const String &id);
+  static void forget(const String &id);
+  // Advances the retained clock; cheap enough to call from every loop().
+  static void tick();
+  // Right before a deep sleep, which stops millis(): moves the retained clock
+  // to the wake so the schedule resumes where it would have been.
+  static void sleepFor(uint32_t seconds);
+  static uint32_t now();
+};
@@ -0,0 +1,61 @@
+#include "BandwidthBudget.h"
+
+void BandwidthBudget::begin(uint32_t bytesPerSecond, uint32_t burstBytes, unsigned long nowMs) {
+  rate_ = bytesPerSecond;
+  burst_ = burstBytes > 0 ? burstBytes : bytesPerSecond;
+  tokens_ = burst_;
+  refilledAt_ = nowMs;
+  carryMilli_ = 0;
+  throttling_ = false;
+  stats_ = Stats();
+}
+
+void BandwidthBudget::refill(unsigned long nowMs) {
+  const uint64_t elapsedMs = nowMs - refilledAt_;
+  refilledAt_ = nowMs;
+  const uint64_t milliTokens = elapsedMs * rate_ + carryMilli_;
+  carryMilli_ = static_cast<uint32_t>(milliTokens % 1000);
+  tokens_ += static_cast<int64_t>(milliTokens / 1000);
+  if (tokens_ >= static_cast<int64_t>(burst_)) {
+    tokens_ = burst_;
+    carryMilli_ = 0;
+  }
+}
+
+int64_t BandwidthBudget::needed(size_t expectedBytes) const {
+  // Unknown sizes only need the bucket out of debt.
+  return expectedBytes == 0 ? 1 : static_cast<int64_t>(expectedBytes < burst_ ? expectedBytes : burst_);
+}
+
+bool BandwidthBudget::admits(size_t expectedBytes, unsigned long nowMs) {
+  if (!enabled()) {
+    return true;
+  }
+  refill(nowMs);
+  const bool admitted = tokens_ >= needed(expectedBytes);
+  // Counted once per wait, not once per poll.
+  if (!admitted && !throttling_) {
+    ++stats_.throttled;
+  }
+  throttling_ = !admitted;
+  return admitted;
+}
+
+void BandwidthBudget::consume(size_t bytes) {
+  stats_.bytes += bytes;
+  if (enabled()) {
+    tokens_ -= static_cast<int64_t>(bytes);
+  }
+}
+
+uint32_t BandwidthBudget::waitMs(size_t expectedBytes, unsigned long nowMs) {
+  if (!enabled()) {
+    return 0;
+  }
+  refill(nowMs);
+  const int64_t missing = needed(expectedBytes) - tokens_;
+  if (missing <= 0) {
+    return 0;
+  }
+  return static_cast<uint32_t>((static_cast<uint64_t>(missing) * 1000 + rate_ - 1) / rate_);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Token bucket over downloaded body bytes, shared by every check. Tokens
+// accrue at bytesPerSecond up to burstBytes; received bytes are charged as
+// they arrive, so a check that downloads more than expected leaves the bucket
+// in debt and later checks wait it out. A rate of 0 disables the budget.
+class BandwidthBudget {
+ public:
+  struct Stats {
+    uint64_t bytes = 0;
+    uint32_t throttled = 0;
+  };
+
+  void begin(uint32_t bytesPerSecond, uint32_t burstBytes, unsigned long nowMs);
+  bool enabled() const { return rate_ > 0; }
+
+  // Whether a check expected to download `expectedBytes` (0 when unknown) may
+  // start now. Expectations above the burst only wait for a full bucket.
+  bool admits(size_t expectedBytes, unsigned long nowMs);
+  void consume(size_t bytes);
+  // Time until admits() would accept `expectedBytes`.
+  uint32_t waitMs(size_t expectedBytes, unsigned long nowMs);
+
+  int64_t tokens() const { return tokens_; }
+  const Stats &stats() const { return stats_; }
+
+ private:
+  void refill(unsigned long nowMs);
+  int64_t needed(size_t expectedBytes) const;
+
+  uint32_t rate_ = 0;
+  uint32_t burst_ = 0;
+  int64_t tokens_ = 0;
+  unsigned long refilledAt_ = 0;
+  // Sub-token remainder so slow rates do not round down to nothing.
+  uint32_t carryMilli_ = 0;
+  bool throttling_ = false;
+  Stats stats_;
+};
@@ -0,0 +1,80 @@
+#include "FetchGovernor.h"
+
+#include <algorithm>
+
+const char *fetchStrategyName(FetchStrategy strategy) {
+  switch (strategy) {
+    case FetchStrategy::Buffered:
+      return "buffered";
+    case FetchStrategy::Streamed:
+      return "streamed";
+    case FetchStrategy::Capped:
+      return "capped";
+    case FetchStrategy::Deferred:
+      return "deferred";
+  }
+  return "";
+}
+
+size_t FetchGovernor::budgetFor(const MemoryStatus &memory) const {
+  // The reserve may come from any block, the body needs a single one.
+  const size_t spare = memory.freeHeap > options_.reserveBytes ? memory.freeHeap - options_.reserveBytes : 0;
+  size_t heapBudget = std::min(memory.largestBlock, spare);
+  // Checks already in flight may still grow their buffers into the same
+  // heap, so they share what is left with this one.
+  heapBudget /= memory.checksInFlight + 1;
+  // An ArenaBuffer lives in the arena or, once it outgrows it, in a single
+  // heap block; it never spans both.
+  return std::max(memory.arenaFree, heapBudget);
+}
+
+FetchPlan FetchGovernor::plan(const SiteMemoryHint &site, const MemoryStatus &memory) const {
+  FetchPlan plan;
+  plan.budgetBytes = budgetFor(memory);
+  if (site.streamable) {
+    plan.strategy = FetchStrategy::Streamed;
+    plan.budgetBytes = std::max(plan.budgetBytes, options_.minBudgetBytes);
+    return plan;
+  }
+  // Headroom for a page that grew since the last check.
+  const size_t expected = site.expectedBytes + site.expectedBytes / 4;
+  if (plan.budgetBytes >= options_.minBudgetBytes && expected <= plan.budgetBytes) {
+    plan.strategy = FetchStrategy::Buffered;
+    return plan;
+  }
+  // Waiting helps when other checks will hand their buffers back; with
+  // nothing in flight and a usable budget, a capped fetch is the best it gets.
+  const bool memoryWillReturn = memory.checksInFlight > 0 || plan.budgetBytes < options_.minBudgetBytes;
+  if (memoryWillReturn && site.deferredForMs < options_.maxDeferMs) {
+    plan.strategy = FetchStrategy::Deferred;
+    plan.budgetBytes = 0;
+    return plan;
+  }
+  plan.strategy = FetchStrategy::Capped;
+  return plan;
+}
+
+FetchPlan FetchGovernor::revise(const FetchPlan &plan, size_t contentLength) const {
+  FetchPlan revised = plan;
+  if (plan.strategy == FetchStrategy::Buffered && contentLength > plan.budgetBytes) {
+    revised.strategy = FetchStrategy::Capped;
+  }
+  return revised;
+}
+
+void FetchGovernor::record(FetchStrategy strategy) {
+  switch (strategy) {
+    case FetchStrategy::Buffered:
+      ++stats_.buffered;
+      break;
+    case FetchStrategy::Streamed:
+      ++stats_.streamed;
+      break;
+    case FetchStrategy::Capped:
+      ++stats_.capped;
+      break;
+    case FetchStrategy::Deferred:
+      ++stats_.deferred;
+      break;
+  }
+}
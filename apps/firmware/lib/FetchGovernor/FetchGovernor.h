@@ -0,0 +1,90 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Heap kept free for everything that is not a response body: MQTT/TLS
+// records, JSON documents, extraction scratch.
+#ifndef GOVERNOR_RESERVE_BYTES
+#define GOVERNOR_RESERVE_BYTES 16384
+#endif
+
+// Smallest body buffer worth opening a connection for.
+#ifndef GOVERNOR_MIN_BUDGET_BYTES
+#define GOVERNOR_MIN_BUDGET_BYTES 4096
+#endif
+
+// A check waits at most this long for memory before it runs capped.
+#ifndef GOVERNOR_MAX_DEFER_MS
+#define GOVERNOR_MAX_DEFER_MS 30000
+#endif
+
+enum class FetchStrategy : uint8_t {
+  // Whole body in memory, extraction once it is complete.
+  Buffered,
+  // Extracted/fingerprinted as it arrives; only the extracted text is kept.
+  Streamed,
+  // Only the first budgetBytes are kept; extraction runs on that prefix.
+  Capped,
+  // Not started now; retried once memory comes back.
+  Deferred,
+};
+
+const char *fetchStrategyName(FetchStrategy strategy);
+
+struct MemoryStatus {
+  size_t freeHeap = 0;
+  size_t largestBlock = 0;
+  // Free bytes of the check slot's arena, used before the heap.
+  size_t arenaFree = 0;
+  size_t checksInFlight = 0;
+};
+
+// What the governor knows about the site before the response arrives.
+struct SiteMemoryHint {
+  // The mode can extract from the stream (full page, markers).
+  bool streamable = false;
+  // Body size of the last fetch; 0 when unknown.
+  size_t expectedBytes = 0;
+  uint32_t deferredForMs = 0;
+};
+
+struct FetchPlan {
+  FetchStrategy strategy = FetchStrategy::Buffered;
+  // Most body (or extracted) bytes the check may hold.
+  size_t budgetBytes = 0;
+};
+
+// Chooses how a check fetches its page from free heap, largest free block,
+// Content-Length and the site's last size, instead of letting a big page fail
+// (or exhaust the heap) halfway through the download. Pure policy: the caller
+// samples memory and applies the plan.
+class FetchGovernor {
+ public:
+  struct Options {
+    size_t reserveBytes = GOVERNOR_RESERVE_BYTES;
+    size_t minBudgetBytes = GOVERNOR_MIN_BUDGET_BYTES;
+    uint32_t maxDeferMs = GOVERNOR_MAX_DEFER_MS;
+  };
+
+  struct Stats {
+    uint32_t buffered = 0;
+    uint32_t streamed = 0;
+    uint32_t capped = 0;
+    uint32_t deferred = 0;
+  };
+
+  void begin(const Options &options) { options_ = options; }
+
+  // Before the connection is opened.
+  FetchPlan plan(const SiteMemoryHint &site, const MemoryStatus &memory) const;
+  // Once Content-Length is known: a buffered body that will not fit is capped.
+  FetchPlan revise(const FetchPlan &plan, size_t contentLength) const;
+  size_t budgetFor(const MemoryStatus &memory) const;
+
+  void record(FetchStrategy strategy);
+  const Stats &stats() const { return stats_; }
+
+ private:
+  Options options_;
+  Stats stats_;
+};
@@ -0,0 +1,320 @@
+#include "HistoryLog.h"
+
+#include <LittleFS.h>
+
+#include <algorithm>
+
+namespace {
+constexpr const char *kHistoryDir = "/hist";
+constexpr uint32_t kHistoryMagic = 0x31545348;  // "HST1"
+// seconds, flags, status, digest, bytes, fetch ms.
+constexpr size_t kMaxRecordBytes = 5 + 1 + 3 + kHistoryDigestBytes + 5 + 5;
+
+struct FileHeader {
+  uint32_t magic;
+  uint16_t segmentBytes;
+  uint8_t segments;
+  uint8_t reserved;
+};
+
+struct SegmentHeader {
+  uint32_t firstSeq;
+  uint32_t baseTime;
+  uint32_t lastTime;
+  uint16_t used;
+  uint16_t count;
+};
+
+constexpr size_t kSegmentData = HISTORY_SEGMENT_BYTES - sizeof(SegmentHeader);
+static_assert(HISTORY_SEGMENT_BYTES > sizeof(SegmentHeader) + kMaxRecordBytes, "HISTORY_SEGMENT_BYTES too small");
+static_assert(HISTORY_SEGMENT_BYTES <= UINT16_MAX && HISTORY_SEGMENTS >= 2 && HISTORY_SEGMENTS <= 255,
+              "HISTORY_SEGMENTS out of range");
+
+using Segments = SegmentHeader[HISTORY_SEGMENTS];
+
+uint32_t fnv1a(const char *data, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+  }
+  return hash;
+}
+
+uint32_t segmentOffset(size_t index) { return sizeof(FileHeader) + index * HISTORY_SEGMENT_BYTES; }
+
+size_t putVarint(uint8_t *out, uint32_t value) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    out[length++] = static_cast<uint8_t>(value | 0x80);
+    value >>= 7;
+  }
+  out[length++] = static_cast<uint8_t>(value);
+  return length;
+}
+
+bool getVarint(const uint8_t *in, size_t length, size_t &pos, uint32_t &value) {
+  value = 0;
+  for (uint32_t shift = 0; shift < 35 && pos < length; shift += 7) {
+    const uint8_t byte = in[pos++];
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t encodeRecord(const HistoryEntry &entry, uint32_t deltaSeconds, uint8_t *out) {
+  size_t length = putVarint(out, deltaSeconds);
+  out[length++] = entry.flags;
+  length += putVarint(out + length, entry.status);
+  std::copy(entry.digest, entry.digest + kHistoryDigestBytes, out + length);
+  length += kHistoryDigestBytes;
+  length += putVarint(out + length, entry.bytes);
+  length += putVarint(out + length, entry.fetchMs);
+  return length;
+}
+
+bool decodeRecord(const uint8_t *in, size_t length, size_t &pos, uint32_t &deltaSeconds, HistoryEntry &entry) {
+  uint32_t status = 0;
+  if (!getVarint(in, length, pos, deltaSeconds) || pos >= length) {
+    return false;
+  }
+  entry.flags = in[pos++];
+  if (!getVarint(in, length, pos, status) || length - pos < kHistoryDigestBytes) {
+    return false;
+  }
+  entry.status = static_cast<uint16_t>(status);
+  std::copy(in + pos, in + pos + kHistoryDigestBytes, entry.digest);
+  pos += kHistoryDigestBytes;
+  return getVarint(in, length, pos, entry.bytes) && getVarint(in, length, pos, entry.fetchMs);
+}
+
+// False when the file is missing or was written with another layout.
+bool readSegments(File &file, Segments &segments) {
+  FileHeader header;
+  if (file.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) != sizeof(header) ||
+      header.magic != kHistoryMagic || header.segmentBytes != HISTORY_SEGMENT_BYTES ||
+      header.segments != HISTORY_SEGMENTS) {
+    return false;
+  }
+  for (size_t i = 0; i < HISTORY_SEGMENTS; ++i) {
+    SegmentHeader &segment = segments[i];
+    if (!file.seek(segmentOffset(i)) ||
+        file.read(reinterpret_cast<uint8_t *>(&segment), sizeof(segment)) != sizeof(segment) ||
+        segment.used > kSegmentData) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Non-empty segments, oldest first.
+size_t orderSegments(const Segments &segments, size_t (&order)[HISTORY_SEGMENTS]) {
+  size_t count = 0;
+  for (size_t i = 0; i < HISTORY_SEGMENTS; ++i) {
+    if (segments[i].count > 0) {
+      order[count++] = i;
+    }
+  }
+  std::sort(order, order + count,
+            [&](size_t a, size_t b) { return segments[a].firstSeq < segments[b].firstSeq; });
+  return count;
+}
+}  // namespace
+
+String HistoryLog::pathFor(const String &id) {
+  char name[20];
+  snprintf(name, sizeof(name), "/hist/%08x", static_cast<unsigned>(fnv1a(id.c_str(), id.length())));
+  return String(name);
+}
+
+bool HistoryLog::append(const String &id, HistoryEntry &entry) {
+  Segments segments = {};
+  File file = LittleFS.open(pathFor(id), "r+");
+  if (!file || !readSegments(file, segments)) {
+    // The whole budget is taken up front, so a site never grows past it.
+    file.close();
+    if (!LittleFS.exists(kHistoryDir)) {
+      LittleFS.mkdir(kHistoryDir);
+    }
+    file = LittleFS.open(pathFor(id), "w");
+    if (!file) {
+      return false;
+    }
+    const FileHeader header{kHistoryMagic, HISTORY_SEGMENT_BYTES, HISTORY_SEGMENTS, 0};
+    const uint8_t zeros[64] = {};
+    bool ok = file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header);
+    for (size_t left = HISTORY_SEGMENTS * HISTORY_SEGMENT_BYTES; ok && left > 0;) {
+      const size_t chunk = std::min(left, sizeof(zeros));
+      ok = file.write(zeros, chunk) == chunk;
+      left -= chunk;
+    }
+    if (!ok) {
+      file.close();
+      return false;
+    }
+    std::fill(std::begin(segments), std::end(segments), SegmentHeader{});
+  }
+
+  size_t order[HISTORY_SEGMENTS];
+  const size_t filled = orderSegments(segments, order);
+  size_t target = HISTORY_SEGMENTS;
+  uint8_t record[kMaxRecordBytes];
+  size_t length = 0;
+  if (filled > 0) {
+    SegmentHeader &newest = segments[order[filled - 1]];
+    entry.seq = newest.firstSeq + newest.count;
+    if (entry.time >= newest.lastTime) {
+      length = encodeRecord(entry, entry.time - newest.lastTime, record);
+      if (newest.used + length <= kSegmentData) {
+        target = order[filled - 1];
+      }
+    }
+  } else {
+    entry.seq = 1;
+  }
+  if (target == HISTORY_SEGMENTS) {
+    // A free segment if there is one, else the oldest.
+    if (filled == HISTORY_SEGMENTS) {
+      target = order[0];
+    } else {
+      target = 0;
+      while (segments[target].count > 0) {
+        ++target;
+      }
+    }
+    SegmentHeader &segment = segments[target];
+    segment = SegmentHeader{};
+    segment.firstSeq = entry.seq;
+    segment.baseTime = entry.time;
+    segment.lastTime = entry.time;
+    length = encodeRecord(entry, 0, record);
+  }
+
+  SegmentHeader &segment = segments[target];
+  const uint32_t at = segmentOffset(target) + sizeof(SegmentHeader) + segment.used;
+  segment.used = static_cast<uint16_t>(segment.used + length);
+  ++segment.count;
+  segment.lastTime = entry.time;
+  const bool ok = file.seek(at) && file.write(record, length) == length && file.seek(segmentOffset(target)) &&
+                  file.write(reinterpret_cast<const uint8_t *>(&segment), sizeof(segment)) == sizeof(segment);
+  file.close();
+  return ok;
+}
+
+size_t HistoryLog::read(const String &id, uint32_t fromSeq, size_t maxCount, std::vector<HistoryEntry> &out) {
+  out.clear();
+  Segments segments = {};
+  File file = LittleFS.open(pathFor(id), "r");
+  if (!file || !readSegments(file, segments)) {
+    return 0;
+  }
+  size_t order[HISTORY_SEGMENTS];
+  const size_t filled = orderSegments(segments, order);
+  std::vector<uint8_t> data;
+  for (size_t n = 0; n < filled && out.size() < maxCount; ++n) {
+    const size_t index = order[n];
+    const SegmentHeader &segment = segments[index];
+    if (segment.firstSeq + segment.count <= fromSeq) {
+      continue;
+    }
+    data.resize(segment.used);
+    if (!file.seek(segmentOffset(index) + sizeof(SegmentHeader)) ||
+        file.read(data.data(), data.size()) != data.size()) {
+      break;
+    }
+    size_t pos = 0;
+    uint32_t time = segment.baseTime;
+    for (uint16_t i = 0; i < segment.count && out.size() < maxCount; ++i) {
+      HistoryEntry entry;
+      uint32_t deltaSeconds = 0;
+      if (!decodeRecord(data.data(), data.size(), pos, deltaSeconds, entry)) {
+        break;
+      }
+      time += deltaSeconds;
+      entry.seq = segment.firstSeq + i;
+      entry.time = time;
+      if (entry.seq >= fromSeq) {
+        out.push_back(entry);
+      }
+    }
+  }
+  file.close();
+  return out.size();
+}
+
+void HistoryLog::range(const String &id, uint32_t &first, uint32_t &next) {
+  first = 1;
+  next = 1;
+  Segments segments = {};
+  File file = LittleFS.open(pathFor(id), "r");
+  if (!file || !readSegments(file, segments)) {
+    return;
+  }
+  size_t order[HISTORY_SEGMENTS];
+  const size_t filled = orderSegments(segments, order);
+  if (filled > 0) {
+    first = segments[order[0]].firstSeq;
+    next = segments[order[filled - 1]].firstSeq + segments[order[filled - 1]].count;
+  }
+}
+
+void HistoryLog::remove(const String &id) { LittleFS.remove(pathFor(id)); }
+
+void HistoryReply::begin(const String &id, uint32_t requestId, uint32_t fromSeq, size_t maxRecords) {
+  id_ = id;
+  requestId_ = requestId;
+  uint32_t next = 0;
+  HistoryLog::range(id, first_, next);
+  from_ = std::max(fromSeq, first_);
+  end_ = std::max(from_, std::min<uint32_t>(next, from_ + std::min<size_t>(maxRecords, HISTORY_MAX_RECORDS)));
+  from_ = std::min(from_, end_);
+  part_ = 0;
+  const uint32_t records = end_ - from_;
+  parts_ =
+      static_cast<uint16_t>(records == 0 ? 1 : (records + HISTORY_RECORDS_PER_PART - 1) / HISTORY_RECORDS_PER_PART);
+  active_ = true;
+}
+
+bool HistoryReply::next(uint32_t now, JsonObject payload) {
+  if (!active_ || part_ >= parts_) {
+    active_ = false;
+    return false;
+  }
+  const uint32_t first = from_ + static_cast<uint32_t>(part_) * HISTORY_RECORDS_PER_PART;
+  const uint32_t last = std::min<uint32_t>(first + HISTORY_RECORDS_PER_PART, end_);
+  std::vector<HistoryEntry> entries;
+  HistoryLog::read(id_, first, last - first, entries);
+  // Checks that ran since the request may have overwritten the oldest ones.
+  while (!entries.empty() && entries.back().seq >= last) {
+    entries.pop_back();
+  }
+
+  payload["id"] = id_;
+  payload["request"] = requestId_;
+  payload["part"] = part_;
+  payload["parts"] = parts_;
+  payload["first"] = first_;
+  payload["next"] = end_;
+  payload["now"] = now;
+  payload["lost"] = (last - first) - static_cast<uint32_t>(entries.size());
+  JsonArray records = payload.createNestedArray("records");
+  for (const HistoryEntry &entry : entries) {
+    char digest[kHistoryDigestBytes * 2 + 1];
+    for (size_t i = 0; i < kHistoryDigestBytes; ++i) {
+      snprintf(digest + i * 2, 3, "%02x", entry.digest[i]);
+    }
+    JsonArray row = records.createNestedArray();
+    row.add(entry.seq);
+    row.add(entry.time);
+    row.add(entry.status);
+    row.add(entry.flags);
+    row.add(entry.bytes);
+    row.add(entry.fetchMs);
+    // char *, not const char *: ArduinoJson copies it into the document.
+    row.add(static_cast<char *>(digest));
+  }
+  ++part_;
+  return true;
+}
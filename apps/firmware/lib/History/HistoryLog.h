@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <vector>
+
+// Flash kept per site: HISTORY_SEGMENTS segments of HISTORY_SEGMENT_BYTES.
+// The default (3 KiB plus a header) fits one 4 KiB LittleFS block and holds
+// around 170 checks; when it is full the oldest segment is overwritten.
+#ifndef HISTORY_SEGMENT_BYTES
+#define HISTORY_SEGMENT_BYTES 1024
+#endif
+
+#ifndef HISTORY_SEGMENTS
+#define HISTORY_SEGMENTS 3
+#endif
+
+// Records per HISTORY message.
+#ifndef HISTORY_RECORDS_PER_PART
+#define HISTORY_RECORDS_PER_PART 16
+#endif
+
+// Most records a single HISTORY request returns.
+#ifndef HISTORY_MAX_RECORDS
+#define HISTORY_MAX_RECORDS 256
+#endif
+
+constexpr uint8_t kHistoryChanged = 0x01;
+// No usable response: network error, or the extraction failed.
+constexpr uint8_t kHistoryError = 0x02;
+constexpr size_t kHistoryDigestBytes = 8;
+
+// One check of a site.
+struct HistoryEntry {
+  // Per site, from 1; assigned by HistoryLog::append().
+  uint32_t seq = 0;
+  // Seconds on the caller's clock (RtcSchedule on the device).
+  uint32_t time = 0;
+  uint8_t flags = 0;
+  // HTTP status, 0 when there was no response.
+  uint16_t status = 0;
+  // First bytes of the fingerprint after the check.
+  uint8_t digest[kHistoryDigestBytes] = {};
+  uint32_t bytes = 0;
+  uint32_t fetchMs = 0;
+};
+
+// Compact per-site log of check outcomes in LittleFS under /hist/, so the
+// server can backfill what it missed during an outage. Each segment starts
+// with an absolute time; records inside it store the seconds since the one
+// before and varints for the rest, about 18 bytes per check.
+class HistoryLog {
+ public:
+  // Sets entry.seq. A clock that went back (a power cycle) starts a segment.
+  static bool append(const String &id, HistoryEntry &entry);
+  // Oldest first, entries with seq >= fromSeq, at most maxCount.
+  static size_t read(const String &id, uint32_t fromSeq, size_t maxCount, std::vector<HistoryEntry> &out);
+  // Seqs still on flash: [first, next). first == next when there are none.
+  static void range(const String &id, uint32_t &first, uint32_t &next);
+  static void remove(const String &id);
+
+ private:
+  static String pathFor(const String &id);
+};
+
+// Sends a range of a site's history as HISTORY parts, one per call. The range
+// is fixed when the request arrives; records overwritten before their part
+// goes out are reported as `lost`.
+class HistoryReply {
+ public:
+  void begin(const String &id, uint32_t requestId, uint32_t fromSeq, size_t maxRecords);
+  bool active() const { return active_; }
+  const String &siteId() const { return id_; }
+  uint32_t records() const { return end_ - from_; }
+  // Fills the payload of the next part: id, request, part, parts, first,
+  // next, now, lost and records ([seq, time, status, flags, bytes, fetch_ms,
+  // digest]). `now` is the clock the entries were written with. False once
+  // every part went out.
+  bool next(uint32_t now, JsonObject payload);
+  // Call after the part returned by next() could not be published.
+  void retry() { --part_; }
+
+ private:
+  String id_;
+  uint32_t requestId_ = 0;
+  uint32_t first_ = 0;
+  uint32_t from_ = 0;
+  uint32_t end_ = 0;
+  uint16_t part_ = 0;
+  uint16_t parts_ = 0;
+  bool active_ = false;
+};
@@ -0,0 +1,90 @@
+#include "DnsCache.h"
+
+#include <algorithm>
+
+#include "NetSocket.h"
+
+void DnsCache::begin(size_t capacity, uint32_t ttlMs, uint32_t staleMs, Resolver resolver) {
+  entries_.clear();
+  capacity_ = std::max<size_t>(capacity, 1);
+  ttlMs_ = ttlMs;
+  staleMs_ = staleMs;
+  resolver_ = resolver ? resolver : netio::resolveIpv4;
+  stats_ = DnsStats();
+}
+
+bool DnsCache::resolve(const char *host, unsigned long now, uint32_t &address, bool &cached) {
+  cached = false;
+  auto it = entries_.find(host);
+  if (it != entries_.end() && now - it->second.resolvedAt < ttlMs_) {
+    ++stats_.hits;
+    it->second.usedAt = now;
+    address = it->second.address;
+    cached = true;
+    return true;
+  }
+  ++stats_.misses;
+  if (lookup(host, now, address)) {
+    return true;
+  }
+  // A failed lookup stores nothing, so `it` is still valid.
+  if (it != entries_.end() && now - it->second.resolvedAt < static_cast<unsigned long>(ttlMs_) + staleMs_) {
+    ++stats_.stale;
+    it->second.usedAt = now;
+    address = it->second.address;
+    return true;
+  }
+  return false;
+}
+
+bool DnsCache::needsRefresh(const char *host, unsigned long now, uint32_t aheadMs) const {
+  auto it = entries_.find(host);
+  return it == entries_.end() || now - it->second.resolvedAt + aheadMs >= ttlMs_;
+}
+
+bool DnsCache::refresh(const char *host, unsigned long now) {
+  ++stats_.prefetches;
+  uint32_t address = 0;
+  return lookup(host, now, address);
+}
+
+void DnsCache::storeLookup(const char *host, bool ok, uint32_t address, uint32_t lookupMs, unsigned long now) {
+  ++stats_.prefetches;
+  ++stats_.lookups;
+  stats_.lookupMsTotal += lookupMs;
+  stats_.lookupMsMax = std::max(stats_.lookupMsMax, lookupMs);
+  if (!ok) {
+    ++stats_.failures;
+    return;
+  }
+  store(host, address, now);
+}
+
+bool DnsCache::lookup(const char *host, unsigned long now, uint32_t &address) {
+  const unsigned long startedAt = millis();
+  const bool ok = resolver_(host, address);
+  const uint32_t lookupMs = static_cast<uint32_t>(millis() - startedAt);
+  ++stats_.lookups;
+  stats_.lookupMsTotal += lookupMs;
+  stats_.lookupMsMax = std::max(stats_.lookupMsMax, lookupMs);
+  if (!ok) {
+    ++stats_.failures;
+    return false;
+  }
+  store(host, address, now);
+  return true;
+}
+
+void DnsCache::store(const std::string &host, uint32_t address, unsigned long now) {
+  auto it = entries_.find(host);
+  if (it == entries_.end() && entries_.size() >= capacity_) {
+    auto oldest = std::min_element(entries_.begin(), entries_.end(), [](const auto &a, const auto &b) {
+      return a.second.usedAt < b.second.usedAt;
+    });
+    entries_.erase(oldest);
+  }
+  Entry &entry = entries_[host];
+  entry.address = address;
+  entry.resolvedAt = now;
+  entry.usedAt = now;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <string>
+#include <unordered_map>
+
+// Hosts remembered; the least recently used one makes room for a new one.
+#ifndef DNS_CACHE_ENTRIES
+#define DNS_CACHE_ENTRIES 16
+#endif
+
+// getaddrinfo() does not expose the record's TTL, so every answer is trusted
+// for this long.
+#ifndef DNS_CACHE_TTL_MS
+#define DNS_CACHE_TTL_MS 300000UL
+#endif
+
+// How long past its TTL an answer still serves a check whose lookup failed.
+#ifndef DNS_CACHE_STALE_MS
+#define DNS_CACHE_STALE_MS 3600000UL
+#endif
+
+// Hosts of sites due within this window are resolved ahead of the check.
+#ifndef DNS_PREFETCH_AHEAD_MS
+#define DNS_PREFETCH_AHEAD_MS 15000UL
+#endif
+
+struct DnsStats {
+  // Every resolve() is a hit or a miss; a miss whose lookup failed but found
+  // an answer within the stale window also counts in `stale`.
+  uint32_t hits = 0;
+  uint32_t misses = 0;
+  uint32_t stale = 0;
+  uint32_t prefetches = 0;
+  uint32_t failures = 0;
+  // Lookups that ran, on the check path or ahead of it.
+  uint32_t lookups = 0;
+  uint64_t lookupMsTotal = 0;
+  uint32_t lookupMsMax = 0;
+
+  uint32_t hitPct() const { return hits + misses == 0 ? 0 : hits * 100 / (hits + misses); }
+  uint32_t lookupMsAvg() const { return lookups == 0 ? 0 : static_cast<uint32_t>(lookupMsTotal / lookups); }
+};
+
+// Host -> IPv4 cache in front of the blocking resolver, so a check only pays
+// for a lookup when the answer expired and prefetch did not refresh it in
+// time. Used from a single thread (the loop).
+class DnsCache {
+ public:
+  // Blocking lookup, network byte order; netio::resolveIpv4 unless a test
+  // swaps it.
+  using Resolver = bool (*)(const char *host, uint32_t &address);
+
+  void begin(size_t capacity = DNS_CACHE_ENTRIES, uint32_t ttlMs = DNS_CACHE_TTL_MS,
+             uint32_t staleMs = DNS_CACHE_STALE_MS, Resolver resolver = nullptr);
+
+  // Address for a check: the cached one while fresh, otherwise a lookup now,
+  // falling back to an answer within the stale window when it fails.
+  // `cached` is true when no lookup ran.
+  bool resolve(const char *host, unsigned long now, uint32_t &address, bool &cached);
+  // Whether host is unknown or its answer expires within aheadMs.
+  bool needsRefresh(const char *host, unsigned long now, uint32_t aheadMs) const;
+  // Prefetch: looks host up now and keeps the answer.
+  bool refresh(const char *host, unsigned long now);
+  // Prefetch done elsewhere (the daemon resolves on its workers).
+  void storeLookup(const char *host, bool ok, uint32_t address, uint32_t lookupMs, unsigned long now);
+
+  const DnsStats &stats() const { return stats_; }
+  size_t size() const { return entries_.size(); }
+
+ private:
+  struct Entry {
+    uint32_t address = 0;
+    unsigned long resolvedAt = 0;
+    unsigned long usedAt = 0;
+  };
+
+  bool lookup(const char *host, unsigned long now, uint32_t &address);
+  void store(const std::string &host, uint32_t address, unsigned long now);
+
+  std::unordered_map<std::string, Entry> entries_;
+  size_t capacity_ = DNS_CACHE_ENTRIES;
+  uint32_t ttlMs_ = DNS_CACHE_TTL_MS;
+  uint32_t staleMs_ = DNS_CACHE_STALE_MS;
+  Resolver resolver_ = nullptr;
+  DnsStats stats_;
+};
@@ -0,0 +1,557 @@
+#include "FetchEngine.h"
+
+#include <AllocProfile.h>
+#include <TraceRing.h>
+#include <errno.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+
+#include <mbedtls/ssl.h>
+#include <strings.h>
+
+#include "NetSocket.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+constexpr size_t kReadChunk = 1024;
+constexpr int kReadsPerStep = 4;
+constexpr unsigned long kTimeoutSweepMs = 100;
+constexpr int kEpollEvents = 256;
+
+using netio::wouldBlock;
+
+bool isRedirect(int status) { return status == 301 || status == 302 || status == 303 || status == 307 || status == 308; }
+
+// "bytes 1000-4999/120000"; the total may be "*".
+bool parseContentRange(const char *value, size_t length, size_t &start, size_t &total) {
+  const String text(value, length);
+  if (!text.startsWith("bytes ")) {
+    return false;
+  }
+  const int dash = text.indexOf('-');
+  const int slash = text.indexOf('/');
+  if (dash < 0 || slash < dash) {
+    return false;
+  }
+  start = strtoul(text.c_str() + 6, nullptr, 10);
+  total = text[slash + 1] == '*' ? 0 : strtoul(text.c_str() + slash + 1, nullptr, 10);
+  return true;
+}
+}  // namespace
+
+void rememberRedirect(const FetchResult &result, String &resolvedUrl) {
+  if (!result.ok || result.statusCode < 200 || result.statusCode >= 400) {
+    resolvedUrl = String();
+  } else if (!result.permanentUrl.isEmpty()) {
+    resolvedUrl = result.permanentUrl;
+  }
+}
+
+struct FetchEngine::Connection : public HttpResponseHandler {
+  enum class Phase { Idle, Connecting, Handshake, Sending, Receiving };
+
+  Phase phase = Phase::Idle;
+  // Epoll bookkeeping: slot index and a generation that tells the events of
+  // an earlier fetch on the same slot apart, plus the events registered.
+  uint32_t index = 0;
+  uint32_t generation = 0;
+  uint32_t watched = 0;
+  bool tlsQueued = false;
+  int fd = -1;
+  bool secure = false;
+  bool tlsActive = false;
+  bool wantWrite = false;
+  FetchSink *sink = nullptr;
+  HttpResponseParser parser;
+  String request;
+  size_t sent = 0;
+  unsigned long startedAt = 0;
+  uint32_t timeoutMs = 0;
+  size_t maxBodyBytes = 0;
+  size_t delivered = 0;
+  bool limitReached = false;
+  bool firstByte = false;
+  uint16_t traceSite = 0;
+  String host;
+  String url;
+  // The request's own headers, sent while the host is the one it named.
+  String extraHeaders;
+  String originHost;
+  // Set from the headers of a redirect that will be followed.
+  String location;
+  uint8_t redirectsLeft = 0;
+  uint8_t redirects = 0;
+  bool permanentOnly = true;
+  String permanentUrl;
+  size_t rangeStart = 0;
+  size_t rangeBytes = 0;
+  // From the Content-Range of a 206.
+  size_t partialStart = 0;
+  size_t totalBytes = 0;
+  mbedtls_ssl_context ssl;
+
+  bool onHeader(const char *name, size_t nameLength, const char *value, size_t valueLength) override {
+    if (redirectsLeft > 0 && isRedirect(parser.statusCode())) {
+      if (nameLength == 8 && strncasecmp(name, "Location", nameLength) == 0) {
+        location = String(value, valueLength);
+      }
+      return true;
+    }
+    if (parser.statusCode() == 206 && nameLength == 13 && strncasecmp(name, "Content-Range", nameLength) == 0) {
+      parseContentRange(value, valueLength, partialStart, totalBytes);
+    }
+    return sink->onHeader(name, nameLength, value, valueLength);
+  }
+
+  // The headers of a redirect to follow are complete.
+  bool redirectReady() const { return !location.isEmpty() && parser.state() != HttpResponseParser::State::Headers; }
+
+  bool onBody(const char *data, size_t length) override {
+    if (!location.isEmpty()) {
+      // The body of a redirect is never read.
+      return false;
+    }
+    if (maxBodyBytes > 0 && delivered + length > maxBodyBytes) {
+      // Stops the parser; the rest of the response is never read.
+      const size_t take = maxBodyBytes - delivered;
+      limitReached = true;
+      delivered += take;
+      if (take > 0) {
+        sink->onBody(data, take);
+      }
+      return false;
+    }
+    delivered += length;
+    return sink->onBody(data, length);
+  }
+
+  bool pendingTls() const { return tlsActive && mbedtls_ssl_get_bytes_avail(&ssl) > 0; }
+
+  uint32_t elapsedMs() const { return static_cast<uint32_t>(millis() - startedAt); }
+
+  bool writing() const {
+    return phase == Phase::Connecting || phase == Phase::Sending || (phase == Phase::Handshake && wantWrite);
+  }
+
+  void close() {
+    if (tlsActive) {
+      mbedtls_ssl_free(&ssl);
+      tlsActive = false;
+    }
+    if (fd >= 0) {
+      // Closing also drops it from the epoll set.
+      ::close(fd);
+      fd = -1;
+    }
+    watched = 0;
+    ++generation;
+    request = String();
+    phase = Phase::Idle;
+  }
+};
+
+FetchEngine::FetchEngine() = default;
+
+FetchEngine::~FetchEngine() {
+  for (auto &connection : connections_) {
+    connection->close();
+  }
+#if defined(__linux__)
+  if (epollFd_ >= 0) {
+    ::close(epollFd_);
+  }
+#endif
+}
+
+void FetchEngine::begin(size_t maxInFlight, size_t slotHeapBytes, Backend backend) {
+  abortAll();
+  maxInFlight_ = maxInFlight == 0 ? 1 : maxInFlight;
+  slotHeapBytes_ = slotHeapBytes;
+  backend_ = Backend::Select;
+#if defined(__linux__)
+  if (epollFd_ >= 0) {
+    ::close(epollFd_);
+    epollFd_ = -1;
+  }
+  if (backend == Backend::Epoll) {
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    backend_ = epollFd_ >= 0 ? Backend::Epoll : Backend::Select;
+  }
+#else
+  (void)backend;
+#endif
+  connections_.clear();
+  idle_.clear();
+  for (size_t i = 0; i < maxInFlight_; ++i) {
+    connections_.emplace_back(new Connection());
+    connections_.back()->index = static_cast<uint32_t>(i);
+  }
+  // Popped from the back: slot 0 first, as the scan used to pick.
+  for (size_t i = maxInFlight_; i > 0; --i) {
+    idle_.push_back(connections_[i - 1].get());
+  }
+}
+
+bool FetchEngine::canStart() const {
+  if (idle_.empty()) {
+    return false;
+  }
+  // The first connection is always admitted so a tight heap degrades to
+  // sequential checks instead of stalling the scheduler.
+  return slotHeapBytes_ == 0 || inFlight() == 0 || ESP.getMaxAllocHeap() >= slotHeapBytes_;
+}
+
+bool FetchEngine::start(const FetchRequest &request, FetchSink &sink) {
+  ALLOC_SCOPE("fetch");
+  if (!canStart()) {
+    return false;
+  }
+  Connection *connection = idle_.back();
+  idle_.pop_back();
+  connection->sink = &sink;
+  connection->startedAt = millis();
+  connection->timeoutMs = request.timeoutMs;
+  connection->maxBodyBytes = request.maxBodyBytes;
+  connection->delivered = 0;
+  connection->limitReached = false;
+  connection->firstByte = false;
+  connection->traceSite = request.traceSite;
+  connection->redirectsLeft = request.maxRedirects;
+  connection->redirects = 0;
+  connection->permanentOnly = true;
+  connection->permanentUrl = String();
+  connection->rangeStart = request.rangeStart;
+  connection->rangeBytes = request.rangeBytes;
+  connection->extraHeaders = String();
+  if (request.headers) {
+    for (const auto &kv : *request.headers) {
+      connection->extraHeaders += kv.first + ": " + kv.second + "\r\n";
+    }
+  }
+  connection->originHost = HttpUrl::parse(request.url).host;
+  connect(*connection, request.url);
+  return true;
+}
+
+bool FetchEngine::connect(Connection &connection, const String &target) {
+  connection.parser.reset();
+  connection.sent = 0;
+  connection.wantWrite = false;
+  connection.location = String();
+  connection.partialStart = 0;
+  connection.totalBytes = 0;
+  connection.url = target;
+  connection.phase = Connection::Phase::Connecting;
+
+  const HttpUrl url = HttpUrl::parse(target);
+  if (!url.valid) {
+    finish(connection, false, "URL inválida");
+    return false;
+  }
+  connection.secure = url.secure;
+  connection.host = url.host;
+
+  const char *error = "";
+  bool cached = false;
+  uint32_t address = 0;
+  if (dns_ && !dns_->resolve(url.host.c_str(), millis(), address, cached)) {
+    connection.fd = -1;
+    error = "DNS sin respuesta";
+  } else if (dns_) {
+    connection.fd = netio::connectNonBlocking(address, url.port, error);
+  } else {
+    connection.fd = netio::connectNonBlocking(url.host.c_str(), url.port, error);
+  }
+  // Name resolution, unless cached, blocks in here.
+  TRACE(FetchStart, connection.traceSite, cached, connection.elapsedMs(), connection.redirects);
+  if (connection.fd < 0) {
+    finish(connection, false, error);
+    return false;
+  }
+
+  const bool defaultPort = url.port == (url.secure ? 443 : 80);
+  connection.request = String("GET ") + url.path + " HTTP/1.1\r\nHost: " + url.host;
+  if (!defaultPort) {
+    connection.request += String(":") + url.port;
+  }
+  connection.request += "\r\nUser-Agent: ESP32-Web-Monitor\r\nAccept-Encoding: identity\r\nConnection: close\r\n";
+  if (connection.rangeBytes > 0) {
+    connection.request += String("Range: bytes=") + connection.rangeStart + "-" +
+                          (connection.rangeStart + connection.rangeBytes - 1) + "\r\n";
+  }
+  if (url.host.equalsIgnoreCase(connection.originHost)) {
+    connection.request += connection.extraHeaders;
+  }
+  connection.request += "\r\n";
+  watch(connection);
+  return true;
+}
+
+// Closes the redirect's connection and opens one to its Location; the slot,
+// the sink and the timeout carry over.
+void FetchEngine::follow(Connection &connection) {
+  const int status = connection.parser.statusCode();
+  const String target = HttpUrl::resolve(connection.url, connection.location);
+  connection.permanentOnly = connection.permanentOnly && (status == 301 || status == 308);
+  if (connection.permanentOnly) {
+    connection.permanentUrl = target;
+  }
+  ++connection.redirects;
+  --connection.redirectsLeft;
+  connection.close();
+  connect(connection, target);
+}
+
+void FetchEngine::watch(Connection &connection) {
+#if defined(__linux__)
+  if (backend_ != Backend::Epoll || connection.fd < 0) {
+    return;
+  }
+  const uint32_t wanted = connection.writing() ? EPOLLOUT : EPOLLIN;
+  if (connection.watched == wanted) {
+    return;
+  }
+  epoll_event event{};
+  event.events = wanted;
+  event.data.u64 = (static_cast<uint64_t>(connection.generation) << 32) | connection.index;
+  if (epoll_ctl(epollFd_, connection.watched == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, connection.fd, &event) == 0) {
+    connection.watched = wanted;
+  }
+#else
+  (void)connection;
+#endif
+}
+
+void FetchEngine::finish(Connection &connection, bool ok, const char *error) {
+  FetchResult result;
+  result.ok = ok;
+  result.statusCode = connection.parser.statusCode() > 0 ? connection.parser.statusCode() : -1;
+  result.bodyBytes = connection.limitReached ? connection.delivered : connection.parser.bodyBytes();
+  result.truncated = connection.limitReached;
+  result.elapsedMs = connection.elapsedMs();
+  result.error = error;
+  result.redirects = connection.redirects;
+  result.permanentUrl = connection.permanentUrl;
+  result.partial = result.statusCode == 206;
+  result.rangeStart = connection.partialStart;
+  result.totalBytes = connection.totalBytes;
+  TRACE(FetchDone, connection.traceSite, ok, result.elapsedMs, result.bodyBytes);
+  FetchSink *sink = connection.sink;
+  connection.sink = nullptr;
+  connection.close();
+  idle_.push_back(&connection);
+  if (sink) {
+    sink->onComplete(result);
+  }
+}
+
+void FetchEngine::abortAll() {
+  for (auto &connection : connections_) {
+    if (connection->phase != Connection::Phase::Idle) {
+      finish(*connection, false, "Cancelado");
+    }
+  }
+}
+
+// The sinks run inside, so what they allocate without a scope of their own
+// is charged to the fetch.
+void FetchEngine::poll(uint32_t waitMs) {
+  ALLOC_SCOPE("fetch");
+  if (backend_ == Backend::Epoll) {
+    pollEpoll(waitMs);
+  } else {
+    pollSelect(waitMs);
+  }
+}
+
+bool FetchEngine::advance(Connection &c) {
+  if (c.phase == Connection::Phase::Connecting) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+    if (error != 0) {
+      finish(c, false, "Conexión rechazada");
+      return false;
+    }
+    TRACE(FetchConnected, c.traceSite, 0, c.elapsedMs(), 0);
+    if (c.secure) {
+      const mbedtls_ssl_config *config = netio::tlsConfig();
+      mbedtls_ssl_init(&c.ssl);
+      c.tlsActive = true;
+      if (!config || mbedtls_ssl_setup(&c.ssl, config) != 0 ||
+          mbedtls_ssl_set_hostname(&c.ssl, c.host.c_str()) != 0) {
+        finish(c, false, "Error TLS");
+        return false;
+      }
+      mbedtls_ssl_set_bio(&c.ssl, &c.fd, netio::tlsSend, netio::tlsRecv, nullptr);
+      c.phase = Connection::Phase::Handshake;
+    } else {
+      c.phase = Connection::Phase::Sending;
+    }
+  }
+  if (c.phase == Connection::Phase::Handshake) {
+    const int rc = mbedtls_ssl_handshake(&c.ssl);
+    if (rc == 0) {
+      TRACE(FetchTls, c.traceSite, 0, c.elapsedMs(), 0);
+      c.phase = Connection::Phase::Sending;
+    } else if (rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE) {
+      c.wantWrite = rc == MBEDTLS_ERR_SSL_WANT_WRITE;
+    } else {
+      finish(c, false, "Error TLS");
+      return false;
+    }
+  }
+  if (c.phase == Connection::Phase::Sending) {
+    const char *data = c.request.c_str() + c.sent;
+    const size_t remaining = c.request.length() - c.sent;
+    int n = c.tlsActive ? mbedtls_ssl_write(&c.ssl, reinterpret_cast<const unsigned char *>(data), remaining)
+                        : static_cast<int>(::send(c.fd, data, remaining, MSG_NOSIGNAL));
+    if (n > 0) {
+      c.sent += static_cast<size_t>(n);
+      if (c.sent == static_cast<size_t>(c.request.length())) {
+        c.request = String();
+        c.phase = Connection::Phase::Receiving;
+      }
+    } else if (!(c.tlsActive ? (n == MBEDTLS_ERR_SSL_WANT_READ || n == MBEDTLS_ERR_SSL_WANT_WRITE)
+                             : wouldBlock())) {
+      finish(c, false, "Error al enviar solicitud");
+      return false;
+    }
+  } else if (c.phase == Connection::Phase::Receiving) {
+    char buffer[kReadChunk];
+    for (int i = 0; i < kReadsPerStep && c.phase == Connection::Phase::Receiving; ++i) {
+      int n = c.tlsActive ? mbedtls_ssl_read(&c.ssl, reinterpret_cast<unsigned char *>(buffer), sizeof(buffer))
+                          : static_cast<int>(::recv(c.fd, buffer, sizeof(buffer), 0));
+      if (n > 0) {
+        if (!c.firstByte) {
+          c.firstByte = true;
+          TRACE(FetchFirstByte, c.traceSite, 0, c.elapsedMs(), 0);
+        }
+        const bool fed = c.parser.feed(buffer, static_cast<size_t>(n), c);
+        if (c.redirectReady()) {
+          follow(c);
+          break;
+        }
+        if (!fed) {
+          if (c.limitReached) {
+            finish(c, true, "");
+          } else {
+            finish(c, false, c.parser.aborted() ? "Descarga abortada" : "Respuesta HTTP inválida");
+          }
+        } else if (c.parser.done()) {
+          finish(c, true, "");
+        }
+        continue;
+      }
+      const bool eof = n == 0 || (c.tlsActive && n == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY);
+      if (eof) {
+        const bool complete = c.parser.finishOnEof();
+        finish(c, complete, complete ? "" : "Conexión cerrada antes de tiempo");
+      } else if (!(c.tlsActive ? n == MBEDTLS_ERR_SSL_WANT_READ : wouldBlock())) {
+        finish(c, false, "Error de lectura");
+      }
+      break;
+    }
+  }
+  return c.phase != Connection::Phase::Idle;
+}
+
+void FetchEngine::pollSelect(uint32_t waitMs) {
+  fd_set readSet;
+  fd_set writeSet;
+  FD_ZERO(&readSet);
+  FD_ZERO(&writeSet);
+  int maxFd = -1;
+  bool pending = false;
+  for (auto &connection : connections_) {
+    Connection &c = *connection;
+    if (c.phase == Connection::Phase::Idle) {
+      continue;
+    }
+    FD_SET(c.fd, c.writing() ? &writeSet : &readSet);
+    maxFd = c.fd > maxFd ? c.fd : maxFd;
+    pending = pending || c.pendingTls();
+  }
+  if (maxFd < 0) {
+    return;
+  }
+  timeval timeout{};
+  timeout.tv_sec = pending ? 0 : waitMs / 1000;
+  timeout.tv_usec = pending ? 0 : (waitMs % 1000) * 1000;
+  if (::select(maxFd + 1, &readSet, &writeSet, nullptr, &timeout) < 0 && errno != EINTR) {
+    return;
+  }
+
+  for (auto &connection : connections_) {
+    Connection &c = *connection;
+    if (c.phase == Connection::Phase::Idle) {
+      continue;
+    }
+    const bool ready = FD_ISSET(c.fd, &readSet) || FD_ISSET(c.fd, &writeSet) || c.pendingTls();
+    if (ready && !advance(c)) {
+      continue;
+    }
+    if (millis() - c.startedAt > c.timeoutMs) {
+      finish(c, false, "Timeout");
+    }
+  }
+}
+
+void FetchEngine::pollEpoll(uint32_t waitMs) {
+#if defined(__linux__)
+  if (inFlight() == 0) {
+    return;
+  }
+  // Decrypted bytes mbedtls already holds never wake epoll up.
+  std::vector<Connection *> pending;
+  for (auto &connection : connections_) {
+    if (connection->tlsQueued) {
+      connection->tlsQueued = false;
+      pending.push_back(connection.get());
+    }
+  }
+  epoll_event events[kEpollEvents];
+  const int ready = epoll_wait(epollFd_, events, kEpollEvents, pending.empty() ? static_cast<int>(waitMs) : 0);
+  auto step = [this](Connection &c) {
+    if (advance(c)) {
+      watch(c);
+      if (c.pendingTls()) {
+        c.tlsQueued = true;
+      }
+    }
+  };
+  for (int i = 0; i < ready; ++i) {
+    const uint64_t key = events[i].data.u64;
+    Connection &c = *connections_[static_cast<uint32_t>(key)];
+    if (c.phase != Connection::Phase::Idle && c.generation == static_cast<uint32_t>(key >> 32)) {
+      step(c);
+    }
+  }
+  for (Connection *c : pending) {
+    if (c->phase != Connection::Phase::Idle && !c->tlsQueued) {
+      step(*c);
+    }
+  }
+  const unsigned long now = millis();
+  if (now - sweptAt_ < kTimeoutSweepMs) {
+    return;
+  }
+  sweptAt_ = now;
+  for (auto &connection : connections_) {
+    Connection &c = *connection;
+    if (c.phase != Connection::Phase::Idle && now - c.startedAt > c.timeoutMs) {
+      finish(c, false, "Timeout");
+    }
+  }
+#else
+  pollSelect(waitMs);
+#endif
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "DnsCache.h"
+#include "HttpProtocol.h"
+
+// Redirects followed per fetch; past that the redirect itself is the result.
+#ifndef FETCH_MAX_REDIRECTS
+#define FETCH_MAX_REDIRECTS 4
+#endif
+
+struct FetchRequest {
+  String url;
+  const std::map<String, String> *headers = nullptr;
+  uint32_t timeoutMs = 8000;
+  // Body bytes delivered at most; the connection is closed once reached. 0 = no limit.
+  size_t maxBodyBytes = 0;
+  uint8_t maxRedirects = FETCH_MAX_REDIRECTS;
+  // With rangeBytes > 0, asks for bytes [rangeStart, rangeStart + rangeBytes)
+  // of the resource only (Range); servers are free to send all of it.
+  size_t rangeStart = 0;
+  size_t rangeBytes = 0;
+  // Site tag of the engine's TRACE records (traceSiteTag()).
+  uint16_t traceSite = 0;
+};
+
+struct FetchResult {
+  bool ok = false;
+  int statusCode = -1;
+  size_t bodyBytes = 0;
+  uint32_t elapsedMs = 0;
+  const char *error = "";
+  // The body was cut at FetchRequest::maxBodyBytes; `ok` stays true.
+  bool truncated = false;
+  // Redirects followed, and the URL the leading permanent ones (301/308)
+  // lead to; empty when the first was temporary or there was none.
+  uint8_t redirects = 0;
+  String permanentUrl;
+  // The server answered the Range with 206: the body starts at rangeStart of
+  // a resource of totalBytes (0 when Content-Range did not say).
+  bool partial = false;
+  size_t rangeStart = 0;
+  size_t totalBytes = 0;
+};
+
+// Keeps `resolvedUrl`, the URL a site's next check goes to directly, in step
+// with a finished fetch: the permanent target when the chain ended in a 2xx or
+// 3xx, cleared after any failure (the redirect may be gone), else unchanged.
+void rememberRedirect(const FetchResult &result, String &resolvedUrl);
+
+class FetchSink {
+ public:
+  virtual ~FetchSink() = default;
+  virtual bool onHeader(const char *name, size_t nameLength, const char *value, size_t valueLength) {
+    (void)name;
+    (void)nameLength;
+    (void)value;
+    (void)valueLength;
+    return true;
+  }
+  // Body bytes as they arrive; returning false aborts the fetch.
+  virtual bool onBody(const char *data, size_t length) = 0;
+  virtual void onComplete(const FetchResult &result) = 0;
+};
+
+// Event-driven HTTP(S) fetcher: keeps up to maxInFlight non-blocking sockets
+// open and multiplexes them with select(), so a cycle costs roughly the
+// slowest response instead of the sum of all of them. A new connection is only
+// admitted while the largest free heap block covers slotHeapBytes (TLS buffers
+// dominate that figure on the ESP32); 0 skips that check.
+//
+// On Linux the Epoll backend replaces select() for thousands of sockets:
+// poll() then only touches the connections that are ready, plus a timeout
+// sweep every kTimeoutSweepMs.
+//
+// Redirects (301, 302, 303, 307, 308 with a Location) are followed on a new
+// connection within the same timeout; the sink only sees the final response.
+// The request's headers only go along while the host stays the same, while a
+// Range is asked again of every hop.
+class FetchEngine {
+ public:
+  enum class Backend { Select, Epoll };
+
+  FetchEngine();
+  ~FetchEngine();
+  FetchEngine(const FetchEngine &) = delete;
+  FetchEngine &operator=(const FetchEngine &) = delete;
+
+  // Epoll falls back to Select where epoll is not available.
+  void begin(size_t maxInFlight, size_t slotHeapBytes, Backend backend = Backend::Select);
+  // Hosts are then resolved through `cache` instead of on every start().
+  void setDnsCache(DnsCache *cache) { dns_ = cache; }
+  bool canStart() const;
+  // True once the sink owns the fetch: onComplete() then runs exactly once,
+  // possibly before start() returns when the connection fails right away
+  // (DNS miss, refused socket). False, with no callback, when canStart() is false.
+  bool start(const FetchRequest &request, FetchSink &sink);
+  // Waits up to waitMs for socket activity and advances every connection.
+  void poll(uint32_t waitMs);
+  void abortAll();
+
+  size_t inFlight() const { return maxInFlight_ - idle_.size(); }
+  size_t capacity() const { return maxInFlight_; }
+  Backend backend() const { return backend_; }
+
+ private:
+  struct Connection;
+
+  void pollSelect(uint32_t waitMs);
+  void pollEpoll(uint32_t waitMs);
+  // Runs the connection as far as its socket allows; false once it finished.
+  bool advance(Connection &connection);
+  void watch(Connection &connection);
+  // Opens the connection to `url` and queues the request; false when it
+  // already finished with an error.
+  bool connect(Connection &connection, const String &url);
+  void follow(Connection &connection);
+  void finish(Connection &connection, bool ok, const char *error);
+
+  std::vector<std::unique_ptr<Connection>> connections_;
+  // Connections free to start, so start() and inFlight() never scan.
+  std::vector<Connection *> idle_;
+  size_t maxInFlight_ = 0;
+  size_t slotHeapBytes_ = 0;
+  Backend backend_ = Backend::Select;
+  DnsCache *dns_ = nullptr;
+  int epollFd_ = -1;
+  unsigned long sweptAt_ = 0;
+};
@@ -0,0 +1,268 @@
+#include "HttpProtocol.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+bool equalsIgnoreCase(const char *a, size_t aLength, const char *b) {
+  const size_t bLength = strlen(b);
+  if (aLength != bLength) {
+    return false;
+  }
+  for (size_t i = 0; i < aLength; ++i) {
+    if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool containsIgnoreCase(const char *haystack, size_t length, const char *needle) {
+  const size_t needleLength = strlen(needle);
+  for (size_t i = 0; i + needleLength <= length; ++i) {
+    if (equalsIgnoreCase(haystack + i, needleLength, needle)) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+HttpUrl HttpUrl::parse(const String &url) {
+  HttpUrl parsed;
+  int schemeEnd = url.indexOf("://");
+  if (schemeEnd < 0) {
+    return parsed;
+  }
+  String scheme = url.substring(0, schemeEnd);
+  scheme.toLowerCase();
+  if (scheme == "https") {
+    parsed.secure = true;
+    parsed.port = 443;
+  } else if (scheme != "http") {
+    return parsed;
+  }
+  String rest = url.substring(schemeEnd + 3);
+  int pathStart = rest.indexOf('/');
+  int queryStart = rest.indexOf('?');
+  if (queryStart >= 0 && (pathStart < 0 || queryStart < pathStart)) {
+    pathStart = queryStart;
+  }
+  String authority = pathStart < 0 ? rest : rest.substring(0, pathStart);
+  parsed.path = pathStart < 0 ? String("/") : rest.substring(pathStart);
+  if (parsed.path.startsWith("?")) {
+    parsed.path = String("/") + parsed.path;
+  }
+  int at = authority.lastIndexOf('@');
+  if (at >= 0) {
+    authority = authority.substring(at + 1);
+  }
+  int colon = authority.lastIndexOf(':');
+  if (colon >= 0) {
+    parsed.port = static_cast<uint16_t>(authority.substring(colon + 1).toInt());
+    authority = authority.substring(0, colon);
+  }
+  parsed.host = authority;
+  parsed.valid = !parsed.host.isEmpty() && parsed.port != 0;
+  return parsed;
+}
+
+String HttpUrl::resolve(const String &base, const String &location) {
+  if (location.indexOf("://") > 0) {
+    return location;
+  }
+  const int schemeEnd = base.indexOf("://");
+  if (schemeEnd < 0) {
+    return location;
+  }
+  if (location.startsWith("//")) {
+    return base.substring(0, schemeEnd + 1) + location;
+  }
+  const int authorityEnd = base.indexOf('/', schemeEnd + 3);
+  const String origin = authorityEnd < 0 ? base : base.substring(0, authorityEnd);
+  if (location.startsWith("/")) {
+    return origin + location;
+  }
+  // Relative to the directory of the base path, ignoring its query.
+  String path = authorityEnd < 0 ? String("/") : base.substring(authorityEnd);
+  const int query = path.indexOf('?');
+  if (query >= 0) {
+    path = path.substring(0, query);
+  }
+  return origin + path.substring(0, path.lastIndexOf('/') + 1) + location;
+}
+
+void HttpResponseParser::reset() {
+  state_ = State::StatusLine;
+  lineLength_ = 0;
+  lineTruncated_ = false;
+  statusCode_ = 0;
+  contentLength_ = -1;
+  chunked_ = false;
+  remaining_ = 0;
+  bodyBytes_ = 0;
+  aborted_ = false;
+}
+
+void HttpResponseParser::headersComplete() {
+  if (statusCode_ == 204 || statusCode_ == 304 || (statusCode_ >= 100 && statusCode_ < 200)) {
+    state_ = statusCode_ < 200 ? State::StatusLine : State::Done;
+    return;
+  }
+  if (chunked_) {
+    state_ = State::ChunkSize;
+  } else if (contentLength_ == 0) {
+    state_ = State::Done;
+  } else {
+    remaining_ = contentLength_ > 0 ? static_cast<size_t>(contentLength_) : 0;
+    state_ = State::Body;
+  }
+}
+
+bool HttpResponseParser::consumeLine(HttpResponseHandler &handler) {
+  size_t length = lineLength_;
+  if (length > 0 && line_[length - 1] == '\r') {
+    --length;
+  }
+  line_[length] = '\0';
+  lineLength_ = 0;
+  const bool truncated = lineTruncated_;
+  lineTruncated_ = false;
+
+  switch (state_) {
+    case State::StatusLine: {
+      if (length == 0) {
+        return true;
+      }
+      if (strncmp(line_, "HTTP/", 5) != 0) {
+        fail();
+        return false;
+      }
+      const char *space = static_cast<const char *>(memchr(line_, ' ', length));
+      statusCode_ = space ? atoi(space + 1) : 0;
+      if (statusCode_ <= 0) {
+        fail();
+        return false;
+      }
+      contentLength_ = -1;
+      chunked_ = false;
+      state_ = State::Headers;
+      return true;
+    }
+    case State::Headers: {
+      if (length == 0) {
+        headersComplete();
+        return true;
+      }
+      if (truncated) {
+        return true;
+      }
+      const char *colon = static_cast<const char *>(memchr(line_, ':', length));
+      if (!colon) {
+        return true;
+      }
+      const size_t nameLength = static_cast<size_t>(colon - line_);
+      const char *value = colon + 1;
+      const char *end = line_ + length;
+      while (value < end && isspace(static_cast<unsigned char>(*value))) {
+        ++value;
+      }
+      while (end > value && isspace(static_cast<unsigned char>(end[-1]))) {
+        --end;
+      }
+      const size_t valueLength = static_cast<size_t>(end - value);
+      if (equalsIgnoreCase(line_, nameLength, "Content-Length")) {
+        contentLength_ = strtol(value, nullptr, 10);
+      } else if (equalsIgnoreCase(line_, nameLength, "Transfer-Encoding")) {
+        chunked_ = containsIgnoreCase(value, valueLength, "chunked");
+      }
+      if (!handler.onHeader(line_, nameLength, value, valueLength)) {
+        aborted_ = true;
+        fail();
+        return false;
+      }
+      return true;
+    }
+    case State::ChunkSize: {
+      if (length == 0) {
+        return true;
+      }
+      char *endPtr = nullptr;
+      const unsigned long size = strtoul(line_, &endPtr, 16);
+      if (endPtr == line_) {
+        fail();
+        return false;
+      }
+      remaining_ = static_cast<size_t>(size);
+      state_ = remaining_ == 0 ? State::Trailers : State::ChunkData;
+      return true;
+    }
+    case State::ChunkDataEnd:
+      state_ = State::ChunkSize;
+      return true;
+    case State::Trailers:
+      if (length == 0) {
+        state_ = State::Done;
+      }
+      return true;
+    default:
+      return true;
+  }
+}
+
+bool HttpResponseParser::feed(const char *data, size_t length, HttpResponseHandler &handler) {
+  size_t offset = 0;
+  while (offset < length) {
+    switch (state_) {
+      case State::Done:
+        return true;
+      case State::Error:
+        return false;
+      case State::Body:
+      case State::ChunkData: {
+        size_t take = length - offset;
+        if (state_ == State::ChunkData || contentLength_ >= 0) {
+          take = take < remaining_ ? take : remaining_;
+        }
+        if (take > 0) {
+          bodyBytes_ += take;
+          if (!handler.onBody(data + offset, take)) {
+            aborted_ = true;
+            fail();
+            return false;
+          }
+        }
+        offset += take;
+        if (state_ == State::ChunkData || contentLength_ >= 0) {
+          remaining_ -= take;
+          if (remaining_ == 0) {
+            state_ = state_ == State::ChunkData ? State::ChunkDataEnd : State::Done;
+          }
+        }
+        break;
+      }
+      default: {
+        const char c = data[offset++];
+        if (c == '\n') {
+          if (!consumeLine(handler)) {
+            return false;
+          }
+        } else if (lineLength_ + 1 < kLineCapacity) {
+          line_[lineLength_++] = c;
+        } else {
+          lineTruncated_ = true;
+        }
+        break;
+      }
+    }
+  }
+  return state_ != State::Error;
+}
+
+bool HttpResponseParser::finishOnEof() {
+  if (state_ == State::Body && contentLength_ < 0) {
+    state_ = State::Done;
+  }
+  return state_ == State::Done;
+}
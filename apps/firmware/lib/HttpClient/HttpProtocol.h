@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>
+
+struct HttpUrl {
+  bool valid = false;
+  bool secure = false;
+  String host;
+  uint16_t port = 80;
+  String path = "/";
+
+  static HttpUrl parse(const String &url);
+  // The absolute URL a Location header points to from `base`: absolute,
+  // scheme-relative ("//host/..."), absolute path or relative path.
+  static String resolve(const String &base, const String &location);
+};
+
+class HttpResponseHandler {
+ public:
+  virtual ~HttpResponseHandler() = default;
+  // Header names arrive as sent by the server; values are trimmed.
+  virtual bool onHeader(const char *name, size_t nameLength, const char *value, size_t valueLength) {
+    (void)name;
+    (void)nameLength;
+    (void)value;
+    (void)valueLength;
+    return true;
+  }
+  // Body bytes after transfer decoding; returning false aborts the response.
+  virtual bool onBody(const char *data, size_t length) = 0;
+};
+
+// Incremental HTTP/1.1 response parser: accepts arbitrary chunks straight from
+// the socket, decodes Content-Length and chunked bodies, and keeps only a small
+// fixed line buffer.
+class HttpResponseParser {
+ public:
+  enum class State { StatusLine, Headers, Body, ChunkSize, ChunkData, ChunkDataEnd, Trailers, Done, Error };
+
+  void reset();
+  // Returns false once the response is malformed or the handler aborted.
+  bool feed(const char *data, size_t length, HttpResponseHandler &handler);
+  // Call on EOF: bodies without Content-Length/chunking end with the connection.
+  bool finishOnEof();
+
+  State state() const { return state_; }
+  bool done() const { return state_ == State::Done; }
+  bool failed() const { return state_ == State::Error; }
+  int statusCode() const { return statusCode_; }
+  long contentLength() const { return contentLength_; }
+  size_t bodyBytes() const { return bodyBytes_; }
+  bool aborted() const { return aborted_; }
+
+ private:
+  static constexpr size_t kLineCapacity = 256;
+
+  bool consumeLine(HttpResponseHandler &handler);
+  void headersComplete();
+  void fail() { state_ = State::Error; }
+
+  State state_ = State::StatusLine;
+  char line_[kLineCapacity];
+  size_t lineLength_ = 0;
+  bool lineTruncated_ = false;
+  int statusCode_ = 0;
+  long contentLength_ = -1;
+  bool chunked_ = false;
+  size_t remaining_ = 0;
+  size_t bodyBytes_ = 0;
+  bool aborted_ = false;
+};
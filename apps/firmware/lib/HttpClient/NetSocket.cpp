@@ -0,0 +1,126 @@
+#include "NetSocket.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+struct TlsShared {
+  mbedtls_entropy_context entropy;
+  mbedtls_ctr_drbg_context drbg;
+  mbedtls_ssl_config config;
+  bool ready = false;
+
+  bool init() {
+    if (ready) {
+      return true;
+    }
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_ssl_config_init(&config);
+    static const char kPersonalization[] = "esp32-web-monitor";
+    if (mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy,
+                              reinterpret_cast<const unsigned char *>(kPersonalization),
+                              sizeof(kPersonalization) - 1) != 0) {
+      return false;
+    }
+    if (mbedtls_ssl_config_defaults(&config, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+      return false;
+    }
+    mbedtls_ssl_conf_authmode(&config, MBEDTLS_SSL_VERIFY_NONE);
+    mbedtls_ssl_conf_rng(&config, mbedtls_ctr_drbg_random, &drbg);
+    ready = true;
+    return true;
+  }
+};
+}  // namespace
+
+namespace netio {
+
+bool setNonBlocking(int fd) {
+  const int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+bool wouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINPROGRESS; }
+
+bool resolveIpv4(const char *host, uint32_t &address) {
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *resolved = nullptr;
+  if (getaddrinfo(host, nullptr, &hints, &resolved) != 0 || !resolved) {
+    return false;
+  }
+  address = reinterpret_cast<const sockaddr_in *>(resolved->ai_addr)->sin_addr.s_addr;
+  freeaddrinfo(resolved);
+  return true;
+}
+
+int connectNonBlocking(uint32_t address, uint16_t port, const char *&error) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0 || !setNonBlocking(fd)) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    error = "Sin sockets disponibles";
+    return -1;
+  }
+  sockaddr_in target{};
+  target.sin_family = AF_INET;
+  target.sin_port = htons(port);
+  target.sin_addr.s_addr = address;
+  const int rc = ::connect(fd, reinterpret_cast<const sockaddr *>(&target), sizeof(target));
+  if (rc != 0 && errno != EINPROGRESS) {
+    ::close(fd);
+    error = "Conexión rechazada";
+    return -1;
+  }
+  return fd;
+}
+
+int connectNonBlocking(const char *host, uint16_t port, const char *&error) {
+  uint32_t address = 0;
+  if (!resolveIpv4(host, address)) {
+    error = "DNS sin respuesta";
+    return -1;
+  }
+  return connectNonBlocking(address, port, error);
+}
+
+const mbedtls_ssl_config *tlsConfig() {
+  static TlsShared shared;
+  return shared.init() ? &shared.config : nullptr;
+}
+
+int tlsSend(void *context, const unsigned char *data, size_t length) {
+  const int fd = *static_cast<int *>(context);
+  const ssize_t n = ::send(fd, data, length, MSG_NOSIGNAL);
+  if (n < 0) {
+    return wouldBlock() ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+  }
+  return static_cast<int>(n);
+}
+
+int tlsRecv(void *context, unsigned char *data, size_t length) {
+  const int fd = *static_cast<int *>(context);
+  const ssize_t n = ::recv(fd, data, length, 0);
+  if (n < 0) {
+    return wouldBlock() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+  }
+  return static_cast<int>(n);
+}
+
+}  // namespace netio
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <mbedtls/ssl.h>
+
+// Non-blocking socket and TLS plumbing shared by FetchEngine and the MQTT
+// transport.
+namespace netio {
+
+bool setNonBlocking(int fd);
+bool wouldBlock();
+
+// IPv4 address of host in network byte order; blocks like lwIP's getaddrinfo.
+bool resolveIpv4(const char *host, uint32_t &address);
+// Starts a non-blocking connect. Returns the socket, or -1 with `error` set.
+int connectNonBlocking(uint32_t address, uint16_t port, const char *&error);
+// resolveIpv4() followed by the connect above.
+int connectNonBlocking(const char *host, uint16_t port, const char *&error);
+
+// One entropy/DRBG/config shared by every TLS session; nullptr if mbedtls
+// could not be seeded. Certificates are not verified, matching the
+// WiFiClientSecure::setInsecure() the firmware used.
+const mbedtls_ssl_config *tlsConfig();
+
+// mbedtls BIO callbacks; the context is a pointer to the socket descriptor.
+int tlsSend(void *context, const unsigned char *data, size_t length);
+int tlsRecv(void *context, unsigned char *data, size_t length);
+
+}  // namespace netio
@@ -0,0 +1,92 @@
+#include "ItemSet.h"
+
+#include <algorithm>
+
+namespace {
+constexpr uint32_t kFnvOffset = 0x811c9dc5u;
+constexpr uint32_t kFnvPrime = 0x01000193u;
+constexpr size_t kExcerptBytes = 120;
+}  // namespace
+
+void ItemSet::begin(const std::vector<uint32_t> &previous, size_t maxItems) {
+  previous_ = previous;
+  maxItems_ = maxItems == 0 ? LIST_MAX_ITEMS : std::min<size_t>(maxItems, LIST_MAX_ITEMS);
+  digests_.clear();
+  digests_.reserve(maxItems_);
+  addedItems_.clear();
+  removedItems_.clear();
+  seen_ = 0;
+  added_ = 0;
+  removed_ = 0;
+  truncated_ = false;
+  beginItem();
+}
+
+void ItemSet::beginItem() {
+  digest_ = kFnvOffset;
+  headLength_ = 0;
+}
+
+void ItemSet::update(const char *data, size_t length) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < length; ++i) {
+    digest_ = (digest_ ^ p[i]) * kFnvPrime;
+  }
+  const size_t take = std::min(length, sizeof(head_) - headLength_);
+  memcpy(head_ + headLength_, data, take);
+  headLength_ += take;
+}
+
+void ItemSet::endItem() {
+  ++seen_;
+  const auto at = std::lower_bound(digests_.begin(), digests_.end(), digest_);
+  if (at != digests_.end() && *at == digest_) {
+    return;
+  }
+  if (digests_.size() >= maxItems_) {
+    truncated_ = true;
+    return;
+  }
+  digests_.insert(at, digest_);
+  if (previous_.empty() || std::binary_search(previous_.begin(), previous_.end(), digest_)) {
+    return;
+  }
+  ++added_;
+  if (addedItems_.size() < LIST_EVENT_ITEMS) {
+    size_t length = headLength_;
+    // Whole UTF-8 characters only: head_ holds one byte past kHeadBytes.
+    if (length > kHeadBytes) {
+      length = kHeadBytes;
+      while (length > 0 && (static_cast<uint8_t>(head_[length]) & 0xC0) == 0x80) {
+        --length;
+      }
+    }
+    addedItems_.push_back({digest_, String(head_, length)});
+  }
+}
+
+void ItemSet::finish() {
+  for (uint32_t digest : previous_) {
+    if (std::binary_search(digests_.begin(), digests_.end(), digest)) {
+      continue;
+    }
+    ++removed_;
+    if (removedItems_.size() < LIST_EVENT_ITEMS) {
+      removedItems_.push_back(digest);
+    }
+  }
+}
+
+String ItemSet::excerpt() const {
+  String excerpt;
+  for (const AddedItem &item : addedItems_) {
+    if (!excerpt.isEmpty()) {
+      excerpt += " … ";
+    }
+    excerpt += item.head;
+    if (static_cast<size_t>(excerpt.length()) >= kExcerptBytes) {
+      break;
+    }
+  }
+  return excerpt;
+}
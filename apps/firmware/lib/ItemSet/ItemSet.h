@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <vector>
+
+// Most items a list site keeps by default, and at most; a site can ask for
+// fewer with max_items. The digests are kept per site, 4 bytes each.
+#ifndef LIST_MAX_ITEMS
+#define LIST_MAX_ITEMS 64
+#endif
+
+// Added and removed items listed in each event; the rest are only counted.
+#ifndef LIST_EVENT_ITEMS
+#define LIST_EVENT_ITEMS 8
+#endif
+
+// The items of a listing (search results, a product grid) as a sorted set of
+// 32-bit digests. Each item is hashed as it streams past and checked against
+// the previous check's set straight away, so a new item's head can be kept
+// for the event without buffering it. Memory is the two digest sets plus
+// LIST_EVENT_ITEMS heads, however long the page is. Order does not matter: a
+// listing that only reshuffles is unchanged.
+class ItemSet {
+ public:
+  static constexpr size_t kHeadBytes = 48;
+
+  struct AddedItem {
+    uint32_t digest;
+    String head;
+  };
+
+  // `previous` is the sorted set stored by the last check (possibly none).
+  void begin(const std::vector<uint32_t> &previous, size_t maxItems);
+  void beginItem();
+  // Text of the current item, in pieces.
+  void update(const char *data, size_t length);
+  void endItem();
+  void finish();
+
+  // Sorted and without duplicates.
+  const std::vector<uint32_t> &digests() const { return digests_; }
+  // Items in the page, duplicates and those past the cap included.
+  size_t seen() const { return seen_; }
+  // Some distinct items were dropped because the set was full.
+  bool truncated() const { return truncated_; }
+  // Items not in `previous`, and previous ones not seen now. Both are 0 when
+  // there was no previous set.
+  size_t addedCount() const { return added_; }
+  size_t removedCount() const { return removed_; }
+  // The first LIST_EVENT_ITEMS of each, in page and digest order.
+  const std::vector<AddedItem> &added() const { return addedItems_; }
+  const std::vector<uint32_t> &removed() const { return removedItems_; }
+  // Heads of the added items, joined with " … ", at most 120 bytes.
+  String excerpt() const;
+
+ private:
+  std::vector<uint32_t> previous_;
+  std::vector<uint32_t> digests_;
+  std::vector<AddedItem> addedItems_;
+  std::vector<uint32_t> removedItems_;
+  size_t maxItems_ = LIST_MAX_ITEMS;
+  uint32_t digest_ = 0;
+  char head_[kHeadBytes + 1];
+  size_t headLength_ = 0;
+  size_t seen_ = 0;
+  size_t added_ = 0;
+  size_t removed_ = 0;
+  bool truncated_ = false;
+};
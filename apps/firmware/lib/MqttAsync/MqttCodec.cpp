@@ -0,0 +1,213 @@
+#include "MqttCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+size_t lengthFieldBytes(size_t remaining) {
+  size_t bytes = 1;
+  while (remaining >= 128) {
+    remaining /= 128;
+    ++bytes;
+  }
+  return bytes;
+}
+
+void putFixedHeader(mqtt::Bytes &out, uint8_t header, size_t remaining) {
+  out.push_back(header);
+  do {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    if (remaining > 0) {
+      digit |= 0x80;
+    }
+    out.push_back(digit);
+  } while (remaining > 0);
+}
+
+void putUint16(mqtt::Bytes &out, uint16_t value) {
+  out.push_back(static_cast<uint8_t>(value >> 8));
+  out.push_back(static_cast<uint8_t>(value & 0xFF));
+}
+
+void putString(mqtt::Bytes &out, const char *data, size_t length) {
+  putUint16(out, static_cast<uint16_t>(length));
+  out.insert(out.end(), data, data + length);
+}
+
+uint16_t readUint16(const uint8_t *p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+}  // namespace
+
+namespace mqtt {
+
+size_t publishSize(size_t topicLength, size_t payloadLength, uint8_t qos) {
+  const size_t remaining = 2 + topicLength + (qos > 0 ? 2 : 0) + payloadLength;
+  return 1 + lengthFieldBytes(remaining) + remaining;
+}
+
+void encodeConnect(Bytes &out, const char *clientId, uint16_t keepAliveS, bool cleanSession) {
+  const size_t idLength = strlen(clientId);
+  putFixedHeader(out, kConnect << 4, 10 + 2 + idLength);
+  putString(out, "MQTT", 4);
+  out.push_back(4);     // protocol level 3.1.1
+  out.push_back(cleanSession ? 0x02 : 0x00);  // no will, no credentials
+  putUint16(out, keepAliveS);
+  putString(out, clientId, idLength);
+}
+
+void encodeConnack(Bytes &out, uint8_t returnCode) {
+  putFixedHeader(out, kConnack << 4, 2);
+  out.push_back(0);
+  out.push_back(returnCode);
+}
+
+void encodePublish(Bytes &out, const char *topic, size_t topicLength, const char *payload, size_t payloadLength,
+                   uint8_t qos, uint16_t packetId, bool dup, bool retain) {
+  const uint8_t header =
+      static_cast<uint8_t>((kPublish << 4) | (dup ? 0x08 : 0) | ((qos & 0x03) << 1) | (retain ? 0x01 : 0));
+  out.reserve(out.size() + publishSize(topicLength, payloadLength, qos));
+  putFixedHeader(out, header, 2 + topicLength + (qos > 0 ? 2 : 0) + payloadLength);
+  putString(out, topic, topicLength);
+  if (qos > 0) {
+    putUint16(out, packetId);
+  }
+  out.insert(out.end(), payload, payload + payloadLength);
+}
+
+void encodeSubscribe(Bytes &out, uint16_t packetId, const char *filter, uint8_t qos) {
+  const size_t filterLength = strlen(filter);
+  // SUBSCRIBE carries reserved flags 0b0010.
+  putFixedHeader(out, (kSubscribe << 4) | 0x02, 2 + 2 + filterLength + 1);
+  putUint16(out, packetId);
+  putString(out, filter, filterLength);
+  out.push_back(qos);
+}
+
+void encodeSuback(Bytes &out, uint16_t packetId, uint8_t grantedQos) {
+  putFixedHeader(out, kSuback << 4, 3);
+  putUint16(out, packetId);
+  out.push_back(grantedQos);
+}
+
+void encodeAck(Bytes &out, PacketType type, uint16_t packetId) {
+  putFixedHeader(out, static_cast<uint8_t>(type << 4), 2);
+  putUint16(out, packetId);
+}
+
+void encodeEmpty(Bytes &out, PacketType type) { putFixedHeader(out, static_cast<uint8_t>(type << 4), 0); }
+
+bool decodePublish(const Packet &packet, PublishView &out) {
+  if (packet.type() != kPublish || packet.length < 2) {
+    return false;
+  }
+  out.qos = (packet.flags() >> 1) & 0x03;
+  out.dup = (packet.flags() & 0x08) != 0;
+  out.retain = (packet.flags() & 0x01) != 0;
+  const size_t topicLength = readUint16(packet.body);
+  size_t offset = 2 + topicLength;
+  if (out.qos > 2 || offset + (out.qos > 0 ? 2 : 0) > packet.length) {
+    return false;
+  }
+  out.topic = reinterpret_cast<const char *>(packet.body + 2);
+  out.topicLength = topicLength;
+  out.packetId = 0;
+  if (out.qos > 0) {
+    out.packetId = readUint16(packet.body + offset);
+    offset += 2;
+  }
+  out.payload = reinterpret_cast<char *>(const_cast<uint8_t *>(packet.body + offset));
+  out.payloadLength = packet.length - offset;
+  return true;
+}
+
+bool decodeSubscribe(const Packet &packet, SubscribeView &out) {
+  if (packet.type() != kSubscribe || packet.length < 2) {
+    return false;
+  }
+  out.packetId = readUint16(packet.body);
+  out.filters.clear();
+  size_t offset = 2;
+  while (offset + 2 <= packet.length) {
+    const size_t filterLength = readUint16(packet.body + offset);
+    offset += 2;
+    if (offset + filterLength + 1 > packet.length) {
+      return false;
+    }
+    out.filters.emplace_back(String(reinterpret_cast<const char *>(packet.body + offset), filterLength),
+                             packet.body[offset + filterLength]);
+    offset += filterLength + 1;
+  }
+  return offset == packet.length && !out.filters.empty();
+}
+
+bool decodeConnack(const Packet &packet, uint8_t &returnCode) {
+  if (packet.type() != kConnack || packet.length != 2) {
+    return false;
+  }
+  returnCode = packet.body[1];
+  return true;
+}
+
+bool decodePacketId(const Packet &packet, uint16_t &packetId) {
+  if (packet.length < 2) {
+    return false;
+  }
+  packetId = readUint16(packet.body);
+  return true;
+}
+
+void PacketReader::reset() {
+  phase_ = Phase::Header;
+  remaining_ = 0;
+  multiplier_ = 1;
+  lengthBytes_ = 0;
+  body_.clear();
+}
+
+PacketReader::Status PacketReader::feed(const uint8_t *data, size_t length, const Handler &handler) {
+  size_t offset = 0;
+  while (offset < length) {
+    if (phase_ == Phase::Header) {
+      header_ = data[offset++];
+      remaining_ = 0;
+      multiplier_ = 1;
+      lengthBytes_ = 0;
+      phase_ = Phase::Length;
+      continue;
+    }
+    if (phase_ == Phase::Length) {
+      const uint8_t digit = data[offset++];
+      remaining_ += (digit & 0x7F) * multiplier_;
+      multiplier_ *= 128;
+      if (++lengthBytes_ > 4) {
+        return Status::Malformed;
+      }
+      if (digit & 0x80) {
+        continue;
+      }
+      if (1 + lengthBytes_ + remaining_ > maxPacketBytes_) {
+        return Status::TooLarge;
+      }
+      body_.clear();
+      body_.reserve(remaining_);
+      phase_ = Phase::Body;
+    } else {
+      const size_t take = std::min(length - offset, remaining_ - body_.size());
+      body_.insert(body_.end(), data + offset, data + offset + take);
+      offset += take;
+    }
+    if (phase_ == Phase::Body && body_.size() == remaining_) {
+      phase_ = Phase::Header;
+      Packet packet;
+      packet.header = header_;
+      packet.body = body_.data();
+      packet.length = body_.size();
+      if (!handler(packet)) {
+        return Status::Rejected;
+      }
+    }
+  }
+  return Status::Ok;
+}
+
+}  // namespace mqtt
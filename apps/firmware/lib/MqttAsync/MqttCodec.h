@@ -0,0 +1,104 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <functional>
+#include <vector>
+
+// MQTT 3.1.1 packet encoding/decoding, without any I/O. Encoders append one
+// complete packet to `out`; the client and the native broker stand-in share it.
+namespace mqtt {
+
+enum PacketType : uint8_t {
+  kConnect = 1,
+  kConnack = 2,
+  kPublish = 3,
+  kPuback = 4,
+  kSubscribe = 8,
+  kSuback = 9,
+  kPingreq = 12,
+  kPingresp = 13,
+  kDisconnect = 14,
+};
+
+// CONNACK return codes.
+constexpr uint8_t kConnectAccepted = 0;
+constexpr uint8_t kServerUnavailable = 3;
+
+using Bytes = std::vector<uint8_t>;
+
+struct Packet {
+  uint8_t header = 0;
+  const uint8_t *body = nullptr;
+  size_t length = 0;
+
+  uint8_t type() const { return header >> 4; }
+  uint8_t flags() const { return header & 0x0F; }
+};
+
+struct PublishView {
+  const char *topic = nullptr;
+  size_t topicLength = 0;
+  // Points into the reader's buffer, which the handler may modify in place.
+  char *payload = nullptr;
+  size_t payloadLength = 0;
+  uint8_t qos = 0;
+  bool dup = false;
+  bool retain = false;
+  uint16_t packetId = 0;
+};
+
+struct SubscribeView {
+  uint16_t packetId = 0;
+  std::vector<std::pair<String, uint8_t>> filters;
+};
+
+// Bytes on the wire for a PUBLISH, fixed header included.
+size_t publishSize(size_t topicLength, size_t payloadLength, uint8_t qos);
+
+void encodeConnect(Bytes &out, const char *clientId, uint16_t keepAliveS, bool cleanSession = true);
+void encodeConnack(Bytes &out, uint8_t returnCode);
+void encodePublish(Bytes &out, const char *topic, size_t topicLength, const char *payload, size_t payloadLength,
+                   uint8_t qos, uint16_t packetId, bool dup, bool retain = false);
+void encodeSubscribe(Bytes &out, uint16_t packetId, const char *filter, uint8_t qos);
+void encodeSuback(Bytes &out, uint16_t packetId, uint8_t grantedQos);
+// PUBACK and the other two-byte acknowledgements.
+void encodeAck(Bytes &out, PacketType type, uint16_t packetId);
+// PINGREQ, PINGRESP and DISCONNECT.
+void encodeEmpty(Bytes &out, PacketType type);
+
+bool decodePublish(const Packet &packet, PublishView &out);
+bool decodeSubscribe(const Packet &packet, SubscribeView &out);
+bool decodeConnack(const Packet &packet, uint8_t &returnCode);
+// Packet identifier of PUBACK/SUBACK and friends.
+bool decodePacketId(const Packet &packet, uint16_t &packetId);
+
+// Incremental framer: bytes go in as they arrive from the socket, whole
+// packets come out. Packets larger than maxPacketBytes fail the stream, as
+// there is no way to resynchronize without reading them.
+class PacketReader {
+ public:
+  enum class Status { Ok, TooLarge, Malformed, Rejected };
+  using Handler = std::function<bool(const Packet &packet)>;
+
+  explicit PacketReader(size_t maxPacketBytes = 2048) : maxPacketBytes_(maxPacketBytes) {}
+
+  void setLimit(size_t maxPacketBytes) { maxPacketBytes_ = maxPacketBytes; }
+  void reset();
+  // Calls `handler` for every packet completed by these bytes; a false return
+  // stops with Status::Rejected.
+  Status feed(const uint8_t *data, size_t length, const Handler &handler);
+
+ private:
+  enum class Phase { Header, Length, Body };
+
+  Phase phase_ = Phase::Header;
+  uint8_t header_ = 0;
+  size_t remaining_ = 0;
+  uint32_t multiplier_ = 1;
+  int lengthBytes_ = 0;
+  Bytes body_;
+  size_t maxPacketBytes_;
+};
+
+}  // namespace mqtt
@@ -0,0 +1,338 @@
+#include "MqttEngine.h"
+
+#include <AllocProfile.h>
+#include <algorithm>
+
+namespace {
+constexpr size_t kReadChunk = 512;
+constexpr int kReadsPerPoll = 8;
+}  // namespace
+
+void MqttEngine::begin(const MqttOptions &options) {
+  options_ = options;
+  if (options_.inflightWindow == 0) {
+    options_.inflightWindow = 1;
+  }
+  reader_.setLimit(options_.maxPacketBytes);
+  backoffMs_ = options_.reconnectMinMs;
+  retryDelayMs_ = 0;
+  phaseStartedAt_ = millis();
+  phase_ = Phase::Waiting;
+}
+
+void MqttEngine::subscribe(const String &filter, uint8_t qos) {
+  subscriptions_.emplace_back(filter, qos);
+  if (phase_ == Phase::Connected) {
+    mqtt::encodeSubscribe(tx_, nextPacketId(), filter.c_str(), qos);
+  }
+}
+
+bool MqttEngine::canPublish() const { return phase_ == Phase::Connected && outbox_.size() < options_.outboxSlots; }
+
+bool MqttEngine::publish(const String &topic, String payload, uint8_t qos, bool retain) {
+  ALLOC_SCOPE("mqtt");
+  if (!canPublish() || mqtt::publishSize(topic.length(), payload.length(), qos) > options_.maxPacketBytes) {
+    return false;
+  }
+  Outgoing message;
+  message.topic = topic;
+  message.payload = std::move(payload);
+  message.qos = qos > 0 ? 1 : 0;
+  message.retain = retain;
+  message.queuedAtUs = micros();
+  outbox_.push_back(std::move(message));
+  ++stats_.published;
+  return true;
+}
+
+void MqttEngine::poll(uint32_t waitMs) {
+  ALLOC_SCOPE("mqtt");
+  switch (phase_) {
+    case Phase::Idle:
+      return;
+    case Phase::Waiting:
+      if (millis() - phaseStartedAt_ >= retryDelayMs_) {
+        startConnect();
+      }
+      return;
+    case Phase::Connecting: {
+      const MqttTransport::State state = transport_.poll(waitMs, true);
+      if (state == MqttTransport::State::Open) {
+        tx_.clear();
+        txOffset_ = 0;
+        reader_.reset();
+        mqtt::encodeConnect(tx_, options_.clientId.c_str(), options_.keepAliveS, options_.cleanSession);
+        phase_ = Phase::AwaitConnack;
+        flush();
+      } else if (state != MqttTransport::State::Connecting) {
+        fail(transport_.error());
+      } else if (millis() - phaseStartedAt_ > options_.connectTimeoutMs) {
+        fail("Timeout");
+      }
+      return;
+    }
+    case Phase::AwaitConnack:
+    case Phase::Connected:
+      break;
+  }
+
+  fillWindow();
+  if (transport_.poll(waitMs, hasPendingWrite()) != MqttTransport::State::Open) {
+    fail(transport_.error());
+    return;
+  }
+  if (!readPackets()) {
+    return;
+  }
+  fillWindow();
+  if (!flush()) {
+    return;
+  }
+  const unsigned long now = millis();
+  if (phase_ == Phase::AwaitConnack) {
+    if (now - phaseStartedAt_ > options_.connectTimeoutMs) {
+      fail("Timeout");
+    }
+    return;
+  }
+  const uint32_t keepAliveMs = static_cast<uint32_t>(options_.keepAliveS) * 1000;
+  if (keepAliveMs == 0) {
+    return;
+  }
+  if (pingPending_) {
+    if (now - pingSentAt_ > keepAliveMs) {
+      fail("Sin respuesta del broker");
+    }
+  } else if (now - lastWriteAt_ >= keepAliveMs / 2) {
+    mqtt::encodeEmpty(tx_, mqtt::kPingreq);
+    pingPending_ = true;
+    pingSentAt_ = now;
+    flush();
+  }
+}
+
+uint32_t MqttEngine::idleMs() const {
+  const unsigned long now = millis();
+  switch (phase_) {
+    case Phase::Idle:
+      return UINT32_MAX;
+    case Phase::Waiting: {
+      const unsigned long waited = now - phaseStartedAt_;
+      return waited >= retryDelayMs_ ? 0 : static_cast<uint32_t>(retryDelayMs_ - waited);
+    }
+    case Phase::Connecting:
+    case Phase::AwaitConnack:
+      return 0;
+    case Phase::Connected:
+      break;
+  }
+  if (hasPendingWrite() || !outbox_.empty() || pingPending_) {
+    return 0;
+  }
+  const uint32_t keepAliveMs = static_cast<uint32_t>(options_.keepAliveS) * 1000;
+  if (keepAliveMs == 0) {
+    return UINT32_MAX;
+  }
+  const unsigned long quiet = now - lastWriteAt_;
+  return quiet >= keepAliveMs / 2 ? 0 : static_cast<uint32_t>(keepAliveMs / 2 - quiet);
+}
+
+void MqttEngine::startConnect() {
+  phaseStartedAt_ = millis();
+  if (!transport_.open(options_.host.c_str(), options_.port)) {
+    fail(transport_.error());
+    return;
+  }
+  phase_ = Phase::Connecting;
+}
+
+void MqttEngine::fail(const char *error) {
+  const bool wasConnected = phase_ == Phase::Connected;
+  transport_.close();
+  tx_.clear();
+  txOffset_ = 0;
+  reader_.reset();
+  inflight_ = 0;
+  pingPending_ = false;
+  // Whatever was written but not acknowledged goes out again, first and in
+  // order, once the session is back.
+  for (Outgoing &message : outbox_) {
+    if (message.sent) {
+      message.sent = false;
+      message.dup = true;
+    }
+  }
+  if (wasConnected) {
+    ++stats_.disconnects;
+    if (millis() - connectedAt_ >= options_.stableSessionMs) {
+      backoffMs_ = options_.reconnectMinMs;
+    }
+  } else {
+    ++stats_.connectFailures;
+  }
+  retryDelayMs_ = backoffMs_;
+  backoffMs_ = std::min(backoffMs_ * 2, options_.reconnectMaxMs);
+  phase_ = Phase::Waiting;
+  phaseStartedAt_ = millis();
+  if (onDisconnect_) {
+    onDisconnect_(error && *error ? error : "Conexión perdida");
+  }
+}
+
+bool MqttEngine::readPackets() {
+  uint8_t buffer[kReadChunk];
+  for (int i = 0; i < kReadsPerPoll; ++i) {
+    const int n = transport_.read(buffer, sizeof(buffer));
+    if (n == 0) {
+      return true;
+    }
+    if (n < 0) {
+      fail(transport_.error());
+      return false;
+    }
+    rejectReason_ = nullptr;
+    const mqtt::PacketReader::Status status =
+        reader_.feed(buffer, static_cast<size_t>(n), [this](const mqtt::Packet &packet) { return handlePacket(packet); });
+    if (status != mqtt::PacketReader::Status::Ok) {
+      fail(status == mqtt::PacketReader::Status::TooLarge ? "Paquete MQTT demasiado grande"
+           : rejectReason_                                 ? rejectReason_
+                                                           : "Paquete MQTT inválido");
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MqttEngine::handlePacket(const mqtt::Packet &packet) {
+  switch (packet.type()) {
+    case mqtt::kConnack: {
+      uint8_t returnCode = 0;
+      if (phase_ != Phase::AwaitConnack || !mqtt::decodeConnack(packet, returnCode)) {
+        return false;
+      }
+      if (returnCode != mqtt::kConnectAccepted) {
+        rejectReason_ = "Conexión rechazada por el broker";
+        return false;
+      }
+      phase_ = Phase::Connected;
+      connectedAt_ = millis();
+      lastWriteAt_ = connectedAt_;
+      ++stats_.connects;
+      for (const auto &subscription : subscriptions_) {
+        mqtt::encodeSubscribe(tx_, nextPacketId(), subscription.first.c_str(), subscription.second);
+      }
+      if (onConnect_) {
+        onConnect_();
+      }
+      return true;
+    }
+    case mqtt::kPublish: {
+      mqtt::PublishView message;
+      if (phase_ != Phase::Connected || !mqtt::decodePublish(packet, message) || message.qos > 1) {
+        return false;
+      }
+      if (message.qos == 1) {
+        mqtt::encodeAck(tx_, mqtt::kPuback, message.packetId);
+      }
+      ++stats_.received;
+      if (onMessage_) {
+        onMessage_(message.topic, message.topicLength, message.payload, message.payloadLength);
+      }
+      return true;
+    }
+    case mqtt::kPuback: {
+      uint16_t packetId = 0;
+      if (!mqtt::decodePacketId(packet, packetId)) {
+        return false;
+      }
+      auto it = std::find_if(outbox_.begin(), outbox_.end(), [packetId](const Outgoing &message) {
+        return message.sent && message.packetId == packetId;
+      });
+      if (it != outbox_.end()) {
+        const uint32_t elapsedUs = static_cast<uint32_t>(micros() - it->queuedAtUs);
+        stats_.ackMicrosTotal += elapsedUs;
+        stats_.ackMicrosMax = std::max(stats_.ackMicrosMax, elapsedUs);
+        ++stats_.acked;
+        --inflight_;
+        outbox_.erase(it);
+      }
+      return true;
+    }
+    case mqtt::kPingresp:
+      pingPending_ = false;
+      return true;
+    default:
+      // SUBACK and anything a 3.1.1 broker may add; a refused subscription
+      // shows up as commands never arriving, not as a broken session.
+      return true;
+  }
+}
+
+void MqttEngine::fillWindow() {
+  if (phase_ != Phase::Connected) {
+    return;
+  }
+  bool wroteQos0 = false;
+  for (Outgoing &message : outbox_) {
+    if (inflight_ >= options_.inflightWindow || tx_.size() - txOffset_ >= options_.maxPacketBytes) {
+      break;
+    }
+    if (message.sent) {
+      continue;
+    }
+    if (message.qos > 0 && message.packetId == 0) {
+      message.packetId = nextPacketId();
+    }
+    mqtt::encodePublish(tx_, message.topic.c_str(), message.topic.length(), message.payload.c_str(),
+                        message.payload.length(), message.qos, message.packetId, message.dup, message.retain);
+    if (message.dup) {
+      ++stats_.retransmitted;
+    }
+    message.sent = true;
+    if (message.qos > 0) {
+      ++inflight_;
+    } else {
+      wroteQos0 = true;
+    }
+  }
+  stats_.inflightPeak = std::max(stats_.inflightPeak, static_cast<uint32_t>(inflight_));
+  if (wroteQos0) {
+    // QoS0 is done once it is in the write buffer.
+    outbox_.erase(std::remove_if(outbox_.begin(), outbox_.end(),
+                                 [](const Outgoing &message) { return message.sent && message.qos == 0; }),
+                  outbox_.end());
+  }
+}
+
+bool MqttEngine::flush() {
+  while (hasPendingWrite()) {
+    const int n = transport_.write(tx_.data() + txOffset_, tx_.size() - txOffset_);
+    if (n == 0) {
+      break;
+    }
+    if (n < 0) {
+      fail(transport_.error());
+      return false;
+    }
+    txOffset_ += static_cast<size_t>(n);
+    lastWriteAt_ = millis();
+  }
+  if (!hasPendingWrite()) {
+    tx_.clear();
+    txOffset_ = 0;
+  }
+  return true;
+}
+
+uint16_t MqttEngine::nextPacketId() {
+  while (true) {
+    if (++lastPacketId_ == 0) {
+      lastPacketId_ = 1;
+    }
+    const uint16_t candidate = lastPacketId_;
+    if (std::none_of(outbox_.begin(), outbox_.end(),
+                     [candidate](const Outgoing &message) { return message.packetId == candidate; })) {
+      return candidate;
+    }
+  }
+}
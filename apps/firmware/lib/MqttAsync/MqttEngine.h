@@ -0,0 +1,141 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "MqttCodec.h"
+#include "MqttTransport.h"
+
+// QoS1 PUBLISHes written before the first PUBACK comes back.
+#ifndef MQTT_INFLIGHT_WINDOW
+#define MQTT_INFLIGHT_WINDOW 4
+#endif
+
+// Messages the engine holds (in flight plus waiting for the window); beyond
+// that publish() refuses and the caller keeps them in its own queue.
+#ifndef MQTT_OUTBOX_SLOTS
+#define MQTT_OUTBOX_SLOTS 8
+#endif
+
+struct MqttOptions {
+  String host;
+  uint16_t port = 8883;
+  String clientId;
+  uint16_t keepAliveS = 30;
+  // false asks the broker to keep the subscriptions and queue QoS1 messages
+  // while the device is away (deep sleep).
+  bool cleanSession = true;
+  size_t maxPacketBytes = 2048;
+  size_t inflightWindow = MQTT_INFLIGHT_WINDOW;
+  size_t outboxSlots = MQTT_OUTBOX_SLOTS;
+  uint32_t connectTimeoutMs = 10000;
+  // Reconnect delay doubles per failed attempt or dropped session between
+  // these two. It only goes back to the minimum once a session stayed up for
+  // stableSessionMs, so a broker that accepts and then kicks the client (a
+  // duplicate client ID, an ACL, a restart loop) is not hammered.
+  uint32_t reconnectMinMs = 2000;
+  uint32_t reconnectMaxMs = 30000;
+  uint32_t stableSessionMs = 60000;
+};
+
+struct MqttStats {
+  uint32_t connects = 0;
+  uint32_t connectFailures = 0;
+  uint32_t disconnects = 0;
+  uint32_t published = 0;
+  uint32_t acked = 0;
+  uint32_t retransmitted = 0;
+  uint32_t received = 0;
+  uint32_t inflightPeak = 0;
+  // publish() to PUBACK, so time spent waiting for the window counts too.
+  uint64_t ackMicrosTotal = 0;
+  uint32_t ackMicrosMax = 0;
+};
+
+// Non-blocking MQTT 3.1.1 client. publish() only queues; poll() connects,
+// keeps up to inflightWindow QoS1 messages on the wire at once and resends
+// the unacknowledged ones (with DUP) after a reconnect, in their original
+// order. Subscriptions are remembered and renewed on every connect.
+class MqttEngine {
+ public:
+  using MessageHandler = std::function<void(const char *topic, size_t topicLength, char *payload, size_t length)>;
+  using ConnectHandler = std::function<void()>;
+  using DisconnectHandler = std::function<void(const char *error)>;
+
+  explicit MqttEngine(MqttTransport &transport) : transport_(transport) {}
+  MqttEngine(const MqttEngine &) = delete;
+  MqttEngine &operator=(const MqttEngine &) = delete;
+
+  void begin(const MqttOptions &options);
+  void subscribe(const String &filter, uint8_t qos);
+  void onMessage(MessageHandler handler) { onMessage_ = std::move(handler); }
+  void onConnect(ConnectHandler handler) { onConnect_ = std::move(handler); }
+  void onDisconnect(DisconnectHandler handler) { onDisconnect_ = std::move(handler); }
+
+  bool connected() const { return phase_ == Phase::Connected; }
+  // Connected with a free outbox slot.
+  bool canPublish() const;
+  // Queues the message; false if !canPublish() or it exceeds maxPacketBytes.
+  // A retained message is what the broker hands to later subscribers.
+  bool publish(const String &topic, String payload, uint8_t qos = 1, bool retain = false);
+  // Waits up to waitMs for socket activity and advances the session.
+  void poll(uint32_t waitMs);
+
+  // How long poll() can go uncalled without hurting the session: until the
+  // keepalive PINGREQ or the reconnect attempt is due. 0 while connecting or
+  // with anything to write or acknowledge.
+  uint32_t idleMs() const;
+
+  size_t pending() const { return outbox_.size(); }
+  size_t inflight() const { return inflight_; }
+  const MqttStats &stats() const { return stats_; }
+
+ private:
+  enum class Phase { Idle, Waiting, Connecting, AwaitConnack, Connected };
+
+  struct Outgoing {
+    String topic;
+    String payload;
+    uint8_t qos = 1;
+    uint16_t packetId = 0;
+    bool sent = false;
+    bool dup = false;
+    bool retain = false;
+    unsigned long queuedAtUs = 0;
+  };
+
+  void startConnect();
+  void fail(const char *error);
+  bool readPackets();
+  bool handlePacket(const mqtt::Packet &packet);
+  void fillWindow();
+  bool flush();
+  uint16_t nextPacketId();
+  bool hasPendingWrite() const { return txOffset_ < tx_.size(); }
+
+  MqttTransport &transport_;
+  MqttOptions options_;
+  Phase phase_ = Phase::Idle;
+  std::vector<std::pair<String, uint8_t>> subscriptions_;
+  std::deque<Outgoing> outbox_;
+  size_t inflight_ = 0;
+  mqtt::Bytes tx_;
+  size_t txOffset_ = 0;
+  mqtt::PacketReader reader_;
+  uint16_t lastPacketId_ = 0;
+  unsigned long phaseStartedAt_ = 0;
+  uint32_t retryDelayMs_ = 0;
+  unsigned long lastWriteAt_ = 0;
+  unsigned long pingSentAt_ = 0;
+  bool pingPending_ = false;
+  uint32_t backoffMs_ = 0;
+  unsigned long connectedAt_ = 0;
+  const char *rejectReason_ = nullptr;
+  MessageHandler onMessage_;
+  ConnectHandler onConnect_;
+  DisconnectHandler onDisconnect_;
+  MqttStats stats_;
+};
@@ -0,0 +1,155 @@
+#include "MqttTransport.h"
+
+#include <NetSocket.h>
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+bool SocketTransport::open(const char *host, uint16_t port) {
+  close();
+  host_ = host;
+  error_ = "";
+  fd_ = netio::connectNonBlocking(host, port, error_);
+  if (fd_ < 0) {
+    phase_ = Phase::Failed;
+    return false;
+  }
+  // PUBLISH packets are written whole, so Nagle would only add latency.
+  int one = 1;
+  setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  phase_ = Phase::Connecting;
+  return true;
+}
+
+void SocketTransport::fail(const char *error) {
+  error_ = error;
+  phase_ = Phase::Failed;
+}
+
+MqttTransport::State SocketTransport::poll(uint32_t waitMs, bool wantWrite) {
+  if (phase_ == Phase::Closed) {
+    return State::Closed;
+  }
+  if (phase_ == Phase::Failed) {
+    return State::Failed;
+  }
+  const bool pendingTls = tlsActive_ && mbedtls_ssl_get_bytes_avail(&ssl_) > 0;
+  const bool writing = phase_ == Phase::Connecting || (phase_ == Phase::Handshake && handshakeWantsWrite_) ||
+                       (phase_ == Phase::Open && wantWrite);
+  fd_set readSet;
+  fd_set writeSet;
+  FD_ZERO(&readSet);
+  FD_ZERO(&writeSet);
+  if (phase_ != Phase::Connecting) {
+    FD_SET(fd_, &readSet);
+  }
+  if (writing) {
+    FD_SET(fd_, &writeSet);
+  }
+  timeval timeout{};
+  timeout.tv_sec = pendingTls ? 0 : waitMs / 1000;
+  timeout.tv_usec = pendingTls ? 0 : (waitMs % 1000) * 1000;
+  const int ready = ::select(fd_ + 1, &readSet, &writeSet, nullptr, &timeout);
+  if (ready < 0 && errno != EINTR) {
+    fail("Error de socket");
+    return State::Failed;
+  }
+  if (ready <= 0 && !pendingTls) {
+    return phase_ == Phase::Open ? State::Open : State::Connecting;
+  }
+
+  if (phase_ == Phase::Connecting) {
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &length);
+    if (error != 0) {
+      fail("Conexión rechazada");
+      return State::Failed;
+    }
+    if (!secure_) {
+      phase_ = Phase::Open;
+      return State::Open;
+    }
+    const mbedtls_ssl_config *config = netio::tlsConfig();
+    mbedtls_ssl_init(&ssl_);
+    tlsActive_ = true;
+    if (!config || mbedtls_ssl_setup(&ssl_, config) != 0 || mbedtls_ssl_set_hostname(&ssl_, host_.c_str()) != 0) {
+      fail("Error TLS");
+      return State::Failed;
+    }
+    mbedtls_ssl_set_bio(&ssl_, &fd_, netio::tlsSend, netio::tlsRecv, nullptr);
+    phase_ = Phase::Handshake;
+  }
+  if (phase_ == Phase::Handshake) {
+    const int rc = mbedtls_ssl_handshake(&ssl_);
+    if (rc == 0) {
+      phase_ = Phase::Open;
+    } else if (rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE) {
+      handshakeWantsWrite_ = rc == MBEDTLS_ERR_SSL_WANT_WRITE;
+    } else {
+      fail("Error TLS");
+      return State::Failed;
+    }
+  }
+  return phase_ == Phase::Open ? State::Open : State::Connecting;
+}
+
+int SocketTransport::read(uint8_t *data, size_t length) {
+  if (phase_ != Phase::Open) {
+    return phase_ == Phase::Failed || phase_ == Phase::Closed ? -1 : 0;
+  }
+  const int n = tlsActive_ ? mbedtls_ssl_read(&ssl_, data, length) : static_cast<int>(::recv(fd_, data, length, 0));
+  if (n > 0) {
+    return n;
+  }
+  if (n == 0 || (tlsActive_ && n == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY)) {
+    fail("Conexión cerrada por el broker");
+    return -1;
+  }
+  const bool blocked = tlsActive_ ? (n == MBEDTLS_ERR_SSL_WANT_READ || n == MBEDTLS_ERR_SSL_WANT_WRITE)
+                                  : netio::wouldBlock();
+  if (blocked) {
+    return 0;
+  }
+  fail("Error de lectura");
+  return -1;
+}
+
+int SocketTransport::write(const uint8_t *data, size_t length) {
+  if (phase_ != Phase::Open) {
+    return phase_ == Phase::Failed || phase_ == Phase::Closed ? -1 : 0;
+  }
+  const int n = tlsActive_ ? mbedtls_ssl_write(&ssl_, data, length)
+                           : static_cast<int>(::send(fd_, data, length, MSG_NOSIGNAL));
+  if (n > 0) {
+    return n;
+  }
+  const bool blocked = tlsActive_ ? (n == MBEDTLS_ERR_SSL_WANT_READ || n == MBEDTLS_ERR_SSL_WANT_WRITE)
+                                  : (n < 0 && netio::wouldBlock());
+  if (blocked) {
+    return 0;
+  }
+  fail("Error al enviar");
+  return -1;
+}
+
+void SocketTransport::close() {
+  if (tlsActive_) {
+    mbedtls_ssl_free(&ssl_);
+    tlsActive_ = false;
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  handshakeWantsWrite_ = false;
+  phase_ = Phase::Closed;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <mbedtls/ssl.h>
+
+// Byte stream under MqttEngine. Every call returns immediately; poll() is the
+// only place that may wait.
+class MqttTransport {
+ public:
+  enum class State { Closed, Connecting, Open, Failed };
+
+  virtual ~MqttTransport() = default;
+  // Starts connecting; false if it failed before any I/O (DNS, no sockets).
+  virtual bool open(const char *host, uint16_t port) = 0;
+  // Waits up to waitMs for the stream to become readable (or writable when
+  // wantWrite) and advances the TCP connect and TLS handshake.
+  virtual State poll(uint32_t waitMs, bool wantWrite) = 0;
+  // Bytes moved, 0 if the call would block, -1 once the stream is closed or failed.
+  virtual int read(uint8_t *data, size_t length) = 0;
+  virtual int write(const uint8_t *data, size_t length) = 0;
+  virtual void close() = 0;
+  virtual const char *error() const = 0;
+};
+
+// Non-blocking TCP socket, optionally wrapped in TLS with the configuration
+// FetchEngine uses.
+class SocketTransport : public MqttTransport {
+ public:
+  explicit SocketTransport(bool secure) : secure_(secure) {}
+  ~SocketTransport() override { close(); }
+  SocketTransport(const SocketTransport &) = delete;
+  SocketTransport &operator=(const SocketTransport &) = delete;
+
+  bool open(const char *host, uint16_t port) override;
+  State poll(uint32_t waitMs, bool wantWrite) override;
+  int read(uint8_t *data, size_t length) override;
+  int write(const uint8_t *data, size_t length) override;
+  void close() override;
+  const char *error() const override { return error_; }
+
+ private:
+  enum class Phase { Closed, Connecting, Handshake, Open, Failed };
+
+  void fail(const char *error);
+
+  bool secure_;
+  Phase phase_ = Phase::Closed;
+  int fd_ = -1;
+  bool tlsActive_ = false;
+  bool handshakeWantsWrite_ = false;
+  String host_;
+  const char *error_ = "";
+  mbedtls_ssl_context ssl_;
+};
@@ -0,0 +1,106 @@
+#include "SleepPlanner.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+constexpr uint32_t kPowerMagic = 0x50575231;  // "PWR1"
+
+struct PowerBlock {
+  uint32_t magic;
+  PowerStats stats;
+  uint32_t sleepMs;
+  uint32_t check;
+};
+static_assert(std::is_trivial<PowerBlock>::value, "PowerBlock is cleared with memset");
+
+RTC_NOINIT_ATTR PowerBlock rtcPower;
+
+uint32_t blockCheck(const PowerBlock &block) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&block);
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < offsetof(PowerBlock, check); ++i) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+}  // namespace
+
+const char *powerPolicyName(PowerPolicy policy) {
+  switch (policy) {
+    case PowerPolicy::AlwaysOn:
+      return "always_on";
+    case PowerPolicy::LightSleep:
+      return "light";
+    case PowerPolicy::DeepSleep:
+      return "deep";
+  }
+  return "";
+}
+
+bool SleepPlanner::begin(const Options &options) {
+  options_ = options;
+  stats_ = PowerStats();
+  awakeSince_ = 0;
+  const bool resumed = rtcPower.magic == kPowerMagic && rtcPower.check == blockCheck(rtcPower);
+  if (resumed) {
+    stats_ = rtcPower.stats;
+    stats_.sleptMsTotal += rtcPower.sleepMs;
+  }
+  // Used once: a reset that is not a deep sleep wake starts over.
+  rtcPower.magic = 0;
+  return resumed;
+}
+
+uint32_t SleepPlanner::batchWindowMs() const {
+  return options_.policy == PowerPolicy::AlwaysOn ? 0 : options_.batchWindowMs;
+}
+
+SleepPlan SleepPlanner::plan(const IdleState &idle) const {
+  SleepPlan plan;
+  if (options_.policy == PowerPolicy::AlwaysOn || idle.busy) {
+    return plan;
+  }
+  if (options_.policy == PowerPolicy::DeepSleep && idle.retainable && idle.nextCheckMs >= options_.deepSleepMinMs &&
+      idle.nextCheckMs > options_.wakeLeadMs) {
+    plan.kind = SleepKind::Deep;
+    plan.durationMs = std::min(idle.nextCheckMs - options_.wakeLeadMs, options_.deepSleepMaxMs);
+    return plan;
+  }
+  const uint32_t durationMs = std::min({idle.nextCheckMs, idle.nextReportMs, idle.mqttIdleMs});
+  if (durationMs >= options_.minSleepMs) {
+    plan.kind = SleepKind::Light;
+    plan.durationMs = durationMs;
+  }
+  return plan;
+}
+
+void SleepPlanner::sleeping(unsigned long now, SleepKind kind) {
+  const uint32_t awakeMs = static_cast<uint32_t>(now - awakeSince_);
+  ++stats_.cycles;
+  stats_.awakeMsLast = awakeMs;
+  stats_.awakeMsMax = std::max(stats_.awakeMsMax, awakeMs);
+  stats_.awakeMsTotal += awakeMs;
+  if (kind == SleepKind::Deep) {
+    ++stats_.deepSleeps;
+  } else {
+    ++stats_.lightSleeps;
+  }
+  sleepingSince_ = now;
+}
+
+void SleepPlanner::woke(unsigned long now) {
+  stats_.sleptMsTotal += now - sleepingSince_;
+  awakeSince_ = now;
+}
+
+void SleepPlanner::retain(uint32_t sleepMs) {
+  std::memset(&rtcPower, 0, sizeof(rtcPower));
+  rtcPower.magic = kPowerMagic;
+  rtcPower.stats = stats_;
+  rtcPower.sleepMs = sleepMs;
+  rtcPower.check = blockCheck(rtcPower);
+}
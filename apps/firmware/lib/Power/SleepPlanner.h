@@ -0,0 +1,124 @@
+#pragma once
+
+#include <Arduino.h>
+
+// 0: always awake (loop() polls flat out, as before); 1: light sleep between
+// checks; 2: deep sleep when the gap is long enough, light sleep otherwise.
+#ifndef POWER_POLICY
+#define POWER_POLICY 0
+#endif
+
+// Idle gaps shorter than this are spent awake.
+#ifndef POWER_MIN_SLEEP_MS
+#define POWER_MIN_SLEEP_MS 2000
+#endif
+
+// A site that comes due takes along every site due within this window, so
+// the radio wakes once for all of them.
+#ifndef POWER_BATCH_WINDOW_MS
+#define POWER_BATCH_WINDOW_MS 10000
+#endif
+
+// Deep sleep pays for a WiFi join, TLS and MQTT connect on every wake, so
+// only gaps this long use it.
+#ifndef POWER_DEEP_SLEEP_MIN_MS
+#define POWER_DEEP_SLEEP_MIN_MS 120000
+#endif
+
+// Longest deep sleep. Every wake publishes a LOAD report, and the server
+// takes a device silent for 10 minutes as gone.
+#ifndef POWER_DEEP_SLEEP_MAX_MS
+#define POWER_DEEP_SLEEP_MAX_MS 300000
+#endif
+
+// Deep sleep ends this early so the device is back online when the check is
+// due.
+#ifndef POWER_WAKE_LEAD_MS
+#define POWER_WAKE_LEAD_MS 5000
+#endif
+
+enum class PowerPolicy : uint8_t { AlwaysOn = 0, LightSleep = 1, DeepSleep = 2 };
+
+enum class SleepKind : uint8_t { Awake = 0, Light = 1, Deep = 2 };
+
+const char *powerPolicyName(PowerPolicy policy);
+
+// What loop() has pending when it considers sleeping.
+struct IdleState {
+  // Checks in flight, events to send or acknowledge, sites still loading or
+  // a trace dump going out: loop() has to keep polling.
+  bool busy = false;
+  // Until the next site comes due.
+  uint32_t nextCheckMs = UINT32_MAX;
+  // Until the next LOAD report; a deep sleep sends it on waking instead.
+  uint32_t nextReportMs = UINT32_MAX;
+  // Until the MQTT session needs poll() again (keepalive, reconnect).
+  uint32_t mqttIdleMs = UINT32_MAX;
+  // Everything a deep sleep would lose is on flash or in RTC memory.
+  bool retainable = false;
+};
+
+struct SleepPlan {
+  SleepKind kind = SleepKind::Awake;
+  uint32_t durationMs = 0;
+};
+
+// Trivial, so it can sit in RTC memory and be cleared with memset (padding
+// included, which the block's checksum covers); PowerStats() zeroes it.
+struct PowerStats {
+  // Awake stretches ended by a sleep.
+  uint32_t cycles;
+  uint32_t lightSleeps;
+  uint32_t deepSleeps;
+  uint32_t awakeMsLast;
+  uint32_t awakeMsMax;
+  uint64_t awakeMsTotal;
+  uint64_t sleptMsTotal;
+
+  uint32_t awakeMsAvg() const { return cycles == 0 ? 0 : static_cast<uint32_t>(awakeMsTotal / cycles); }
+  uint32_t awakePct() const {
+    const uint64_t total = awakeMsTotal + sleptMsTotal;
+    return total == 0 ? 100 : static_cast<uint32_t>(awakeMsTotal * 100 / total);
+  }
+};
+
+// Decides whether loop() sleeps, how and for how long, and measures the awake
+// time of every cycle. Pure policy plus bookkeeping: the caller gathers the
+// idle state and does the sleeping. The stats survive a deep sleep in RTC
+// memory.
+class SleepPlanner {
+ public:
+  struct Options {
+    PowerPolicy policy = static_cast<PowerPolicy>(POWER_POLICY);
+    uint32_t minSleepMs = POWER_MIN_SLEEP_MS;
+    uint32_t batchWindowMs = POWER_BATCH_WINDOW_MS;
+    uint32_t deepSleepMinMs = POWER_DEEP_SLEEP_MIN_MS;
+    uint32_t deepSleepMaxMs = POWER_DEEP_SLEEP_MAX_MS;
+    uint32_t wakeLeadMs = POWER_WAKE_LEAD_MS;
+  };
+
+  // Picks up the stats retained by a deep sleep; false on any other boot.
+  // The first cycle counts from boot.
+  bool begin(const Options &options);
+
+  SleepPlan plan(const IdleState &idle) const;
+  // How early sites may run to join a batch; 0 when always awake.
+  uint32_t batchWindowMs() const;
+  PowerPolicy policy() const { return options_.policy; }
+
+  // Closes the awake cycle.
+  void sleeping(unsigned long now, SleepKind kind);
+  // After a light sleep (which may end early on MQTT traffic).
+  void woke(unsigned long now);
+  // Right before the deep sleep starts: the stats and its length go to RTC
+  // memory for begin() on the wake.
+  void retain(uint32_t sleepMs);
+
+  const PowerStats &stats() const { return stats_; }
+
+ private:
+  Options options_;
+  PowerStats stats_{};
+  unsigned long awakeSince_ = 0;
+  unsigned long sleepingSince_ = 0;
+};
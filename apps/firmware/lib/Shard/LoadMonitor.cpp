@@ -0,0 +1,60 @@
+#include "LoadMonitor.h"
+
+#include <algorithm>
+
+void LoadMonitor::begin(size_t slots, const Options &options) {
+  options_ = options;
+  slots_ = slots > 0 ? slots : 1;
+  seq_ = 0;
+  checks_ = 0;
+  checkMs_ = 0;
+  lagMaxMs_ = 0;
+  minFreeHeap_ = SIZE_MAX;
+}
+
+void LoadMonitor::checkStarted(uint32_t lagMs) { lagMaxMs_ = std::max(lagMaxMs_, lagMs); }
+
+void LoadMonitor::checkFinished(uint32_t durationMs) {
+  ++checks_;
+  // Smoothed over about eight checks; one slow page should not move shards.
+  checkMs_ = checkMs_ == 0 ? std::max<uint32_t>(durationMs, 1) : (checkMs_ * 7 + durationMs) / 8;
+}
+
+void LoadMonitor::noteFreeHeap(size_t freeHeap) { minFreeHeap_ = std::min(minFreeHeap_, freeHeap); }
+
+LoadReport LoadMonitor::report(const SiteList &sites, unsigned long nowMs) {
+  LoadReport report;
+  report.seq = ++seq_;
+  report.sites = sites.size();
+  report.checks = checks_;
+  report.checkMs = checkMs_;
+  report.lagMs = lagMaxMs_;
+  // Slot-milliseconds per millisecond the schedule asks for.
+  double demand = 0;
+  for (const auto &record : sites) {
+    if (record.config.paused) {
+      continue;
+    }
+    ++report.active;
+    const uint32_t intervalMs = std::max<uint32_t>(record.config.intervalSeconds, 1) * 1000;
+    demand += static_cast<double>(checkMs_) / intervalMs;
+    // A site the device has not got to yet is late too.
+    if (record.state.checkedSinceBoot && !record.state.inFlight && nowMs - record.state.lastCheckAt > intervalMs) {
+      report.lagMs = std::max<uint32_t>(report.lagMs, nowMs - record.state.lastCheckAt - intervalMs);
+    }
+  }
+  report.cycleMs = static_cast<uint32_t>(static_cast<uint64_t>(checkMs_) * report.active / slots_);
+  report.utilizationPct = static_cast<uint16_t>(std::min(demand * 100 / slots_, 65535.0));
+  report.minFreeHeap = minFreeHeap_ == SIZE_MAX ? 0 : minFreeHeap_;
+  if (report.utilizationPct >= options_.overloadUtilizationPct) {
+    report.overload = "utilization";
+  } else if (report.lagMs >= options_.overloadLagMs) {
+    report.overload = "lag";
+  } else if (minFreeHeap_ < options_.minHeapBytes) {
+    report.overload = "heap";
+  }
+  checks_ = 0;
+  lagMaxMs_ = 0;
+  minFreeHeap_ = SIZE_MAX;
+  return report;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Arduino.h>
+#include <site_record.h>
+
+// How often the device publishes its LOAD report.
+#ifndef LOAD_REPORT_INTERVAL_MS
+#define LOAD_REPORT_INTERVAL_MS 60000
+#endif
+
+// A due site waiting longer than this to start means the device is behind.
+#ifndef LOAD_OVERLOAD_LAG_MS
+#define LOAD_OVERLOAD_LAG_MS 120000
+#endif
+
+// Share of the check slots the site list needs to stay on schedule.
+#ifndef LOAD_OVERLOAD_UTILIZATION_PCT
+#define LOAD_OVERLOAD_UTILIZATION_PCT 90
+#endif
+
+struct LoadReport {
+  uint32_t seq = 0;
+  size_t sites = 0;
+  size_t active = 0;
+  // Checks finished since the previous report.
+  uint32_t checks = 0;
+  // Smoothed duration of one check, connect to extraction.
+  uint32_t checkMs = 0;
+  // Time to check every active site once with all slots busy.
+  uint32_t cycleMs = 0;
+  // Longest a due site waited to start, in this window or right now.
+  uint32_t lagMs = 0;
+  uint16_t utilizationPct = 0;
+  size_t minFreeHeap = 0;
+  // "utilization", "lag" or "heap"; nullptr while the device keeps up.
+  const char *overload = nullptr;
+};
+
+// Measures whether this device keeps up with its share of the sites, for the
+// LOAD reports the server balances shards with. Pure bookkeeping: the caller
+// feeds it check timings and heap samples.
+class LoadMonitor {
+ public:
+  struct Options {
+    uint32_t overloadLagMs = LOAD_OVERLOAD_LAG_MS;
+    uint16_t overloadUtilizationPct = LOAD_OVERLOAD_UTILIZATION_PCT;
+    // Free heap below this at any point of the window counts as overload.
+    size_t minHeapBytes = 0;
+  };
+
+  void begin(size_t slots, const Options &options);
+  // A scheduled check started `lagMs` after it came due.
+  void checkStarted(uint32_t lagMs);
+  void checkFinished(uint32_t durationMs);
+  void noteFreeHeap(size_t freeHeap);
+  // Closes the window.
+  LoadReport report(const SiteList &sites, unsigned long nowMs);
+
+ private:
+  Options options_;
+  size_t slots_ = 1;
+  uint32_t seq_ = 0;
+  uint32_t checks_ = 0;
+  uint32_t checkMs_ = 0;
+  uint32_t lagMaxMs_ = 0;
+  size_t minFreeHeap_ = SIZE_MAX;
+};
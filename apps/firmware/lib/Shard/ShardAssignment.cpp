@@ -0,0 +1,50 @@
+#include "ShardAssignment.h"
+
+#include <algorithm>
+#include <iterator>
+
+ShardAssignment::Result ShardAssignment::add(uint32_t epoch, uint16_t part, uint16_t parts,
+                                             const std::vector<String> &ids) {
+  if (parts == 0 || part >= parts || (assigned_ && epoch <= epoch_)) {
+    return Result::Rejected;
+  }
+  if (part == 0) {
+    pendingEpoch_ = epoch;
+    nextPart_ = 0;
+    pending_.clear();
+  } else if (epoch != pendingEpoch_ || part != nextPart_) {
+    // A lost part cannot be filled in later: wait for the whole assignment again.
+    pending_.clear();
+    nextPart_ = 0;
+    return Result::Rejected;
+  }
+  pending_.insert(pending_.end(), ids.begin(), ids.end());
+  ++nextPart_;
+  if (nextPart_ < parts) {
+    return Result::Collecting;
+  }
+  std::sort(pending_.begin(), pending_.end());
+  owned_.swap(pending_);
+  pending_.clear();
+  pending_.shrink_to_fit();
+  nextPart_ = 0;
+  epoch_ = epoch;
+  assigned_ = true;
+  return Result::Applied;
+}
+
+bool ShardAssignment::owns(const String &id) const {
+  return !assigned_ || std::binary_search(owned_.begin(), owned_.end(), id);
+}
+
+std::vector<String> ShardAssignment::missing(const SiteList &sites) const {
+  std::vector<String> local;
+  local.reserve(sites.size());
+  for (const auto &record : sites) {
+    local.push_back(record.config.id);
+  }
+  std::sort(local.begin(), local.end());
+  std::vector<String> result;
+  std::set_difference(owned_.begin(), owned_.end(), local.begin(), local.end(), std::back_inserter(result));
+  return result;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+#include <site_record.h>
+
+#include <vector>
+
+// Site ids this device owns, as sent by ASSIGN_SHARD. A long list arrives in
+// several parts (one MQTT packet holds about a hundred ids) and only takes
+// effect once the last one is in. Until the first assignment the device owns
+// whatever it has been sent, as a single device always did.
+class ShardAssignment {
+ public:
+  enum class Result {
+    // More parts to come.
+    Collecting,
+    // The assignment is complete and now in effect.
+    Applied,
+    // Out of order, or from an older epoch; the server resends it when the
+    // LOAD report shows the device on a different epoch.
+    Rejected,
+  };
+
+  Result add(uint32_t epoch, uint16_t part, uint16_t parts, const std::vector<String> &ids);
+
+  bool assigned() const { return assigned_; }
+  uint32_t epoch() const { return epoch_; }
+  bool owns(const String &id) const;
+  // Owned ids without a local site, so the server knows to send UPSERT_SITE.
+  std::vector<String> missing(const SiteList &sites) const;
+
+ private:
+  bool assigned_ = false;
+  uint32_t epoch_ = 0;
+  std::vector<String> owned_;
+  // Parts collected so far for pendingEpoch_.
+  uint32_t pendingEpoch_ = 0;
+  uint16_t nextPart_ = 0;
+  std::vector<String> pending_;
+};
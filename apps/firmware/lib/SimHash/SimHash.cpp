@@ -0,0 +1,128 @@
+#include "SimHash.h"
+
+#include <cstring>
+
+namespace {
+constexpr uint64_t kFnvOffset = 0xcbf29ce484222325ULL;
+constexpr uint64_t kFnvPrime = 0x100000001b3ULL;
+
+// Words are runs of ASCII letters and digits plus any non-ASCII byte, so
+// accented UTF-8 text stays inside its word.
+inline bool isWordByte(uint8_t c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+inline uint8_t lowerAscii(uint8_t c) { return (c >= 'A' && c <= 'Z') ? static_cast<uint8_t>(c | 0x20) : c; }
+
+// splitmix64 finalizer: FNV alone leaves the high bits poorly mixed, and every
+// bit of the shingle hash votes.
+inline uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+}  // namespace
+
+void SimHash::begin() {
+  memset(weights_, 0, sizeof(weights_));
+  wordHash_ = kFnvOffset;
+  wordLength_ = 0;
+  windowWords_ = 0;
+  shingles_ = 0;
+}
+
+void SimHash::update(const char *data, size_t length) {
+  const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < length; ++i) {
+    const uint8_t c = p[i];
+    if (isWordByte(c)) {
+      wordHash_ = (wordHash_ ^ lowerAscii(c)) * kFnvPrime;
+      ++wordLength_;
+    } else if (wordLength_ > 0) {
+      endWord();
+    }
+  }
+}
+
+uint64_t SimHash::finish() {
+  if (wordLength_ > 0) {
+    endWord();
+  }
+  if (shingles_ == 0 && windowWords_ > 0) {
+    // Fewer words than one shingle: the words seen so far stand in for it.
+    uint64_t hash = 0;
+    for (size_t i = 0; i < windowWords_; ++i) {
+      hash = mix(hash ^ window_[i]);
+    }
+    addShingle(hash);
+  }
+  uint64_t fingerprint = 0;
+  for (size_t bit = 0; bit < 64; ++bit) {
+    if (weights_[bit] > 0) {
+      fingerprint |= uint64_t{1} << bit;
+    }
+  }
+  return fingerprint;
+}
+
+void SimHash::endWord() {
+  if (windowWords_ == kShingleWords) {
+    memmove(window_, window_ + 1, sizeof(window_) - sizeof(window_[0]));
+    --windowWords_;
+  }
+  window_[windowWords_++] = wordHash_;
+  wordHash_ = kFnvOffset;
+  wordLength_ = 0;
+  if (windowWords_ < kShingleWords) {
+    return;
+  }
+  uint64_t hash = 0;
+  for (size_t i = 0; i < kShingleWords; ++i) {
+    hash = mix(hash ^ window_[i]);
+  }
+  addShingle(hash);
+}
+
+void SimHash::addShingle(uint64_t hash) {
+  ++shingles_;
+  for (size_t bit = 0; bit < 64; ++bit) {
+    weights_[bit] += ((hash >> bit) & 1) ? 1 : -1;
+  }
+}
+
+String SimHash::toHex(uint64_t fingerprint) {
+  static const char kDigits[] = "0123456789abcdef";
+  char hex[17];
+  for (int i = 15; i >= 0; --i) {
+    hex[i] = kDigits[fingerprint & 0xF];
+    fingerprint >>= 4;
+  }
+  hex[16] = '\0';
+  return String(hex);
+}
+
+bool SimHash::fromHex(const String &hex, uint64_t &fingerprint) {
+  if (hex.length() != 16) {
+    return false;
+  }
+  uint64_t value = 0;
+  for (size_t i = 0; i < 16; ++i) {
+    const char c = hex[i];
+    uint8_t digit = 0;
+    if (c >= '0' && c <= '9') {
+      digit = static_cast<uint8_t>(c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      digit = static_cast<uint8_t>(c - 'a' + 10);
+    } else if (c >= 'A' && c <= 'F') {
+      digit = static_cast<uint8_t>(c - 'A' + 10);
+    } else {
+      return false;
+    }
+    value = (value << 4) | digit;
+  }
+  fingerprint = value;
+  return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Streaming 64-bit SimHash over shingles of consecutive words. Similar texts
+// get fingerprints that differ in few bits, so a rotating ad or a counter
+// moves the fingerprint a little instead of changing it completely. Memory is
+// fixed (64 counters plus the shingle window) whatever the input size, and
+// input may be split at any byte.
+class SimHash {
+ public:
+  static constexpr size_t kShingleWords = 3;
+
+  void begin();
+  void update(const char *data, size_t length);
+  // Closes the last word; content without a single word fingerprints as 0.
+  uint64_t finish();
+
+  size_t shingles() const { return shingles_; }
+
+  static uint8_t distance(uint64_t a, uint64_t b) { return static_cast<uint8_t>(__builtin_popcountll(a ^ b)); }
+  // 16 lowercase hex digits, the form kept in /sites.json and sent in events.
+  static String toHex(uint64_t fingerprint);
+  static bool fromHex(const String &hex, uint64_t &fingerprint);
+
+ private:
+  void endWord();
+  void addShingle(uint64_t hash);
+
+  int32_t weights_[64];
+  uint64_t wordHash_ = 0;
+  size_t wordLength_ = 0;
+  uint64_t window_[kShingleWords];
+  size_t windowWords_ = 0;
+  size_t shingles_ = 0;
+};
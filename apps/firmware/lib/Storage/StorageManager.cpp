@@ -1,100 +1,263 @@
 #include "StorageManager.h"
 
+#include <AllocProfile.h>
 #include <ArduinoJson.h>
+#include <ContentChunker.h>
+#include <SimHash.h>
 
-bool StorageManager::begin() {
-  if (!LittleFS.begin(true)) {
-    return false;
+#include <cctype>
+
+namespace {
+constexpr size_t kRecordDocumentBytes = 2048;
+
+void readRecord(JsonObject item, SiteRecord &record) {
+  record.config.id = item["id"].as<String>();
+  record.config.url = item["url"].as<String>();
+  record.config.intervalSeconds = item["interval_s"].as<uint32_t>();
+  record.config.mode = item["mode"].as<String>();
+  record.config.extractMode = parseExtractMode(record.config.mode);
+  record.config.selectorCss = item["selector_css"].as<String>();
+  record.config.startMarker = item["start_marker"].as<String>();
+  record.config.endMarker = item["end_marker"].as<String>();
+  record.config.regex = item["regex"].as<String>();
+  record.config.normalize = item["normalize"] | "";
+  record.config.ignoreStartMarker = item["ignore_start"] | "";
+  record.config.ignoreEndMarker = item["ignore_end"] | "";
+  record.config.fingerprint = item["fingerprint"] | "";
+  record.config.simhashThreshold = item["simhash_threshold"] | record.config.simhashThreshold;
+  record.config.maxBytes = item["max_bytes"] | 0u;
+  record.config.maxItems = item["max_items"] | 0u;
+  record.config.paused = item["paused"].as<bool>();
+  if (item.containsKey("headers")) {
+    JsonObject headers = item["headers"].as<JsonObject>();
+    for (JsonPair kv : headers) {
+      record.config.headers[String(kv.key().c_str())] = kv.value().as<String>();
+    }
   }
-  return true;
+  record.state.lastHash = item["state"]["hash"].as<String>();
+  record.state.lastStatus = item["state"]["http"].as<uint32_t>();
+  record.state.lastSize = item["state"]["size"].as<uint32_t>();
+  record.state.lastChanged = item["state"]["changed"].as<bool>();
+  record.state.bytesTotal = item["state"]["bytes"].as<uint64_t>();
+  record.state.checksTotal = item["state"]["checks"].as<uint32_t>();
+  record.state.resolvedUrl = item["state"]["url"] | "";
+  record.state.hasSimhash = SimHash::fromHex(item["state"]["simhash"] | "", record.state.simhash);
+  ContentChunker::fromHex(item["state"]["chunks"] | "", record.state.chunkDigests);
+  ContentChunker::fromHex(item["state"]["items"] | "", record.state.itemDigests);
+  record.state.markerAt = item["state"]["marker_at"] | 0u;
+  record.state.markerBytes = item["state"]["marker_bytes"] | 0u;
+  record.state.pageBytes = item["state"]["page_bytes"] | 0u;
+  record.state.rangeRefused = item["state"]["no_range"] | false;
 }
 
-String StorageManager::readFile(const String &path) {
-  File file = LittleFS.open(path, "r");
-  if (!file) {
-    return {};
+void writeRecord(JsonObject item, const SiteRecord &record) {
+  item["id"] = record.config.id;
+  item["url"] = record.config.url;
+  item["interval_s"] = record.config.intervalSeconds;
+  item["mode"] = record.config.mode;
+  item["selector_css"] = record.config.selectorCss;
+  item["start_marker"] = record.config.startMarker;
+  item["end_marker"] = record.config.endMarker;
+  item["regex"] = record.config.regex;
+  if (!record.config.normalize.isEmpty()) {
+    item["normalize"] = record.config.normalize;
+  }
+  if (!record.config.ignoreStartMarker.isEmpty()) {
+    item["ignore_start"] = record.config.ignoreStartMarker;
+    item["ignore_end"] = record.config.ignoreEndMarker;
+  }
+  if (!record.config.fingerprint.isEmpty()) {
+    item["fingerprint"] = record.config.fingerprint;
+    item["simhash_threshold"] = record.config.simhashThreshold;
+  }
+  if (record.config.maxBytes > 0) {
+    item["max_bytes"] = record.config.maxBytes;
+  }
+  if (record.config.maxItems > 0) {
+    item["max_items"] = record.config.maxItems;
+  }
+  item["paused"] = record.config.paused;
+  JsonObject headers = item.createNestedObject("headers");
+  for (const auto &kv : record.config.headers) {
+    headers[kv.first] = kv.second;
+  }
+  JsonObject state = item.createNestedObject("state");
+  state["hash"] = record.state.lastHash;
+  state["http"] = record.state.lastStatus;
+  state["size"] = record.state.lastSize;
+  state["changed"] = record.state.lastChanged;
+  state["bytes"] = record.state.bytesTotal;
+  state["checks"] = record.state.checksTotal;
+  if (!record.state.resolvedUrl.isEmpty()) {
+    state["url"] = record.state.resolvedUrl;
+  }
+  if (record.state.hasSimhash) {
+    state["simhash"] = SimHash::toHex(record.state.simhash);
+  }
+  if (!record.state.chunkDigests.empty()) {
+    state["chunks"] = ContentChunker::toHex(record.state.chunkDigests);
+  }
+  if (!record.state.itemDigests.empty()) {
+    // Stored sorted, as ItemSet keeps them.
+    state["items"] = ContentChunker::toHex(record.state.itemDigests);
+  }
+  if (record.state.markerBytes > 0) {
+    state["marker_at"] = record.state.markerAt;
+    state["marker_bytes"] = record.state.markerBytes;
+    state["page_bytes"] = record.state.pageBytes;
+  }
+  if (record.state.rangeRefused) {
+    state["no_range"] = true;
   }
-  String content = file.readString();
-  file.close();
-  return content;
 }
+}  // namespace
 
-bool StorageManager::writeToFile(const String &path, const String &content) {
-  File file = LittleFS.open(path, "w");
-  if (!file) {
+bool StorageManager::begin() {
+  if (!LittleFS.begin(true)) {
     return false;
   }
-  file.print(content);
-  file.close();
   return true;
 }
 
 bool StorageManager::loadSites(SiteList &outSites) {
+  ALLOC_SCOPE("storage");
   outSites.clear();
-  const String raw = readFile(kSitesFile);
-  if (raw.isEmpty()) {
-    return true;
+  if (!beginLoad()) {
+    return !loadFailed_;
+  }
+  while (loading_) {
+    loadMore(outSites, SIZE_MAX);
   }
+  return !loadFailed_;
+}
 
-  DynamicJsonDocument doc(8192);
-  DeserializationError err = deserializeJson(doc, raw);
-  if (err) {
+bool StorageManager::beginLoad() {
+  endLoad(false);
+  loadFile_ = LittleFS.open(kSitesFile, "r");
+  if (!loadFile_) {
     return false;
   }
+  loading_ = true;
+  arrayOpen_ = false;
+  loadBufferLength_ = 0;
+  loadBufferOffset_ = 0;
+  return true;
+}
+
+void StorageManager::endLoad(bool failed) {
+  if (loadFile_) {
+    loadFile_.close();
+  }
+  loading_ = false;
+  loadFailed_ = failed;
+}
 
-  JsonArray array = doc.as<JsonArray>();
-  for (JsonObject item : array) {
-    SiteRecord record;
-    record.config.id = item["id"].as<String>();
-    record.config.url = item["url"].as<String>();
-    record.config.intervalSeconds = item["interval_s"].as<uint32_t>();
-    record.config.mode = item["mode"].as<String>();
-    record.config.selectorCss = item["selector_css"].as<String>();
-    record.config.startMarker = item["start_marker"].as<String>();
-    record.config.endMarker = item["end_marker"].as<String>();
-    record.config.regex = item["regex"].as<String>();
-    record.config.paused = item["paused"].as<bool>();
-    if (item.containsKey("headers")) {
-      JsonObject headers = item["headers"].as<JsonObject>();
-      for (JsonPair kv : headers) {
-        record.config.headers[String(kv.key().c_str())] = kv.value().as<String>();
+// Scans the top-level array for the next complete object, tracking nesting
+// and string literals so braces inside values do not end it early.
+bool StorageManager::nextElement(String &element) {
+  element = String();
+  int depth = 0;
+  bool inString = false;
+  bool escaped = false;
+  while (true) {
+    if (loadBufferOffset_ == loadBufferLength_) {
+      loadBufferLength_ = loadFile_.read(reinterpret_cast<uint8_t *>(loadBuffer_), sizeof(loadBuffer_));
+      loadBufferOffset_ = 0;
+      if (loadBufferLength_ == 0) {
+        endLoad(depth != 0 || !arrayOpen_);
+        return false;
+      }
+    }
+    const char c = loadBuffer_[loadBufferOffset_++];
+    if (!arrayOpen_) {
+      if (c == '[') {
+        arrayOpen_ = true;
+      } else if (!isspace(static_cast<unsigned char>(c))) {
+        endLoad(true);
+        return false;
+      }
+      continue;
+    }
+    if (depth == 0) {
+      if (c == ']') {
+        endLoad(false);
+        return false;
+      }
+      if (c != '{') {
+        continue;
+      }
+    }
+    element.concat(c);
+    if (inString) {
+      if (escaped) {
+        escaped = false;
+      } else if (c == '\\') {
+        escaped = true;
+      } else if (c == '"') {
+        inString = false;
       }
+      continue;
+    }
+    if (c == '"') {
+      inString = true;
+    } else if (c == '{' || c == '[') {
+      ++depth;
+    } else if (c == '}' || c == ']') {
+      if (--depth == 0) {
+        return true;
+      }
+    }
+  }
+}
+
+size_t StorageManager::loadMore(SiteList &outSites, size_t maxCount) {
+  ALLOC_SCOPE("storage");
+  size_t added = 0;
+  String element;
+  while (loading_ && added < maxCount && nextElement(element)) {
+    DynamicJsonDocument doc(kRecordDocumentBytes);
+    if (deserializeJson(doc, element)) {
+      endLoad(true);
+      break;
     }
-    record.state.lastHash = item["state"]["hash"].as<String>();
-    record.state.lastStatus = item["state"]["http"].as<uint32_t>();
-    record.state.lastSize = item["state"]["size"].as<uint32_t>();
-    record.state.lastChanged = item["state"]["changed"].as<bool>();
+    SiteRecord record;
+    readRecord(doc.as<JsonObject>(), record);
     outSites.push_back(record);
+    ++added;
   }
-  return true;
+  return added;
 }
 
+// Records are serialized one at a time into a temporary file that replaces
+// the old one only once complete, so a reset mid-write keeps the last list.
 bool StorageManager::saveSites(const SiteList &sites) {
-  DynamicJsonDocument doc(8192);
-  JsonArray array = doc.to<JsonArray>();
+  ALLOC_SCOPE("storage");
+  File file = LittleFS.open(kSitesTempFile, "w");
+  if (!file) {
+    return false;
+  }
+  bool ok = file.print("[") == 1;
+  bool first = true;
   for (const auto &record : sites) {
-    JsonObject item = array.createNestedObject();
-    item["id"] = record.config.id;
-    item["url"] = record.config.url;
-    item["interval_s"] = record.config.intervalSeconds;
-    item["mode"] = record.config.mode;
-    item["selector_css"] = record.config.selectorCss;
-    item["start_marker"] = record.config.startMarker;
-    item["end_marker"] = record.config.endMarker;
-    item["regex"] = record.config.regex;
-    item["paused"] = record.config.paused;
-    JsonObject headers = item.createNestedObject("headers");
-    for (const auto &kv : record.config.headers) {
-      headers[kv.first] = kv.second;
+    DynamicJsonDocument doc(kRecordDocumentBytes);
+    writeRecord(doc.to<JsonObject>(), record);
+    String serialized;
+    if (!first) {
+      serialized = ",";
     }
-    JsonObject state = item.createNestedObject("state");
-    state["hash"] = record.state.lastHash;
-    state["http"] = record.state.lastStatus;
-    state["size"] = record.state.lastSize;
-    state["changed"] = record.state.lastChanged;
+    serializeJson(doc, serialized);
+    ok = ok && file.print(serialized) == static_cast<size_t>(serialized.length());
+    first = false;
   }
-
-  String serialized;
-  serializeJson(doc, serialized);
-  return writeToFile(kSitesFile, serialized);
+  ok = ok && file.print("]") == 1;
+  file.close();
+  if (!ok) {
+    LittleFS.remove(kSitesTempFile);
+    return false;
+  }
+  if (!LittleFS.rename(kSitesTempFile, kSitesFile)) {
+    LittleFS.remove(kSitesFile);
+    return LittleFS.rename(kSitesTempFile, kSitesFile);
+  }
+  return true;
 }
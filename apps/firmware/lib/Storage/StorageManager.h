@@ -11,8 +11,25 @@ class StorageManager {
   bool loadSites(SiteList &outSites);
   bool saveSites(const SiteList &sites);
 
+  // Incremental loading: /sites.json is read one array element at a time so
+  // boot never parses (or holds) the whole file at once.
+  bool beginLoad();
+  // Appends up to maxCount records; returns how many were added.
+  size_t loadMore(SiteList &outSites, size_t maxCount);
+  bool loading() const { return loading_; }
+  bool loadFailed() const { return loadFailed_; }
+
  private:
   static constexpr const char *kSitesFile = "/sites.json";
-  bool writeToFile(const String &path, const String &content);
-  String readFile(const String &path);
+  static constexpr const char *kSitesTempFile = "/sites.json.tmp";
+  bool nextElement(String &element);
+  void endLoad(bool failed);
+
+  File loadFile_;
+  char loadBuffer_[256];
+  size_t loadBufferLength_ = 0;
+  size_t loadBufferOffset_ = 0;
+  bool loading_ = false;
+  bool loadFailed_ = false;
+  bool arrayOpen_ = false;
 };
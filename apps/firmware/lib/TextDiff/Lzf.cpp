@@ -0,0 +1,121 @@
+#include "Lzf.h"
+
+#include <CheckArena.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+constexpr size_t kHashBits = 10;
+constexpr size_t kMaxLiteral = 32;
+constexpr size_t kMaxOffset = 8192;
+constexpr size_t kMaxMatch = 264;
+
+inline uint32_t hash3(const uint8_t *p) {
+  const uint32_t v = (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+  return (v * 2654435761u) >> (32 - kHashBits);
+}
+}  // namespace
+
+namespace lzf {
+
+size_t compress(const uint8_t *in, size_t length, uint8_t *out, size_t outCapacity) {
+  // Positions + 1 of the last occurrence of each 3-byte prefix (0 = none).
+  std::vector<uint32_t, ArenaAllocator<uint32_t>> table(size_t{1} << kHashBits, 0);
+  size_t ip = 0;
+  size_t op = 0;
+  size_t literalStart = 0;
+  auto flushLiterals = [&](size_t end) -> bool {
+    while (literalStart < end) {
+      const size_t run = std::min(end - literalStart, kMaxLiteral);
+      if (op + 1 + run > outCapacity) {
+        return false;
+      }
+      out[op++] = static_cast<uint8_t>(run - 1);
+      memcpy(out + op, in + literalStart, run);
+      op += run;
+      literalStart += run;
+    }
+    return true;
+  };
+  while (ip + 2 < length) {
+    const uint32_t h = hash3(in + ip);
+    const size_t candidate = table[h];
+    table[h] = static_cast<uint32_t>(ip + 1);
+    if (candidate == 0 || ip - (candidate - 1) > kMaxOffset) {
+      ++ip;
+      continue;
+    }
+    const size_t ref = candidate - 1;
+    if (memcmp(in + ref, in + ip, 3) != 0) {
+      ++ip;
+      continue;
+    }
+    size_t matchLength = 3;
+    while (matchLength < kMaxMatch && ip + matchLength < length && in[ref + matchLength] == in[ip + matchLength]) {
+      ++matchLength;
+    }
+    if (!flushLiterals(ip)) {
+      return 0;
+    }
+    const size_t distance = ip - ref - 1;
+    const size_t encoded = matchLength - 2;
+    if (op + 3 > outCapacity) {
+      return 0;
+    }
+    if (encoded < 7) {
+      out[op++] = static_cast<uint8_t>((encoded << 5) | (distance >> 8));
+    } else {
+      out[op++] = static_cast<uint8_t>((7 << 5) | (distance >> 8));
+      out[op++] = static_cast<uint8_t>(encoded - 7);
+    }
+    out[op++] = static_cast<uint8_t>(distance & 0xFF);
+    ip += matchLength;
+    literalStart = ip;
+  }
+  if (!flushLiterals(length)) {
+    return 0;
+  }
+  return op;
+}
+
+size_t decompress(const uint8_t *in, size_t length, uint8_t *out, size_t outCapacity) {
+  size_t ip = 0;
+  size_t op = 0;
+  while (ip < length) {
+    const uint8_t control = in[ip++];
+    if (control < kMaxLiteral) {
+      const size_t run = static_cast<size_t>(control) + 1;
+      if (ip + run > length || op + run > outCapacity) {
+        return 0;
+      }
+      memcpy(out + op, in + ip, run);
+      ip += run;
+      op += run;
+      continue;
+    }
+    size_t matchLength = control >> 5;
+    if (matchLength == 7) {
+      if (ip >= length) {
+        return 0;
+      }
+      matchLength += in[ip++];
+    }
+    matchLength += 2;
+    if (ip >= length) {
+      return 0;
+    }
+    const size_t distance = ((static_cast<size_t>(control & 0x1F) << 8) | in[ip++]) + 1;
+    if (distance > op || op + matchLength > outCapacity) {
+      return 0;
+    }
+    // Byte by byte: the reference may overlap the bytes being written.
+    for (size_t i = 0; i < matchLength; ++i, ++op) {
+      out[op] = out[op - distance];
+    }
+  }
+  return op;
+}
+
+}  // namespace lzf
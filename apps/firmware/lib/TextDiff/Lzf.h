@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Arduino.h>
+
+// LZF-format compressor (the liblzf byte stream: literal runs of up to 32
+// bytes and back references of up to 264 bytes within 8 KiB). Fast, no
+// entropy stage, and the decoder needs no state beyond the output buffer,
+// which suits small text snapshots on flash.
+namespace lzf {
+// Returns the compressed size, or 0 if the output would not fit in outCapacity.
+size_t compress(const uint8_t *in, size_t length, uint8_t *out, size_t outCapacity);
+// Returns the decompressed size, or 0 on corrupt input or a short buffer.
+size_t decompress(const uint8_t *in, size_t length, uint8_t *out, size_t outCapacity);
+}  // namespace lzf
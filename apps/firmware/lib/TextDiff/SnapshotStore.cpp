@@ -0,0 +1,99 @@
+#include "SnapshotStore.h"
+
+#include <LittleFS.h>
+
+#include <algorithm>
+
+#include "Lzf.h"
+#include "TextDiff.h"
+
+namespace {
+constexpr const char *kSnapshotDir = "/prev";
+constexpr uint32_t kSnapshotMagic = 0x31504E53;  // "SNP1"
+
+struct SnapshotHeader {
+  uint32_t magic;
+  uint16_t rawLength;
+  uint16_t storedLength;
+  uint8_t compressed;
+  uint8_t reserved[3];
+};
+
+uint32_t fnv1a(const char *data, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; ++i) {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+  }
+  return hash;
+}
+}  // namespace
+
+String SnapshotStore::pathFor(const String &id) {
+  char name[20];
+  snprintf(name, sizeof(name), "/prev/%08x", static_cast<unsigned>(fnv1a(id.c_str(), id.length())));
+  return String(name);
+}
+
+bool SnapshotStore::save(const String &id, const char *data, size_t length) {
+  length = std::min<size_t>(length, DIFF_MAX_CONTENT_BYTES);
+  SnapshotText packed(length);
+  SnapshotHeader header{};
+  header.magic = kSnapshotMagic;
+  header.rawLength = static_cast<uint16_t>(length);
+  size_t stored = lzf::compress(reinterpret_cast<const uint8_t *>(data), length,
+                                reinterpret_cast<uint8_t *>(packed.data()), packed.size());
+  const char *payload = packed.data();
+  header.compressed = stored > 0 ? 1 : 0;
+  if (stored == 0) {
+    // Incompressible (or tiny): kept as is.
+    stored = length;
+    payload = data;
+  }
+  header.storedLength = static_cast<uint16_t>(stored);
+  if (!LittleFS.exists(kSnapshotDir)) {
+    LittleFS.mkdir(kSnapshotDir);
+  }
+  File file = LittleFS.open(pathFor(id), "w");
+  if (!file) {
+    return false;
+  }
+  const bool ok = file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                  file.write(reinterpret_cast<const uint8_t *>(payload), stored) == stored;
+  file.close();
+  return ok;
+}
+
+bool SnapshotStore::load(const String &id, SnapshotText &out) {
+  out.clear();
+  File file = LittleFS.open(pathFor(id), "r");
+  if (!file) {
+    return false;
+  }
+  SnapshotHeader header;
+  if (file.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) != sizeof(header) ||
+      header.magic != kSnapshotMagic || header.rawLength > DIFF_MAX_CONTENT_BYTES ||
+      header.storedLength > header.rawLength) {
+    file.close();
+    return false;
+  }
+  SnapshotText stored(header.storedLength);
+  const bool complete = file.read(reinterpret_cast<uint8_t *>(stored.data()), stored.size()) == stored.size();
+  file.close();
+  if (!complete) {
+    return false;
+  }
+  if (!header.compressed) {
+    out.swap(stored);
+    return true;
+  }
+  out.resize(header.rawLength);
+  const size_t length = lzf::decompress(reinterpret_cast<const uint8_t *>(stored.data()), stored.size(),
+                                        reinterpret_cast<uint8_t *>(out.data()), out.size());
+  if (length != header.rawLength) {
+    out.clear();
+    return false;
+  }
+  return true;
+}
+
+void SnapshotStore::remove(const String &id) { LittleFS.remove(pathFor(id)); }
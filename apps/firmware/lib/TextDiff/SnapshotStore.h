@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Arduino.h>
+#include <CheckArena.h>
+
+#include <vector>
+
+using SnapshotText = std::vector<char, ArenaAllocator<char>>;
+
+// The last extracted (normalized) content of each site, LZF-compressed in
+// LittleFS under /prev/ and capped at DIFF_MAX_CONTENT_BYTES, so a change can
+// be diffed against what was there before without keeping pages in RAM.
+class SnapshotStore {
+ public:
+  static bool save(const String &id, const char *data, size_t length);
+  // False when there is no (valid) snapshot for the site.
+  static bool load(const String &id, SnapshotText &out);
+  static void remove(const String &id);
+
+ private:
+  static String pathFor(const String &id);
+};
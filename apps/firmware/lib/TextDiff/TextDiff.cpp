@@ -0,0 +1,200 @@
+#include "TextDiff.h"
+
+#include <CheckArena.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+// Words past this many on either side (after trimming) skip the Myers pass.
+constexpr size_t kMaxWords = 256;
+
+struct Word {
+  uint16_t start;
+  uint16_t length;
+  uint32_t hash;
+};
+
+using Words = std::vector<Word, ArenaAllocator<Word>>;
+using Trace = std::vector<int16_t, ArenaAllocator<int16_t>>;
+
+bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\v'; }
+
+// Splits text[from, to) into words; false if there are more than kMaxWords.
+bool splitWords(const char *text, size_t from, size_t to, Words &words) {
+  size_t i = from;
+  while (i < to) {
+    while (i < to && isSpace(text[i])) {
+      ++i;
+    }
+    if (i == to) {
+      break;
+    }
+    if (words.size() == kMaxWords) {
+      return false;
+    }
+    Word word{static_cast<uint16_t>(i), 0, 2166136261u};
+    while (i < to && !isSpace(text[i])) {
+      word.hash = (word.hash ^ static_cast<uint8_t>(text[i])) * 16777619u;
+      ++i;
+    }
+    word.length = static_cast<uint16_t>(i - word.start);
+    words.push_back(word);
+  }
+  return true;
+}
+
+bool sameWord(const char *a, const Word &wa, const char *b, const Word &wb) {
+  return wa.hash == wb.hash && wa.length == wb.length && memcmp(a + wa.start, b + wb.start, wa.length) == 0;
+}
+
+DiffHunk spanHunk(const char *oldText, size_t oldFrom, size_t oldTo, const char *newText, size_t newFrom,
+                  size_t newTo) {
+  while (oldFrom < oldTo && isSpace(oldText[oldFrom])) {
+    ++oldFrom;
+  }
+  while (oldTo > oldFrom && isSpace(oldText[oldTo - 1])) {
+    --oldTo;
+  }
+  while (newFrom < newTo && isSpace(newText[newFrom])) {
+    ++newFrom;
+  }
+  while (newTo > newFrom && isSpace(newText[newTo - 1])) {
+    --newTo;
+  }
+  return DiffHunk{oldFrom, oldTo - oldFrom, newFrom, newTo - newFrom};
+}
+
+// Byte range covered by words[first, last), or an empty range where such
+// words would be inserted.
+void wordRange(const Words &words, size_t first, size_t last, size_t regionEnd, size_t &offset, size_t &length) {
+  if (first < last) {
+    offset = words[first].start;
+    length = words[last - 1].start + words[last - 1].length - offset;
+    return;
+  }
+  offset = first < words.size() ? words[first].start : regionEnd;
+  length = 0;
+}
+}  // namespace
+
+DiffResult diffWords(const char *oldText, size_t oldLength, const char *newText, size_t newLength) {
+  DiffResult result;
+  oldLength = std::min<size_t>(oldLength, DIFF_MAX_CONTENT_BYTES);
+  newLength = std::min<size_t>(newLength, DIFF_MAX_CONTENT_BYTES);
+
+  // Common prefix and suffix, backed off to word boundaries.
+  size_t prefix = 0;
+  while (prefix < oldLength && prefix < newLength && oldText[prefix] == newText[prefix]) {
+    ++prefix;
+  }
+  if (prefix == oldLength && prefix == newLength) {
+    return result;
+  }
+  while (prefix > 0 && !isSpace(oldText[prefix - 1])) {
+    --prefix;
+  }
+  size_t suffix = 0;
+  while (suffix < oldLength - prefix && suffix < newLength - prefix &&
+         oldText[oldLength - 1 - suffix] == newText[newLength - 1 - suffix]) {
+    ++suffix;
+  }
+  while (suffix > 0 && !isSpace(oldText[oldLength - suffix])) {
+    --suffix;
+  }
+  const size_t oldEnd = oldLength - suffix;
+  const size_t newEnd = newLength - suffix;
+
+  Words a;
+  Words b;
+  const bool fits = splitWords(oldText, prefix, oldEnd, a) && splitWords(newText, prefix, newEnd, b);
+  const size_t n = a.size();
+  const size_t m = b.size();
+  const size_t maxEdits = std::min<size_t>(n + m, DIFF_MAX_EDITS);
+  if (!fits) {
+    result.exact = false;
+    result.hunks.push_back(spanHunk(oldText, prefix, oldEnd, newText, prefix, newEnd));
+    return result;
+  }
+
+  // Greedy Myers; trace[d * d + d + k] is V[k] after round d, so round d
+  // needs 2d + 1 slots and all rounds up to D fit in (D + 1)^2.
+  const int offset = static_cast<int>(maxEdits) + 1;
+  Trace v(2 * static_cast<size_t>(offset) + 1, 0);
+  Trace trace;
+  trace.reserve((maxEdits + 1) * (maxEdits + 1));
+  int found = -1;
+  for (int d = 0; d <= static_cast<int>(maxEdits) && found < 0; ++d) {
+    for (int k = -d; k <= d; k += 2) {
+      int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ? v[offset + k + 1]
+                                                                              : v[offset + k - 1] + 1;
+      int y = x - k;
+      while (x < static_cast<int>(n) && y < static_cast<int>(m) && sameWord(oldText, a[x], newText, b[y])) {
+        ++x;
+        ++y;
+      }
+      v[offset + k] = static_cast<int16_t>(x);
+      if (x >= static_cast<int>(n) && y >= static_cast<int>(m)) {
+        found = d;
+        break;
+      }
+    }
+    for (int k = -d; k <= d; ++k) {
+      trace.push_back(v[offset + k]);
+    }
+  }
+  if (found < 0) {
+    result.exact = false;
+    result.hunks.push_back(spanHunk(oldText, prefix, oldEnd, newText, prefix, newEnd));
+    return result;
+  }
+
+  // Walk back from (n, m), collecting runs of edits between equal words.
+  std::vector<DiffHunk, ArenaAllocator<DiffHunk>> reversed;
+  int x = static_cast<int>(n);
+  int y = static_cast<int>(m);
+  size_t oldHunkEnd = n;
+  size_t newHunkEnd = m;
+  bool open = false;
+  auto closeHunk = [&](int hunkX, int hunkY) {
+    DiffHunk hunk;
+    wordRange(a, static_cast<size_t>(hunkX), oldHunkEnd, oldEnd, hunk.oldOffset, hunk.oldLength);
+    wordRange(b, static_cast<size_t>(hunkY), newHunkEnd, newEnd, hunk.newOffset, hunk.newLength);
+    reversed.push_back(hunk);
+    open = false;
+  };
+  for (int d = found; d > 0; --d) {
+    const int16_t *previous = trace.data() + (d - 1) * (d - 1) + (d - 1);
+    const int k = x - y;
+    const bool down = k == -d || (k != d && previous[k - 1] < previous[k + 1]);
+    const int previousK = down ? k + 1 : k - 1;
+    const int previousX = previous[previousK];
+    const int previousY = previousX - previousK;
+    const int editX = down ? previousX : previousX + 1;
+    const int editY = down ? previousY + 1 : previousY;
+    if (x > editX && open) {
+      closeHunk(x, y);
+    }
+    x = editX;
+    y = editY;
+    if (!open) {
+      oldHunkEnd = static_cast<size_t>(x);
+      newHunkEnd = static_cast<size_t>(y);
+      open = true;
+    }
+    x = previousX;
+    y = previousY;
+  }
+  if (open) {
+    closeHunk(x, y);
+  }
+
+  for (auto it = reversed.rbegin(); it != reversed.rend(); ++it) {
+    if (result.hunks.size() == DIFF_MAX_HUNKS) {
+      result.truncated = true;
+      break;
+    }
+    result.hunks.push_back(*it);
+  }
+  return result;
+}
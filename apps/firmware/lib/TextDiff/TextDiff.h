@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <vector>
+
+// Limits that keep a diff inside the check arena: contents longer than
+// DIFF_MAX_CONTENT_BYTES are compared on their prefix, and scripts needing
+// more than DIFF_MAX_EDITS word insertions/deletions (or differing regions of
+// more than 256 words) fall back to one before/after snippet. The Myers trace
+// costs ~(DIFF_MAX_EDITS)^2 * 2 bytes of the check arena.
+#ifndef DIFF_MAX_CONTENT_BYTES
+#define DIFF_MAX_CONTENT_BYTES 4096
+#endif
+
+#ifndef DIFF_MAX_EDITS
+#define DIFF_MAX_EDITS 48
+#endif
+
+#ifndef DIFF_MAX_HUNKS
+#define DIFF_MAX_HUNKS 4
+#endif
+
+// One run of removed and/or added words. Offsets are bytes into the old and
+// new texts; either side may be empty.
+struct DiffHunk {
+  size_t oldOffset = 0;
+  size_t oldLength = 0;
+  size_t newOffset = 0;
+  size_t newLength = 0;
+};
+
+struct DiffResult {
+  // False when the edit budget ran out: `hunks` then holds a single hunk
+  // spanning everything between the common prefix and suffix.
+  bool exact = true;
+  // More hunks than DIFF_MAX_HUNKS were found; only the first ones are kept.
+  bool truncated = false;
+  std::vector<DiffHunk> hunks;
+};
+
+// Word-level Myers diff (whitespace separates words and is not compared).
+// Common leading/trailing words are stripped first, so a price or stock edit
+// inside a long block costs only the words around it.
+DiffResult diffWords(const char *oldText, size_t oldLength, const char *newText, size_t newLength);
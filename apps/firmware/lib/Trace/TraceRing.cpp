@@ -0,0 +1,170 @@
+#include "TraceRing.h"
+
+#include <mbedtls/base64.h>
+
+#include <algorithm>
+
+TraceRing traceRing;
+
+namespace {
+void putLe32(uint8_t *out, uint32_t value) {
+  out[0] = static_cast<uint8_t>(value);
+  out[1] = static_cast<uint8_t>(value >> 8);
+  out[2] = static_cast<uint8_t>(value >> 16);
+  out[3] = static_cast<uint8_t>(value >> 24);
+}
+
+uint32_t getLe32(const uint8_t *in) {
+  return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 | static_cast<uint32_t>(in[2]) << 16 |
+         static_cast<uint32_t>(in[3]) << 24;
+}
+
+const char *const kEventNames[] = {
+    "?",
+    "BOOT",
+    "CHECK_START",
+    "CHECK_DEFERRED",
+    "CHECK_END",
+    "FETCH_START",
+    "FETCH_CONNECTED",
+    "FETCH_TLS",
+    "FETCH_FIRST_BYTE",
+    "FETCH_DONE",
+    "MQTT_CONNECTED",
+    "MQTT_DISCONNECTED",
+    "EVENT_QUEUED",
+    "PERSIST",
+    "HEAP",
+    "ARENA_OVERFLOW",
+    "LOAD_REPORT",
+    "COMMAND",
+    "TRACE_DUMP",
+    "SLEEP",
+};
+}  // namespace
+
+size_t TraceRing::copy(uint32_t from, size_t count, TraceRecord *out) const {
+  if (from < oldest()) {
+    return 0;
+  }
+  size_t copied = 0;
+  for (uint32_t seq = from; copied < count && seq < written_; ++seq) {
+    out[copied++] = records_[seq % TRACE_RING_RECORDS];
+  }
+  return copied;
+}
+
+uint16_t traceSiteTag(const char *id, size_t length) {
+  uint32_t hash = 0x811c9dc5u;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<uint8_t>(id[i]);
+    hash *= 0x01000193u;
+  }
+  const uint16_t tag = static_cast<uint16_t>(hash ^ (hash >> 16));
+  return tag == 0 ? 1 : tag;
+}
+
+const char *traceEventName(uint8_t event) {
+  return event < sizeof(kEventNames) / sizeof(kEventNames[0]) ? kEventNames[event] : kEventNames[0];
+}
+
+TraceCommand traceCommandFor(const char *type) {
+  static const struct {
+    const char *type;
+    TraceCommand command;
+  } kCommands[] = {
+      {"UPSERT_SITE", TraceCommand::Upsert},     {"DELETE_SITE", TraceCommand::Delete},
+      {"PAUSE_SITE", TraceCommand::Pause},       {"RESUME_SITE", TraceCommand::Resume},
+      {"CHECK_NOW", TraceCommand::CheckNow},     {"ASSIGN_SHARD", TraceCommand::AssignShard},
+      {"DUMP_TRACE", TraceCommand::DumpTrace},   {"HISTORY", TraceCommand::History},
+  };
+  for (const auto &entry : kCommands) {
+    if (strcmp(type, entry.type) == 0) {
+      return entry.command;
+    }
+  }
+  return TraceCommand::Unknown;
+}
+
+void encodeTraceRecord(const TraceRecord &record, uint8_t *out) {
+  putLe32(out, record.atMs);
+  out[4] = record.event;
+  out[5] = record.flags;
+  out[6] = static_cast<uint8_t>(record.site);
+  out[7] = static_cast<uint8_t>(record.site >> 8);
+  putLe32(out + 8, record.a);
+  putLe32(out + 12, record.b);
+}
+
+TraceRecord decodeTraceRecord(const uint8_t *in) {
+  TraceRecord record;
+  record.atMs = getLe32(in);
+  record.event = in[4];
+  record.flags = in[5];
+  record.site = static_cast<uint16_t>(in[6] | in[7] << 8);
+  record.a = getLe32(in + 8);
+  record.b = getLe32(in + 12);
+  return record;
+}
+
+bool decodeTracePart(const char *base64, std::vector<TraceRecord> &out) {
+  const size_t length = strlen(base64);
+  std::vector<uint8_t> raw(length / 4 * 3 + 3);
+  size_t rawLength = 0;
+  if (mbedtls_base64_decode(raw.data(), raw.size(), &rawLength, reinterpret_cast<const unsigned char *>(base64),
+                            length) != 0 ||
+      rawLength % kTraceRecordBytes != 0) {
+    return false;
+  }
+  for (size_t offset = 0; offset < rawLength; offset += kTraceRecordBytes) {
+    out.push_back(decodeTraceRecord(raw.data() + offset));
+  }
+  return true;
+}
+
+void TraceDumper::begin(const TraceRing &ring, uint32_t dumpId) {
+  dumpId_ = dumpId;
+  from_ = ring.oldest();
+  end_ = ring.written();
+  part_ = 0;
+  const uint32_t records = end_ - from_;
+  parts_ = static_cast<uint16_t>(records == 0 ? 1 : (records + TRACE_RECORDS_PER_PART - 1) / TRACE_RECORDS_PER_PART);
+  active_ = true;
+}
+
+bool TraceDumper::next(const TraceRing &ring, const char *deviceId, JsonObject payload) {
+  if (!active_ || part_ >= parts_) {
+    active_ = false;
+    return false;
+  }
+  const uint32_t first = from_ + static_cast<uint32_t>(part_) * TRACE_RECORDS_PER_PART;
+  const uint32_t last = std::min<uint32_t>(first + TRACE_RECORDS_PER_PART, end_);
+  // The device kept recording while earlier parts went out.
+  const uint32_t start = std::min(std::max(first, ring.oldest()), last);
+
+  TraceRecord records[TRACE_RECORDS_PER_PART];
+  const size_t count = ring.copy(start, last - start, records);
+  uint8_t raw[TRACE_RECORDS_PER_PART * kTraceRecordBytes];
+  for (size_t i = 0; i < count; ++i) {
+    encodeTraceRecord(records[i], raw + i * kTraceRecordBytes);
+  }
+  unsigned char encoded[((sizeof(raw) + 2) / 3) * 4 + 1];
+  size_t encodedLength = 0;
+  if (mbedtls_base64_encode(encoded, sizeof(encoded), &encodedLength, raw, count * kTraceRecordBytes) != 0) {
+    encodedLength = 0;
+  }
+  encoded[encodedLength] = '\0';
+
+  payload["id"] = deviceId;
+  payload["dump"] = dumpId_;
+  payload["part"] = part_;
+  payload["parts"] = parts_;
+  payload["seq"] = start;
+  payload["records"] = static_cast<uint32_t>(count);
+  payload["lost"] = (last - first) - static_cast<uint32_t>(count);
+  payload["now_ms"] = static_cast<uint32_t>(millis());
+  // char *, not const char *: ArduinoJson copies it into the document.
+  payload["data"] = reinterpret_cast<char *>(encoded);
+  ++part_;
+  return true;
+}
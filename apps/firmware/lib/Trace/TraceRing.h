@@ -0,0 +1,148 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <vector>
+
+// 0 compiles every TRACE() out; the ring and DUMP_TRACE stay, empty.
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+// 16 bytes each: 512 keep the last few minutes of a busy device in 8 KB.
+#ifndef TRACE_RING_RECORDS
+#define TRACE_RING_RECORDS 512
+#endif
+
+// Records per DUMP_TRACE message; 48 encode to ~1 KB of base64, well under
+// the firmware's 2 KB MQTT packets.
+#ifndef TRACE_RECORDS_PER_PART
+#define TRACE_RECORDS_PER_PART 48
+#endif
+
+// Numbers are part of the dump format: append, never renumber.
+enum class TraceEvent : uint8_t {
+  Boot = 1,              // flags: warm boot; b: free heap
+  CheckStart = 2,        // flags: FetchStrategy; a: schedule lag ms; b: expected bytes
+  CheckDeferred = 3,     // a: largest free block; b: expected bytes
+  CheckEnd = 4,          // flags: EventKind of the event; a: duration ms; b: HTTP status
+  FetchStart = 5,        // flags: address from the DNS cache; a: ms resolving and opening the socket;
+                         // b: redirects followed before it
+  FetchConnected = 6,    // a: ms since start
+  FetchTls = 7,          // a: ms since start
+  FetchFirstByte = 8,    // a: ms since start
+  FetchDone = 9,         // flags: ok; a: ms since start; b: body bytes
+  MqttConnected = 10,    // a: events queued
+  MqttDisconnected = 11, // a: messages awaiting PUBACK
+  EventQueued = 12,      // flags: EventKind; a: queue depth
+  Persist = 13,          // flags: ok; a: sites; b: ms
+  Heap = 14,             // a: free heap; b: largest block
+  ArenaOverflow = 15,    // a: heap fallback bytes so far
+  LoadReport = 16,       // flags: overloaded; a: utilization %; b: lag ms
+  Command = 17,          // flags: TraceCommand; a: message bytes
+  TraceDump = 18,        // a: records in the dump; b: dump number
+  Sleep = 19,            // flags: SleepKind; a: ms awake before it; b: planned ms
+};
+
+enum class TraceCommand : uint8_t {
+  Upsert = 1,
+  Delete,
+  Pause,
+  Resume,
+  CheckNow,
+  AssignShard,
+  DumpTrace,
+  History,
+  Unknown
+};
+
+struct TraceRecord {
+  uint32_t atMs = 0;
+  uint8_t event = 0;
+  uint8_t flags = 0;
+  // traceSiteTag() of the site, 0 when the record is not about one.
+  uint16_t site = 0;
+  uint32_t a = 0;
+  uint32_t b = 0;
+};
+
+constexpr size_t kTraceRecordBytes = 16;
+
+// Fixed ring of the newest TRACE_RING_RECORDS records. Recording is a handful
+// of stores with no locking: the firmware's loop() (or the daemon's loop
+// thread) is the only writer.
+class TraceRing {
+ public:
+  void record(TraceEvent event, uint16_t site, uint8_t flags, uint32_t a, uint32_t b) {
+    TraceRecord &slot = records_[written_ % TRACE_RING_RECORDS];
+    slot.atMs = static_cast<uint32_t>(millis());
+    slot.event = static_cast<uint8_t>(event);
+    slot.flags = flags;
+    slot.site = site;
+    slot.a = a;
+    slot.b = b;
+    ++written_;
+  }
+
+  // Records ever written; the sequence number of the next one.
+  uint32_t written() const { return written_; }
+  // Sequence number of the oldest record still in the ring.
+  uint32_t oldest() const { return written_ > TRACE_RING_RECORDS ? written_ - TRACE_RING_RECORDS : 0; }
+  size_t capacity() const { return TRACE_RING_RECORDS; }
+  // Copies records [from, from + count) still in the ring; returns how many.
+  size_t copy(uint32_t from, size_t count, TraceRecord *out) const;
+  void clear() { written_ = 0; }
+
+ private:
+  TraceRecord records_[TRACE_RING_RECORDS];
+  uint32_t written_ = 0;
+};
+
+extern TraceRing traceRing;
+
+#if TRACE_ENABLED
+#define TRACE(event, site, flags, a, b)                                                                    \
+  traceRing.record(TraceEvent::event, (site), static_cast<uint8_t>(flags), static_cast<uint32_t>(a),     \
+                   static_cast<uint32_t>(b))
+#else
+#define TRACE(event, site, flags, a, b) (void)0
+#endif
+
+// 16-bit FNV-1a of a site id, never 0. Collisions are possible; the decoder
+// resolves tags against a site list and shows every match.
+uint16_t traceSiteTag(const char *id, size_t length);
+inline uint16_t traceSiteTag(const String &id) { return traceSiteTag(id.c_str(), id.length()); }
+inline uint16_t traceSiteTag(const char *id) { return traceSiteTag(id, strlen(id)); }
+
+const char *traceEventName(uint8_t event);
+// TraceCommand of a command `type`; Unknown for anything else.
+TraceCommand traceCommandFor(const char *type);
+
+// Little-endian, kTraceRecordBytes per record.
+void encodeTraceRecord(const TraceRecord &record, uint8_t *out);
+TraceRecord decodeTraceRecord(const uint8_t *in);
+// Appends the records of one DUMP_TRACE part (its `data`); false if malformed.
+bool decodeTracePart(const char *base64, std::vector<TraceRecord> &out);
+
+// Streams a snapshot of the ring as DUMP_TRACE parts: the range is fixed when
+// the dump starts, and records overwritten before their part goes out are
+// reported as `lost` instead of sent out of order.
+class TraceDumper {
+ public:
+  void begin(const TraceRing &ring, uint32_t dumpId);
+  bool active() const { return active_; }
+  // Fills the payload of the next part: id, dump, part, parts, seq, records,
+  // lost, now_ms and base64 data. False once every part went out.
+  bool next(const TraceRing &ring, const char *deviceId, JsonObject payload);
+  // Call after the part returned by next() could not be published.
+  void retry() { --part_; }
+
+ private:
+  uint32_t dumpId_ = 0;
+  uint32_t from_ = 0;
+  uint32_t end_ = 0;
+  uint16_t part_ = 0;
+  uint16_t parts_ = 0;
+  bool active_ = false;
+};
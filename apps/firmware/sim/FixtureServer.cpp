@@ -0,0 +1,294 @@
+#include "FixtureServer.h"
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace sim {
+
+namespace {
+bool sendAll(int fd, const char *data, size_t length) {
+  size_t sent = 0;
+  while (sent < length) {
+    ssize_t n = ::send(fd, data + sent, length - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    sent += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// Filler for ?pad_kb= pages, streamed line by line so the server does not
+// allocate the padding (the simulated device heap shares this process).
+const char kFillerLine[] = "<p class=\"filler\">Contenido relleno para simular una página pesada.</p>\n";
+
+size_t fillerLines(const String &target) {
+  const int pad = target.indexOf("pad_kb=");
+  if (pad < 0) {
+    return 0;
+  }
+  const size_t padBytes = static_cast<size_t>(target.substring(pad + 7).toInt()) * 1024;
+  const size_t lineLength = sizeof(kFillerLine) - 1;
+  return (padBytes + lineLength - 1) / lineLength;
+}
+
+// "Range: bytes=a-b" in the request head; false when absent or not that form.
+bool requestedRange(const String &head, size_t &first, size_t &last) {
+  String lower = head;
+  lower.toLowerCase();
+  const int header = lower.indexOf("\r\nrange: bytes=");
+  if (header < 0) {
+    return false;
+  }
+  const int from = header + 15;
+  const int dash = head.indexOf('-', from);
+  const int lineEnd = head.indexOf("\r\n", from);
+  if (dash < 0 || lineEnd < dash + 2) {
+    return false;
+  }
+  first = static_cast<size_t>(head.substring(from, dash).toInt());
+  last = static_cast<size_t>(head.substring(dash + 1, lineEnd).toInt());
+  return first <= last;
+}
+
+// Bytes [from, to) of the padded page: body up to `split`, the filler lines,
+// then the rest of the body.
+bool sendSlice(int fd, const String &body, size_t split, size_t lines, size_t from, size_t to) {
+  const size_t lineLength = sizeof(kFillerLine) - 1;
+  const size_t fillerEnd = split + lines * lineLength;
+  size_t at = from;
+  if (at < split) {
+    const size_t end = std::min(to, split);
+    if (!sendAll(fd, body.c_str() + at, end - at)) {
+      return false;
+    }
+    at = end;
+  }
+  while (at < to && at < fillerEnd) {
+    const size_t offset = (at - split) % lineLength;
+    const size_t take = std::min(lineLength - offset, std::min(to, fillerEnd) - at);
+    if (!sendAll(fd, kFillerLine + offset, take)) {
+      return false;
+    }
+    at += take;
+  }
+  return at >= to || sendAll(fd, body.c_str() + split + (at - fillerEnd), to - at);
+}
+
+String readRequestHead(int fd) {
+  String head;
+  char buffer[512];
+  while (head.indexOf("\r\n\r\n") < 0 && head.length() < 16384) {
+    pollfd pfd{fd, POLLIN, 0};
+    if (::poll(&pfd, 1, 5000) <= 0) {
+      break;
+    }
+    ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      break;
+    }
+    head.append(buffer, static_cast<size_t>(n));
+  }
+  return head;
+}
+}  // namespace
+
+FixtureServer::FixtureServer(FixtureServerOptions options) : options_(std::move(options)) {}
+
+FixtureServer::~FixtureServer() { stop(); }
+
+bool FixtureServer::loadFixtures() {
+  DIR *dir = ::opendir(options_.fixturesDir.c_str());
+  if (!dir) {
+    return false;
+  }
+  while (dirent *entry = ::readdir(dir)) {
+    String name(entry->d_name);
+    if (!name.endsWith(".html")) {
+      continue;
+    }
+    std::ifstream input((options_.fixturesDir + "/" + name).c_str(), std::ios::binary);
+    std::stringstream content;
+    content << input.rdbuf();
+    fixtures_[name] = String(content.str());
+  }
+  ::closedir(dir);
+  return !fixtures_.empty();
+}
+
+bool FixtureServer::start() {
+  if (!loadFixtures()) {
+    return false;
+  }
+  listenFd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd_ < 0) {
+    return false;
+  }
+  int one = 1;
+  setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  if (::bind(listenFd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(listenFd_, 1024) != 0) {
+    ::close(listenFd_);
+    listenFd_ = -1;
+    return false;
+  }
+  socklen_t len = sizeof(addr);
+  ::getsockname(listenFd_, reinterpret_cast<sockaddr *>(&addr), &len);
+  port_ = ntohs(addr.sin_port);
+  running_ = true;
+  acceptThread_ = std::thread(&FixtureServer::acceptLoop, this);
+  return true;
+}
+
+void FixtureServer::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  ::shutdown(listenFd_, SHUT_RDWR);
+  ::close(listenFd_);
+  listenFd_ = -1;
+  if (acceptThread_.joinable()) {
+    acceptThread_.join();
+  }
+  while (activeConnections_.load() > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+}
+
+String FixtureServer::urlFor(const String &fixture, size_t siteIndex, uint32_t padKb, bool moved) const {
+  String url = String("http://127.0.0.1:") + port_ + (moved ? "/moved/" : "/f/") + fixture + "?site=" + siteIndex;
+  if (padKb > 0) {
+    url += String("&pad_kb=") + padKb;
+  }
+  return url;
+}
+
+std::vector<String> FixtureServer::fixtureNames() const {
+  std::vector<String> names;
+  for (const auto &entry : fixtures_) {
+    names.push_back(entry.first);
+  }
+  return names;
+}
+
+void FixtureServer::acceptLoop() {
+  while (running_) {
+    pollfd pfd{listenFd_, POLLIN, 0};
+    if (::poll(&pfd, 1, 100) <= 0) {
+      continue;
+    }
+    int fd = ::accept(listenFd_, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    ++activeConnections_;
+    std::thread([this, fd]() {
+      handle(fd);
+      ::close(fd);
+      --activeConnections_;
+    }).detach();
+  }
+}
+
+String FixtureServer::render(const String &target) {
+  int query = target.indexOf('?');
+  String path = query < 0 ? target : target.substring(0, query);
+  if (!path.startsWith("/f/")) {
+    return String();
+  }
+  auto it = fixtures_.find(path.substring(3));
+  if (it == fixtures_.end()) {
+    return String();
+  }
+  uint32_t hits = 0;
+  {
+    std::lock_guard<std::mutex> lock(hitsMutex_);
+    hits = hits_[target]++;
+  }
+  String body = it->second;
+  const uint32_t revision = options_.changeEvery ? hits / options_.changeEvery : 0;
+  body.replace(String("{{rev}}"), String(revision));
+  return body;
+}
+
+void FixtureServer::handle(int fd) {
+  const String head = readRequestHead(fd);
+  int lineEnd = head.indexOf("\r\n");
+  String requestLine = lineEnd < 0 ? head : head.substring(0, lineEnd);
+  int firstSpace = requestLine.indexOf(' ');
+  int secondSpace = firstSpace < 0 ? -1 : requestLine.indexOf(' ', firstSpace + 1);
+  if (secondSpace < 0) {
+    return;
+  }
+  const String target = requestLine.substring(firstSpace + 1, secondSpace);
+
+  uint32_t delayMs = options_.latencyMs;
+  if (options_.jitterMs > 0) {
+    delayMs += static_cast<uint32_t>(std::rand()) % (options_.jitterMs + 1);
+  }
+  if (delayMs > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+  }
+
+  if (target.startsWith("/moved/")) {
+    const String response = String("HTTP/1.1 301 Moved Permanently\r\nLocation: /f/") + target.substring(7) +
+                            "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    if (sendAll(fd, response.c_str(), response.length())) {
+      ++redirectsServed_;
+    }
+    return;
+  }
+
+  const String body = render(target);
+  const bool found = !body.isEmpty();
+  const size_t lines = found ? fillerLines(target) : 0;
+  const size_t paddedLength = body.length() + lines * (sizeof(kFillerLine) - 1);
+  // The filler goes before </body>, after the content the sites extract.
+  const int bodyEnd = lines > 0 ? body.indexOf("</body>") : -1;
+  const size_t split = bodyEnd < 0 ? body.length() : static_cast<size_t>(bodyEnd);
+  size_t first = 0;
+  size_t last = 0;
+  if (found && options_.ranges && requestedRange(head, first, last)) {
+    if (first >= paddedLength) {
+      const String response = String("HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */") +
+                              paddedLength + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+      if (sendAll(fd, response.c_str(), response.length())) {
+        ++served_;
+      }
+      return;
+    }
+    last = std::min(last, paddedLength - 1);
+    const size_t length = last - first + 1;
+    const String response = String("HTTP/1.1 206 Partial Content\r\nContent-Type: text/html; charset=utf-8") +
+                            "\r\nContent-Range: bytes " + first + "-" + last + "/" + paddedLength +
+                            "\r\nContent-Length: " + length + "\r\nConnection: close\r\n\r\n";
+    if (sendAll(fd, response.c_str(), response.length()) && sendSlice(fd, body, split, lines, first, last + 1)) {
+      ++served_;
+      ++rangesServed_;
+      bytesServed_ += length;
+    }
+    return;
+  }
+  String response = String("HTTP/1.1 ") + (found ? "200 OK" : "404 Not Found") +
+                    "\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: " + paddedLength +
+                    "\r\nConnection: close\r\n\r\n";
+  bool sent = sendAll(fd, response.c_str(), response.length());
+  if (sent && sendSlice(fd, body, split, lines, 0, paddedLength)) {
+    ++served_;
+    bytesServed_ += paddedLength;
+  }
+}
+
+}  // namespace sim
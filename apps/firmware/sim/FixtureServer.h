@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sim {
+
+struct FixtureServerOptions {
+  String fixturesDir = "sim/fixtures";
+  uint32_t latencyMs = 0;
+  uint32_t jitterMs = 0;
+  // Every N requests to the same URL the {{rev}} placeholder advances; 0 keeps pages stable.
+  uint32_t changeEvery = 0;
+  // Answer "Range: bytes=a-b" with 206; false serves the whole page as 200.
+  bool ranges = true;
+};
+
+// Loopback HTTP server that replays recorded pages from a directory, one thread
+// per connection so artificial latency does not serialize concurrent clients.
+class FixtureServer {
+ public:
+  explicit FixtureServer(FixtureServerOptions options);
+  ~FixtureServer();
+
+  bool start();
+  void stop();
+
+  uint16_t port() const { return port_; }
+  // padKb > 0 serves the fixture with that much filler markup before </body>,
+  // after the content the sites extract. A moved URL answers 301 with the
+  // fixture's URL as Location.
+  String urlFor(const String &fixture, size_t siteIndex, uint32_t padKb = 0, bool moved = false) const;
+  std::vector<String> fixtureNames() const;
+  uint64_t requestsServed() const { return served_.load(); }
+  uint64_t bytesServed() const { return bytesServed_.load(); }
+  uint64_t redirectsServed() const { return redirectsServed_.load(); }
+  uint64_t rangesServed() const { return rangesServed_.load(); }
+
+ private:
+  bool loadFixtures();
+  void acceptLoop();
+  void handle(int fd);
+  String render(const String &target);
+
+  FixtureServerOptions options_;
+  std::map<String, String> fixtures_;
+  std::map<String, uint32_t> hits_;
+  std::mutex hitsMutex_;
+  std::thread acceptThread_;
+  std::atomic<bool> running_{false};
+  std::atomic<int> activeConnections_{0};
+  std::atomic<uint64_t> served_{0};
+  std::atomic<uint64_t> bytesServed_{0};
+  std::atomic<uint64_t> redirectsServed_{0};
+  std::atomic<uint64_t> rangesServed_{0};
+  int listenFd_ = -1;
+  uint16_t port_ = 0;
+};
+
+}  // namespace sim
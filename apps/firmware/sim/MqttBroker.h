@@ -0,0 +1,165 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace sim {
+
+struct MqttMessage {
+  String topic;
+  String payload;
+};
+
+// In-process broker stand-in. Every client session attaches a mailbox; taps let
+// a harness observe traffic as it is published.
+class MqttBroker {
+ public:
+  using Tap = std::function<void(const String &topic, const String &payload)>;
+
+  static MqttBroker &instance() {
+    static MqttBroker broker;
+    return broker;
+  }
+
+  static bool topicMatches(const String &filter, const String &topic) {
+    int f = 0;
+    int t = 0;
+    while (f < filter.length()) {
+      if (filter[f] == '#') {
+        return true;
+      }
+      if (filter[f] == '+') {
+        while (t < topic.length() && topic[t] != '/') {
+          ++t;
+        }
+        ++f;
+        continue;
+      }
+      if (t >= topic.length() || filter[f] != topic[t]) {
+        return false;
+      }
+      ++f;
+      ++t;
+    }
+    return t == topic.length();
+  }
+
+  int attach() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int id = nextId_++;
+    mailboxes_[id];
+    return id;
+  }
+
+  void detach(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    mailboxes_.erase(id);
+  }
+
+  void subscribe(int id, const String &filter) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = mailboxes_.find(id);
+    if (it != mailboxes_.end()) {
+      it->second.filters.push_back(filter);
+    }
+  }
+
+  bool publish(const String &topic, const String &payload) {
+    std::vector<Tap> taps;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!available_) {
+        return false;
+      }
+      ++published_;
+      for (auto &entry : mailboxes_) {
+        for (const auto &filter : entry.second.filters) {
+          if (topicMatches(filter, topic)) {
+            entry.second.pending.push_back({topic, payload});
+            break;
+          }
+        }
+      }
+      for (const auto &tap : taps_) {
+        if (topicMatches(tap.first, topic)) {
+          taps.push_back(tap.second);
+        }
+      }
+    }
+    for (const auto &tap : taps) {
+      tap(topic, payload);
+    }
+    return true;
+  }
+
+  bool poll(int id, MqttMessage &out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = mailboxes_.find(id);
+    if (it == mailboxes_.end() || it->second.pending.empty()) {
+      return false;
+    }
+    out = std::move(it->second.pending.front());
+    it->second.pending.pop_front();
+    return true;
+  }
+
+  void addTap(const String &filter, Tap tap) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    taps_.emplace_back(filter, std::move(tap));
+  }
+
+  void setAvailable(bool available) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    available_ = available;
+    if (!available) {
+      mailboxes_.clear();
+    }
+  }
+
+  bool available() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return available_;
+  }
+
+  bool hasSubscriber(const String &topic) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &entry : mailboxes_) {
+      for (const auto &filter : entry.second.filters) {
+        if (topicMatches(filter, topic)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  bool attached(int id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mailboxes_.count(id) > 0;
+  }
+
+  uint64_t published() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return published_;
+  }
+
+ private:
+  struct Mailbox {
+    std::vector<String> filters;
+    std::deque<MqttMessage> pending;
+  };
+
+  mutable std::mutex mutex_;
+  std::map<int, Mailbox> mailboxes_;
+  std::vector<std::pair<String, Tap>> taps_;
+  int nextId_ = 1;
+  bool available_ = true;
+  uint64_t published_ = 0;
+};
+
+}  // namespace sim
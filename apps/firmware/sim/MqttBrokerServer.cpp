@@ -0,0 +1,209 @@
+#include "MqttBrokerServer.h"
+
+#include <MqttCodec.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <deque>
+
+namespace sim {
+
+namespace {
+bool sendAll(int fd, const uint8_t *data, size_t length) {
+  size_t sent = 0;
+  while (sent < length) {
+    ssize_t n = ::send(fd, data + sent, length - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    sent += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+struct DelayedAck {
+  std::chrono::steady_clock::time_point due;
+  uint16_t packetId;
+};
+}  // namespace
+
+MqttBrokerServer::~MqttBrokerServer() { stop(); }
+
+bool MqttBrokerServer::start(uint16_t port) {
+  listenFd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd_ < 0) {
+    return false;
+  }
+  int one = 1;
+  setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if (::bind(listenFd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(listenFd_, 16) != 0) {
+    ::close(listenFd_);
+    listenFd_ = -1;
+    return false;
+  }
+  socklen_t len = sizeof(addr);
+  ::getsockname(listenFd_, reinterpret_cast<sockaddr *>(&addr), &len);
+  port_ = ntohs(addr.sin_port);
+  running_ = true;
+  acceptThread_ = std::thread(&MqttBrokerServer::acceptLoop, this);
+  return true;
+}
+
+void MqttBrokerServer::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  ::shutdown(listenFd_, SHUT_RDWR);
+  ::close(listenFd_);
+  listenFd_ = -1;
+  if (acceptThread_.joinable()) {
+    acceptThread_.join();
+  }
+  while (activeConnections_.load() > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+}
+
+void MqttBrokerServer::acceptLoop() {
+  while (running_) {
+    pollfd pfd{listenFd_, POLLIN, 0};
+    if (::poll(&pfd, 1, 100) <= 0) {
+      continue;
+    }
+    int fd = ::accept(listenFd_, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    ++activeConnections_;
+    std::thread([this, fd]() {
+      serve(fd);
+      ::close(fd);
+      --activeConnections_;
+    }).detach();
+  }
+}
+
+void MqttBrokerServer::serve(int fd) {
+  mqtt::PacketReader reader(64 * 1024);
+  mqtt::Bytes out;
+  std::deque<DelayedAck> delayedAcks;
+  int mailbox = -1;
+  uint16_t lastPacketId = 0;
+  bool open = true;
+  uint8_t buffer[2048];
+
+  const auto handle = [&](const mqtt::Packet &packet) {
+    switch (packet.type()) {
+      case mqtt::kConnect:
+        if (mailbox >= 0) {
+          return false;
+        }
+        if (!broker_.available()) {
+          ++refused_;
+          mqtt::encodeConnack(out, mqtt::kServerUnavailable);
+          open = false;
+          return true;
+        }
+        ++sessions_;
+        mailbox = broker_.attach();
+        mqtt::encodeConnack(out, mqtt::kConnectAccepted);
+        return true;
+      case mqtt::kSubscribe: {
+        mqtt::SubscribeView subscribe;
+        if (mailbox < 0 || !mqtt::decodeSubscribe(packet, subscribe)) {
+          return false;
+        }
+        for (const auto &filter : subscribe.filters) {
+          broker_.subscribe(mailbox, filter.first);
+        }
+        mqtt::encodeSuback(out, subscribe.packetId, subscribe.filters.front().second > 0 ? 1 : 0);
+        return true;
+      }
+      case mqtt::kPublish: {
+        mqtt::PublishView publish;
+        if (mailbox < 0 || !mqtt::decodePublish(packet, publish)) {
+          return false;
+        }
+        // An outage between the write and the ack loses the ack, not the
+        // retry: the client resends after reconnecting.
+        if (!broker_.publish(String(publish.topic, publish.topicLength),
+                             String(publish.payload, publish.payloadLength))) {
+          open = false;
+          return true;
+        }
+        if (publish.qos > 0) {
+          const uint32_t delayMs = ackDelayMs_.load();
+          if (delayMs == 0 && delayedAcks.empty()) {
+            mqtt::encodeAck(out, mqtt::kPuback, publish.packetId);
+          } else {
+            delayedAcks.push_back(
+                {std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs), publish.packetId});
+          }
+        }
+        return true;
+      }
+      case mqtt::kPingreq:
+        mqtt::encodeEmpty(out, mqtt::kPingresp);
+        return true;
+      case mqtt::kDisconnect:
+        open = false;
+        return true;
+      default:
+        return true;
+    }
+  };
+
+  while (running_ && open) {
+    pollfd pfd{fd, POLLIN, 0};
+    if (::poll(&pfd, 1, 1) > 0) {
+      const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+      if (n <= 0 || reader.feed(buffer, static_cast<size_t>(n), handle) != mqtt::PacketReader::Status::Ok) {
+        break;
+      }
+    }
+    if (mailbox >= 0 && !broker_.attached(mailbox)) {
+      // setAvailable(false) dropped every session.
+      mailbox = -1;
+      break;
+    }
+    MqttMessage message;
+    uint64_t forwarded = 0;
+    while (open && mailbox >= 0 && broker_.poll(mailbox, message)) {
+      if (++lastPacketId == 0) {
+        lastPacketId = 1;
+      }
+      mqtt::encodePublish(out, message.topic.c_str(), message.topic.length(), message.payload.c_str(),
+                          message.payload.length(), 1, lastPacketId, false);
+      ++forwarded;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    while (!delayedAcks.empty() && delayedAcks.front().due <= now) {
+      mqtt::encodeAck(out, mqtt::kPuback, delayedAcks.front().packetId);
+      delayedAcks.pop_front();
+    }
+    if (!out.empty()) {
+      if (!sendAll(fd, out.data(), out.size())) {
+        break;
+      }
+      out.clear();
+      delivered_ += forwarded;
+    }
+  }
+  if (mailbox >= 0) {
+    broker_.detach(mailbox);
+  }
+}
+
+}  // namespace sim
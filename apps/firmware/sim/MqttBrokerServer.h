@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <thread>
+
+#include "MqttBroker.h"
+
+namespace sim {
+
+// Loopback MQTT 3.1.1 front end for MqttBroker, so the firmware's MqttEngine
+// runs over a real socket. One thread per connection. While the broker is
+// unavailable, sessions are dropped and CONNECTs refused with "server
+// unavailable", like a broker restart.
+class MqttBrokerServer {
+ public:
+  explicit MqttBrokerServer(MqttBroker &broker) : broker_(broker) {}
+  ~MqttBrokerServer();
+
+  bool start(uint16_t port);
+  void stop();
+
+  uint16_t port() const { return port_; }
+  // Holds every PUBACK back this long, as if the broker were one round trip away.
+  void setAckDelayMs(uint32_t delayMs) { ackDelayMs_ = delayMs; }
+  uint64_t sessions() const { return sessions_.load(); }
+  uint64_t refused() const { return refused_.load(); }
+  // Messages written to subscribers' sockets.
+  uint64_t delivered() const { return delivered_.load(); }
+
+ private:
+  void acceptLoop();
+  void serve(int fd);
+
+  MqttBroker &broker_;
+  std::thread acceptThread_;
+  std::atomic<bool> running_{false};
+  std::atomic<int> activeConnections_{0};
+  std::atomic<uint32_t> ackDelayMs_{0};
+  std::atomic<uint64_t> sessions_{0};
+  std::atomic<uint64_t> refused_{0};
+  std::atomic<uint64_t> delivered_{0};
+  int listenFd_ = -1;
+  uint16_t port_ = 0;
+};
+
+}  // namespace sim
@@ -0,0 +1,625 @@
+// Native end-to-end harness: runs the firmware's setup()/loop() against the
+// loopback fixture server and the in-process MQTT broker, then prints a JSON
+// report with check throughput, command latency, MQTT pipelining and memory.
+#include <AllocProfile.h>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <MqttEngine.h>
+#include <TraceRing.h>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "../src/hmac_utils.h"
+#include "FixtureServer.h"
+#include "MqttBroker.h"
+#include "MqttBrokerServer.h"
+
+void setup();
+void loop();
+
+namespace {
+
+struct Options {
+  size_t sites = 1000;
+  uint32_t rounds = 3;
+  uint32_t idleSamples = 50;
+  uint32_t heapKb = 320;
+  uint32_t outageMs = 3000;
+  // Pipelining benchmark: messages per run and the emulated broker round trip.
+  uint32_t mqttMessages = 500;
+  uint32_t mqttRttMs = 5;
+  // Mixed page sizes: every Nth site's page carries largeKb of extra markup.
+  uint32_t largeEvery = 0;
+  uint32_t largeKb = 96;
+  // max_bytes for every site, in KB; 0 leaves downloads unlimited.
+  uint32_t maxKb = 0;
+  // Every Nth site is configured with a URL that redirects permanently.
+  uint32_t movedEvery = 0;
+  bool verbose = false;
+  // DUMP_TRACE messages one per line, the input of tools/trace_decode.
+  String traceOut;
+  String littlefsRoot = ".pio/sim/littlefs";
+  sim::FixtureServerOptions server;
+};
+
+struct FixtureProfile {
+  const char *file;
+  const char *mode;
+  const char *selector;
+  const char *startMarker;
+  const char *endMarker;
+  const char *regex;
+  const char *fingerprint;
+};
+
+const FixtureProfile kProfiles[] = {
+    {"product.html", "selector", "#price", "", "", "", ""},
+    {"listing.html", "selector", "li.item:nth-of-type(2)", "", "", "", ""},
+    {"article.html", "markers", "", "<!-- contenido:inicio -->", "<!-- contenido:fin -->", "", ""},
+    {"status.html", "regex", "", "", "", "Stock: (\\d+)", ""},
+    {"landing.html", "full", "", "", "", "", ""},
+    {"landing.html", "full", "", "", "", "", "simhash"},
+};
+
+struct LatencyStats {
+  std::vector<double> samplesMs;
+
+  void add(double ms) { samplesMs.push_back(ms); }
+
+  double percentile(double p) {
+    if (samplesMs.empty()) {
+      return 0;
+    }
+    std::sort(samplesMs.begin(), samplesMs.end());
+    size_t index = static_cast<size_t>(p * static_cast<double>(samplesMs.size() - 1));
+    return samplesMs[index];
+  }
+
+  void write(JsonObject out) {
+    out["samples"] = static_cast<uint32_t>(samplesMs.size());
+    out["p50_ms"] = percentile(0.50);
+    out["p95_ms"] = percentile(0.95);
+    out["max_ms"] = percentile(1.0);
+  }
+};
+
+struct EventCounters {
+  std::map<String, unsigned long> sentAtUs;
+  LatencyStats latency;
+  uint32_t received = 0;
+  uint32_t changes = 0;
+  uint32_t withDiff = 0;
+  uint32_t statuses = 0;
+  uint32_t errors = 0;
+  // payload.fetch: which path the governor chose, truncations and deferrals.
+  std::map<String, uint32_t> fetchPaths;
+  uint32_t truncated = 0;
+  uint32_t cutByMaxBytes = 0;
+  // Body bytes the firmware downloaded (payload.size).
+  uint64_t bodyBytes = 0;
+  uint32_t deferred = 0;
+};
+
+EventCounters counters;
+size_t minFreeHeap = SIZE_MAX;
+
+// Events reach the broker on its connection thread; they are counted on the
+// main thread, between loop() calls, like the device's consumer would see them.
+struct ReceivedEvent {
+  String message;
+  unsigned long receivedAtUs;
+};
+std::mutex inboxMutex;
+std::deque<ReceivedEvent> inbox;
+// Last retained LOAD report, as the server would read it.
+String lastLoadReport;
+uint32_t loadReports = 0;
+// DUMP_TRACE parts, in arrival order.
+std::vector<String> traceParts;
+
+bool parseUint(const String &arg, const char *name, uint32_t &out) {
+  const String prefix = String("--") + name + "=";
+  if (!arg.startsWith(prefix)) {
+    return false;
+  }
+  out = static_cast<uint32_t>(arg.substring(prefix.length()).toInt());
+  return true;
+}
+
+Options parseOptions(int argc, char **argv) {
+  Options options;
+  options.server.latencyMs = 20;
+  options.server.jitterMs = 10;
+  options.server.changeEvery = 2;
+  for (int i = 1; i < argc; ++i) {
+    const String arg(argv[i]);
+    uint32_t value = 0;
+    if (parseUint(arg, "sites", value)) {
+      options.sites = value;
+    } else if (parseUint(arg, "rounds", value)) {
+      options.rounds = value;
+    } else if (parseUint(arg, "idle-samples", value)) {
+      options.idleSamples = value;
+    } else if (parseUint(arg, "outage-ms", value)) {
+      options.outageMs = value;
+    } else if (parseUint(arg, "mqtt-messages", value)) {
+      options.mqttMessages = value;
+    } else if (parseUint(arg, "mqtt-rtt-ms", value)) {
+      options.mqttRttMs = value;
+    } else if (parseUint(arg, "large-every", value)) {
+      options.largeEvery = value;
+    } else if (parseUint(arg, "large-kb", value)) {
+      options.largeKb = value;
+    } else if (parseUint(arg, "max-kb", value)) {
+      options.maxKb = value;
+    } else if (parseUint(arg, "moved-every", value)) {
+      options.movedEvery = value;
+    } else if (parseUint(arg, "heap-kb", value)) {
+      options.heapKb = value;
+    } else if (parseUint(arg, "latency-ms", value)) {
+      options.server.latencyMs = value;
+    } else if (parseUint(arg, "jitter-ms", value)) {
+      options.server.jitterMs = value;
+    } else if (parseUint(arg, "change-every", value)) {
+      options.server.changeEvery = value;
+    } else if (arg.startsWith("--fixtures=")) {
+      options.server.fixturesDir = arg.substring(11);
+    } else if (arg.startsWith("--trace-out=")) {
+      options.traceOut = arg.substring(12);
+    } else if (arg.startsWith("--fs-root=")) {
+      options.littlefsRoot = arg.substring(10);
+    } else if (arg == "--no-ranges") {
+      options.server.ranges = false;
+    } else if (arg == "--verbose") {
+      options.verbose = true;
+    } else {
+      std::fprintf(stderr, "Argumento desconocido: %s\n", argv[i]);
+    }
+  }
+  return options;
+}
+
+String signedCommand(const char *type, const std::function<void(JsonObject)> &fillPayload) {
+  StaticJsonDocument<1024> doc;
+  doc["type"] = type;
+  fillPayload(doc.createNestedObject("payload"));
+  doc["ts"] = static_cast<uint32_t>(millis() / 1000);
+  String canonical;
+  serializeJson(doc, canonical);
+  std::string hmac;
+  security::computeHmacBase64(DEVICE_SECRET, canonical.c_str(), hmac);
+  doc["hmac"] = hmac.c_str();
+  String message;
+  serializeJson(doc, message);
+  return message;
+}
+
+String siteId(size_t index) { return String("sim-") + index; }
+
+void sampleHeap() { minFreeHeap = std::min<size_t>(minFreeHeap, ESP.getFreeHeap()); }
+
+void onEvent(const String &, const String &message) {
+  std::lock_guard<std::mutex> lock(inboxMutex);
+  inbox.push_back({message, micros()});
+}
+
+void onLoadReport(const String &, const String &message) {
+  std::lock_guard<std::mutex> lock(inboxMutex);
+  lastLoadReport = message;
+  ++loadReports;
+}
+
+void onTracePart(const String &, const String &message) {
+  std::lock_guard<std::mutex> lock(inboxMutex);
+  traceParts.push_back(message);
+}
+
+size_t tracePartsReceived() {
+  std::lock_guard<std::mutex> lock(inboxMutex);
+  return traceParts.size();
+}
+
+// Decodes the dump like tools/trace_decode and counts records per event.
+void writeTraceDump(bool completed, const String &path, JsonObject out) {
+  std::lock_guard<std::mutex> lock(inboxMutex);
+  FILE *file = path.isEmpty() ? nullptr : std::fopen(path.c_str(), "w");
+  if (file) {
+    for (const String &message : traceParts) {
+      std::fprintf(file, "%s\n", message.c_str());
+    }
+    std::fclose(file);
+  }
+  std::vector<TraceRecord> records;
+  uint32_t lost = 0;
+  uint32_t parts = 0;
+  bool valid = true;
+  for (const String &message : traceParts) {
+    DynamicJsonDocument doc(2048);
+    if (deserializeJson(doc, message)) {
+      valid = false;
+      continue;
+    }
+    parts = doc["payload"]["parts"] | 0u;
+    lost += doc["payload"]["lost"] | 0u;
+    valid = decodeTracePart(doc["payload"]["data"] | "", records) && valid;
+  }
+  out["completed"] = completed;
+  out["valid"] = valid;
+  out["parts"] = parts;
+  out["records"] = static_cast<uint32_t>(records.size());
+  out["lost"] = lost;
+  out["span_ms"] = records.empty() ? 0 : records.back().atMs - records.front().atMs;
+  std::map<String, uint32_t> perEvent;
+  for (const TraceRecord &record : records) {
+    ++perEvent[traceEventName(record.event)];
+  }
+  JsonObject events = out.createNestedObject("events");
+  for (const auto &entry : perEvent) {
+    events[entry.first] = entry.second;
+  }
+}
+
+uint32_t loadReportEpoch() {
+  std::lock_guard<std::mutex> lock(inboxMutex);
+  StaticJsonDocument<1536> doc;
+  return deserializeJson(doc, lastLoadReport) ? 0 : doc["payload"]["epoch"].as<uint32_t>();
+}
+
+void countEvent(const ReceivedEvent &event) {
+  StaticJsonDocument<2048> doc;
+  if (deserializeJson(doc, event.message)) {
+    return;
+  }
+  const String id = doc["payload"]["id"].as<String>();
+  auto it = counters.sentAtUs.find(id);
+  if (it != counters.sentAtUs.end()) {
+    counters.latency.add(static_cast<double>(event.receivedAtUs - it->second) / 1000.0);
+    counters.sentAtUs.erase(it);
+  }
+  counters.bodyBytes += doc["payload"]["size"].as<uint32_t>();
+  JsonObject fetch = doc["payload"]["fetch"];
+  if (!fetch.isNull()) {
+    ++counters.fetchPaths[fetch["path"] | "?"];
+    counters.truncated += fetch["truncated"].as<bool>() ? 1 : 0;
+    counters.cutByMaxBytes += strcmp(fetch["cut_by"] | "", "max_bytes") == 0 ? 1 : 0;
+    counters.deferred += fetch.containsKey("deferred_ms") ? 1 : 0;
+  }
+  const char *type = doc["type"] | "";
+  if (strcmp(type, "CHANGE_DETECTED") == 0) {
+    ++counters.changes;
+    if (doc["payload"]["diff"]["hunks"].size() > 0) {
+      ++counters.withDiff;
+    }
+  } else if (strcmp(type, "STATUS") == 0) {
+    ++counters.statuses;
+  } else {
+    ++counters.errors;
+  }
+  ++counters.received;
+  sampleHeap();
+}
+
+void countReceivedEvents() {
+  std::deque<ReceivedEvent> received;
+  {
+    std::lock_guard<std::mutex> lock(inboxMutex);
+    received.swap(inbox);
+  }
+  for (const ReceivedEvent &event : received) {
+    countEvent(event);
+  }
+}
+
+bool pumpUntil(const std::function<bool()> &done, unsigned long timeoutMs) {
+  const unsigned long start = millis();
+  while (!done()) {
+    loop();
+    countReceivedEvents();
+    if (millis() - start > timeoutMs) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Publishes `messages` QoS1 events from a harness-owned MqttEngine through the
+// loopback broker with every PUBACK delayed by the emulated round trip.
+void measurePipeline(uint16_t port, size_t window, const Options &options, JsonObject out) {
+  SocketTransport transport(false);
+  MqttEngine engine(transport);
+  MqttOptions mqttOptions;
+  mqttOptions.host = "127.0.0.1";
+  mqttOptions.port = port;
+  mqttOptions.clientId = String("sim-bench-") + window;
+  mqttOptions.inflightWindow = window;
+  mqttOptions.outboxSlots = window * 2;
+  engine.begin(mqttOptions);
+  const unsigned long connectStart = millis();
+  while (!engine.connected() && millis() - connectStart < 5000) {
+    engine.poll(1);
+  }
+  // Roughly a CHANGE_DETECTED event with a diff.
+  const String payload(600, 'x');
+  const uint32_t target = options.mqttMessages;
+  uint32_t queued = 0;
+  const unsigned long start = micros();
+  while (engine.stats().acked < target && micros() - start < 60000000UL) {
+    while (queued < target && engine.publish("sim/bench", payload, 1)) {
+      ++queued;
+    }
+    engine.poll(1);
+  }
+  const double seconds = static_cast<double>(micros() - start) / 1e6;
+  const MqttStats &stats = engine.stats();
+  out["window"] = static_cast<uint32_t>(window);
+  out["acked"] = stats.acked;
+  out["seconds"] = seconds;
+  out["per_second"] = seconds > 0 ? stats.acked / seconds : 0;
+  out["ack_mean_ms"] = stats.acked ? static_cast<double>(stats.ackMicrosTotal) / stats.acked / 1000.0 : 0;
+  out["ack_max_ms"] = stats.ackMicrosMax / 1000.0;
+  out["inflight_peak"] = stats.inflightPeak;
+}
+
+long peakRssKb() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options options = parseOptions(argc, argv);
+  setenv("LITTLEFS_ROOT", options.littlefsRoot.c_str(), 1);
+  std::remove((options.littlefsRoot + "/sites.json").c_str());
+
+  sim::FixtureServer server(options.server);
+  if (!server.start()) {
+    std::fprintf(stderr, "No se pudo iniciar el servidor de fixtures en %s\n", options.server.fixturesDir.c_str());
+    return 1;
+  }
+  auto &broker = sim::MqttBroker::instance();
+  sim::MqttBrokerServer brokerServer(broker);
+  if (!brokerServer.start(MQTT_PORT_TLS)) {
+    std::fprintf(stderr, "No se pudo abrir el broker MQTT en 127.0.0.1:%d\n", MQTT_PORT_TLS);
+    return 1;
+  }
+
+  // The simulated heap starts where the harness (fixtures, broker) left it so
+  // the firmware's fetch admission sees roughly the device's budget.
+  ESP.setHeapSize(options.heapKb * 1024 + static_cast<uint32_t>(EspClass::usedHeap()));
+  Serial.setMuted(!options.verbose);
+  // wifi.bin is kept between runs, so a second run shows the cached join.
+  const unsigned long bootStart = micros();
+  setup();
+  const double setupMs = static_cast<double>(micros() - bootStart) / 1000.0;
+
+  const std::string suffix = security::deriveTopicSuffix(DEVICE_ID, DEVICE_SECRET);
+  const String base = String("devices/") + DEVICE_ID + "-" + suffix.c_str();
+  const String commandTopic = base + "/commands";
+  broker.addTap(base + "/events", onEvent);
+  broker.addTap(base + "/load", onLoadReport);
+  broker.addTap(base + "/trace", onTracePart);
+
+  if (!pumpUntil([&]() { return broker.hasSubscriber(commandTopic); }, 10000)) {
+    std::fprintf(stderr, "El firmware no se suscribió a %s\n", commandTopic.c_str());
+    return 1;
+  }
+  const double subscribedMs = static_cast<double>(micros() - bootStart) / 1000.0;
+
+  counters = EventCounters();
+  const unsigned long upsertStart = micros();
+  for (size_t i = 0; i < options.sites; ++i) {
+    const FixtureProfile &profile = kProfiles[i % (sizeof(kProfiles) / sizeof(kProfiles[0]))];
+    broker.publish(commandTopic, signedCommand("UPSERT_SITE", [&](JsonObject payload) {
+                     payload["id"] = siteId(i);
+                     const bool large = options.largeEvery > 0 && i % options.largeEvery == options.largeEvery - 1;
+                     const bool moved = options.movedEvery > 0 && i % options.movedEvery == 0;
+                     payload["url"] = server.urlFor(profile.file, i, large ? options.largeKb : 0, moved);
+                     payload["interval_s"] = 900;
+                     payload["mode"] = profile.mode;
+                     payload["selector_css"] = profile.selector;
+                     payload["start_marker"] = profile.startMarker;
+                     payload["end_marker"] = profile.endMarker;
+                     payload["regex"] = profile.regex;
+                     if (options.maxKb > 0) {
+                       payload["max_bytes"] = options.maxKb * 1024;
+                     }
+                     if (*profile.fingerprint) {
+                       // landing.html is ~40 words, so one changed word moves
+                       // about 10 bits; longer pages stay within the default 3.
+                       payload["fingerprint"] = profile.fingerprint;
+                       payload["simhash_threshold"] = 12;
+                     }
+                   }));
+    loop();
+    countReceivedEvents();
+  }
+  const double upsertSeconds = static_cast<double>(micros() - upsertStart) / 1e6;
+
+  // New sites are due immediately, so the first scheduled cycle starts while
+  // the upserts are still arriving.
+  const bool cycleCompleted =
+      pumpUntil([&]() { return counters.received >= static_cast<uint32_t>(options.sites); }, 600000);
+  const double firstCycleSeconds = static_cast<double>(micros() - upsertStart) / 1e6;
+  const uint32_t firstCycleErrors = counters.errors;
+
+  // Broker outage: checks requested just before it finish while the firmware
+  // is offline, so their events must come out of the store-and-forward queue.
+  const uint32_t outageSites = static_cast<uint32_t>(std::min<size_t>(options.sites, 20));
+  const uint32_t beforeOutage = counters.received;
+  const uint64_t deliveredBefore = brokerServer.delivered();
+  for (uint32_t i = 0; i < outageSites; ++i) {
+    broker.publish(commandTopic, signedCommand("CHECK_NOW", [&](JsonObject payload) { payload["id"] = siteId(i); }));
+  }
+  // The commands must be on the firmware's socket before the broker drops it.
+  pumpUntil([&]() { return brokerServer.delivered() >= deliveredBefore + outageSites; }, 5000);
+  loop();
+  countReceivedEvents();
+  broker.setAvailable(false);
+  pumpUntil([]() { return false; }, options.outageMs);
+  const uint32_t deliveredDuringOutage = counters.received - beforeOutage;
+  broker.setAvailable(true);
+  const unsigned long reconnectStart = micros();
+  const bool outageRecovered =
+      pumpUntil([&]() { return counters.received >= beforeOutage + outageSites; }, 60000);
+  const double outageRecoverySeconds = static_cast<double>(micros() - reconnectStart) / 1e6;
+  const uint32_t deliveredAfterOutage = counters.received - beforeOutage - deliveredDuringOutage;
+
+  LatencyStats idle;
+  for (uint32_t i = 0; i < options.idleSamples && options.sites > 0; ++i) {
+    const String id = siteId(i % options.sites);
+    const uint32_t before = counters.received;
+    const unsigned long sentAt = micros();
+    broker.publish(commandTopic, signedCommand("CHECK_NOW", [&](JsonObject payload) { payload["id"] = id; }));
+    pumpUntil([&]() { return counters.received > before; }, 30000);
+    idle.add(static_cast<double>(micros() - sentAt) / 1000.0);
+  }
+
+  counters = EventCounters();
+  const uint64_t servedBefore = server.requestsServed();
+  const unsigned long cycleStart = micros();
+  bool completed = true;
+  for (uint32_t round = 0; round < options.rounds; ++round) {
+    const uint32_t target = counters.received + static_cast<uint32_t>(options.sites);
+    for (size_t i = 0; i < options.sites; ++i) {
+      const String id = siteId(i);
+      counters.sentAtUs[id] = micros();
+      broker.publish(commandTopic, signedCommand("CHECK_NOW", [&](JsonObject payload) { payload["id"] = id; }));
+    }
+    completed = pumpUntil([&]() { return counters.received >= target; }, 600000) && completed;
+  }
+  const double cycleSeconds = static_cast<double>(micros() - cycleStart) / 1e6;
+  server.stop();
+
+  // Shard handover: the device keeps the even sites and drops the rest. One id
+  // it has never been sent must show up as missing in the next LOAD report.
+  const uint32_t shardEpoch = 7;
+  const size_t idsPerPart = 40;
+  std::vector<String> owned;
+  for (size_t i = 0; i < options.sites; i += 2) {
+    owned.push_back(siteId(i));
+  }
+  owned.push_back("sim-missing");
+  const uint16_t parts = static_cast<uint16_t>((owned.size() + idsPerPart - 1) / idsPerPart);
+  for (uint16_t part = 0; part < parts; ++part) {
+    broker.publish(commandTopic, signedCommand("ASSIGN_SHARD", [&](JsonObject payload) {
+                     payload["id"] = DEVICE_ID;
+                     payload["epoch"] = shardEpoch;
+                     payload["part"] = part;
+                     payload["parts"] = parts;
+                     JsonArray ids = payload.createNestedArray("sites");
+                     for (size_t i = part * idsPerPart; i < owned.size() && i < (part + 1u) * idsPerPart; ++i) {
+                       ids.add(owned[i]);
+                     }
+                   }));
+  }
+  const bool shardApplied = pumpUntil([&]() { return loadReportEpoch() == shardEpoch; }, 10000);
+  StaticJsonDocument<1536> shardLoad;
+  {
+    std::lock_guard<std::mutex> lock(inboxMutex);
+    deserializeJson(shardLoad, lastLoadReport);
+  }
+
+  // The whole ring comes back over MQTT while the device keeps running.
+  broker.publish(commandTopic, signedCommand("DUMP_TRACE", [](JsonObject payload) { payload["id"] = DEVICE_ID; }));
+  const size_t traceExpected = (TRACE_RING_RECORDS + TRACE_RECORDS_PER_PART - 1) / TRACE_RECORDS_PER_PART;
+  const bool traceCompleted = pumpUntil([&]() { return tracePartsReceived() >= traceExpected; }, 10000);
+
+  brokerServer.setAckDelayMs(options.mqttRttMs);
+  DynamicJsonDocument pipeline(1024);
+  measurePipeline(brokerServer.port(), 1, options, pipeline.createNestedObject("serial"));
+  measurePipeline(brokerServer.port(), MQTT_INFLIGHT_WINDOW * 2, options, pipeline.createNestedObject("pipelined"));
+  brokerServer.stop();
+
+  // The allocation profile adds a section per tag.
+  DynamicJsonDocument report(ALLOC_PROFILE ? 16384 : 4096);
+  report["sites"] = static_cast<uint32_t>(options.sites);
+  report["rounds"] = options.rounds;
+  report["completed"] = completed;
+  JsonObject fixtures = report.createNestedObject("fixtures");
+  fixtures["latency_ms"] = options.server.latencyMs;
+  fixtures["jitter_ms"] = options.server.jitterMs;
+  fixtures["requests"] = static_cast<uint32_t>(server.requestsServed() - servedBefore);
+  fixtures["max_kb"] = options.maxKb;
+  fixtures["large_every"] = options.largeEvery;
+  fixtures["large_kb"] = options.largeKb;
+  fixtures["moved_every"] = options.movedEvery;
+  // Whole run: with the permanent redirect cached only each moved site's first
+  // check is redirected.
+  fixtures["redirects"] = static_cast<uint32_t>(server.redirectsServed());
+  // Whole run too: markers sites ask for a byte window from their second check.
+  fixtures["ranges"] = static_cast<uint32_t>(server.rangesServed());
+  fixtures["bytes"] = static_cast<uint32_t>(server.bytesServed());
+  JsonObject boot = report.createNestedObject("boot");
+  boot["setup_ms"] = setupMs;
+  boot["mqtt_subscribed_ms"] = subscribedMs;
+  JsonObject upserts = report.createNestedObject("upserts");
+  upserts["seconds"] = upsertSeconds;
+  upserts["per_second"] = upsertSeconds > 0 ? options.sites / upsertSeconds : 0;
+  JsonObject firstCycle = report.createNestedObject("first_cycle");
+  firstCycle["completed"] = cycleCompleted;
+  firstCycle["seconds"] = firstCycleSeconds;
+  firstCycle["errors"] = firstCycleErrors;
+  firstCycle["sequential_estimate_s"] = options.sites * (options.server.latencyMs + options.server.jitterMs / 2.0) / 1000.0;
+  JsonObject outage = report.createNestedObject("outage");
+  outage["duration_ms"] = options.outageMs;
+  outage["checks"] = outageSites;
+  outage["delivered_during"] = deliveredDuringOutage;
+  outage["delivered_after"] = deliveredAfterOutage;
+  outage["recovered"] = outageRecovered;
+  outage["recovery_s"] = outageRecoverySeconds;
+  JsonObject checks = report.createNestedObject("checks");
+  checks["events"] = counters.received;
+  checks["changed"] = counters.changes;
+  checks["changed_with_diff"] = counters.withDiff;
+  checks["status"] = counters.statuses;
+  checks["errors"] = counters.errors;
+  checks["body_bytes"] = static_cast<uint32_t>(counters.bodyBytes);
+  checks["seconds"] = cycleSeconds;
+  checks["per_second"] = cycleSeconds > 0 ? counters.received / cycleSeconds : 0;
+  JsonObject fetchPaths = checks.createNestedObject("fetch");
+  for (const auto &path : counters.fetchPaths) {
+    fetchPaths[path.first] = path.second;
+  }
+  fetchPaths["truncated"] = counters.truncated;
+  fetchPaths["cut_by_max_bytes"] = counters.cutByMaxBytes;
+  fetchPaths["deferred"] = counters.deferred;
+  idle.write(report.createNestedObject("check_now_idle"));
+  counters.latency.write(report.createNestedObject("check_now_queued"));
+  JsonObject shardReport = report.createNestedObject("shard");
+  shardReport["applied"] = shardApplied;
+  shardReport["parts"] = parts;
+  shardReport["load_reports"] = loadReports;
+  shardReport["load"] = shardLoad["payload"];
+  writeTraceDump(traceCompleted, options.traceOut, report.createNestedObject("trace"));
+  JsonObject mqttReport = report.createNestedObject("mqtt");
+  mqttReport["sessions"] = static_cast<uint32_t>(brokerServer.sessions());
+  mqttReport["refused_during_outage"] = static_cast<uint32_t>(brokerServer.refused());
+  mqttReport["rtt_ms"] = options.mqttRttMs;
+  mqttReport["messages"] = options.mqttMessages;
+  mqttReport["serial"] = pipeline["serial"];
+  mqttReport["pipelined"] = pipeline["pipelined"];
+  JsonObject memory = report.createNestedObject("memory");
+  memory["peak_rss_kb"] = peakRssKb();
+  memory["heap_used_bytes"] = static_cast<uint32_t>(EspClass::usedHeap());
+  memory["min_free_heap_bytes"] = static_cast<uint32_t>(minFreeHeap == SIZE_MAX ? 0 : minFreeHeap);
+  DynamicJsonDocument alloc(ALLOC_PROFILE ? 12288 : 0);
+  if (ALLOC_PROFILE && !deserializeJson(alloc, allocprofile::toJson())) {
+    memory["alloc"] = alloc.as<JsonObject>();
+  }
+
+  String serialized;
+  serializeJsonPretty(report, serialized);
+  std::printf("%s\n", serialized.c_str());
+  return completed && cycleCompleted && outageRecovered && shardApplied ? 0 : 2;
+}
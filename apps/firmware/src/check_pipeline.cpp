@@ -0,0 +1,294 @@
+#include "check_pipeline.h"
+
+#include <AllocProfile.h>
+#include <algorithm>
+
+namespace {
+String digestHex(uint32_t digest) {
+  char hex[9];
+  snprintf(hex, sizeof(hex), "%08x", static_cast<unsigned>(digest));
+  return String(hex);
+}
+
+String extractionError(const SiteRecord &record, const CheckCapture &capture, String message, size_t keptLength) {
+  if (capture.truncated) {
+    message += strcmp(capture.cutBy, "max_bytes") == 0
+                   ? String(" (descarga cortada en max_bytes = ") + record.config.maxBytes + ")"
+                   : String(" (contenido recortado a ") + keptLength + " de " + capture.bodyBytes +
+                         " bytes por memoria)";
+  }
+  return message;
+}
+}  // namespace
+
+String buildCanonicalCommand(const JsonDocument &doc) {
+  StaticJsonDocument<2048> canonical;
+  canonical["type"] = doc["type"];
+  canonical["payload"] = doc["payload"];
+  canonical["ts"] = doc["ts"];
+  String serialized;
+  serializeJson(canonical, serialized);
+  return serialized;
+}
+
+SiteRecord buildRecordFromPayload(JsonObject payload) {
+  SiteRecord record;
+  record.config.id = payload["id"].as<String>();
+  record.config.url = payload["url"].as<String>();
+  record.config.intervalSeconds = payload["interval_s"].as<uint32_t>();
+  record.config.mode = payload["mode"].as<String>();
+  record.config.extractMode = parseExtractMode(record.config.mode);
+  record.config.selectorCss = payload["selector_css"].as<String>();
+  record.config.startMarker = payload["start_marker"].as<String>();
+  record.config.endMarker = payload["end_marker"].as<String>();
+  record.config.regex = payload["regex"].as<String>();
+  record.config.normalize = payload["normalize"] | "";
+  record.config.ignoreStartMarker = payload["ignore_start"] | "";
+  record.config.ignoreEndMarker = payload["ignore_end"] | "";
+  record.config.fingerprint = payload["fingerprint"] | "";
+  record.config.simhashThreshold = payload["simhash_threshold"] | record.config.simhashThreshold;
+  record.config.maxBytes = payload["max_bytes"] | 0u;
+  record.config.maxItems = payload["max_items"] | 0u;
+  record.config.paused = payload["paused"].as<bool>();
+  if (payload.containsKey("headers")) {
+    JsonObject headers = payload["headers"].as<JsonObject>();
+    for (JsonPair kv : headers) {
+      record.config.headers[String(kv.key().c_str())] = kv.value().as<String>();
+    }
+  }
+  return record;
+}
+
+String diffSnippet(const SnapshotText &text, size_t offset, size_t length) {
+  if (length > DIFF_SNIPPET_BYTES) {
+    length = DIFF_SNIPPET_BYTES;
+    while (length > 0 && (static_cast<uint8_t>(text[offset + length]) & 0xC0) == 0x80) {
+      --length;
+    }
+  }
+  return String(text.data() + offset, length);
+}
+
+void writeDiff(JsonObject out, const ChangeDiff &diff) {
+  out["exact"] = diff.result.exact;
+  out["truncated"] = diff.result.truncated;
+  JsonArray hunks = out.createNestedArray("hunks");
+  for (const DiffHunk &hunk : diff.result.hunks) {
+    JsonObject item = hunks.createNestedObject();
+    item["at"] = static_cast<uint32_t>(hunk.newOffset);
+    item["removed"] = diffSnippet(diff.previous, hunk.oldOffset, hunk.oldLength);
+    item["added"] = diffSnippet(diff.current, hunk.newOffset, hunk.newLength);
+  }
+}
+
+String sanitizeExcerpt(const char *data, size_t length) {
+  String excerpt(data, std::min<size_t>(length, 120));
+  excerpt.replace('\n', ' ');
+  excerpt.replace('\r', ' ');
+  return excerpt;
+}
+
+bool usesSimHash(const SiteConfig &config) { return config.fingerprint.equalsIgnoreCase("simhash"); }
+
+bool isFullPage(const SiteConfig &config) {
+  return extractModeEnabled(ExtractMode::Full) && config.extractMode == ExtractMode::Full;
+}
+
+bool isListing(const SiteConfig &config) {
+  return extractModeEnabled(ExtractMode::List) && config.extractMode == ExtractMode::List;
+}
+
+bool canStream(const SiteConfig &config) {
+  return isFullPage(config) ||
+         (extractModeEnabled(ExtractMode::Markers) && config.extractMode == ExtractMode::Markers);
+}
+
+void writeDnsStats(JsonObject out, const DnsCache &cache) {
+  const DnsStats &stats = cache.stats();
+  out["entries"] = static_cast<uint32_t>(cache.size());
+  out["hits"] = stats.hits;
+  out["misses"] = stats.misses;
+  out["stale"] = stats.stale;
+  out["prefetches"] = stats.prefetches;
+  out["failures"] = stats.failures;
+  out["hit_pct"] = stats.hitPct();
+  out["lookup_ms_avg"] = stats.lookupMsAvg();
+  out["lookup_ms_max"] = stats.lookupMsMax;
+}
+
+void writeFetch(JsonObject out, const CheckCapture &capture) {
+  out["path"] = fetchStrategyName(capture.plan.strategy);
+  out["budget"] = static_cast<uint32_t>(capture.plan.budgetBytes);
+  out["truncated"] = capture.truncated;
+  if (capture.truncated) {
+    out["cut_by"] = capture.cutBy;
+  }
+  if (capture.deferredMs > 0) {
+    out["deferred_ms"] = capture.deferredMs;
+  }
+  if (capture.ranged) {
+    JsonObject range = out.createNestedObject("range");
+    range["start"] = static_cast<uint32_t>(capture.rangeStart);
+    range["bytes"] = static_cast<uint32_t>(capture.bodyBytes);
+    range["page"] = static_cast<uint32_t>(capture.pageBytes);
+  }
+}
+
+CheckReport finishCheck(SiteRecord &record, const FetchResult &result, const CheckCapture &capture,
+                        const ExtractionOutcome &extraction, const char *kept, size_t keptLength,
+                        ContentDigest &digest) {
+  ALLOC_SCOPE("check");
+  CheckReport report;
+  const bool fetched = result.ok;
+  const size_t bodySize = capture.bodyBytes;
+  String excerpt;
+  bool extractionOk = false;
+  record.state.lastChanged = false;
+  if (!fetched) {
+    report.errorMessage = String(F("Error HTTP: ")) + result.error;
+  } else if (capture.fullPage) {
+    record.state.lastChanged = digest.finish(record.state);
+    excerpt = digest.excerpt();
+    extractionOk = true;
+  } else if (extraction.ok && isListing(record.config)) {
+    String error;
+    const size_t items = extractListItems(
+        record.config, extraction.data, extraction.length,
+        [&digest](const char *item, size_t itemLength) { digest.addItem(item, itemLength); }, error);
+    if (items > 0) {
+      record.state.lastChanged = digest.finish(record.state);
+      excerpt = digest.excerpt();
+      extractionOk = true;
+      report.addedItems = digest.items().added();
+      report.removedItems = digest.items().removed();
+    } else {
+      report.errorMessage = extractionError(record, capture, error, keptLength);
+      excerpt = String(kept, std::min<size_t>(keptLength, 120));
+    }
+  } else {
+    if (extraction.ok) {
+      ChangeDiff &changeDiff = report.diff;
+      digest.captureInto(&changeDiff.current);
+      digest.update(extraction.data, extraction.length);
+      record.state.lastChanged = digest.finish(record.state);
+      digest.captureInto(nullptr);
+      excerpt = digest.excerpt();
+      extractionOk = true;
+      if (record.state.lastChanged) {
+        report.hasDiff = SnapshotStore::load(record.config.id, changeDiff.previous);
+        if (report.hasDiff) {
+          changeDiff.result = diffWords(changeDiff.previous.data(), changeDiff.previous.size(),
+                                        changeDiff.current.data(), changeDiff.current.size());
+        }
+        report.snapshotFailed =
+            !SnapshotStore::save(record.config.id, changeDiff.current.data(), changeDiff.current.size());
+      }
+    } else {
+      report.errorMessage = extractionError(record, capture, extraction.errorMessage, keptLength);
+      excerpt = String(kept, std::min<size_t>(keptLength, 120));
+    }
+  }
+  rememberRedirect(result, record.state.resolvedUrl);
+  if (fetched && capture.rangeAsked && !capture.ranged && result.statusCode == 200) {
+    record.state.rangeRefused = true;
+  }
+  if (fetched && extractionOk && capture.markersEnd > capture.markersStart && capture.pageBytes > 0) {
+    record.state.markerAt = static_cast<uint32_t>(capture.markersStart);
+    record.state.markerBytes = static_cast<uint32_t>(capture.markersEnd - capture.markersStart);
+    record.state.pageBytes = static_cast<uint32_t>(capture.pageBytes);
+  } else if (fetched) {
+    record.state.markerBytes = 0;
+  }
+  record.state.lastStatus = result.statusCode;
+  record.state.lastSize = fetched ? bodySize : 0;
+  record.state.bytesTotal += bodySize;
+  ++record.state.checksTotal;
+  const bool success = fetched && extractionOk;
+  report.type = success ? (record.state.lastChanged ? "CHANGE_DETECTED" : "STATUS") : "ERROR";
+  report.statusCode = result.statusCode;
+  report.redirects = result.redirects;
+  report.size = fetched ? bodySize : 0;
+  report.excerpt = sanitizeExcerpt(excerpt.c_str(), excerpt.length());
+  return report;
+}
+
+void writeCheckEvent(JsonDocument &doc, const SiteRecord &record, const CheckCapture &capture,
+                     const CheckReport &report) {
+  doc["type"] = report.type;
+  JsonObject payload = doc.createNestedObject("payload");
+  payload["id"] = record.config.id;
+  payload["http"] = report.statusCode;
+  payload["size"] = static_cast<uint32_t>(report.size);
+  if (record.state.hasSimhash) {
+    payload["hash"] = SimHash::toHex(record.state.simhash);
+    payload["distance"] = record.state.lastDistance;
+  } else {
+    payload["hash"] = record.state.lastHash;
+  }
+  if (!record.state.chunkDigests.empty()) {
+    JsonObject chunks = payload.createNestedObject("chunks");
+    chunks["total"] = static_cast<uint32_t>(record.state.chunkDigests.size());
+    chunks["added"] = record.state.chunksAdded;
+    chunks["removed"] = record.state.chunksRemoved;
+  }
+  if (!record.state.itemDigests.empty()) {
+    JsonObject items = payload.createNestedObject("items");
+    items["total"] = record.state.itemsSeen;
+    items["kept"] = static_cast<uint32_t>(record.state.itemDigests.size());
+    items["truncated"] = record.state.itemsTruncated;
+    items["added"] = record.state.itemsAdded;
+    items["removed"] = record.state.itemsRemoved;
+    if (!report.addedItems.empty()) {
+      JsonArray added = items.createNestedArray("added_items");
+      for (const ItemSet::AddedItem &item : report.addedItems) {
+        JsonArray row = added.createNestedArray();
+        row.add(digestHex(item.digest));
+        row.add(item.head);
+      }
+    }
+    if (!report.removedItems.empty()) {
+      JsonArray removed = items.createNestedArray("removed_items");
+      for (uint32_t digest : report.removedItems) {
+        removed.add(digestHex(digest));
+      }
+    }
+  }
+  payload["changed"] = record.state.lastChanged;
+  payload["excerpt"] = report.excerpt;
+  payload["error"] = report.errorMessage;
+  if (report.hasDiff) {
+    writeDiff(payload.createNestedObject("diff"), report.diff);
+  }
+  JsonObject fetch = payload.createNestedObject("fetch");
+  writeFetch(fetch, capture);
+  fetch["bytes_total"] = record.state.bytesTotal;
+  if (report.redirects > 0) {
+    fetch["redirects"] = report.redirects;
+  }
+}
+
+HistoryEntry historyEntryFor(const SiteRecord &record, const FetchResult &result, const CheckReport &report,
+                             uint32_t time) {
+  HistoryEntry entry;
+  entry.time = time;
+  if (strcmp(report.type, "ERROR") == 0) {
+    entry.flags |= kHistoryError;
+  } else if (record.state.lastChanged) {
+    entry.flags |= kHistoryChanged;
+  }
+  entry.status = report.statusCode > 0 ? static_cast<uint16_t>(report.statusCode) : 0;
+  entry.bytes = static_cast<uint32_t>(report.size);
+  entry.fetchMs = result.elapsedMs;
+  if (record.state.hasSimhash) {
+    for (size_t i = 0; i < kHistoryDigestBytes; ++i) {
+      entry.digest[i] = static_cast<uint8_t>(record.state.simhash >> (56 - 8 * i));
+    }
+  } else {
+    const String &hex = record.state.lastHash;
+    const size_t bytes = std::min<size_t>(hex.length() / 2, kHistoryDigestBytes);
+    for (size_t i = 0; i < bytes; ++i) {
+      entry.digest[i] = static_cast<uint8_t>(strtoul(hex.substring(i * 2, i * 2 + 2).c_str(), nullptr, 16));
+    }
+  }
+  return entry;
+}
@@ -0,0 +1,271 @@
+#pragma once
+
+// The per-check steps that turn a fetched body into a fingerprint, an excerpt
+// and a CHANGE_DETECTED diff, plus the command contract, shared by the
+// firmware and the Linux daemon so both report exactly the same events.
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <ContentChunker.h>
+#include <ContentExtractor.h>
+#include <ContentNormalizer.h>
+#include <FetchEngine.h>
+#include <FetchGovernor.h>
+#include <HistoryLog.h>
+#include <ItemSet.h>
+#include <SimHash.h>
+#include <SnapshotStore.h>
+#include <TextDiff.h>
+#include <algorithm>
+
+#include "hmac_utils.h"
+#include "site_record.h"
+
+// Longest removed/added text per diff hunk in CHANGE_DETECTED events.
+#ifndef DIFF_SNIPPET_BYTES
+#define DIFF_SNIPPET_BYTES 48
+#endif
+
+// The signed part of a command: type, payload and ts, in that order.
+String buildCanonicalCommand(const JsonDocument &doc);
+SiteRecord buildRecordFromPayload(JsonObject payload);
+
+// What a CHANGE_DETECTED replaced: the diff plus the two texts its hunks
+// point into.
+struct ChangeDiff {
+  SnapshotText previous;
+  SnapshotText current;
+  DiffResult result;
+};
+
+// Cuts at a UTF-8 character boundary so the event stays valid JSON text.
+String diffSnippet(const SnapshotText &text, size_t offset, size_t length);
+void writeDiff(JsonObject out, const ChangeDiff &diff);
+
+// payload.dns of LOAD reports: cache hit rate and resolver latency.
+void writeDnsStats(JsonObject out, const DnsCache &cache);
+
+String sanitizeExcerpt(const char *data, size_t length);
+bool usesSimHash(const SiteConfig &config);
+bool isFullPage(const SiteConfig &config);
+bool isListing(const SiteConfig &config);
+// Full pages go straight into the digest and markers keep only the text
+// between them; selectors and regexes need the whole body.
+bool canStream(const SiteConfig &config);
+
+// Feeds content through the site's normalizer into its fingerprint (SHA-256,
+// or SimHash for near-duplicate tolerant sites), keeping the start of the
+// normalized text as the event excerpt. Works chunk by chunk, so full-page
+// sites are fingerprinted straight from the socket without buffering; for
+// those the content is also split into chunks so the excerpt can show the
+// regions that changed instead of the top of the page. "list" sites feed each
+// item through addItem() instead and are fingerprinted as a set of items.
+class ContentDigest {
+ public:
+  void begin(const SiteConfig &config, const SiteState &state, bool fullPage) {
+    chunking_ = fullPage;
+    if (chunking_) {
+      chunker_.begin(state.chunkDigests);
+    }
+    listing_ = !fullPage && isListing(config);
+    if (listing_) {
+      items_.begin(state.itemDigests, config.maxItems);
+    }
+    simhash_ = !listing_ && usesSimHash(config);
+    threshold_ = config.simhashThreshold;
+    if (simhash_) {
+      similarity_.begin();
+    } else {
+      sha_.reset();
+    }
+    excerpt_ = String();
+    options_ = normalizeOptionsForSite(config);
+    output_ = [this](const char *chunk, size_t chunkLength) {
+      if (listing_) {
+        items_.update(chunk, chunkLength);
+      } else if (simhash_) {
+        similarity_.update(chunk, chunkLength);
+      } else {
+        sha_.update(chunk, chunkLength);
+      }
+      if (chunking_) {
+        chunker_.update(chunk, chunkLength);
+      }
+      if (capture_ && capture_->size() < DIFF_MAX_CONTENT_BYTES) {
+        const size_t take = std::min<size_t>(chunkLength, DIFF_MAX_CONTENT_BYTES - capture_->size());
+        capture_->insert(capture_->end(), chunk, chunk + take);
+      }
+      if (excerpt_.length() < 120) {
+        excerpt_.concat(chunk, std::min<size_t>(chunkLength, 120 - excerpt_.length()));
+      }
+    };
+    normalizer_.begin(options_, output_);
+  }
+
+  void update(const char *data, size_t length) { normalizer_.update(data, length); }
+  // One item of a "list" site, normalized on its own.
+  void addItem(const char *data, size_t length) {
+    if (items_.seen() > 0 && excerpt_.length() < 120) {
+      excerpt_ += " … ";
+    }
+    items_.beginItem();
+    normalizer_.begin(options_, output_);
+    normalizer_.update(data, length);
+    normalizer_.finish();
+    items_.endItem();
+  }
+  // Also collects the normalized text (up to DIFF_MAX_CONTENT_BYTES) into
+  // `text`, which must outlive finish(); nullptr stops collecting.
+  void captureInto(SnapshotText *text) { capture_ = text; }
+
+  // Stores the new fingerprint in `state` and returns whether it counts as a
+  // change against the previous one.
+  bool finish(SiteState &state) {
+    if (listing_) {
+      return finishItems(state);
+    }
+    state.itemDigests.clear();
+    state.itemsSeen = 0;
+    state.itemsAdded = 0;
+    state.itemsRemoved = 0;
+    state.itemsTruncated = false;
+    normalizer_.finish();
+    const bool changed = finishFingerprint(state);
+    if (chunking_) {
+      chunker_.finish();
+      state.chunkDigests = chunker_.digests();
+      state.chunksAdded = static_cast<uint16_t>(chunker_.addedChunks());
+      state.chunksRemoved = static_cast<uint16_t>(chunker_.removedChunks());
+      if (changed && !chunker_.excerpt().isEmpty()) {
+        excerpt_ = chunker_.excerpt();
+      }
+    } else {
+      state.chunkDigests.clear();
+      state.chunksAdded = 0;
+      state.chunksRemoved = 0;
+    }
+    return changed;
+  }
+
+  const String &excerpt() const { return excerpt_; }
+  const ItemSet &items() const { return items_; }
+
+ private:
+  // The site's hash is the SHA-256 of the sorted item digests, so it only
+  // moves when an item comes or goes.
+  bool finishItems(SiteState &state) {
+    items_.finish();
+    state.itemDigests = items_.digests();
+    state.itemsSeen = static_cast<uint16_t>(std::min<size_t>(items_.seen(), UINT16_MAX));
+    state.itemsAdded = static_cast<uint16_t>(items_.addedCount());
+    state.itemsRemoved = static_cast<uint16_t>(items_.removedCount());
+    state.itemsTruncated = items_.truncated();
+    state.chunkDigests.clear();
+    state.chunksAdded = 0;
+    state.chunksRemoved = 0;
+    for (uint32_t digest : state.itemDigests) {
+      const uint8_t bytes[4] = {static_cast<uint8_t>(digest >> 24), static_cast<uint8_t>(digest >> 16),
+                                static_cast<uint8_t>(digest >> 8), static_cast<uint8_t>(digest)};
+      sha_.update(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+    }
+    const bool changed = finishFingerprint(state);
+    if (changed && !items_.excerpt().isEmpty()) {
+      excerpt_ = items_.excerpt();
+    }
+    return changed;
+  }
+
+  bool finishFingerprint(SiteState &state) {
+    if (!simhash_) {
+      const String previous = state.lastHash;
+      state.lastHash = String(sha_.finishHex().c_str());
+      state.hasSimhash = false;
+      return previous != state.lastHash;
+    }
+    const uint64_t fingerprint = similarity_.finish();
+    const bool hadPrevious = state.hasSimhash;
+    state.lastDistance = hadPrevious ? SimHash::distance(state.simhash, fingerprint) : 64;
+    state.lastHash = String();
+    state.hasSimhash = true;
+    if (hadPrevious && state.lastDistance <= threshold_) {
+      // Keep the reference so slow drift still adds up to a change.
+      return false;
+    }
+    state.simhash = fingerprint;
+    return true;
+  }
+
+  ContentNormalizer normalizer_;
+  NormalizeOptions options_;
+  ContentNormalizer::Output output_;
+  security::Sha256Stream sha_;
+  SimHash similarity_;
+  ContentChunker chunker_;
+  ItemSet items_;
+  bool simhash_ = false;
+  bool chunking_ = false;
+  bool listing_ = false;
+  uint8_t threshold_ = 0;
+  SnapshotText *capture_ = nullptr;
+  String excerpt_;
+};
+
+// How a check received the response body.
+struct CheckCapture {
+  FetchPlan plan;
+  // The body went straight into the digest (full page).
+  bool fullPage = false;
+  // Only part of the body was kept: cutBy is "memory" (plan.budgetBytes or
+  // what the heap allowed) or "max_bytes" (the site's limit stopped the download).
+  bool truncated = false;
+  const char *cutBy = "";
+  size_t bodyBytes = 0;
+  uint32_t deferredMs = 0;
+  // A Range was asked for (markerWindowFor()) and the server sent only that
+  // part, from rangeStart of a pageBytes page.
+  bool rangeAsked = false;
+  bool ranged = false;
+  size_t rangeStart = 0;
+  size_t pageBytes = 0;
+  // Markers sites: page offsets of the markers, markersEnd 0 when unknown.
+  size_t markersStart = 0;
+  size_t markersEnd = 0;
+};
+
+void writeFetch(JsonObject out, const CheckCapture &capture);
+
+// What a finished check reports.
+struct CheckReport {
+  const char *type = "ERROR";
+  int statusCode = -1;
+  size_t size = 0;
+  String excerpt;
+  String errorMessage;
+  ChangeDiff diff;
+  bool hasDiff = false;
+  // The new content could not be kept for the next CHANGE_DETECTED diff.
+  bool snapshotFailed = false;
+  uint8_t redirects = 0;
+  // "list" sites: the first items the check added and removed.
+  std::vector<ItemSet::AddedItem> addedItems;
+  std::vector<uint32_t> removedItems;
+};
+
+// The URL a check fetches: the end of the site's permanent redirects if known.
+inline const String &fetchUrlFor(const SiteRecord &record) {
+  return record.state.resolvedUrl.isEmpty() ? record.config.url : record.state.resolvedUrl;
+}
+
+// `digest` has been begun for the site; for full pages the body already went
+// through it and was never buffered, otherwise `extraction` points into the
+// `keptLength` bytes at `kept` (the page, its prefix or the text between
+// markers). Updates the site's fingerprint and counters.
+CheckReport finishCheck(SiteRecord &record, const FetchResult &result, const CheckCapture &capture,
+                        const ExtractionOutcome &extraction, const char *kept, size_t keptLength,
+                        ContentDigest &digest);
+// type and payload of the event; the caller adds payload.queue and ts.
+void writeCheckEvent(JsonDocument &doc, const SiteRecord &record, const CheckCapture &capture,
+                     const CheckReport &report);
+// The check as a HISTORY record at `time` (seconds); the caller appends it.
+HistoryEntry historyEntryFor(const SiteRecord &record, const FetchResult &result, const CheckReport &report,
+                             uint32_t time);
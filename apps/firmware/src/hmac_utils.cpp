@@ -71,15 +71,34 @@ bool constantTimeEquals(const std::string &a, const std::string &b) {
   return diff == 0;
 }
 
-std::string computeSha256Hex(const std::string &input) {
-  unsigned char hash[32];
-  mbedtls_sha256_context ctx;
-  mbedtls_sha256_init(&ctx);
-  mbedtls_sha256_starts_ret(&ctx, 0);
-  mbedtls_sha256_update_ret(&ctx, reinterpret_cast<const unsigned char *>(input.data()), input.size());
-  mbedtls_sha256_finish_ret(&ctx, hash);
-  mbedtls_sha256_free(&ctx);
+std::string computeSha256Hex(const std::string &input) { return computeSha256Hex(input.data(), input.size()); }
+
+std::string computeSha256Hex(const char *data, size_t length) {
+  Sha256Stream stream;
+  stream.update(data, length);
+  return stream.finishHex();
+}
 
+Sha256Stream::Sha256Stream() {
+  mbedtls_sha256_init(&ctx_);
+  mbedtls_sha256_starts_ret(&ctx_, 0);
+}
+
+Sha256Stream::~Sha256Stream() { mbedtls_sha256_free(&ctx_); }
+
+void Sha256Stream::reset() {
+  mbedtls_sha256_free(&ctx_);
+  mbedtls_sha256_init(&ctx_);
+  mbedtls_sha256_starts_ret(&ctx_, 0);
+}
+
+void Sha256Stream::update(const char *data, size_t length) {
+  mbedtls_sha256_update_ret(&ctx_, reinterpret_cast<const unsigned char *>(data), length);
+}
+
+std::string Sha256Stream::finishHex() {
+  unsigned char hash[32];
+  mbedtls_sha256_finish_ret(&ctx_, hash);
   char hex[65] = {0};
   for (size_t i = 0; i < sizeof(hash); ++i) {
     std::snprintf(hex + (i * 2), 3, "%02x", hash[i]);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Arduino.h>
+#include <mbedtls/sha256.h>
 #include <string>
 
 namespace security {
@@ -13,4 +14,23 @@ bool constantTimeEquals(const std::string &a, const std::string &b);
 
 std::string computeSha256Hex(const std::string &input);
 
+std::string computeSha256Hex(const char *data, size_t length);
+
+// Incremental SHA-256 for content produced in chunks (e.g. by the normalizer).
+class Sha256Stream {
+ public:
+  Sha256Stream();
+  ~Sha256Stream();
+  Sha256Stream(const Sha256Stream &) = delete;
+  Sha256Stream &operator=(const Sha256Stream &) = delete;
+
+  // Starts a new digest, discarding any input so far.
+  void reset();
+  void update(const char *data, size_t length);
+  std::string finishHex();
+
+ private:
+  mbedtls_sha256_context ctx_;
+};
+
 }
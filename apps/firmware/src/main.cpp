@@ -1,14 +1,31 @@
+#include <AllocProfile.h>
 #include <Arduino.h>
 #include <ArduinoJson.h>
-#include <PubSubClient.h>
+#include <CheckArena.h>
 #include <WiFi.h>
-#include <WiFiClientSecure.h>
 
 #include <ContentExtractor.h>
-#include <SecureHttpClient.h>
+#include <EventQueue.h>
+#include <FastBoot.h>
+#include <FetchEngine.h>
+#include <BandwidthBudget.h>
+#include <FetchGovernor.h>
+#include <HistoryLog.h>
+#include <LoadMonitor.h>
+#include <MqttEngine.h>
+#include <ShardAssignment.h>
+#include <SimHash.h>
+#include <SleepPlanner.h>
+#include <SnapshotStore.h>
 #include <StorageManager.h>
+#include <TextDiff.h>
+#include <TraceRing.h>
 #include <algorithm>
+#include <esp_pm.h>
+#include <esp_sleep.h>
+#include <strings.h>
 
+#include "check_pipeline.h"
 #include "hmac_utils.h"
 #include "site_record.h"
 
@@ -36,26 +53,130 @@
 #error "Define DEVICE_SECRET via entorno"
 #endif
 
+// 0 talks plain TCP to the broker (the native simulator's loopback broker).
+#ifndef MQTT_USE_TLS
+#define MQTT_USE_TLS 1
+#endif
+
+#ifndef CHECK_ARENA_BYTES
+#define CHECK_ARENA_BYTES 49152
+#endif
+
+#ifndef FETCH_MAX_IN_FLIGHT
+#define FETCH_MAX_IN_FLIGHT 4
+#endif
+
+#ifndef FETCH_SLOT_HEAP_BYTES
+#define FETCH_SLOT_HEAP_BYTES 40960
+#endif
+
+// Body bytes per second all checks together may download; 0 = unlimited.
+// The burst lets a cycle start with that many bytes before pacing kicks in.
+#ifndef FETCH_BANDWIDTH_BYTES_PER_S
+#define FETCH_BANDWIDTH_BYTES_PER_S 0
+#endif
+
+#ifndef FETCH_BANDWIDTH_BURST_BYTES
+#define FETCH_BANDWIDTH_BURST_BYTES 65536
+#endif
+
+#ifndef EVENT_QUEUE_RAM_SLOTS
+#define EVENT_QUEUE_RAM_SLOTS 8
+#endif
+
+#ifndef EVENT_QUEUE_MAX_EVENTS
+#define EVENT_QUEUE_MAX_EVENTS 200
+#endif
+
+#ifndef EVENT_DRAIN_INTERVAL_MS
+#define EVENT_DRAIN_INTERVAL_MS 100
+#endif
+
+#ifndef SITE_LOAD_BATCH
+#define SITE_LOAD_BATCH 4
+#endif
+
+#ifndef WIFI_FAST_JOIN_TIMEOUT_MS
+#define WIFI_FAST_JOIN_TIMEOUT_MS 1500
+#endif
+
+// 0 leaves the per-check warnings (deferred checks, arena overflow, failed
+// snapshots, rejected events) to the trace ring instead of Serial.
+#ifndef LOG_HOT_PATH
+#define LOG_HOT_PATH 1
+#endif
+
+#ifndef TRACE_HEAP_INTERVAL_MS
+#define TRACE_HEAP_INTERVAL_MS 10000
+#endif
+
+#if LOG_HOT_PATH
+#define LOG_HOT(level, message) logLine(level, message)
+#else
+#define LOG_HOT(level, message) (void)0
+#endif
+
 namespace {
 constexpr uint16_t kMqttPort = MQTT_PORT_TLS;
+constexpr uint16_t kMqttBufferSize = 2048;
+constexpr size_t kCheckSlots = FETCH_MAX_IN_FLIGHT;
+constexpr uint32_t kFetchPollMs = 1;
+// Sites looked at per prefetch pass, and how often a pass runs.
+constexpr size_t kDnsPrefetchScan = 8;
+constexpr uint32_t kDnsPrefetchIntervalMs = 500;
+// Owned sites not configured here yet, listed by id in each LOAD report.
+constexpr size_t kLoadMissingIds = 16;
 const char *kWifiSsid = WIFI_SSID;
 const char *kWifiPass = WIFI_PASS;
 const char *kMqttHost = MQTT_HOST_TLS;
 const char *kDeviceId = DEVICE_ID;
 const std::string kDeviceSecret = DEVICE_SECRET;
-WiFiClientSecure secureClient;
-PubSubClient mqttClient(secureClient);
+SocketTransport mqttTransport(MQTT_USE_TLS != 0);
+MqttEngine mqttEngine(mqttTransport);
 StorageManager storageManager;
-SecureHttpClient httpClient;
+FetchEngine fetchEngine;
+DnsCache dnsCache;
+FetchGovernor fetchGovernor;
+BandwidthBudget bandwidth;
+EventQueue eventQueue;
+LoadMonitor loadMonitor;
+ShardAssignment shard;
+SleepPlanner sleepPlanner;
 SiteList sites;
+size_t dispatchCursor = 0;
+size_t dnsPrefetchCursor = 0;
 String commandTopic;
 String eventsTopic;
-unsigned long lastReconnectAttempt = 0;
+String loadTopic;
+String traceTopic;
+TraceDumper traceDumper;
+uint32_t traceDumps = 0;
+String historyTopic;
+HistoryReply historyReply;
+uint32_t historyRequests = 0;
+unsigned long lastDrainAt = 0;
+unsigned long lastHeapTraceAt = 0;
+unsigned long lastDnsPrefetchAt = 0;
+unsigned long lastLoadReportAt = 0;
+unsigned long batchOpenedAt = 0;
+unsigned long bootStartedAt = 0;
+unsigned long lastBootPhaseAt = 0;
+bool bootMqttLogged = false;
+bool bootCheckLogged = false;
+bool pendingPersist = false;
+bool batchOpen = false;
+bool loadReportedSinceConnect = false;
 
 void logLine(const char *level, const String &message) {
   Serial.printf("[%s] %s\n", level, message.c_str());
 }
 
+void logBootPhase(const char *phase) {
+  const unsigned long now = millis();
+  logLine("BOOT", String(phase) + " +" + (now - lastBootPhaseAt) + " ms (total " + (now - bootStartedAt) + " ms)");
+  lastBootPhaseAt = now;
+}
+
 SiteRecord *findSite(const String &id) {
   for (auto &record : sites) {
     if (record.config.id == id) {
@@ -65,106 +186,698 @@ SiteRecord *findSite(const String &id) {
   return nullptr;
 }
 
-String buildCanonicalCommand(const JsonDocument &doc) {
-  StaticJsonDocument<2048> canonical;
-  canonical["type"] = doc["type"];
-  canonical["payload"] = doc["payload"];
-  canonical["ts"] = doc["ts"];
-  String serialized;
-  serializeJson(canonical, serialized);
-  return serialized;
+// Hands the event to the MQTT engine, which only queues it; false keeps it in
+// eventQueue until the session is up and the outbox has room.
+bool sendEvent(const String &message) {
+  if (mqttEngine.publish(eventsTopic, message, 1)) {
+    return true;
+  }
+  if (mqttEngine.canPublish()) {
+    // Refused with room to spare, so larger than kMqttBufferSize: retrying
+    // would wedge the queue behind it.
+    LOG_HOT("WARN", "Evento rechazado por el cliente MQTT, descartado");
+    return true;
+  }
+  return false;
+}
+
+EventKind eventKindFor(const char *type) {
+  if (strcmp(type, "CHANGE_DETECTED") == 0) {
+    return EventKind::Change;
+  }
+  return strcmp(type, "ERROR") == 0 ? EventKind::Error : EventKind::Status;
+}
+
+void publishEvent(const SiteRecord &record, const CheckCapture &capture, const CheckReport &report) {
+  ALLOC_SCOPE("json_event");
+  StaticJsonDocument<2048> doc;
+  writeCheckEvent(doc, record, capture, report);
+  JsonObject queue = doc["payload"].createNestedObject("queue");
+  queue["depth"] = static_cast<uint32_t>(eventQueue.depth());
+  queue["dropped"] = eventQueue.stats().dropped;
+  doc["ts"] = static_cast<uint32_t>(millis() / 1000);
+  String message;
+  serializeJson(doc, message);
+  // Anything already queued goes first so the broker sees events in order.
+  if (eventQueue.empty() && mqttEngine.canPublish() && sendEvent(message)) {
+    return;
+  }
+  eventQueue.push(eventKindFor(report.type), message);
+  TRACE(EventQueued, traceSiteTag(record.config.id), eventKindFor(report.type), eventQueue.depth(), 0);
+}
+
+void drainEventQueue() {
+  if (eventQueue.empty() || !mqttEngine.canPublish()) {
+    return;
+  }
+  const unsigned long now = millis();
+  if (now - lastDrainAt < EVENT_DRAIN_INTERVAL_MS) {
+    return;
+  }
+  lastDrainAt = now;
+  // Fills the outbox; the engine keeps MQTT_INFLIGHT_WINDOW of them on the wire.
+  eventQueue.drain(sendEvent, MQTT_OUTBOX_SLOTS);
+  if (eventQueue.empty()) {
+    logLine("INFO", String("Cola de eventos vaciada (") + eventQueue.stats().dropped + " descartados en total)");
+  }
 }
 
-void publishEvent(const char *type, const SiteRecord &record, int statusCode, size_t size, bool changed,
-                  const String &excerpt, const String &errorMessage) {
-  if (!mqttClient.connected()) {
+// Retained, so the server reads the last report of every device whenever it
+// rebalances; a report that stops changing means the device went silent.
+void publishLoadReport() {
+  const unsigned long now = millis();
+  if (now - lastLoadReportAt < LOAD_REPORT_INTERVAL_MS || !mqttEngine.canPublish() || storageManager.loading()) {
     return;
   }
-  StaticJsonDocument<1024> doc;
-  doc["type"] = type;
+  lastLoadReportAt = now;
+  ALLOC_SCOPE("json_load");
+  loadMonitor.noteFreeHeap(ESP.getFreeHeap());
+  const LoadReport report = loadMonitor.report(sites, now);
+  StaticJsonDocument<2048> doc;
+  doc["type"] = "LOAD";
   JsonObject payload = doc.createNestedObject("payload");
-  payload["id"] = record.config.id;
-  payload["http"] = statusCode;
-  payload["size"] = static_cast<uint32_t>(size);
-  payload["hash"] = record.state.lastHash;
-  payload["changed"] = changed;
-  payload["excerpt"] = excerpt;
-  payload["error"] = errorMessage;
+  payload["id"] = kDeviceId;
+  payload["seq"] = report.seq;
+  payload["epoch"] = shard.epoch();
+  payload["sites"] = static_cast<uint32_t>(report.sites);
+  payload["active"] = static_cast<uint32_t>(report.active);
+  const std::vector<String> missing = shard.missing(sites);
+  JsonArray missingIds = payload.createNestedArray("missing");
+  for (size_t i = 0; i < missing.size() && i < kLoadMissingIds; ++i) {
+    missingIds.add(missing[i]);
+  }
+  payload["missing_total"] = static_cast<uint32_t>(missing.size());
+  payload["checks"] = report.checks;
+  payload["check_ms"] = report.checkMs;
+  payload["cycle_ms"] = report.cycleMs;
+  payload["lag_ms"] = report.lagMs;
+  payload["utilization"] = report.utilizationPct;
+  payload["heap_free"] = ESP.getFreeHeap();
+  payload["heap_min"] = static_cast<uint32_t>(report.minFreeHeap);
+  payload["largest_block"] = ESP.getMaxAllocHeap();
+  payload["queue_depth"] = static_cast<uint32_t>(eventQueue.depth());
+  payload["in_flight"] = static_cast<uint32_t>(fetchEngine.inFlight());
+  writeDnsStats(payload.createNestedObject("dns"), dnsCache);
+  const PowerStats &powerStats = sleepPlanner.stats();
+  JsonObject power = payload.createNestedObject("power");
+  power["policy"] = powerPolicyName(sleepPlanner.policy());
+  power["cycles"] = powerStats.cycles;
+  power["awake_ms_last"] = powerStats.awakeMsLast;
+  power["awake_ms_avg"] = powerStats.awakeMsAvg();
+  power["awake_ms_max"] = powerStats.awakeMsMax;
+  power["awake_pct"] = powerStats.awakePct();
+  power["light_sleeps"] = powerStats.lightSleeps;
+  power["deep_sleeps"] = powerStats.deepSleeps;
+  payload["overloaded"] = report.overload != nullptr;
+  if (report.overload) {
+    payload["overload"] = report.overload;
+  }
+  doc["ts"] = static_cast<uint32_t>(now / 1000);
+  String message;
+  serializeJson(doc, message);
+  if (!mqttEngine.publish(loadTopic, message, 1, true)) {
+    logLine("WARN", "Reporte LOAD rechazado por el cliente MQTT");
+  } else {
+    loadReportedSinceConnect = true;
+  }
+  TRACE(LoadReport, 0, report.overload != nullptr, report.utilizationPct, report.lagMs);
+}
+
+// One part per loop() so a dump never holds back events or checks.
+void sendTraceDump() {
+  if (!traceDumper.active() || !mqttEngine.canPublish()) {
+    return;
+  }
+  StaticJsonDocument<1536> doc;
+  doc["type"] = "TRACE";
+  if (!traceDumper.next(traceRing, kDeviceId, doc.createNestedObject("payload"))) {
+    return;
+  }
   doc["ts"] = static_cast<uint32_t>(millis() / 1000);
   String message;
   serializeJson(doc, message);
-  mqttClient.publish(eventsTopic.c_str(), message.c_str(), false);
+  if (!mqttEngine.publish(traceTopic, message, 1)) {
+    traceDumper.retry();
+  }
+}
+
+// Like the trace dump, one part per loop().
+void sendHistoryPart() {
+  if (!historyReply.active() || !mqttEngine.canPublish()) {
+    return;
+  }
+  StaticJsonDocument<3072> doc;
+  doc["type"] = "HISTORY";
+  if (!historyReply.next(RtcSchedule::now(), doc.createNestedObject("payload"))) {
+    return;
+  }
+  doc["ts"] = static_cast<uint32_t>(millis() / 1000);
+  String message;
+  serializeJson(doc, message);
+  if (!mqttEngine.publish(historyTopic, message, 1)) {
+    historyReply.retry();
+  }
+}
+
+void traceHeap() {
+  const unsigned long now = millis();
+  if (now - lastHeapTraceAt < TRACE_HEAP_INTERVAL_MS) {
+    return;
+  }
+  lastHeapTraceAt = now;
+  TRACE(Heap, 0, 0, ESP.getFreeHeap(), ESP.getMaxAllocHeap());
 }
 
 void persistSites() {
-  if (!storageManager.saveSites(sites)) {
+  if (storageManager.loading()) {
+    // Saving now would drop the sites not read yet; finishSiteLoading() saves.
+    pendingPersist = true;
+    return;
+  }
+  const unsigned long startedAt = millis();
+  const bool saved = storageManager.saveSites(sites);
+  TRACE(Persist, 0, saved, sites.size(), millis() - startedAt);
+  if (!saved) {
     logLine("WARN", "No se pudo persistir sitios en LittleFS");
   }
 }
 
-SiteRecord buildRecordFromPayload(JsonObject payload) {
-  SiteRecord record;
-  record.config.id = payload["id"].as<String>();
-  record.config.url = payload["url"].as<String>();
-  record.config.intervalSeconds = payload["interval_s"].as<uint32_t>();
-  record.config.mode = payload["mode"].as<String>();
-  record.config.selectorCss = payload["selector_css"].as<String>();
-  record.config.startMarker = payload["start_marker"].as<String>();
-  record.config.endMarker = payload["end_marker"].as<String>();
-  record.config.regex = payload["regex"].as<String>();
-  record.config.paused = payload["paused"].as<bool>();
-  if (payload.containsKey("headers")) {
-    JsonObject headers = payload["headers"].as<JsonObject>();
-    for (JsonPair kv : headers) {
-      record.config.headers[String(kv.key().c_str())] = kv.value().as<String>();
-    }
+// Sites checked before a soft reset keep their place in the schedule instead
+// of all coming due at once.
+void restoreRetainedSchedule(SiteRecord &record) {
+  uint32_t secondsSinceCheck = 0;
+  if (RtcSchedule::lookup(record.config.id, secondsSinceCheck)) {
+    record.state.lastCheckAt = millis() - secondsSinceCheck * 1000UL;
+    record.state.checkedSinceBoot = true;
+  }
+}
+
+void loadSiteBatch(size_t maxCount) {
+  const size_t before = sites.size();
+  storageManager.loadMore(sites, maxCount);
+  for (size_t i = before; i < sites.size(); ++i) {
+    restoreRetainedSchedule(sites[i]);
+  }
+  if (storageManager.loading()) {
+    return;
+  }
+  if (storageManager.loadFailed()) {
+    logLine("WARN", "No se pudieron cargar todos los sitios previos");
+  }
+  logLine("INFO", String("Sitios cargados: ") + sites.size());
+  logBootPhase("Sitios cargados");
+  if (pendingPersist) {
+    pendingPersist = false;
+    persistSites();
   }
-  return record;
 }
 
-String sanitizeExcerpt(const String &input) {
-  String excerpt = input.substring(0, 120);
-  excerpt.replace('\n', ' ');
-  excerpt.replace('\r', ' ');
-  return excerpt;
+// Commands may refer to sites not read yet, so they wait for the full list.
+void finishSiteLoading() {
+  if (storageManager.loading()) {
+    loadSiteBatch(SIZE_MAX);
+  }
 }
 
-void performCheck(SiteRecord &record) {
-  String body;
-  int statusCode = -1;
-  String errorMessage;
-  bool fetched = httpClient.fetch(record.config, body, statusCode);
-  String previousHash = record.state.lastHash;
-  String excerptSource = body;
-  bool extractionOk = false;
-  if (!fetched) {
-    errorMessage = F("Error HTTP");
-    body = "";
-  } else {
-    ExtractionOutcome extraction = extractContentForSite(record.config, body);
+void reportArenaOverflow(const CheckArena &arena) {
+  const CheckArena::Stats &stats = arena.stats();
+  TRACE(ArenaOverflow, 0, 0, stats.fallbackBytes, stats.overflowChecks);
+  LOG_HOT("WARN", String("Arena de chequeo excedida (") + stats.overflowChecks + "/" + stats.checks +
+                      " chequeos, " + stats.fallbackAllocations + " reservas en heap, " + stats.fallbackBytes +
+                      " bytes)");
+}
+
+void completeCheck(SiteRecord &record, const FetchResult &result, const CheckCapture &capture,
+                   const ExtractionOutcome &extraction, const ArenaBuffer &body, ContentDigest &digest) {
+  const CheckReport report = finishCheck(record, result, capture, extraction, body.data(), body.size(), digest);
+  TRACE(CheckEnd, traceSiteTag(record.config.id), eventKindFor(report.type), result.elapsedMs, report.statusCode);
+  if (report.snapshotFailed) {
+    LOG_HOT("WARN", String("No se pudo guardar el contenido previo de ") + record.config.id);
+  }
+  HistoryEntry entry = historyEntryFor(record, result, report, RtcSchedule::now());
+  if (!HistoryLog::append(record.config.id, entry)) {
+    LOG_HOT("WARN", String("No se pudo registrar el historial de ") + record.config.id);
+  }
+  persistSites();
+  publishEvent(record, capture, report);
+}
+
+// One in-flight check: owns a slice of the check arena that receives the body
+// while the engine streams it, then hosts extraction/hash once it completes.
+// The governor's plan decides how much of the body it keeps.
+class CheckSlot : public FetchSink {
+ public:
+  CheckSlot() : body_(arena_) {}
+
+  bool begin(size_t arenaBytes) { return arena_.begin(arenaBytes); }
+  bool busy() const { return busy_; }
+  size_t arenaFree() const { return arena_.largestFree(); }
+
+  bool start(SiteRecord &record, const FetchPlan &plan) {
+    siteId_ = record.config.id;
+    busy_ = true;
+    startedAt_ = millis();
+    capture_ = CheckCapture();
+    capture_.plan = plan;
+    capture_.fullPage = isFullPage(record.config);
+    capture_.deferredMs = record.state.deferred ? millis() - record.state.deferredSince : 0;
+    expectedBytes_ = record.state.lastSize;
+    digest_.begin(record.config, record.state, capture_.fullPage);
+    const bool requested = record.state.checkRequested;
+    record.state.inFlight = true;
+    record.state.checkRequested = false;
+#if EXTRACT_MODE_MARKERS
+    const bool markers = plan.strategy == FetchStrategy::Streamed && !capture_.fullPage;
+    const ByteWindow window = markers ? markerWindowFor(record.config, record.state) : ByteWindow();
+#else
+    const ByteWindow window;
+#endif
+    if (fetch(record, window)) {
+      record.state.deferred = false;
+      return true;
+    }
+    busy_ = false;
+    record.state.inFlight = false;
+    record.state.checkRequested = requested;
+    return false;
+  }
+
+  bool onHeader(const char *name, size_t nameLength, const char *value, size_t valueLength) override {
+    (void)valueLength;
+    if (capture_.plan.strategy == FetchStrategy::Buffered && nameLength == 14 &&
+        strncasecmp(name, "Content-Length", nameLength) == 0) {
+      const long contentLength = atol(value);
+      if (contentLength > 0) {
+        capture_.plan = fetchGovernor.revise(capture_.plan, static_cast<size_t>(contentLength));
+        // Sized once, so the buffer never needs a doubling copy.
+        body_.reserve(std::min(static_cast<size_t>(contentLength), capture_.plan.budgetBytes));
+      }
+    }
+    return true;
+  }
+
+  // Never aborts on memory: what does not fit is counted and dropped, and the
+  // check reports a truncated body instead of a failed fetch.
+  bool onBody(const char *data, size_t length) override {
+    capture_.bodyBytes += length;
+    bandwidth.consume(length);
+    if (capture_.plan.strategy == FetchStrategy::Streamed) {
+#if EXTRACT_MODE_MARKERS
+      if (!capture_.fullPage) {
+        markers_.update(data, length);
+        return true;
+      }
+#endif
+      digest_.update(data, length);
+      return true;
+    }
+    if (capture_.truncated) {
+      return true;
+    }
+    if (body_.empty() && expectedBytes_ > 0) {
+      body_.reserve(std::min(expectedBytes_ + expectedBytes_ / 4, capture_.plan.budgetBytes));
+    }
+    const size_t room = capture_.plan.budgetBytes - std::min(body_.size(), capture_.plan.budgetBytes);
+    const size_t take = std::min(length, room);
+    if (take < length || !body_.append(data, take)) {
+      capture_.truncated = true;
+      capture_.cutBy = "memory";
+      capture_.plan.strategy = FetchStrategy::Capped;
+    }
+    return true;
+  }
+
+  void onComplete(const FetchResult &result) override {
+#if EXTRACT_MODE_MARKERS
+    if (missedWindow(result) && fetchWholePage()) {
+      return;
+    }
+#endif
+    const uint32_t overflowsBefore = arena_.stats().overflowChecks;
+    fetchGovernor.record(capture_.plan.strategy);
+    loadMonitor.checkFinished(millis() - startedAt_);
+    if (result.truncated && !capture_.truncated) {
+      capture_.truncated = true;
+      capture_.cutBy = "max_bytes";
+    }
+    {
+      CheckArena::Scope arenaScope(arena_);
+      SiteRecord *record = findSite(siteId_);
+      if (record) {
+        record->state.inFlight = false;
+        record->state.lastCheckAt = millis();
+        record->state.checkedSinceBoot = true;
+        RtcSchedule::record(siteId_);
+        ExtractionOutcome extraction;
+        // Streamed without fullPage is only ever a "markers" site (canStream()).
+        if (result.ok && !capture_.fullPage && capture_.plan.strategy != FetchStrategy::Streamed) {
+          extraction = extractContentForSite(record->config, body_.data(), body_.size());
+        }
+#if EXTRACT_MODE_MARKERS
+        if (result.ok && !capture_.fullPage && capture_.plan.strategy == FetchStrategy::Streamed) {
+          extraction = markers_.finish();
+          noteMarkers(*record, result, extraction);
+        }
+#endif
+        completeCheck(*record, result, capture_, extraction, body_, digest_);
+      }
+      body_.release();
+    }
+    busy_ = false;
+    if (arena_.stats().overflowChecks != overflowsBefore) {
+      reportArenaOverflow(arena_);
+    }
+  }
+
+ private:
+  // `window` is the Range to ask for; bytes == 0 fetches the whole page.
+  bool fetch(SiteRecord &record, const ByteWindow &window) {
+#if EXTRACT_MODE_MARKERS
+    if (capture_.plan.strategy == FetchStrategy::Streamed && !capture_.fullPage) {
+      markers_.begin(record.config, body_, capture_.plan.budgetBytes, window.start);
+    }
+#endif
+    capture_.rangeAsked = window.bytes > 0;
+    capture_.rangeStart = window.start;
+    FetchRequest request;
+    request.url = fetchUrlFor(record);
+    request.headers = &record.config.headers;
+    request.maxBodyBytes = record.config.maxBytes;
+    request.rangeStart = window.start;
+    request.rangeBytes = window.bytes;
+    request.traceSite = traceSiteTag(record.config.id);
+    return fetchEngine.start(request, *this);
+  }
+
+#if EXTRACT_MODE_MARKERS
+  // The Range came back without both markers (they moved, or the page shrank
+  // and the server answered 416).
+  bool missedWindow(const FetchResult &result) {
+    if (!capture_.rangeAsked || !result.ok) {
+      return false;
+    }
+    if (!result.partial) {
+      return result.statusCode == 416;
+    }
+    return result.rangeStart != capture_.rangeStart || !markers_.finish().ok;
+  }
+
+  // Same check, no Range; false when the engine could not take it.
+  bool fetchWholePage() {
+    SiteRecord *record = findSite(siteId_);
+    if (!record) {
+      return false;
+    }
+    LOG_HOT("INFO", String("Marcadores fuera del rango pedido en ") + siteId_ + ", se descarga la página completa");
+    record->state.markerBytes = 0;
+    // The window's bytes were downloaded all the same.
+    record->state.bytesTotal += capture_.bodyBytes;
+    const CheckCapture windowed = capture_;
+    capture_ = CheckCapture();
+    capture_.plan = windowed.plan;
+    capture_.deferredMs = windowed.deferredMs;
+    return fetch(*record, ByteWindow());
+  }
+
+  // Where the markers were, in page offsets, for the next check's Range.
+  void noteMarkers(const SiteRecord &record, const FetchResult &result, const ExtractionOutcome &extraction) {
+    capture_.ranged = result.partial;
+    capture_.pageBytes = !result.partial ? capture_.bodyBytes
+                         : result.totalBytes > 0 ? result.totalBytes
+                                                 : record.state.pageBytes;
     if (extraction.ok) {
-      excerptSource = extraction.content;
-      std::string extractedCopy(extraction.content.c_str(), extraction.content.length());
-      record.state.lastHash = String(security::computeSha256Hex(extractedCopy).c_str());
-      record.state.lastChanged = previousHash != record.state.lastHash;
-      extractionOk = true;
-    } else {
-      errorMessage = extraction.errorMessage;
-      record.state.lastHash = previousHash;
-      record.state.lastChanged = false;
+      capture_.markersStart = markers_.markersStart();
+      capture_.markersEnd = markers_.markersEnd();
+    }
+  }
+#endif
+
+  CheckArena arena_;
+  ArenaBuffer body_;
+  ContentDigest digest_;
+#if EXTRACT_MODE_MARKERS
+  MarkerStream markers_;
+#endif
+  CheckCapture capture_;
+  String siteId_;
+  size_t expectedBytes_ = 0;
+  unsigned long startedAt_ = 0;
+  bool busy_ = false;
+};
+
+CheckSlot checkSlots[kCheckSlots];
+
+CheckSlot *idleSlot() {
+  for (auto &slot : checkSlots) {
+    if (!slot.busy()) {
+      return &slot;
     }
   }
-  if (!fetched) {
-    record.state.lastHash = previousHash;
-    record.state.lastChanged = false;
+  return nullptr;
+}
+
+// aheadMs lets a site run that early, to join a batch.
+bool isDue(const SiteRecord &record, unsigned long now, bool requestedOnly, unsigned long aheadMs = 0) {
+  if (record.state.inFlight) {
+    return false;
+  }
+  if (record.state.checkRequested) {
+    return true;
   }
-  record.state.lastStatus = statusCode;
-  record.state.lastSize = fetched ? body.length() : 0;
-  persistSites();
-  const bool success = fetched && extractionOk;
-  const char *eventType = success ? (record.state.lastChanged ? "CHANGE_DETECTED" : "STATUS") : "ERROR";
-  publishEvent(eventType, record, statusCode, body.length(), record.state.lastChanged,
-               sanitizeExcerpt(excerptSource), errorMessage);
+  if (requestedOnly || record.config.paused) {
+    return false;
+  }
+  return !record.state.checkedSinceBoot ||
+         now - record.state.lastCheckAt + aheadMs >= static_cast<unsigned long>(record.config.intervalSeconds) * 1000UL;
+}
+
+// With a power policy, the first site to come due opens a batch: for
+// POWER_BATCH_WINDOW_MS, sites due before the window ends run right away, so
+// the device wakes once for all of them instead of once each.
+unsigned long batchAheadMs(unsigned long now) {
+  const uint32_t windowMs = sleepPlanner.batchWindowMs();
+  if (windowMs == 0) {
+    return 0;
+  }
+  if (batchOpen && now - batchOpenedAt < windowMs) {
+    return windowMs - (now - batchOpenedAt);
+  }
+  batchOpen = false;
+  for (const SiteRecord &record : sites) {
+    if (isDue(record, now, false)) {
+      batchOpen = true;
+      batchOpenedAt = now;
+      return windowMs;
+    }
+  }
+  return 0;
+}
+
+uint32_t scheduleLagMs(const SiteRecord &record, unsigned long now) {
+  if (!record.state.checkedSinceBoot) {
+    return 0;
+  }
+  const unsigned long intervalMs = static_cast<unsigned long>(record.config.intervalSeconds) * 1000UL;
+  const unsigned long waited = now - record.state.lastCheckAt;
+  return waited > intervalMs ? waited - intervalMs : 0;
+}
+
+MemoryStatus sampleMemory() {
+  MemoryStatus memory;
+  memory.freeHeap = ESP.getFreeHeap();
+  memory.largestBlock = ESP.getMaxAllocHeap();
+  return memory;
+}
+
+SiteMemoryHint memoryHintFor(const SiteRecord &record, unsigned long now) {
+  SiteMemoryHint hint;
+  hint.streamable = canStream(record.config);
+  hint.expectedBytes = record.config.maxBytes > 0 ? std::min<size_t>(record.state.lastSize, record.config.maxBytes)
+                                                 : record.state.lastSize;
+  hint.deferredForMs = record.state.deferred ? now - record.state.deferredSince : 0;
+  return hint;
+}
+
+void deferCheck(SiteRecord &record, unsigned long now, const MemoryStatus &memory) {
+  if (record.state.deferred) {
+    return;
+  }
+  record.state.deferred = true;
+  record.state.deferredSince = now;
+  fetchGovernor.record(FetchStrategy::Deferred);
+  TRACE(CheckDeferred, traceSiteTag(record.config.id), 0, memory.largestBlock, record.state.lastSize);
+  LOG_HOT("INFO", String("Chequeo de ") + record.config.id + " aplazado por memoria (" + record.state.lastSize +
+                      " bytes esperados, bloque libre " + memory.largestBlock + ", " + memory.checksInFlight +
+                      " en curso)");
+}
+
+// Starts due checks while the engine has room, CHECK_NOW requests first, then
+// scheduled ones round-robin so a long list cannot starve its tail. Sites the
+// governor defers are skipped, so a smaller page may go first; with a
+// bandwidth budget, dispatch pauses until the bucket covers the next site.
+void dispatchDueChecks() {
+  if (sites.empty()) {
+    return;
+  }
+  const unsigned long now = millis();
+  const unsigned long aheadMs = batchAheadMs(now);
+  MemoryStatus memory;
+  bool memorySampled = false;
+  const size_t first = dispatchCursor;
+  for (int pass = 0; pass < 2; ++pass) {
+    const bool requestedOnly = pass == 0;
+    for (size_t visited = 0; visited < sites.size(); ++visited) {
+      const size_t index = (first + visited) % sites.size();
+      SiteRecord &record = sites[index];
+      if (!isDue(record, now, requestedOnly, aheadMs)) {
+        continue;
+      }
+      CheckSlot *slot = idleSlot();
+      if (!slot || !fetchEngine.canStart()) {
+        return;
+      }
+      if (!memorySampled) {
+        memory = sampleMemory();
+        memorySampled = true;
+        loadMonitor.noteFreeHeap(memory.freeHeap);
+      }
+      memory.arenaFree = slot->arenaFree();
+      memory.checksInFlight = fetchEngine.inFlight();
+      const SiteMemoryHint hint = memoryHintFor(record, now);
+      // Waits in order: letting smaller pages through would starve big ones.
+      if (!bandwidth.admits(hint.expectedBytes, now)) {
+        return;
+      }
+      const FetchPlan plan = fetchGovernor.plan(hint, memory);
+      if (plan.strategy == FetchStrategy::Deferred) {
+        deferCheck(record, now, memory);
+        continue;
+      }
+      const uint32_t lagMs = requestedOnly ? 0 : scheduleLagMs(record, now);
+      TRACE(CheckStart, traceSiteTag(record.config.id), plan.strategy, lagMs, hint.expectedBytes);
+      // Counted first: a connect that fails at once finishes the check inside start().
+      loadMonitor.checkStarted(lagMs);
+      if (slot->start(record, plan)) {
+        if (!bootCheckLogged) {
+          bootCheckLogged = true;
+          logBootPhase("Primer chequeo iniciado");
+        }
+      }
+      if (!requestedOnly) {
+        dispatchCursor = index + 1;
+      }
+    }
+  }
+}
+
+// Looks up, at most once per pass, the host of a site due within
+// DNS_PREFETCH_AHEAD_MS whose answer would have expired by then, so the check
+// starts from the cache instead of blocking on the resolver.
+void prefetchDns() {
+  const unsigned long now = millis();
+  if (sites.empty() || now - lastDnsPrefetchAt < kDnsPrefetchIntervalMs) {
+    return;
+  }
+  lastDnsPrefetchAt = now;
+  for (size_t visited = 0; visited < kDnsPrefetchScan && visited < sites.size(); ++visited) {
+    dnsPrefetchCursor = (dnsPrefetchCursor + 1) % sites.size();
+    const SiteRecord &record = sites[dnsPrefetchCursor];
+    if (record.config.paused || record.state.inFlight || !record.state.checkedSinceBoot) {
+      continue;
+    }
+    const unsigned long intervalMs = static_cast<unsigned long>(record.config.intervalSeconds) * 1000UL;
+    const unsigned long waited = now - record.state.lastCheckAt;
+    if (waited >= intervalMs || intervalMs - waited > DNS_PREFETCH_AHEAD_MS) {
+      continue;
+    }
+    const HttpUrl url = HttpUrl::parse(fetchUrlFor(record));
+    if (url.valid && dnsCache.needsRefresh(url.host.c_str(), now, DNS_PREFETCH_AHEAD_MS)) {
+      dnsCache.refresh(url.host.c_str(), now);
+      return;
+    }
+  }
+}
+
+// Until the next site comes due on its own; 0 when one is due already.
+uint32_t msUntilNextCheck(unsigned long now) {
+  uint32_t next = UINT32_MAX;
+  for (const SiteRecord &record : sites) {
+    if (record.state.inFlight || (record.config.paused && !record.state.checkRequested)) {
+      continue;
+    }
+    const unsigned long intervalMs = static_cast<unsigned long>(record.config.intervalSeconds) * 1000UL;
+    const unsigned long waited = now - record.state.lastCheckAt;
+    if (record.state.checkRequested || !record.state.checkedSinceBoot || waited >= intervalMs) {
+      return 0;
+    }
+    next = std::min<uint32_t>(next, intervalMs - waited);
+  }
+  return next;
+}
+
+// Everything a wake needs is on LittleFS (sites, spilled events) or in RTC
+// memory (schedule, WiFi, power stats), and the MQTT session is persistent,
+// so commands sent meanwhile wait at the broker. Does not return.
+void deepSleep(uint32_t durationMs) {
+  sleepPlanner.sleeping(millis(), SleepKind::Deep);
+  TRACE(Sleep, 0, static_cast<uint8_t>(SleepKind::Deep), sleepPlanner.stats().awakeMsLast, durationMs);
+  logLine("INFO", String("Sueño profundo de ") + durationMs + " ms tras " + sleepPlanner.stats().awakeMsLast +
+                      " ms despierto");
+  RtcSchedule::tick();
+  RtcSchedule::sleepFor(durationMs / 1000);
+  sleepPlanner.retain(durationMs);
+  esp_sleep_enable_timer_wakeup(static_cast<uint64_t>(durationMs) * 1000ULL);
+  esp_deep_sleep_start();
+}
+
+// With automatic light sleep configured, the CPU sleeps while this blocks and
+// the WiFi association is kept between DTIM beacons. MQTT traffic (a command)
+// ends it early; the plan already ends it before the keepalive is due.
+void lightSleep(uint32_t durationMs) {
+  sleepPlanner.sleeping(millis(), SleepKind::Light);
+  TRACE(Sleep, 0, static_cast<uint8_t>(SleepKind::Light), sleepPlanner.stats().awakeMsLast, durationMs);
+  if (mqttEngine.connected()) {
+    mqttEngine.poll(durationMs);
+  } else {
+    delay(durationMs);
+  }
+  sleepPlanner.woke(millis());
+}
+
+void sleepIfIdle() {
+  if (sleepPlanner.policy() == PowerPolicy::AlwaysOn || fetchEngine.inFlight() > 0 || !eventQueue.empty() ||
+      mqttEngine.pending() > 0 || storageManager.loading() || traceDumper.active() ||
+      historyReply.active()) {
+    return;
+  }
+  const unsigned long now = millis();
+  IdleState idle;
+  idle.nextCheckMs = msUntilNextCheck(now);
+  idle.nextReportMs = LOAD_REPORT_INTERVAL_MS - std::min<unsigned long>(now - lastLoadReportAt, LOAD_REPORT_INTERVAL_MS);
+  idle.mqttIdleMs = mqttEngine.idleMs();
+  // Sites beyond the RTC schedule would all come due on waking; the LOAD
+  // report of this wake goes out first.
+  idle.retainable =
+      sites.size() <= RTC_SCHEDULE_MAX_SITES && mqttEngine.connected() && loadReportedSinceConnect;
+  const SleepPlan plan = sleepPlanner.plan(idle);
+  if (plan.kind == SleepKind::Deep) {
+    deepSleep(plan.durationMs);
+  } else if (plan.kind == SleepKind::Light) {
+    lightSleep(plan.durationMs);
+  }
+}
+
+// Lets FreeRTOS light-sleep whenever loop() blocks; needs CONFIG_PM_ENABLE
+// and tickless idle in the Arduino core's sdkconfig.
+void configureLightSleep() {
+  esp_pm_config_esp32_t pm;
+  pm.max_freq_mhz = 240;
+  pm.min_freq_mhz = 80;
+  pm.light_sleep_enable = true;
+  if (esp_pm_configure(&pm) != ESP_OK) {
+    logLine("WARN", "Sueño ligero automático no disponible; el bucle solo esperará entre chequeos");
+  }
+  WiFi.setSleep(true);
 }
 
 void handleUpsert(JsonObject payload) {
@@ -179,8 +892,17 @@ void handleUpsert(JsonObject payload) {
   if (incoming.config.mode.isEmpty()) {
     incoming.config.mode = "selector";
   }
+  if (incoming.config.extractMode != ExtractMode::Unknown && !extractModeEnabled(incoming.config.extractMode)) {
+    logLine("WARN", String("Modo ") + incoming.config.mode + " no incluido en este firmware, sitio " +
+                        incoming.config.id + " ignorado");
+    return;
+  }
   SiteRecord *existing = findSite(incoming.config.id);
   if (existing) {
+    if (existing->config.url != incoming.config.url) {
+      existing->state.resolvedUrl = String();
+      existing->state.rangeRefused = false;
+    }
     existing->config = incoming.config;
   } else {
     sites.push_back(incoming);
@@ -189,15 +911,61 @@ void handleUpsert(JsonObject payload) {
   logLine("INFO", String("Sitio actualizado: ") + incoming.config.id);
 }
 
-void handleDelete(const String &id) {
-  auto it = std::remove_if(sites.begin(), sites.end(), [&](const SiteRecord &rec) { return rec.config.id == id; });
-  if (it != sites.end()) {
-    sites.erase(it, sites.end());
+// Drops the matching sites with their retained schedule, snapshot and
+// history; checks still in flight for them finish without a record and
+// publish nothing.
+template <typename Predicate>
+size_t forgetSites(Predicate matches) {
+  auto it = std::stable_partition(sites.begin(), sites.end(), [&](const SiteRecord &rec) { return !matches(rec); });
+  const size_t removed = sites.end() - it;
+  for (auto forgotten = it; forgotten != sites.end(); ++forgotten) {
+    RtcSchedule::forget(forgotten->config.id);
+    SnapshotStore::remove(forgotten->config.id);
+    HistoryLog::remove(forgotten->config.id);
+  }
+  sites.erase(it, sites.end());
+  if (removed > 0) {
     persistSites();
+  }
+  return removed;
+}
+
+void handleDelete(const String &id) {
+  if (forgetSites([&](const SiteRecord &rec) { return rec.config.id == id; }) > 0) {
     logLine("INFO", String("Sitio eliminado: ") + id);
   }
 }
 
+// Keeps only the sites the server assigned to this device. The ones it lost
+// are forgotten as with DELETE_SITE; new ones arrive as UPSERT_SITE, and the
+// LOAD report lists those still missing.
+void handleAssignShard(JsonObject payload) {
+  const String deviceId = payload["id"].as<String>();
+  if (deviceId != kDeviceId) {
+    logLine("WARN", String("ASSIGN_SHARD para otro dispositivo: ") + deviceId);
+    return;
+  }
+  const uint32_t epoch = payload["epoch"] | 0u;
+  std::vector<String> ids;
+  for (JsonVariant id : payload["sites"].as<JsonArray>()) {
+    ids.push_back(id.as<String>());
+  }
+  switch (shard.add(epoch, payload["part"] | 0, payload["parts"] | 1, ids)) {
+    case ShardAssignment::Result::Collecting:
+      return;
+    case ShardAssignment::Result::Rejected:
+      logLine("WARN", String("ASSIGN_SHARD época ") + epoch + " descartado (parte fuera de orden o época vieja)");
+      return;
+    case ShardAssignment::Result::Applied:
+      break;
+  }
+  const size_t released = forgetSites([](const SiteRecord &rec) { return !shard.owns(rec.config.id); });
+  logLine("INFO", String("Shard época ") + epoch + ": " + sites.size() + " sitios propios, " + released +
+                      " liberados, " + shard.missing(sites).size() + " pendientes de configuración");
+  // The server learns the new epoch from the next report; send it now.
+  lastLoadReportAt = millis() - LOAD_REPORT_INTERVAL_MS;
+}
+
 void handlePause(const String &id, bool paused) {
   SiteRecord *record = findSite(id);
   if (!record) {
@@ -215,10 +983,31 @@ void handleCheckNow(const String &id) {
     logLine("WARN", String("CHECK_NOW sin sitio: ") + id);
     return;
   }
-  performCheck(*record);
+  record->state.checkRequested = true;
+}
+
+// Streams the trace ring to devices/{id}/trace; a new request restarts the dump.
+void handleDumpTrace() {
+  traceDumper.begin(traceRing, ++traceDumps);
+  TRACE(TraceDump, 0, 0, traceRing.written() - traceRing.oldest(), traceDumps);
+  logLine("INFO", String("Volcando traza ") + traceDumps + " (" + (traceRing.written() - traceRing.oldest()) +
+                      " registros) a " + traceTopic);
+}
+
+// Sends up to `limit` checks of the site from seq `from` to
+// devices/{id}/history; a new request replaces the one going out.
+void handleHistory(JsonObject payload) {
+  const String id = payload["id"].as<String>();
+  if (!findSite(id)) {
+    logLine("WARN", String("HISTORY sin sitio: ") + id);
+    return;
+  }
+  historyReply.begin(id, ++historyRequests, payload["from"] | 0u, payload["limit"] | HISTORY_MAX_RECORDS);
+  logLine("INFO", String("Historial de ") + id + ": " + historyReply.records() + " registros a " + historyTopic);
 }
 
 void handleCommand(char *payload, unsigned int length) {
+  ALLOC_SCOPE("json_command");
   StaticJsonDocument<4096> doc;
   DeserializationError err = deserializeJson(doc, payload, length);
   if (err) {
@@ -242,8 +1031,10 @@ void handleCommand(char *payload, unsigned int length) {
     return;
   }
 
+  finishSiteLoading();
   const char *type = doc["type"] | "";
   JsonObject payloadObj = doc["payload"].as<JsonObject>();
+  TRACE(Command, traceSiteTag(payloadObj["id"] | ""), traceCommandFor(type), length, 0);
   if (strcmp(type, "UPSERT_SITE") == 0) {
     handleUpsert(payloadObj);
   } else if (strcmp(type, "DELETE_SITE") == 0) {
@@ -254,41 +1045,94 @@ void handleCommand(char *payload, unsigned int length) {
     handlePause(payloadObj["id"].as<String>(), false);
   } else if (strcmp(type, "CHECK_NOW") == 0) {
     handleCheckNow(payloadObj["id"].as<String>());
+  } else if (strcmp(type, "ASSIGN_SHARD") == 0) {
+    handleAssignShard(payloadObj);
+  } else if (strcmp(type, "DUMP_TRACE") == 0) {
+    handleDumpTrace();
+  } else if (strcmp(type, "HISTORY") == 0) {
+    handleHistory(payloadObj);
   } else {
     logLine("INFO", String("Comando desconocido: ") + type);
   }
 }
 
-bool ensureMqttConnected() {
-  if (mqttClient.connected()) {
-    return true;
+void onMqttConnected() {
+  TRACE(MqttConnected, 0, 0, eventQueue.depth(), 0);
+  loadReportedSinceConnect = false;
+  logLine("INFO", String("MQTT conectado, suscrito a ") + commandTopic);
+  if (!bootMqttLogged) {
+    bootMqttLogged = true;
+    logBootPhase("MQTT conectado");
+  }
+  lastLoadReportAt = millis() - LOAD_REPORT_INTERVAL_MS;
+  if (!eventQueue.empty()) {
+    const EventQueue::Stats &stats = eventQueue.stats();
+    logLine("INFO", String("Eventos pendientes: ") + eventQueue.depth() + " (" + eventQueue.spilledDepth() +
+                        " en LittleFS), descartados: " + stats.dropped + " (STATUS " + stats.droppedStatus +
+                        ", ERROR " + stats.droppedError + ", CHANGE " + stats.droppedChange + ")");
+  }
+}
+
+void onMqttDisconnected(const char *error) {
+  TRACE(MqttDisconnected, 0, 0, mqttEngine.pending(), 0);
+  logLine("ERROR", String("MQTT sin conexión: ") + error + " (" + mqttEngine.pending() + " eventos sin confirmar)");
+}
+
+void onMqttMessage(const char *topic, size_t topicLength, char *payload, size_t length) {
+  if (topicLength != static_cast<size_t>(commandTopic.length()) ||
+      strncmp(topic, commandTopic.c_str(), topicLength) != 0) {
+    return;
   }
-  unsigned long now = millis();
-  if (now - lastReconnectAttempt < 2000) {
+  handleCommand(payload, static_cast<unsigned int>(length));
+}
+
+// Joins the AP/channel of the last boot directly and reuses its DHCP lease as
+// a static config, which skips both the scan and DHCP. Any failure forgets
+// the cache and falls back to the normal join.
+bool connectWiFiFast() {
+  WifiCache cache;
+  if (!WifiCache::load(cache)) {
     return false;
   }
-  lastReconnectAttempt = now;
-  logLine("INFO", "Conectando a MQTT...");
-  if (mqttClient.connect(kDeviceId, nullptr, nullptr)) {
-    mqttClient.subscribe(commandTopic.c_str(), 1);
-    logLine("INFO", String("Suscrito a ") + commandTopic);
-    return true;
+  WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+  WiFi.begin(kWifiSsid, kWifiPass, cache.channel, cache.bssid);
+  const unsigned long start = millis();
+  while (WiFi.status() != WL_CONNECTED) {
+    if (millis() - start > WIFI_FAST_JOIN_TIMEOUT_MS) {
+      logLine("WARN", "Reconexión WiFi rápida fallida, se buscará la red");
+      WifiCache::clear();
+      WiFi.disconnect();
+      WiFi.config(IPAddress(), IPAddress(), IPAddress());
+      return false;
+    }
+    delay(10);
   }
-  logLine("ERROR", String("Fallo al conectar MQTT: ") + mqttClient.state());
-  return false;
+  return true;
 }
 
-void mqttCallback(char *topic, byte *payload, unsigned int length) {
-  if (String(topic) != commandTopic) {
+void rememberWiFi() {
+  WifiCache cache;
+  const uint8_t *bssid = WiFi.BSSID();
+  if (!bssid) {
     return;
   }
-  handleCommand(reinterpret_cast<char *>(payload), length);
+  memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+  cache.channel = WiFi.channel();
+  cache.ip = static_cast<uint32_t>(WiFi.localIP());
+  cache.gateway = static_cast<uint32_t>(WiFi.gatewayIP());
+  cache.subnet = static_cast<uint32_t>(WiFi.subnetMask());
+  cache.dns = static_cast<uint32_t>(WiFi.dnsIP());
+  WifiCache::store(cache);
 }
 
 void connectWiFi() {
   WiFi.mode(WIFI_STA);
-  WiFi.begin(kWifiSsid, kWifiPass);
   logLine("INFO", String("Conectando WiFi a ") + kWifiSsid);
+  if (connectWiFiFast()) {
+    logLine("INFO", String("WiFi conectado (canal/BSSID en caché), IP: ") + WiFi.localIP().toString());
+    return;
+  }
+  WiFi.begin(kWifiSsid, kWifiPass);
   unsigned long start = millis();
   while (WiFi.status() != WL_CONNECTED) {
     delay(500);
@@ -300,42 +1144,98 @@ void connectWiFi() {
   }
   Serial.println();
   logLine("INFO", String("WiFi conectado, IP: ") + WiFi.localIP().toString());
+  rememberWiFi();
 }
 
 void setupTopics() {
   const std::string suffix = security::deriveTopicSuffix(kDeviceId, kDeviceSecret);
   commandTopic = String("devices/") + kDeviceId + "-" + suffix.c_str() + "/commands";
   eventsTopic = String("devices/") + kDeviceId + "-" + suffix.c_str() + "/events";
+  loadTopic = String("devices/") + kDeviceId + "-" + suffix.c_str() + "/load";
+  traceTopic = String("devices/") + kDeviceId + "-" + suffix.c_str() + "/trace";
+  historyTopic = String("devices/") + kDeviceId + "-" + suffix.c_str() + "/history";
 }
 
 }  // namespace
 
 void setup() {
+  bootStartedAt = millis();
+  lastBootPhaseAt = bootStartedAt;
   Serial.begin(115200);
-  delay(200);
   logLine("INFO", "ESP32 Web Monitor — inicializando");
+  for (auto &slot : checkSlots) {
+    if (!slot.begin(CHECK_ARENA_BYTES / kCheckSlots)) {
+      logLine("WARN", "No se pudo reservar la arena de chequeo; se usará el heap");
+      break;
+    }
+  }
+  fetchEngine.begin(kCheckSlots, FETCH_SLOT_HEAP_BYTES);
+  dnsCache.begin();
+  fetchEngine.setDnsCache(&dnsCache);
+  fetchGovernor.begin(FetchGovernor::Options());
+  bandwidth.begin(FETCH_BANDWIDTH_BYTES_PER_S, FETCH_BANDWIDTH_BURST_BYTES, millis());
+  LoadMonitor::Options loadOptions;
+  loadOptions.minHeapBytes = GOVERNOR_RESERVE_BYTES;
+  loadMonitor.begin(kCheckSlots, loadOptions);
+  // LittleFS goes first: the WiFi cache is mirrored there.
+  const bool storageReady = storageManager.begin();
+  if (!storageReady) {
+    logLine("WARN", "No se pudo montar LittleFS");
+  }
+  const bool warmBoot = RtcSchedule::begin();
+  TRACE(Boot, 0, warmBoot, 0, ESP.getFreeHeap());
+  logBootPhase(warmBoot ? "Arranque en caliente, calendario RTC conservado" : "Arranque en frío");
+  if (sleepPlanner.begin(SleepPlanner::Options())) {
+    logLine("INFO", String("Despertar de sueño profundo (") + sleepPlanner.stats().deepSleeps + " en total)");
+  }
+  if (sleepPlanner.policy() != PowerPolicy::AlwaysOn) {
+    configureLightSleep();
+    logLine("INFO", String("Política de energía: ") + powerPolicyName(sleepPlanner.policy()));
+  }
 
   connectWiFi();
-  secureClient.setInsecure();  // TODO: cargar CA específica del broker
-  mqttClient.setServer(kMqttHost, kMqttPort);
-  mqttClient.setCallback(mqttCallback);
+  logBootPhase("WiFi conectado");
   setupTopics();
+  // TODO: cargar CA específica del broker (hoy sin verificar, como setInsecure()).
+  MqttOptions mqttOptions;
+  mqttOptions.host = kMqttHost;
+  mqttOptions.port = kMqttPort;
+  mqttOptions.clientId = kDeviceId;
+  mqttOptions.maxPacketBytes = kMqttBufferSize;
+  mqttOptions.cleanSession = sleepPlanner.policy() != PowerPolicy::DeepSleep;
+  mqttEngine.onConnect(onMqttConnected);
+  mqttEngine.onDisconnect(onMqttDisconnected);
+  mqttEngine.onMessage(onMqttMessage);
+  mqttEngine.subscribe(commandTopic, 1);
+  mqttEngine.begin(mqttOptions);
+  logLine("INFO", String("Conectando a MQTT en ") + kMqttHost + ":" + kMqttPort);
 
-  if (!storageManager.begin()) {
-    logLine("WARN", "No se pudo montar LittleFS");
-  } else {
-    if (!storageManager.loadSites(sites)) {
-      logLine("WARN", "No se pudieron cargar sitios previos");
-    } else {
-      logLine("INFO", String("Sitios cargados: ") + sites.size());
-    }
+  // The rest of /sites.json is read a few sites per loop() so the first
+  // check and the MQTT connect do not wait for the whole file.
+  if (storageReady && storageManager.beginLoad()) {
+    loadSiteBatch(SITE_LOAD_BATCH);
+  }
+  eventQueue.begin(EVENT_QUEUE_RAM_SLOTS, EVENT_QUEUE_MAX_EVENTS);
+  if (!eventQueue.empty()) {
+    logLine("INFO", String("Eventos recuperados de LittleFS: ") + eventQueue.depth());
   }
+  logBootPhase("setup() completo");
 }
 
 void loop() {
-  if (!mqttClient.connected()) {
-    ensureMqttConnected();
-  } else {
-    mqttClient.loop();
+  RtcSchedule::tick();
+  if (storageManager.loading()) {
+    loadSiteBatch(SITE_LOAD_BATCH);
   }
+  // Never waits: fetchEngine.poll() below is where the loop sleeps.
+  mqttEngine.poll(0);
+  drainEventQueue();
+  publishLoadReport();
+  sendTraceDump();
+  sendHistoryPart();
+  traceHeap();
+  prefetchDns();
+  dispatchDueChecks();
+  fetchEngine.poll(kFetchPollMs);
+  sleepIfIdle();
 }
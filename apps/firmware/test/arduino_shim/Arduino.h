@@ -1,7 +1,119 @@
 #pragma once
 
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
 #include "WString.h"
 
 using byte = unsigned char;
 
 #define F(x) x
+
+// No RTC domain on the host: retained variables are plain (zeroed) globals,
+// i.e. every run is a cold boot.
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+
+inline unsigned long millis() {
+  static const auto start = std::chrono::steady_clock::now();
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+inline unsigned long micros() {
+  static const auto start = std::chrono::steady_clock::now();
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+inline void yield() { std::this_thread::yield(); }
+
+class Print {
+ public:
+  virtual ~Print() = default;
+  virtual size_t write(uint8_t byte) = 0;
+  virtual size_t write(const uint8_t *data, size_t length) {
+    size_t written = 0;
+    while (written < length && write(data[written]) == 1) {
+      ++written;
+    }
+    return written;
+  }
+  virtual void flush() {}
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+class HardwareSerial {
+ public:
+  void begin(unsigned long) {}
+  void setMuted(bool muted) { muted_ = muted; }
+
+  int printf(const char *format, ...) {
+    if (muted_) {
+      return 0;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = std::vprintf(format, args);
+    va_end(args);
+    return written;
+  }
+
+  size_t print(char c) { return muted_ ? 0 : static_cast<size_t>(std::fputc(c, stdout) == EOF ? 0 : 1); }
+  size_t print(const char *text) { return muted_ ? 0 : std::fwrite(text, 1, std::strlen(text), stdout); }
+  size_t print(const String &text) { return print(text.c_str()); }
+  size_t println() { return print('\n'); }
+  size_t println(const char *text) { return print(text) + println(); }
+  size_t println(const String &text) { return print(text) + println(); }
+
+ private:
+  bool muted_ = false;
+};
+
+inline HardwareSerial Serial;
+
+// Heap figures come from glibc when available so native runs report something
+// comparable to ESP.getFreeHeap()/getMaxAllocHeap() on the device.
+class EspClass {
+ public:
+  uint32_t getHeapSize() const { return heapSize_; }
+
+  uint32_t getFreeHeap() const {
+    const size_t used = usedHeap();
+    return used >= heapSize_ ? 0 : static_cast<uint32_t>(heapSize_ - used);
+  }
+
+  uint32_t getMinFreeHeap() const { return getFreeHeap(); }
+  uint32_t getMaxAllocHeap() const { return getFreeHeap(); }
+  void setHeapSize(uint32_t bytes) { heapSize_ = bytes; }
+  void restart() {}
+
+  static size_t usedHeap() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+  }
+
+ private:
+  uint32_t heapSize_ = 320 * 1024;
+};
+
+inline EspClass ESP;
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#include <utility>
+#include <vector>
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+// Minimal HTTP/1.1 client with the subset of the ESP32 HTTPClient API the
+// firmware uses. Only http:// URLs are supported; the body stays on the socket
+// until getString() or getStreamPtr() consumes it.
+class HTTPClient {
+ public:
+  bool begin(WiFiClient &client, const String &url) {
+    end();
+    client_ = &client;
+    headers_.clear();
+    const String scheme = "http://";
+    if (!url.startsWith(scheme)) {
+      return false;
+    }
+    String rest = url.substring(scheme.length());
+    int slash = rest.indexOf('/');
+    String hostPort = slash < 0 ? rest : rest.substring(0, slash);
+    path_ = slash < 0 ? String("/") : rest.substring(slash);
+    int colon = hostPort.indexOf(':');
+    host_ = colon < 0 ? hostPort : hostPort.substring(0, colon);
+    port_ = colon < 0 ? 80 : static_cast<uint16_t>(hostPort.substring(colon + 1).toInt());
+    hostHeader_ = hostPort;
+    return !host_.isEmpty();
+  }
+
+  void setTimeout(uint16_t timeoutMs) { timeoutMs_ = timeoutMs; }
+  void setReuse(bool) {}
+
+  void addHeader(const String &name, const String &value) { headers_.emplace_back(name, value); }
+
+  int GET() {
+    if (!client_) {
+      return HTTPC_ERROR_NOT_CONNECTED;
+    }
+    client_->setTimeout(timeoutMs_);
+    if (!client_->connect(host_.c_str(), port_)) {
+      return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    String request = String("GET ") + path_ + " HTTP/1.1\r\nHost: " + hostHeader_ +
+                     "\r\nConnection: close\r\nUser-Agent: ESP32HTTPClient\r\n";
+    for (const auto &header : headers_) {
+      request += header.first + ": " + header.second + "\r\n";
+    }
+    request += "\r\n";
+    if (client_->print(request) != static_cast<size_t>(request.length())) {
+      return HTTPC_ERROR_SEND_HEADER_FAILED;
+    }
+    String statusLine = client_->readStringUntil('\n');
+    if (statusLine.isEmpty()) {
+      return HTTPC_ERROR_READ_TIMEOUT;
+    }
+    int space = statusLine.indexOf(' ');
+    if (!statusLine.startsWith("HTTP/") || space < 0) {
+      return HTTPC_ERROR_NO_HTTP_SERVER;
+    }
+    int code = static_cast<int>(statusLine.substring(space + 1).toInt());
+    size_ = -1;
+    while (true) {
+      String line = client_->readStringUntil('\n');
+      line.trim();
+      if (line.isEmpty()) {
+        break;
+      }
+      int colon = line.indexOf(':');
+      if (colon < 0) {
+        continue;
+      }
+      String name = line.substring(0, colon);
+      String value = line.substring(colon + 1);
+      value.trim();
+      if (name.equalsIgnoreCase("Content-Length")) {
+        size_ = static_cast<int>(value.toInt());
+      }
+    }
+    return code > 0 ? code : HTTPC_ERROR_NO_HTTP_SERVER;
+  }
+
+  int getSize() const { return size_; }
+  WiFiClient *getStreamPtr() { return client_; }
+
+  // Copies the body into stream in chunks; returns bytes written or an HTTPC_ERROR_*.
+  int writeToStream(Stream *stream) {
+    if (!client_ || !stream) {
+      return HTTPC_ERROR_NOT_CONNECTED;
+    }
+    uint8_t buffer[1024];
+    int total = 0;
+    while (size_ < 0 || total < size_) {
+      size_t want = sizeof(buffer);
+      if (size_ >= 0) {
+        want = std::min(want, static_cast<size_t>(size_ - total));
+      }
+      size_t n = client_->readBytes(reinterpret_cast<char *>(buffer), want);
+      if (n == 0) {
+        break;
+      }
+      if (stream->write(buffer, n) != n) {
+        return HTTPC_ERROR_STREAM_WRITE;
+      }
+      total += static_cast<int>(n);
+    }
+    if (size_ > 0 && total < size_) {
+      return HTTPC_ERROR_CONNECTION_LOST;
+    }
+    return total;
+  }
+
+  String getString() {
+    String body;
+    if (!client_) {
+      return body;
+    }
+    if (size_ > 0) {
+      body.reserve(static_cast<size_t>(size_));
+    }
+    char buffer[1024];
+    while (size_ < 0 || body.length() < size_) {
+      size_t want = sizeof(buffer);
+      if (size_ >= 0) {
+        want = std::min(want, static_cast<size_t>(size_ - body.length()));
+      }
+      size_t n = client_->readBytes(buffer, want);
+      if (n == 0) {
+        break;
+      }
+      body.append(buffer, n);
+    }
+    return body;
+  }
+
+  void end() {
+    if (client_) {
+      client_->stop();
+    }
+    size_ = -1;
+  }
+
+ private:
+  WiFiClient *client_ = nullptr;
+  String host_;
+  String hostHeader_;
+  String path_;
+  uint16_t port_ = 80;
+  uint16_t timeoutMs_ = 5000;
+  int size_ = -1;
+  std::vector<std::pair<String, String>> headers_;
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdlib>
+
+namespace fs {
+
+// File handle over a host file, mirroring the fs::File calls the firmware uses.
+class File {
+ public:
+  File() = default;
+  explicit File(FILE *handle) : handle_(handle) {}
+  File(File &&other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+  File &operator=(File &&other) noexcept {
+    if (this != &other) {
+      close();
+      handle_ = other.handle_;
+      other.handle_ = nullptr;
+    }
+    return *this;
+  }
+  File(const File &) = delete;
+  File &operator=(const File &) = delete;
+  ~File() { close(); }
+
+  explicit operator bool() const { return handle_ != nullptr; }
+
+  size_t write(const uint8_t *data, size_t length) { return handle_ ? std::fwrite(data, 1, length, handle_) : 0; }
+  size_t print(const String &text) { return write(reinterpret_cast<const uint8_t *>(text.c_str()), text.length()); }
+  size_t read(uint8_t *buffer, size_t length) { return handle_ ? std::fread(buffer, 1, length, handle_) : 0; }
+
+  int read() {
+    uint8_t c = 0;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+
+  String readString() {
+    String content;
+    char buffer[512];
+    size_t n = 0;
+    while ((n = read(reinterpret_cast<uint8_t *>(buffer), sizeof(buffer))) > 0) {
+      content.append(buffer, n);
+    }
+    return content;
+  }
+
+  bool seek(uint32_t position) { return handle_ && std::fseek(handle_, static_cast<long>(position), SEEK_SET) == 0; }
+  size_t position() const { return handle_ ? static_cast<size_t>(std::ftell(handle_)) : 0; }
+
+  size_t size() const {
+    if (!handle_) {
+      return 0;
+    }
+    long current = std::ftell(handle_);
+    std::fseek(handle_, 0, SEEK_END);
+    long total = std::ftell(handle_);
+    std::fseek(handle_, current, SEEK_SET);
+    return static_cast<size_t>(total);
+  }
+
+  int available() { return static_cast<int>(size() - position()); }
+
+  void flush() {
+    if (handle_) {
+      std::fflush(handle_);
+    }
+  }
+
+  void close() {
+    if (handle_) {
+      std::fclose(handle_);
+      handle_ = nullptr;
+    }
+  }
+
+ private:
+  FILE *handle_ = nullptr;
+};
+
+// Directory-backed stand-in for LittleFS. The root comes from LITTLEFS_ROOT
+// (default ".pio/littlefs") so simulations can start from a clean tree.
+class FS {
+ public:
+  bool begin(bool formatOnFail = false) {
+    (void)formatOnFail;
+    const char *env = std::getenv("LITTLEFS_ROOT");
+    root_ = env && *env ? String(env) : String(".pio/littlefs");
+    return makeDirs(root_);
+  }
+
+  File open(const String &path, const char *mode = "r") {
+    const String full = resolve(path);
+    if (mode[0] != 'r') {
+      int slash = full.lastIndexOf('/');
+      if (slash > 0) {
+        makeDirs(full.substring(0, slash));
+      }
+    }
+    const char *hostMode = mode[0] == 'r' ? "rb" : (mode[0] == 'a' ? "ab" : "wb");
+    if (mode[0] == 'r' && mode[1] == '+') {
+      hostMode = "r+b";
+    }
+    return File(std::fopen(full.c_str(), hostMode));
+  }
+
+  bool exists(const String &path) {
+    struct stat info {};
+    return ::stat(resolve(path).c_str(), &info) == 0;
+  }
+
+  bool remove(const String &path) { return std::remove(resolve(path).c_str()) == 0; }
+  bool rename(const String &from, const String &to) {
+    return std::rename(resolve(from).c_str(), resolve(to).c_str()) == 0;
+  }
+  bool mkdir(const String &path) { return makeDirs(resolve(path)); }
+
+ private:
+  String resolve(const String &path) const { return path.startsWith("/") ? root_ + path : root_ + "/" + path; }
+
+  static bool makeDirs(const String &path) {
+    for (int i = 1; i <= path.length(); ++i) {
+      if (i == path.length() || path[i] == '/') {
+        const String partial = path.substring(0, i);
+        if (::mkdir(partial.c_str(), 0755) != 0 && errno != EEXIST) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  String root_ = ".pio/littlefs";
+};
+
+}  // namespace fs
+
+using fs::File;
+
+inline fs::FS LittleFS;
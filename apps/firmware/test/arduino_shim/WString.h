@@ -4,10 +4,20 @@
 #include <cctype>
 #include <cstdlib>
 #include <string>
+#include <type_traits>
 
 class String : public std::string {
  public:
   using std::string::string;
+  using std::string::replace;
+
+  String() = default;
+  String(const std::string &other) : std::string(other) {}
+  explicit String(char c) : std::string(1, c) {}
+
+  template <typename T, typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, char>::value,
+                                                int>::type = 0>
+  explicit String(T value) : std::string(std::to_string(value)) {}
 
   int length() const { return static_cast<int>(size()); }
   bool isEmpty() const { return empty(); }
@@ -40,6 +50,11 @@ class String : public std::string {
     return pos == npos ? -1 : static_cast<int>(pos);
   }
 
+  int lastIndexOf(char c) const {
+    auto pos = rfind(c);
+    return pos == npos ? -1 : static_cast<int>(pos);
+  }
+
   String substring(int from) const {
     if (from < 0) {
       from = 0;
@@ -74,6 +89,8 @@ class String : public std::string {
     return compare(length() - suffix.length(), suffix.length(), suffix) == 0;
   }
 
+  void remove(int index) { remove(index, length() - index); }
+
   void remove(int index, int count) {
     if (index < 0) {
       index = 0;
@@ -106,6 +123,34 @@ class String : public std::string {
 
   long toInt() const { return std::strtol(c_str(), nullptr, 10); }
 
+  bool concat(const char *other) {
+    append(other);
+    return true;
+  }
+
+  bool concat(char c) {
+    push_back(c);
+    return true;
+  }
+
+  bool concat(const char *other, unsigned int length) {
+    append(other, length);
+    return true;
+  }
+
+  void replace(char find, char with) { std::replace(begin(), end(), find, with); }
+
+  void replace(const String &find, const String &with) {
+    if (find.empty()) {
+      return;
+    }
+    size_t pos = 0;
+    while ((pos = std::string::find(find, pos)) != npos) {
+      std::string::replace(pos, find.size(), with);
+      pos += with.size();
+    }
+  }
+
   String &operator+=(char c) {
     push_back(c);
     return *this;
@@ -134,3 +179,20 @@ inline String operator+(const char *lhs, const String &rhs) {
   result += rhs;
   return result;
 }
+
+inline String operator+(const String &lhs, char rhs) {
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+template <typename T, typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, char>::value,
+                                              int>::type = 0>
+inline String operator+(const String &lhs, T rhs) {
+  return lhs + String(rhs);
+}
+
+class StringSumHelper : public String {
+ public:
+  using String::String;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+enum wifi_mode_t { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 };
+
+enum wl_status_t { WL_IDLE_STATUS = 0, WL_NO_SSID_AVAIL = 1, WL_CONNECTED = 3, WL_DISCONNECTED = 6 };
+
+class IPAddress {
+ public:
+  IPAddress() = default;
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : octets_{a, b, c, d} {}
+  IPAddress(uint32_t address) { std::memcpy(octets_, &address, sizeof(octets_)); }
+
+  operator uint32_t() const {
+    uint32_t address = 0;
+    std::memcpy(&address, octets_, sizeof(address));
+    return address;
+  }
+
+  String toString() const {
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", octets_[0], octets_[1], octets_[2], octets_[3]);
+    return String(buffer);
+  }
+
+ private:
+  uint8_t octets_[4] = {0, 0, 0, 0};
+};
+
+// Joins "complete" after rough ESP32 timings so boot paths can be compared:
+// a full scan is far slower than joining a known BSSID/channel, and DHCP adds
+// its own round trips unless a static configuration was applied.
+class WiFiClass {
+ public:
+  static constexpr unsigned long kScanJoinMs = 2000;
+  static constexpr unsigned long kDirectJoinMs = 200;
+  static constexpr unsigned long kDhcpMs = 500;
+
+  bool mode(wifi_mode_t mode) {
+    mode_ = mode;
+    return true;
+  }
+
+  bool config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1 = IPAddress()) {
+    (void)gateway;
+    (void)subnet;
+    (void)dns1;
+    staticIp_ = static_cast<uint32_t>(local) != 0;
+    return true;
+  }
+
+  wl_status_t begin(const char *, const char *, int32_t channel = 0, const uint8_t *bssid = nullptr,
+                    bool = true) {
+    const unsigned long join = channel > 0 && bssid ? kDirectJoinMs : kScanJoinMs;
+    connectAt_ = millis() + join + (staticIp_ ? 0 : kDhcpMs);
+    status_ = WL_DISCONNECTED;
+    return status_;
+  }
+
+  bool disconnect(bool = false) {
+    status_ = WL_DISCONNECTED;
+    connectAt_ = 0;
+    return true;
+  }
+
+  wl_status_t status() {
+    if (status_ != WL_CONNECTED && connectAt_ != 0 && millis() >= connectAt_) {
+      status_ = WL_CONNECTED;
+    }
+    return status_;
+  }
+
+  IPAddress localIP() const { return IPAddress(127, 0, 0, 1); }
+  IPAddress gatewayIP() const { return IPAddress(127, 0, 0, 1); }
+  IPAddress subnetMask() const { return IPAddress(255, 0, 0, 0); }
+  IPAddress dnsIP(uint8_t = 0) const { return IPAddress(127, 0, 0, 1); }
+  int32_t channel() const { return 6; }
+  uint8_t *BSSID() {
+    static uint8_t bssid[6] = {0x24, 0x0A, 0xC4, 0x00, 0x51, 0x4D};
+    return bssid;
+  }
+  int32_t RSSI() const { return -40; }
+  bool setSleep(bool enabled) {
+    modemSleep_ = enabled;
+    return true;
+  }
+
+ private:
+  wifi_mode_t mode_ = WIFI_OFF;
+  wl_status_t status_ = WL_DISCONNECTED;
+  unsigned long connectAt_ = 0;
+  bool staticIp_ = false;
+  bool modemSleep_ = true;
+};
+
+inline WiFiClass WiFi;
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+// Plain TCP client over POSIX sockets. TLS is not emulated: native runs talk to
+// loopback fixture servers, so WiFiClientSecure is the same thing.
+class WiFiClient {
+ public:
+  WiFiClient() = default;
+  WiFiClient(const WiFiClient &) = delete;
+  WiFiClient &operator=(const WiFiClient &) = delete;
+  virtual ~WiFiClient() { stop(); }
+
+  int connect(const char *host, uint16_t port) {
+    stop();
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *result = nullptr;
+    char portText[8];
+    std::snprintf(portText, sizeof(portText), "%u", port);
+    if (getaddrinfo(host, portText, &hints, &result) != 0 || !result) {
+      return 0;
+    }
+    int fd = ::socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (fd < 0) {
+      freeaddrinfo(result);
+      return 0;
+    }
+    if (::connect(fd, result->ai_addr, result->ai_addrlen) != 0) {
+      ::close(fd);
+      freeaddrinfo(result);
+      return 0;
+    }
+    freeaddrinfo(result);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fd_ = fd;
+    return 1;
+  }
+
+  size_t write(const uint8_t *data, size_t length) {
+    size_t sent = 0;
+    while (fd_ >= 0 && sent < length) {
+      ssize_t n = ::send(fd_, data + sent, length - sent, MSG_NOSIGNAL);
+      if (n <= 0) {
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        break;
+      }
+      sent += static_cast<size_t>(n);
+    }
+    return sent;
+  }
+
+  size_t print(const String &text) { return write(reinterpret_cast<const uint8_t *>(text.c_str()), text.length()); }
+
+  int available() {
+    if (fd_ < 0) {
+      return 0;
+    }
+    int pending = 0;
+    if (ioctl(fd_, FIONREAD, &pending) != 0) {
+      return 0;
+    }
+    return pending;
+  }
+
+  int read(uint8_t *buffer, size_t length) {
+    if (fd_ < 0) {
+      return -1;
+    }
+    ssize_t n = ::recv(fd_, buffer, length, MSG_DONTWAIT);
+    if (n == 0) {
+      eof_ = true;
+      return -1;
+    }
+    return n < 0 ? -1 : static_cast<int>(n);
+  }
+
+  int read() {
+    uint8_t c = 0;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+
+  // Blocks up to the configured timeout, like Stream::readBytes.
+  size_t readBytes(char *buffer, size_t length) {
+    size_t received = 0;
+    while (received < length && waitReadable()) {
+      int n = read(reinterpret_cast<uint8_t *>(buffer) + received, length - received);
+      if (n <= 0) {
+        break;
+      }
+      received += static_cast<size_t>(n);
+    }
+    return received;
+  }
+
+  String readStringUntil(char terminator) {
+    String line;
+    char c = 0;
+    while (readBytes(&c, 1) == 1 && c != terminator) {
+      line += c;
+    }
+    return line;
+  }
+
+  uint8_t connected() {
+    if (fd_ < 0 || eof_) {
+      return 0;
+    }
+    char probe = 0;
+    ssize_t n = ::recv(fd_, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0) {
+      eof_ = true;
+      return 0;
+    }
+    return n > 0 || errno == EAGAIN || errno == EWOULDBLOCK ? 1 : 0;
+  }
+
+  virtual void stop() {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+    fd_ = -1;
+    eof_ = false;
+  }
+
+  void setTimeout(unsigned long timeoutMs) { timeoutMs_ = timeoutMs; }
+  int fd() const { return fd_; }
+
+ private:
+  bool waitReadable() {
+    if (fd_ < 0 || eof_) {
+      return false;
+    }
+    pollfd pfd{fd_, POLLIN, 0};
+    return ::poll(&pfd, 1, static_cast<int>(timeoutMs_)) > 0;
+  }
+
+  int fd_ = -1;
+  bool eof_ = false;
+  unsigned long timeoutMs_ = 8000;
+};
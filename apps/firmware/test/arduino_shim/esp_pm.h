@@ -0,0 +1,12 @@
+#pragma once
+
+#include <esp_sleep.h>
+
+typedef struct {
+  int max_freq_mhz;
+  int min_freq_mhz;
+  bool light_sleep_enable;
+} esp_pm_config_esp32_t;
+
+// The host has no power management; callers keep running at full speed.
+inline esp_err_t esp_pm_configure(const void *) { return ESP_ERR_NOT_SUPPORTED; }
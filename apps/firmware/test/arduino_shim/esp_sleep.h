@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+typedef int esp_err_t;
+
+#ifndef ESP_OK
+#define ESP_OK 0
+#endif
+
+#ifndef ESP_ERR_NOT_SUPPORTED
+#define ESP_ERR_NOT_SUPPORTED 0x106
+#endif
+
+inline esp_err_t esp_sleep_enable_timer_wakeup(uint64_t) { return ESP_OK; }
+
+// No RTC domain on the host to come back with (see RTC_NOINIT_ATTR), so a
+// deep sleep ends the run.
+[[noreturn]] inline void esp_deep_sleep_start() {
+  std::printf("[SHIM] esp_deep_sleep_start(): fin de la ejecución\n");
+  std::exit(0);
+}
@@ -0,0 +1,68 @@
+#include <AllocProfile.h>
+#include <unity.h>
+
+#include <cstring>
+#include <string>
+
+void test_scopes_nest_and_restore_the_outer_tag() {
+  const uint8_t outer = allocprofile::intern("test_outer");
+  const uint8_t inner = allocprofile::intern("test_inner");
+  TEST_ASSERT_EQUAL(outer, allocprofile::intern("test_outer"));
+  TEST_ASSERT_TRUE(outer != inner);
+  TEST_ASSERT_EQUAL(0, allocprofile::currentTag());
+  {
+    allocprofile::Scope first(outer);
+    TEST_ASSERT_EQUAL(outer, allocprofile::currentTag());
+    {
+      allocprofile::Scope second(inner);
+      TEST_ASSERT_EQUAL(inner, allocprofile::currentTag());
+    }
+    TEST_ASSERT_EQUAL(outer, allocprofile::currentTag());
+  }
+  TEST_ASSERT_EQUAL(0, allocprofile::currentTag());
+}
+
+void test_live_bytes_peak_and_size_classes() {
+  allocprofile::reset();
+  const uint8_t tag = allocprofile::intern("test_peak");
+  allocprofile::recordAlloc(tag, 10);
+  allocprofile::recordAlloc(tag, 100);
+  allocprofile::recordFree(tag, 100);
+  allocprofile::recordAlloc(tag, 70000);
+  allocprofile::recordFree(tag, 70000);
+  allocprofile::recordAlloc(tag, 50);
+
+  const allocprofile::TagStats stats = allocprofile::snapshot(tag);
+  TEST_ASSERT_EQUAL_STRING("test_peak", stats.name);
+  TEST_ASSERT_EQUAL_UINT32(4, static_cast<uint32_t>(stats.allocations));
+  TEST_ASSERT_EQUAL_UINT32(2, static_cast<uint32_t>(stats.frees));
+  TEST_ASSERT_EQUAL_UINT32(70160, static_cast<uint32_t>(stats.bytes));
+  TEST_ASSERT_EQUAL_INT(60, static_cast<int>(stats.liveBytes));
+  TEST_ASSERT_EQUAL_INT(70010, static_cast<int>(stats.peakLiveBytes));
+  TEST_ASSERT_EQUAL_UINT32(1, static_cast<uint32_t>(stats.sizeClasses[0]));
+  TEST_ASSERT_EQUAL_UINT32(1, static_cast<uint32_t>(stats.sizeClasses[allocprofile::sizeClassOf(64)]));
+  TEST_ASSERT_EQUAL_UINT32(1, static_cast<uint32_t>(stats.sizeClasses[allocprofile::sizeClassOf(128)]));
+  TEST_ASSERT_EQUAL_UINT32(1, static_cast<uint32_t>(stats.sizeClasses[allocprofile::kSizeClasses - 1]));
+  TEST_ASSERT_EQUAL(0, allocprofile::sizeClassOf(16));
+  TEST_ASSERT_EQUAL(1, allocprofile::sizeClassOf(17));
+  TEST_ASSERT_EQUAL(allocprofile::kSizeClasses - 2, allocprofile::sizeClassOf(65536));
+}
+
+void test_json_lists_only_tags_with_traffic() {
+  allocprofile::reset();
+  allocprofile::intern("test_quiet");
+  allocprofile::recordAlloc(allocprofile::intern("test_json"), 2000);
+  const std::string json = allocprofile::toJson();
+  TEST_ASSERT_NOT_NULL(std::strstr(json.c_str(), "\"test_json\":{\"allocations\":1,\"frees\":0,\"bytes\":2000"));
+  TEST_ASSERT_NOT_NULL(std::strstr(json.c_str(), "\"<=2048\":1"));
+  TEST_ASSERT_NULL(std::strstr(json.c_str(), "test_quiet"));
+  TEST_ASSERT_NOT_NULL(std::strstr(json.c_str(), "\"total\":{"));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_scopes_nest_and_restore_the_outer_tag);
+  RUN_TEST(test_live_bytes_peak_and_size_classes);
+  RUN_TEST(test_json_lists_only_tags_with_traffic);
+  return UNITY_END();
+}
@@ -0,0 +1,116 @@
+#include <Arduino.h>
+#include <CheckArena.h>
+#include <unity.h>
+
+#include <random>
+#include <vector>
+
+namespace {
+constexpr size_t kArenaBytes = 48 * 1024;
+
+void fillBody(ArenaBuffer &body, size_t bytes) {
+  char chunk[512];
+  memset(chunk, 'x', sizeof(chunk));
+  size_t written = 0;
+  while (written < bytes) {
+    const size_t n = std::min(sizeof(chunk), bytes - written);
+    TEST_ASSERT_TRUE(body.append(chunk, n));
+    written += n;
+  }
+}
+}  // namespace
+
+void test_scope_rewinds_arena() {
+  CheckArena arena;
+  TEST_ASSERT_TRUE(arena.begin(kArenaBytes));
+  {
+    CheckArena::Scope scope(arena);
+    TEST_ASSERT_TRUE(CheckArena::active() == &arena);
+    ArenaBuffer body;
+    fillBody(body, 4000);
+    TEST_ASSERT_TRUE(arena.owns(body.data()));
+    TEST_ASSERT_GREATER_OR_EQUAL(4000, arena.used());
+  }
+  TEST_ASSERT_NULL(CheckArena::active());
+  TEST_ASSERT_EQUAL(0, arena.used());
+  TEST_ASSERT_EQUAL(1, arena.stats().checks);
+  TEST_ASSERT_EQUAL(0, arena.stats().overflowChecks);
+}
+
+void test_buffer_grows_in_place() {
+  CheckArena arena;
+  TEST_ASSERT_TRUE(arena.begin(kArenaBytes));
+  CheckArena::Scope scope(arena);
+  ArenaBuffer body;
+  TEST_ASSERT_TRUE(body.reserve(1024));
+  const char *first = body.data();
+  fillBody(body, 20000);
+  TEST_ASSERT_TRUE(first == body.data());
+  TEST_ASSERT_EQUAL(20000, body.size());
+}
+
+void test_overflow_falls_back_to_heap() {
+  CheckArena arena;
+  TEST_ASSERT_TRUE(arena.begin(kArenaBytes));
+  {
+    CheckArena::Scope scope(arena);
+    ArenaBuffer body;
+    fillBody(body, kArenaBytes + 1000);
+    TEST_ASSERT_FALSE(arena.owns(body.data()));
+    TEST_ASSERT_EQUAL(kArenaBytes + 1000, body.size());
+    std::vector<int, ArenaAllocator<int>> values(16, 7);
+    TEST_ASSERT_TRUE(arena.owns(values.data()));
+  }
+  TEST_ASSERT_EQUAL(1, arena.stats().overflowChecks);
+  TEST_ASSERT_GREATER_THAN(0, arena.stats().fallbackAllocations);
+  TEST_ASSERT_EQUAL(0, arena.outstandingFallbacks());
+}
+
+// 100k simulated checks with mixed page sizes: oversized pages must only cost
+// counted fallbacks, and the heap's largest free block must not shrink along the
+// way (ESP.getMaxAllocHeap(), the figure heap_caps_get_largest_free_block gives
+// on the device).
+void test_soak_largest_free_block_is_stable() {
+  CheckArena arena;
+  TEST_ASSERT_TRUE(arena.begin(kArenaBytes));
+  std::mt19937 rng(20240611);
+  const size_t heapBefore = EspClass::usedHeap();
+  const uint32_t largestBefore = ESP.getMaxAllocHeap();
+  TEST_ASSERT_GREATER_THAN(0, largestBefore);
+  uint32_t oversized = 0;
+  uint32_t minLargestFree = largestBefore;
+  size_t maxOutstanding = 0;
+  for (uint32_t i = 0; i < 100000; ++i) {
+    const bool big = i % 97 == 0;
+    const size_t bodySize = big ? 64 * 1024 + rng() % 8192 : 256 + rng() % (32 * 1024);
+    oversized += big ? 1 : 0;
+    {
+      CheckArena::Scope scope(arena);
+      ArenaBuffer body;
+      fillBody(body, bodySize);
+      std::vector<uint32_t, ArenaAllocator<uint32_t>> counters;
+      for (uint32_t k = 0; k < 48; ++k) {
+        counters.push_back(k);
+      }
+    }
+    minLargestFree = std::min(minLargestFree, ESP.getMaxAllocHeap());
+    maxOutstanding = std::max(maxOutstanding, arena.outstandingFallbacks());
+  }
+  const size_t heapAfter = EspClass::usedHeap();
+  TEST_ASSERT_GREATER_OR_EQUAL(largestBefore - 4096, minLargestFree);
+  TEST_ASSERT_GREATER_OR_EQUAL(largestBefore - 4096, ESP.getMaxAllocHeap());
+  TEST_ASSERT_EQUAL(0, maxOutstanding);
+  TEST_ASSERT_EQUAL(100000, arena.stats().checks);
+  TEST_ASSERT_EQUAL(oversized, arena.stats().overflowChecks);
+  TEST_ASSERT_LESS_OR_EQUAL(kArenaBytes, arena.stats().highWater);
+  TEST_ASSERT_LESS_OR_EQUAL(heapBefore + 4096, heapAfter);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_scope_rewinds_arena);
+  RUN_TEST(test_buffer_grows_in_place);
+  RUN_TEST(test_overflow_falls_back_to_heap);
+  RUN_TEST(test_soak_largest_free_block_is_stable);
+  return UNITY_END();
+}
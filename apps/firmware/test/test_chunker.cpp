@@ -0,0 +1,81 @@
+#include <Arduino.h>
+#include <ContentChunker.h>
+#include <unity.h>
+
+#include <string>
+
+namespace {
+// Deterministic filler text with no repeats that could make chunks collide.
+std::string page(size_t paragraphs) {
+  std::string text;
+  uint32_t seed = 12345;
+  for (size_t p = 0; p < paragraphs; ++p) {
+    text += "Párrafo " + std::to_string(p) + ": ";
+    for (int w = 0; w < 40; ++w) {
+      seed = seed * 1103515245u + 12345u;
+      text += "palabra" + std::to_string(seed % 9973) + " ";
+    }
+  }
+  return text;
+}
+
+ContentChunker chunk(const std::string &text, const std::vector<uint32_t> &previous, size_t step = 1460) {
+  ContentChunker chunker;
+  chunker.begin(previous);
+  for (size_t offset = 0; offset < text.size(); offset += step) {
+    chunker.update(text.data() + offset, std::min(step, text.size() - offset));
+  }
+  chunker.finish();
+  return chunker;
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_boundaries_do_not_depend_on_input_splits() {
+  const std::string text = page(60);
+  const ContentChunker whole = chunk(text, {}, text.size());
+  TEST_ASSERT_GREATER_THAN(4, whole.digests().size());
+  TEST_ASSERT_LESS_OR_EQUAL(CDC_MAX_CHUNKS, whole.digests().size());
+  for (size_t step : {size_t{1}, size_t{7}, size_t{1460}}) {
+    TEST_ASSERT_TRUE(whole.digests() == chunk(text, {}, step).digests());
+  }
+  TEST_ASSERT_EQUAL(0, whole.addedChunks());
+  TEST_ASSERT_TRUE(whole.excerpt().isEmpty());
+}
+
+void test_edit_is_localized_to_the_chunks_it_touches() {
+  const std::string before = page(60);
+  std::string after = before;
+  const size_t at = after.find("Párrafo 30:");
+  after.insert(at, "OFERTA NUEVA ");
+  const ContentChunker first = chunk(before, {});
+  const ContentChunker second = chunk(after, first.digests());
+  TEST_ASSERT_GREATER_THAN(0, second.addedChunks());
+  TEST_ASSERT_LESS_OR_EQUAL(2, second.addedChunks());
+  TEST_ASSERT_LESS_OR_EQUAL(2, second.removedChunks());
+  // The excerpt comes from the edited region, not from the top of the page.
+  TEST_ASSERT_TRUE(second.excerpt().indexOf("Párrafo 0:") < 0);
+  TEST_ASSERT_LESS_OR_EQUAL(ContentChunker::kExcerptBytes + 5, second.excerpt().length());
+}
+
+void test_hex_round_trip() {
+  std::vector<uint32_t> parsed;
+  const std::vector<uint32_t> digests = {0x0, 0xdeadbeef, 0x12345678};
+  TEST_ASSERT_EQUAL_STRING("00000000deadbeef12345678", ContentChunker::toHex(digests).c_str());
+  TEST_ASSERT_TRUE(ContentChunker::fromHex(ContentChunker::toHex(digests), parsed));
+  TEST_ASSERT_TRUE(parsed == digests);
+  TEST_ASSERT_TRUE(ContentChunker::fromHex("", parsed));
+  TEST_ASSERT_TRUE(parsed.empty());
+  TEST_ASSERT_FALSE(ContentChunker::fromHex("null", parsed));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_boundaries_do_not_depend_on_input_splits);
+  RUN_TEST(test_edit_is_localized_to_the_chunks_it_touches);
+  RUN_TEST(test_hex_round_trip);
+  return UNITY_END();
+}
@@ -0,0 +1,107 @@
+#include <Arduino.h>
+#include <DnsCache.h>
+#include <unity.h>
+
+#include <cstring>
+
+namespace {
+bool resolverUp = true;
+int lookups = 0;
+
+// "a.test" -> 1, "b.test" -> 2, ...; fails while resolverUp is false.
+bool fakeResolver(const char *host, uint32_t &address) {
+  ++lookups;
+  if (!resolverUp) {
+    return false;
+  }
+  address = static_cast<uint32_t>(host[0] - 'a' + 1);
+  return true;
+}
+
+void beginCache(DnsCache &cache, size_t capacity = 4) {
+  resolverUp = true;
+  lookups = 0;
+  cache.begin(capacity, 1000, 5000, fakeResolver);
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_answers_are_served_until_the_ttl() {
+  DnsCache cache;
+  beginCache(cache);
+  uint32_t address = 0;
+  bool cached = true;
+  TEST_ASSERT_TRUE(cache.resolve("b.test", 100, address, cached));
+  TEST_ASSERT_FALSE(cached);
+  TEST_ASSERT_EQUAL_UINT32(2, address);
+  TEST_ASSERT_TRUE(cache.resolve("b.test", 1099, address, cached));
+  TEST_ASSERT_TRUE(cached);
+  TEST_ASSERT_EQUAL(1, lookups);
+  TEST_ASSERT_TRUE(cache.resolve("b.test", 1100, address, cached));
+  TEST_ASSERT_FALSE(cached);
+  TEST_ASSERT_EQUAL(2, lookups);
+
+  const DnsStats &stats = cache.stats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats.hits);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.misses);
+  TEST_ASSERT_EQUAL_UINT32(33, stats.hitPct());
+  TEST_ASSERT_EQUAL_UINT32(2, stats.lookups);
+}
+
+void test_stale_answers_cover_resolver_failures() {
+  DnsCache cache;
+  beginCache(cache);
+  uint32_t address = 0;
+  bool cached = false;
+  TEST_ASSERT_TRUE(cache.resolve("c.test", 0, address, cached));
+  resolverUp = false;
+  // Expired, lookup fails, still within ttl + stale.
+  address = 0;
+  TEST_ASSERT_TRUE(cache.resolve("c.test", 5999, address, cached));
+  TEST_ASSERT_FALSE(cached);
+  TEST_ASSERT_EQUAL_UINT32(3, address);
+  TEST_ASSERT_FALSE(cache.resolve("c.test", 6000, address, cached));
+  TEST_ASSERT_FALSE(cache.resolve("d.test", 6000, address, cached));
+  TEST_ASSERT_EQUAL_UINT32(1, cache.stats().stale);
+  TEST_ASSERT_EQUAL_UINT32(3, cache.stats().failures);
+
+  // A failed lookup keeps the old answer; a good one replaces its age.
+  resolverUp = true;
+  TEST_ASSERT_TRUE(cache.refresh("c.test", 7000));
+  TEST_ASSERT_TRUE(cache.resolve("c.test", 7500, address, cached));
+  TEST_ASSERT_TRUE(cached);
+}
+
+void test_prefetch_window_and_eviction() {
+  DnsCache cache;
+  beginCache(cache, 2);
+  uint32_t address = 0;
+  bool cached = false;
+  TEST_ASSERT_TRUE(cache.needsRefresh("a.test", 0, 200));
+  TEST_ASSERT_TRUE(cache.refresh("a.test", 0));
+  TEST_ASSERT_FALSE(cache.needsRefresh("a.test", 799, 200));
+  TEST_ASSERT_TRUE(cache.needsRefresh("a.test", 800, 200));
+  cache.storeLookup("b.test", true, 22, 40, 10);
+  TEST_ASSERT_EQUAL_UINT32(2, cache.stats().prefetches);
+  TEST_ASSERT_EQUAL_UINT32(40, cache.stats().lookupMsMax);
+  TEST_ASSERT_TRUE(cache.resolve("b.test", 20, address, cached));
+  TEST_ASSERT_TRUE(cached);
+  TEST_ASSERT_EQUAL_UINT32(22, address);
+
+  // Full: the least recently used host (a.test) makes room.
+  TEST_ASSERT_TRUE(cache.resolve("e.test", 30, address, cached));
+  TEST_ASSERT_EQUAL(2, cache.size());
+  TEST_ASSERT_TRUE(cache.needsRefresh("a.test", 30, 0));
+  TEST_ASSERT_FALSE(cache.needsRefresh("b.test", 30, 0));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_answers_are_served_until_the_ttl);
+  RUN_TEST(test_stale_answers_cover_resolver_failures);
+  RUN_TEST(test_prefetch_window_and_eviction);
+  return UNITY_END();
+}
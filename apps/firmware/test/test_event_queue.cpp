@@ -0,0 +1,121 @@
+#include <Arduino.h>
+#include <EventQueue.h>
+#include <LittleFS.h>
+#include <unity.h>
+
+#include <cstdlib>
+#include <vector>
+
+namespace {
+const char *kSpillPath = "/events-test.q";
+
+String eventJson(const char *type, int n) { return String("{\"type\":\"") + type + "\",\"n\":" + n + "}"; }
+
+std::vector<String> drainAll(EventQueue &queue) {
+  std::vector<String> out;
+  queue.drain(
+      [&](const String &message) {
+        out.push_back(message);
+        return true;
+      },
+      SIZE_MAX);
+  return out;
+}
+}  // namespace
+
+void setUp() { LittleFS.remove(kSpillPath); }
+
+void tearDown() {}
+
+void test_spills_to_flash_and_drains_in_order() {
+  EventQueue queue;
+  queue.begin(2, 50, kSpillPath);
+  for (int i = 0; i < 6; ++i) {
+    TEST_ASSERT_TRUE(queue.push(EventKind::Status, eventJson("STATUS", i)));
+  }
+  TEST_ASSERT_EQUAL_UINT32(6, queue.depth());
+  TEST_ASSERT_EQUAL_UINT32(4, queue.spilledDepth());
+  TEST_ASSERT_TRUE(LittleFS.exists(kSpillPath));
+
+  std::vector<String> sent = drainAll(queue);
+  TEST_ASSERT_EQUAL_UINT32(6, sent.size());
+  for (int i = 0; i < 6; ++i) {
+    TEST_ASSERT_EQUAL_STRING(eventJson("STATUS", i).c_str(), sent[i].c_str());
+  }
+  TEST_ASSERT_TRUE(queue.empty());
+  TEST_ASSERT_FALSE(LittleFS.exists(kSpillPath));
+}
+
+void test_full_queue_evicts_oldest_status_first() {
+  EventQueue queue;
+  queue.begin(2, 4, kSpillPath);
+  queue.push(EventKind::Status, eventJson("STATUS", 0));
+  queue.push(EventKind::Change, eventJson("CHANGE_DETECTED", 1));
+  queue.push(EventKind::Status, eventJson("STATUS", 2));
+  queue.push(EventKind::Error, eventJson("ERROR", 3));
+  TEST_ASSERT_TRUE(queue.push(EventKind::Change, eventJson("CHANGE_DETECTED", 4)));
+  TEST_ASSERT_TRUE(queue.push(EventKind::Change, eventJson("CHANGE_DETECTED", 5)));
+  TEST_ASSERT_TRUE(queue.push(EventKind::Change, eventJson("CHANGE_DETECTED", 6)));
+  // Only changes are left: a new status is the one that gets dropped.
+  TEST_ASSERT_FALSE(queue.push(EventKind::Status, eventJson("STATUS", 7)));
+
+  const EventQueue::Stats &stats = queue.stats();
+  TEST_ASSERT_EQUAL_UINT32(4, stats.dropped);
+  TEST_ASSERT_EQUAL_UINT32(3, stats.droppedStatus);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.droppedError);
+  TEST_ASSERT_EQUAL_UINT32(0, stats.droppedChange);
+
+  std::vector<String> sent = drainAll(queue);
+  TEST_ASSERT_EQUAL_UINT32(4, sent.size());
+  TEST_ASSERT_EQUAL_STRING(eventJson("CHANGE_DETECTED", 1).c_str(), sent[0].c_str());
+  TEST_ASSERT_EQUAL_STRING(eventJson("CHANGE_DETECTED", 6).c_str(), sent[3].c_str());
+}
+
+void test_drain_stops_on_publish_failure() {
+  EventQueue queue;
+  queue.begin(4, 16, kSpillPath);
+  for (int i = 0; i < 3; ++i) {
+    queue.push(EventKind::Change, eventJson("CHANGE_DETECTED", i));
+  }
+  int calls = 0;
+  const size_t sent = queue.drain(
+      [&](const String &) {
+        ++calls;
+        return calls < 2;
+      },
+      10);
+  TEST_ASSERT_EQUAL_UINT32(1, sent);
+  TEST_ASSERT_EQUAL_UINT32(2, queue.depth());
+  TEST_ASSERT_EQUAL_UINT32(1, queue.drain([](const String &) { return true; }, 1));
+  TEST_ASSERT_EQUAL_UINT32(1, queue.depth());
+}
+
+void test_spilled_events_survive_restart() {
+  {
+    EventQueue queue;
+    queue.begin(1, 32, kSpillPath);
+    for (int i = 0; i < 5; ++i) {
+      queue.push(i % 2 ? EventKind::Change : EventKind::Status, eventJson("X", i));
+    }
+    // Consume one spilled record so a tombstone is left behind.
+    queue.drain([](const String &) { return true; }, 1);
+  }
+  EventQueue restarted;
+  restarted.begin(1, 32, kSpillPath);
+  // The RAM entry is lost with the reboot; the three remaining spilled ones are not.
+  std::vector<String> sent = drainAll(restarted);
+  TEST_ASSERT_EQUAL_UINT32(3, sent.size());
+  TEST_ASSERT_EQUAL_STRING(eventJson("X", 1).c_str(), sent[0].c_str());
+  TEST_ASSERT_EQUAL_STRING(eventJson("X", 3).c_str(), sent[2].c_str());
+}
+
+int main(int, char **) {
+  setenv("LITTLEFS_ROOT", ".pio/test-littlefs", 1);
+  LittleFS.begin(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_spills_to_flash_and_drains_in_order);
+  RUN_TEST(test_full_queue_evicts_oldest_status_first);
+  RUN_TEST(test_drain_stops_on_publish_failure);
+  RUN_TEST(test_spilled_events_survive_restart);
+  return UNITY_END();
+}
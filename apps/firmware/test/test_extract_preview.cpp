@@ -0,0 +1,104 @@
+#include <Arduino.h>
+#include <ExtractPreview.h>
+#include <unity.h>
+
+#include <cstring>
+
+namespace {
+const char *kPage =
+    "<html><body><div id=\"precio\" class=\"box\">\n  <b>1&#46;299&euro;</b> con   IVA\n</div>"
+    "<p>Envío gratis</p><footer>pie</footer></body></html>";
+
+SiteConfig selectorSite(const char *selector) {
+  SiteConfig config;
+  config.mode = "selector";
+  config.extractMode = ExtractMode::Selector;
+  config.selectorCss = selector;
+  return config;
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_selector_preview_reports_span_scan_and_normalized_text() {
+  SiteConfig config = selectorSite("div#precio");
+  config.normalize = "text";
+  const ExtractionPreview preview = previewExtraction(config, kPage, strlen(kPage));
+  TEST_ASSERT_TRUE(preview.outcome.ok);
+  TEST_ASSERT_EQUAL_STRING_LEN("<b>1&#46;299&euro;</b> con   IVA", preview.outcome.data, preview.outcome.length);
+  TEST_ASSERT_EQUAL(strlen(kPage), preview.bodyBytes);
+  TEST_ASSERT_FALSE(preview.truncated);
+  // The device can stop once the content ends, well before the footer.
+  TEST_ASSERT_EQUAL(static_cast<size_t>(strstr(kPage, " IVA") + 4 - kPage), preview.scannedBytes);
+  TEST_ASSERT_EQUAL_STRING("1.299\xE2\x82\xAC con IVA", preview.normalized.c_str());
+  TEST_ASSERT_EQUAL(preview.normalized.length(), preview.normalizedBytes);
+}
+
+void test_max_bytes_cuts_the_body_like_the_device() {
+  SiteConfig config = selectorSite("footer");
+  const ExtractionPreview whole = previewExtraction(config, kPage, strlen(kPage));
+  TEST_ASSERT_TRUE(whole.outcome.ok);
+  TEST_ASSERT_EQUAL_STRING_LEN("pie", whole.outcome.data, whole.outcome.length);
+
+  config.maxBytes = 80;
+  const ExtractionPreview cut = previewExtraction(config, kPage, strlen(kPage));
+  TEST_ASSERT_TRUE(cut.truncated);
+  TEST_ASSERT_EQUAL(80, cut.bodyBytes);
+  TEST_ASSERT_FALSE(cut.outcome.ok);
+  TEST_ASSERT_EQUAL_STRING("Selector sin coincidencias", cut.outcome.errorMessage.c_str());
+  TEST_ASSERT_EQUAL(80, cut.scannedBytes);
+}
+
+void test_failures_and_text_limit() {
+  SiteConfig config;
+  config.mode = "regex";
+  config.extractMode = ExtractMode::Regex;
+  config.regex = "([0-9";
+  const ExtractionPreview invalid = previewExtraction(config, kPage, strlen(kPage));
+  TEST_ASSERT_FALSE(invalid.outcome.ok);
+  TEST_ASSERT_TRUE(invalid.outcome.errorMessage.startsWith("Regex inválida"));
+  TEST_ASSERT_EQUAL(strlen(kPage), invalid.scannedBytes);
+  TEST_ASSERT_EQUAL(0, invalid.normalizedBytes);
+
+  config.mode = "full";
+  config.extractMode = ExtractMode::Full;
+  const ExtractionPreview full = previewExtraction(config, kPage, strlen(kPage), 10);
+  TEST_ASSERT_TRUE(full.outcome.ok);
+  TEST_ASSERT_EQUAL(strlen(kPage), full.scannedBytes);
+  TEST_ASSERT_EQUAL(10, full.normalized.length());
+  TEST_ASSERT_EQUAL(strlen(kPage), full.normalizedBytes);
+}
+
+void test_modes_are_parsed_once_and_dispatched_by_enum() {
+  TEST_ASSERT_TRUE(parseExtractMode("") == ExtractMode::Selector);
+  TEST_ASSERT_TRUE(parseExtractMode("Markers") == ExtractMode::Markers);
+  TEST_ASSERT_TRUE(parseExtractMode("REGEX") == ExtractMode::Regex);
+  TEST_ASSERT_TRUE(parseExtractMode("xpath") == ExtractMode::Unknown);
+  for (const ExtractModeInfo &info : kExtractModes) {
+    TEST_ASSERT_TRUE(parseExtractMode(info.name) == info.mode);
+    TEST_ASSERT_TRUE(extractModeEnabled(info.mode));
+  }
+  TEST_ASSERT_FALSE(extractModeEnabled(ExtractMode::Unknown));
+
+  // The enum decides, not the string.
+  SiteConfig config = selectorSite("footer");
+  config.mode = "full";
+  ExtractionPreview preview = previewExtraction(config, kPage, strlen(kPage));
+  TEST_ASSERT_EQUAL_STRING_LEN("pie", preview.outcome.data, preview.outcome.length);
+  config.mode = "XPath";
+  config.extractMode = parseExtractMode(config.mode);
+  preview = previewExtraction(config, kPage, strlen(kPage));
+  TEST_ASSERT_FALSE(preview.outcome.ok);
+  TEST_ASSERT_EQUAL_STRING("Modo desconocido: xpath", preview.outcome.errorMessage.c_str());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_selector_preview_reports_span_scan_and_normalized_text);
+  RUN_TEST(test_max_bytes_cuts_the_body_like_the_device);
+  RUN_TEST(test_failures_and_text_limit);
+  RUN_TEST(test_modes_are_parsed_once_and_dispatched_by_enum);
+  return UNITY_END();
+}
@@ -0,0 +1,70 @@
+#include <Arduino.h>
+#include <FastBoot.h>
+#include <LittleFS.h>
+#include <unity.h>
+
+#include <cstdlib>
+#include <cstring>
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_schedule_survives_soft_reset() {
+  TEST_ASSERT_FALSE(RtcSchedule::begin());
+  RtcSchedule::record("site-a");
+  RtcSchedule::record("site-b");
+  RtcSchedule::tick();
+
+  // A soft reset keeps RTC memory, so begin() finds the block again.
+  TEST_ASSERT_TRUE(RtcSchedule::begin());
+  uint32_t seconds = 99;
+  TEST_ASSERT_TRUE(RtcSchedule::lookup("site-a", seconds));
+  TEST_ASSERT_EQUAL_UINT32(0, seconds);
+  TEST_ASSERT_FALSE(RtcSchedule::lookup("site-c", seconds));
+
+  RtcSchedule::forget("site-a");
+  TEST_ASSERT_FALSE(RtcSchedule::lookup("site-a", seconds));
+  TEST_ASSERT_TRUE(RtcSchedule::lookup("site-b", seconds));
+}
+
+void test_schedule_reuses_oldest_slot_when_full() {
+  RtcSchedule::begin();
+  for (int i = 0; i < RTC_SCHEDULE_MAX_SITES + 1; ++i) {
+    RtcSchedule::record(String("site-") + i);
+  }
+  uint32_t seconds = 0;
+  TEST_ASSERT_TRUE(RtcSchedule::lookup(String("site-") + RTC_SCHEDULE_MAX_SITES, seconds));
+}
+
+void test_wifi_cache_round_trip() {
+  WifiCache cache;
+  const uint8_t bssid[6] = {0x24, 0x0a, 0xc4, 0x01, 0x02, 0x03};
+  memcpy(cache.bssid, bssid, sizeof(bssid));
+  cache.channel = 11;
+  cache.ip = 0x0a01a8c0;
+  cache.gateway = 0x0101a8c0;
+  cache.subnet = 0x00ffffff;
+  cache.dns = 0x0101a8c0;
+  WifiCache::store(cache);
+  TEST_ASSERT_TRUE(LittleFS.exists("/wifi.bin"));
+
+  WifiCache loaded;
+  TEST_ASSERT_TRUE(WifiCache::load(loaded));
+  TEST_ASSERT_EQUAL_INT32(11, loaded.channel);
+  TEST_ASSERT_EQUAL_UINT32(cache.ip, loaded.ip);
+  TEST_ASSERT_EQUAL_MEMORY(bssid, loaded.bssid, sizeof(bssid));
+
+  WifiCache::clear();
+  TEST_ASSERT_FALSE(WifiCache::load(loaded));
+}
+
+int main(int, char **) {
+  setenv("LITTLEFS_ROOT", ".pio/test-littlefs", 1);
+  LittleFS.begin(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_schedule_survives_soft_reset);
+  RUN_TEST(test_schedule_reuses_oldest_slot_when_full);
+  RUN_TEST(test_wifi_cache_round_trip);
+  return UNITY_END();
+}
@@ -0,0 +1,194 @@
+#include <Arduino.h>
+#include <BandwidthBudget.h>
+#include <ContentExtractor.h>
+#include <FetchGovernor.h>
+#include <unity.h>
+
+#include <string>
+
+namespace {
+FetchGovernor::Options testOptions() {
+  FetchGovernor::Options options;
+  options.reserveBytes = 16 * 1024;
+  options.minBudgetBytes = 4 * 1024;
+  options.maxDeferMs = 30000;
+  return options;
+}
+
+MemoryStatus memoryWith(size_t freeHeap, size_t largestBlock, size_t inFlight) {
+  MemoryStatus memory;
+  memory.freeHeap = freeHeap;
+  memory.largestBlock = largestBlock;
+  memory.arenaFree = 8 * 1024;
+  memory.checksInFlight = inFlight;
+  return memory;
+}
+
+std::string extractStreamed(const SiteConfig &config, const std::string &body, size_t pieceBytes, size_t maxBytes,
+                            bool &ok) {
+  CheckArena arena;
+  arena.begin(1024);
+  ArenaBuffer out(arena);
+  MarkerStream markers;
+  markers.begin(config, out, maxBytes);
+  for (size_t offset = 0; offset < body.size(); offset += pieceBytes) {
+    markers.update(body.data() + offset, std::min(pieceBytes, body.size() - offset));
+  }
+  const ExtractionOutcome outcome = markers.finish();
+  ok = outcome.ok;
+  const std::string text = outcome.ok ? std::string(outcome.data, outcome.length) : std::string(outcome.errorMessage.c_str());
+  out.release();
+  return text;
+}
+}  // namespace
+
+void test_small_pages_are_buffered_and_markers_streamed() {
+  FetchGovernor governor;
+  governor.begin(testOptions());
+  SiteMemoryHint site;
+  site.expectedBytes = 20 * 1024;
+  const FetchPlan plan = governor.plan(site, memoryWith(200 * 1024, 120 * 1024, 1));
+  TEST_ASSERT_TRUE(plan.strategy == FetchStrategy::Buffered);
+  // 120 KB block, shared with the check already in flight.
+  TEST_ASSERT_EQUAL(60 * 1024, plan.budgetBytes);
+
+  site.streamable = true;
+  site.expectedBytes = 500 * 1024;
+  TEST_ASSERT_TRUE(governor.plan(site, memoryWith(200 * 1024, 120 * 1024, 1)).strategy == FetchStrategy::Streamed);
+}
+
+void test_large_page_waits_for_memory_then_runs_capped() {
+  FetchGovernor governor;
+  governor.begin(testOptions());
+  SiteMemoryHint site;
+  site.expectedBytes = 100 * 1024;
+  const MemoryStatus busy = memoryWith(150 * 1024, 90 * 1024, 2);
+  TEST_ASSERT_TRUE(governor.plan(site, busy).strategy == FetchStrategy::Deferred);
+
+  // Nothing else will hand memory back: best effort on a prefix right away.
+  const FetchPlan alone = governor.plan(site, memoryWith(150 * 1024, 90 * 1024, 0));
+  TEST_ASSERT_TRUE(alone.strategy == FetchStrategy::Capped);
+  TEST_ASSERT_EQUAL(90 * 1024, alone.budgetBytes);
+
+  // Waiting is bounded even while other checks keep running.
+  site.deferredForMs = 30000;
+  TEST_ASSERT_TRUE(governor.plan(site, busy).strategy == FetchStrategy::Capped);
+
+  // Content-Length beyond the budget turns an optimistic plan into a capped one.
+  site = SiteMemoryHint();
+  const FetchPlan optimistic = governor.plan(site, busy);
+  TEST_ASSERT_TRUE(optimistic.strategy == FetchStrategy::Buffered);
+  TEST_ASSERT_TRUE(governor.revise(optimistic, optimistic.budgetBytes).strategy == FetchStrategy::Buffered);
+  TEST_ASSERT_TRUE(governor.revise(optimistic, optimistic.budgetBytes + 1).strategy == FetchStrategy::Capped);
+}
+
+void test_exhausted_heap_defers_even_unknown_pages() {
+  FetchGovernor governor;
+  governor.begin(testOptions());
+  SiteMemoryHint site;
+  MemoryStatus exhausted = memoryWith(18 * 1024, 12 * 1024, 0);
+  exhausted.arenaFree = 2 * 1024;
+  FetchPlan plan = governor.plan(site, exhausted);
+  TEST_ASSERT_TRUE(plan.strategy == FetchStrategy::Deferred);
+  governor.record(plan.strategy);
+  site.deferredForMs = 40000;
+  plan = governor.plan(site, exhausted);
+  TEST_ASSERT_TRUE(plan.strategy == FetchStrategy::Capped);
+  TEST_ASSERT_EQUAL(2 * 1024, plan.budgetBytes);  // the arena is all there is
+  governor.record(plan.strategy);
+  TEST_ASSERT_EQUAL_UINT32(1, governor.stats().deferred);
+  TEST_ASSERT_EQUAL_UINT32(1, governor.stats().capped);
+  TEST_ASSERT_EQUAL_STRING("capped", fetchStrategyName(plan.strategy));
+}
+
+void test_marker_stream_matches_markers_split_across_pieces() {
+  SiteConfig config;
+  config.mode = "markers";
+  config.extractMode = ExtractMode::Markers;
+  config.startMarker = "<!-- inicio -->";
+  config.endMarker = "<!-- fin -->";
+  const std::string body = "<html><p>antes</p><!-- inicio --> Precio: 42 <!-- fin --><p>después</p></html>";
+  for (size_t piece : {1u, 3u, 7u, 16u, 1000u}) {
+    bool ok = false;
+    const std::string text = extractStreamed(config, body, piece, 256, ok);
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_EQUAL_STRING("Precio: 42", text.c_str());
+  }
+
+  bool ok = true;
+  TEST_ASSERT_EQUAL_STRING("No se encontró end_marker",
+                           extractStreamed(config, "<!-- inicio --> sin cierre", 4, 256, ok).c_str());
+  TEST_ASSERT_FALSE(ok);
+  extractStreamed(config, "<!-- inicio -->" + std::string(300, 'x') + "<!-- fin -->", 5, 256, ok);
+  TEST_ASSERT_FALSE(ok);
+  config.endMarker = "";
+  TEST_ASSERT_EQUAL_STRING("hasta el final", extractStreamed(config, "a<!-- inicio -->hasta el final ", 2, 256, ok).c_str());
+  TEST_ASSERT_TRUE(ok);
+}
+
+void test_marker_stream_takes_text_of_exactly_max_bytes() {
+  SiteConfig config;
+  config.mode = "markers";
+  config.extractMode = ExtractMode::Markers;
+  config.startMarker = "<!-- inicio -->";
+  config.endMarker = "<!-- fin -->";
+  const std::string fits = std::string(256, 'x');
+  for (size_t piece : {1u, 5u, 1000u}) {
+    bool ok = false;
+    const std::string text = extractStreamed(config, "<!-- inicio -->" + fits + "<!-- fin -->", piece, 256, ok);
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_EQUAL(256, text.size());
+    const std::string error = extractStreamed(config, "<!-- inicio -->" + fits + "y<!-- fin -->", piece, 256, ok);
+    TEST_ASSERT_FALSE(ok);
+    TEST_ASSERT_EQUAL_STRING("Texto entre marcadores supera 256 bytes", error.c_str());
+  }
+}
+
+void test_bandwidth_budget_refills_up_to_burst_and_carries_debt() {
+  BandwidthBudget budget;
+  budget.begin(1000, 4000, 0);
+  TEST_ASSERT_TRUE(budget.admits(4000, 0));
+  budget.consume(6000);  // the page was bigger than expected
+  TEST_ASSERT_EQUAL_INT(-2000, static_cast<int>(budget.tokens()));
+  // Unknown sizes only wait for the debt to be paid off.
+  TEST_ASSERT_FALSE(budget.admits(0, 1500));
+  TEST_ASSERT_EQUAL_UINT32(501, budget.waitMs(0, 1500));
+  TEST_ASSERT_TRUE(budget.admits(0, 2001));
+  // The bucket never holds more than the burst, and big pages wait for a full one.
+  TEST_ASSERT_TRUE(budget.admits(100000, 60000));
+  TEST_ASSERT_EQUAL_INT(4000, static_cast<int>(budget.tokens()));
+  TEST_ASSERT_EQUAL_UINT64(6000, budget.stats().bytes);
+}
+
+void test_bandwidth_budget_counts_each_wait_once() {
+  BandwidthBudget budget;
+  budget.begin(3, 10, 0);
+  budget.consume(10);
+  // 3 bytes/s: one byte every 333.3 ms, without losing the remainder.
+  TEST_ASSERT_FALSE(budget.admits(1, 100));
+  TEST_ASSERT_FALSE(budget.admits(1, 200));
+  TEST_ASSERT_FALSE(budget.admits(1, 300));
+  TEST_ASSERT_TRUE(budget.admits(1, 334));
+  TEST_ASSERT_EQUAL_UINT32(1, budget.stats().throttled);
+  budget.consume(1);
+  TEST_ASSERT_FALSE(budget.admits(1, 400));
+  TEST_ASSERT_EQUAL_UINT32(2, budget.stats().throttled);
+
+  BandwidthBudget disabled;
+  disabled.begin(0, 0, 0);
+  disabled.consume(1 << 20);
+  TEST_ASSERT_TRUE(disabled.admits(1 << 20, 0));
+  TEST_ASSERT_EQUAL_UINT32(0, disabled.waitMs(1 << 20, 0));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_small_pages_are_buffered_and_markers_streamed);
+  RUN_TEST(test_large_page_waits_for_memory_then_runs_capped);
+  RUN_TEST(test_exhausted_heap_defers_even_unknown_pages);
+  RUN_TEST(test_marker_stream_matches_markers_split_across_pieces);
+  RUN_TEST(test_marker_stream_takes_text_of_exactly_max_bytes);
+  RUN_TEST(test_bandwidth_budget_refills_up_to_burst_and_carries_debt);
+  RUN_TEST(test_bandwidth_budget_counts_each_wait_once);
+  return UNITY_END();
+}
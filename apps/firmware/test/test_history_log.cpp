@@ -0,0 +1,128 @@
+#include <Arduino.h>
+#include <HistoryLog.h>
+#include <LittleFS.h>
+#include <unity.h>
+
+#include <cstdlib>
+
+namespace {
+const String kSite = "site-a";
+
+HistoryEntry entryAt(uint32_t time, uint16_t status = 200) {
+  HistoryEntry entry;
+  entry.time = time;
+  entry.status = status;
+  entry.bytes = 1000 + time;
+  entry.fetchMs = time % 700;
+  entry.digest[0] = static_cast<uint8_t>(time);
+  entry.digest[7] = 0xAB;
+  return entry;
+}
+
+void appendChecks(uint32_t count, uint32_t firstTime, uint32_t stepSeconds) {
+  for (uint32_t i = 0; i < count; ++i) {
+    HistoryEntry entry = entryAt(firstTime + i * stepSeconds);
+    TEST_ASSERT_TRUE(HistoryLog::append(kSite, entry));
+  }
+}
+}  // namespace
+
+void setUp() { HistoryLog::remove(kSite); }
+
+void tearDown() {}
+
+void test_entries_round_trip_in_order() {
+  HistoryEntry changed = entryAt(100);
+  changed.flags = kHistoryChanged;
+  TEST_ASSERT_TRUE(HistoryLog::append(kSite, changed));
+  TEST_ASSERT_EQUAL_UINT32(1, changed.seq);
+  HistoryEntry failed = entryAt(400, 0);
+  failed.flags = kHistoryError;
+  failed.fetchMs = 15000;
+  TEST_ASSERT_TRUE(HistoryLog::append(kSite, failed));
+  TEST_ASSERT_EQUAL_UINT32(2, failed.seq);
+
+  std::vector<HistoryEntry> entries;
+  TEST_ASSERT_EQUAL(2, HistoryLog::read(kSite, 0, 10, entries));
+  TEST_ASSERT_EQUAL_UINT32(100, entries[0].time);
+  TEST_ASSERT_EQUAL_UINT8(kHistoryChanged, entries[0].flags);
+  TEST_ASSERT_EQUAL_UINT16(200, entries[0].status);
+  TEST_ASSERT_EQUAL_UINT32(1100, entries[0].bytes);
+  TEST_ASSERT_EQUAL_UINT8(100, entries[0].digest[0]);
+  TEST_ASSERT_EQUAL_UINT8(0xAB, entries[0].digest[7]);
+  TEST_ASSERT_EQUAL_UINT32(400, entries[1].time);
+  TEST_ASSERT_EQUAL_UINT8(kHistoryError, entries[1].flags);
+  TEST_ASSERT_EQUAL_UINT16(0, entries[1].status);
+  TEST_ASSERT_EQUAL_UINT32(15000, entries[1].fetchMs);
+
+  TEST_ASSERT_EQUAL(1, HistoryLog::read(kSite, 2, 10, entries));
+  TEST_ASSERT_EQUAL_UINT32(2, entries[0].seq);
+  HistoryLog::remove(kSite);
+  TEST_ASSERT_EQUAL(0, HistoryLog::read(kSite, 0, 10, entries));
+}
+
+void test_wraparound_keeps_the_flash_budget() {
+  appendChecks(1000, 5000, 900);
+  uint32_t first = 0;
+  uint32_t next = 0;
+  HistoryLog::range(kSite, first, next);
+  TEST_ASSERT_EQUAL_UINT32(1001, next);
+  TEST_ASSERT_TRUE(first > 1);
+  TEST_ASSERT_TRUE(next - first >= 2 * (HISTORY_SEGMENT_BYTES / 32));
+
+  std::vector<HistoryEntry> entries;
+  const size_t kept = HistoryLog::read(kSite, 0, 2000, entries);
+  TEST_ASSERT_EQUAL(next - first, kept);
+  TEST_ASSERT_EQUAL_UINT32(first, entries.front().seq);
+  TEST_ASSERT_EQUAL_UINT32(1000, entries.back().seq);
+  TEST_ASSERT_EQUAL_UINT32(5000 + 999 * 900, entries.back().time);
+  TEST_ASSERT_EQUAL_UINT32(5000 + (first - 1) * 900, entries.front().time);
+
+  // A power cycle restarts the clock: the times still decode.
+  HistoryEntry afterReset = entryAt(3);
+  TEST_ASSERT_TRUE(HistoryLog::append(kSite, afterReset));
+  TEST_ASSERT_EQUAL_UINT32(1001, afterReset.seq);
+  TEST_ASSERT_EQUAL(2, HistoryLog::read(kSite, 1000, 10, entries));
+  TEST_ASSERT_EQUAL_UINT32(5000 + 999 * 900, entries[0].time);
+  TEST_ASSERT_EQUAL_UINT32(3, entries[1].time);
+}
+
+void test_reply_splits_a_range_in_parts() {
+  appendChecks(40, 0, 60);
+  HistoryReply reply;
+  reply.begin(kSite, 7, 5, 30);
+  TEST_ASSERT_TRUE(reply.active());
+  TEST_ASSERT_EQUAL_UINT32(30, reply.records());
+
+  StaticJsonDocument<4096> doc;
+  JsonObject payload = doc.to<JsonObject>();
+  TEST_ASSERT_TRUE(reply.next(9000, payload));
+  TEST_ASSERT_EQUAL(2, payload["parts"].as<int>());
+  TEST_ASSERT_EQUAL(7, payload["request"].as<int>());
+  TEST_ASSERT_EQUAL(35, payload["next"].as<int>());
+  TEST_ASSERT_EQUAL(HISTORY_RECORDS_PER_PART, payload["records"].as<JsonArray>().size());
+  TEST_ASSERT_EQUAL(5, payload["records"][0][0].as<int>());
+  TEST_ASSERT_EQUAL(240, payload["records"][0][1].as<int>());
+
+  // Checks that ran meanwhile overwrote nothing here; the part is complete.
+  appendChecks(1, 3000, 0);
+  doc.clear();
+  payload = doc.to<JsonObject>();
+  TEST_ASSERT_TRUE(reply.next(9000, payload));
+  TEST_ASSERT_EQUAL(30 - HISTORY_RECORDS_PER_PART, payload["records"].as<JsonArray>().size());
+  TEST_ASSERT_EQUAL(0, payload["lost"].as<int>());
+  TEST_ASSERT_EQUAL_STRING("b0000000000000ab", payload["records"][0][6].as<const char *>());
+  doc.clear();
+  TEST_ASSERT_FALSE(reply.next(9000, doc.to<JsonObject>()));
+  TEST_ASSERT_FALSE(reply.active());
+}
+
+int main(int, char **) {
+  setenv("LITTLEFS_ROOT", ".pio/test-littlefs", 1);
+  LittleFS.begin(true);
+  UNITY_BEGIN();
+  RUN_TEST(test_entries_round_trip_in_order);
+  RUN_TEST(test_wraparound_keeps_the_flash_budget);
+  RUN_TEST(test_reply_splits_a_range_in_parts);
+  return UNITY_END();
+}
@@ -0,0 +1,72 @@
+#include <Arduino.h>
+#include <HtmlScanner.h>
+#include <unity.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+std::vector<std::string> tagNames(const char *html) {
+  std::vector<std::string> names;
+  HtmlTagScanner scanner(html, strlen(html));
+  HtmlTag tag;
+  while (scanner.next(tag)) {
+    names.push_back(std::string(tag.closing ? "/" : "") + std::string(tag.name, tag.nameLength) +
+                    (tag.selfClosing ? "/" : ""));
+  }
+  return names;
+}
+
+std::string joined(const std::vector<std::string> &names) {
+  std::string out;
+  for (const auto &name : names) {
+    out += out.empty() ? name : " " + name;
+  }
+  return out;
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_find_any_matches_bytewise_search_at_every_alignment() {
+  char buffer[96];
+  for (size_t hit = 0; hit < 40; ++hit) {
+    for (size_t offset = 0; offset < 9; ++offset) {
+      memset(buffer, 'a', sizeof(buffer));
+      buffer[offset + hit] = '"';
+      buffer[offset + hit + 5] = '>';
+      const char *begin = buffer + offset;
+      const char *end = buffer + offset + 48;
+      TEST_ASSERT_EQUAL_PTR(begin + hit, htmlscan::findAny(begin, end, '>', '"', '\''));
+      TEST_ASSERT_EQUAL_PTR(begin + hit + 5, htmlscan::findByte(begin, end, '>'));
+      TEST_ASSERT_EQUAL_PTR(end, htmlscan::findAny(begin, end, '<', '{', '}'));
+    }
+  }
+  // Bytes with the high bit set must not produce false positives.
+  const char high[] = "\xC3\xA1\xC3\xA9\xE2\x82\xAC\xFF\x80\x81 x";
+  TEST_ASSERT_EQUAL_PTR(high + strlen(high) - 1, htmlscan::findAny(high, high + strlen(high), 'x', 'y', 'z'));
+}
+
+void test_scanner_skips_raw_text_comments_and_quoted_gt() {
+  TEST_ASSERT_EQUAL_STRING("html script /script STYLE /STYLE p br/ /p textarea /textarea /html",
+                           joined(tagNames("<!DOCTYPE html><html><script>a<b && c>d; '</p>'</script>"
+                                           "<STYLE>p > a {}</STYLE><!-- <p> -> --><p title='x > y' b=\"<\">"
+                                           "1 < 2<br/></p><textarea><b>no</b></textarea></html>"))
+                               .c_str());
+}
+
+void test_scanner_stops_on_truncated_tag() {
+  TEST_ASSERT_EQUAL_STRING("p /p", joined(tagNames("<p>x</p><a href=\"/y")).c_str());
+  TEST_ASSERT_EQUAL_STRING("script", joined(tagNames("<script>never closed <b>")).c_str());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_find_any_matches_bytewise_search_at_every_alignment);
+  RUN_TEST(test_scanner_skips_raw_text_comments_and_quoted_gt);
+  RUN_TEST(test_scanner_stops_on_truncated_tag);
+  return UNITY_END();
+}
@@ -0,0 +1,133 @@
+#include <Arduino.h>
+#include <HttpProtocol.h>
+#include <unity.h>
+
+#include <cstring>
+#include <string>
+
+namespace {
+class Collector : public HttpResponseHandler {
+ public:
+  bool onHeader(const char *name, size_t nameLength, const char *value, size_t valueLength) override {
+    headers += std::string(name, nameLength) + "=" + std::string(value, valueLength) + ";";
+    return true;
+  }
+
+  bool onBody(const char *data, size_t length) override {
+    body.append(data, length);
+    return body.size() <= limit;
+  }
+
+  std::string headers;
+  std::string body;
+  size_t limit = SIZE_MAX;
+};
+
+// Feeds the response in pieces of `step` bytes, like reads from a socket.
+bool feedInSteps(HttpResponseParser &parser, Collector &collector, const char *response, size_t step) {
+  const size_t length = strlen(response);
+  for (size_t offset = 0; offset < length; offset += step) {
+    const size_t n = offset + step > length ? length - offset : step;
+    if (!parser.feed(response + offset, n, collector)) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+void test_url_parse() {
+  HttpUrl url = HttpUrl::parse("https://example.com:8443/a/b?c=1");
+  TEST_ASSERT_TRUE(url.valid);
+  TEST_ASSERT_TRUE(url.secure);
+  TEST_ASSERT_EQUAL_STRING("example.com", url.host.c_str());
+  TEST_ASSERT_EQUAL_UINT16(8443, url.port);
+  TEST_ASSERT_EQUAL_STRING("/a/b?c=1", url.path.c_str());
+
+  url = HttpUrl::parse("http://example.com?q=2");
+  TEST_ASSERT_TRUE(url.valid);
+  TEST_ASSERT_EQUAL_UINT16(80, url.port);
+  TEST_ASSERT_EQUAL_STRING("/?q=2", url.path.c_str());
+
+  TEST_ASSERT_FALSE(HttpUrl::parse("ftp://example.com/").valid);
+}
+
+void test_redirect_location_resolves() {
+  const String base = "https://example.com:8443/a/b?c=1";
+  TEST_ASSERT_EQUAL_STRING("http://other.org/x", HttpUrl::resolve(base, "http://other.org/x").c_str());
+  TEST_ASSERT_EQUAL_STRING("https://cdn.example.com/y", HttpUrl::resolve(base, "//cdn.example.com/y").c_str());
+  TEST_ASSERT_EQUAL_STRING("https://example.com:8443/nuevo?p=2", HttpUrl::resolve(base, "/nuevo?p=2").c_str());
+  TEST_ASSERT_EQUAL_STRING("https://example.com:8443/a/c", HttpUrl::resolve(base, "c").c_str());
+  TEST_ASSERT_EQUAL_STRING("http://example.com/z", HttpUrl::resolve("http://example.com", "z").c_str());
+}
+
+void test_content_length_body() {
+  const char *response =
+      "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 11\r\n\r\nhola mundo!";
+  for (size_t step : {1u, 3u, 64u}) {
+    HttpResponseParser parser;
+    Collector collector;
+    TEST_ASSERT_TRUE(feedInSteps(parser, collector, response, step));
+    TEST_ASSERT_TRUE(parser.done());
+    TEST_ASSERT_EQUAL(200, parser.statusCode());
+    TEST_ASSERT_EQUAL_STRING("hola mundo!", collector.body.c_str());
+    TEST_ASSERT_EQUAL_STRING("Content-Type=text/html;Content-Length=11;", collector.headers.c_str());
+  }
+}
+
+void test_chunked_body_split_across_reads() {
+  const char *response =
+      "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+      "5\r\nhola \r\n6;ext=1\r\nmundo!\r\n0\r\nX-Trailer: 1\r\n\r\n";
+  for (size_t step : {1u, 2u, 7u, 128u}) {
+    HttpResponseParser parser;
+    Collector collector;
+    TEST_ASSERT_TRUE(feedInSteps(parser, collector, response, step));
+    TEST_ASSERT_TRUE(parser.done());
+    TEST_ASSERT_EQUAL_STRING("hola mundo!", collector.body.c_str());
+    TEST_ASSERT_EQUAL_UINT32(11, parser.bodyBytes());
+  }
+}
+
+void test_body_until_eof() {
+  HttpResponseParser parser;
+  Collector collector;
+  TEST_ASSERT_TRUE(feedInSteps(parser, collector, "HTTP/1.0 200 OK\r\n\r\nsin longitud", 4));
+  TEST_ASSERT_FALSE(parser.done());
+  TEST_ASSERT_TRUE(parser.finishOnEof());
+  TEST_ASSERT_EQUAL_STRING("sin longitud", collector.body.c_str());
+
+  HttpResponseParser truncated;
+  Collector partial;
+  TEST_ASSERT_TRUE(feedInSteps(truncated, partial, "HTTP/1.1 200 OK\r\nContent-Length: 50\r\n\r\ncorto", 8));
+  TEST_ASSERT_FALSE(truncated.finishOnEof());
+}
+
+void test_no_body_statuses_and_errors() {
+  HttpResponseParser parser;
+  Collector collector;
+  TEST_ASSERT_TRUE(feedInSteps(parser, collector, "HTTP/1.1 304 Not Modified\r\nETag: \"x\"\r\n\r\n", 5));
+  TEST_ASSERT_TRUE(parser.done());
+  TEST_ASSERT_EQUAL(304, parser.statusCode());
+
+  HttpResponseParser bogus;
+  TEST_ASSERT_FALSE(feedInSteps(bogus, collector, "SSH-2.0-OpenSSH\r\n", 32));
+  TEST_ASSERT_TRUE(bogus.failed());
+
+  HttpResponseParser limited;
+  Collector small;
+  small.limit = 4;
+  TEST_ASSERT_FALSE(feedInSteps(limited, small, "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n0123456789", 2));
+  TEST_ASSERT_TRUE(limited.aborted());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_url_parse);
+  RUN_TEST(test_redirect_location_resolves);
+  RUN_TEST(test_content_length_body);
+  RUN_TEST(test_chunked_body_split_across_reads);
+  RUN_TEST(test_body_until_eof);
+  RUN_TEST(test_no_body_statuses_and_errors);
+  return UNITY_END();
+}
@@ -0,0 +1,110 @@
+#include <Arduino.h>
+#include <ContentExtractor.h>
+#include <ItemSet.h>
+#include <unity.h>
+
+#include <vector>
+
+namespace {
+ItemSet collect(const std::vector<const char *> &items, const std::vector<uint32_t> &previous, size_t maxItems = 0) {
+  ItemSet set;
+  set.begin(previous, maxItems);
+  for (const char *item : items) {
+    set.beginItem();
+    // In two pieces, as the normalizer hands them over.
+    const size_t half = strlen(item) / 2;
+    set.update(item, half);
+    set.update(item + half, strlen(item) - half);
+    set.endItem();
+  }
+  set.finish();
+  return set;
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_added_and_removed_items_ignore_order() {
+  const ItemSet first = collect({"Casa en Gracia 320.000 €", "Piso en Sants 210.000 €", "Ático en Sarrià 540.000 €"}, {});
+  TEST_ASSERT_EQUAL(3, first.digests().size());
+  TEST_ASSERT_TRUE(std::is_sorted(first.digests().begin(), first.digests().end()));
+  // Nothing to compare with yet.
+  TEST_ASSERT_EQUAL(0, first.addedCount());
+
+  const ItemSet shuffled = collect({"Ático en Sarrià 540.000 €", "Casa en Gracia 320.000 €", "Piso en Sants 210.000 €"},
+                                   first.digests());
+  TEST_ASSERT_EQUAL(0, shuffled.addedCount());
+  TEST_ASSERT_EQUAL(0, shuffled.removedCount());
+  TEST_ASSERT_TRUE(shuffled.digests() == first.digests());
+
+  const ItemSet next = collect({"Casa en Gracia 320.000 €", "Loft en Poblenou 380.000 €", "Ático en Sarrià 540.000 €"},
+                               first.digests());
+  TEST_ASSERT_EQUAL(1, next.addedCount());
+  TEST_ASSERT_EQUAL(1, next.removedCount());
+  TEST_ASSERT_EQUAL_STRING("Loft en Poblenou 380.000 €", next.added()[0].head.c_str());
+  TEST_ASSERT_EQUAL_STRING("Loft en Poblenou 380.000 €", next.excerpt().c_str());
+  const ItemSet onlyPiso = collect({"Piso en Sants 210.000 €"}, {});
+  TEST_ASSERT_EQUAL_UINT32(onlyPiso.digests()[0], next.removed()[0]);
+}
+
+void test_cap_bounds_the_set() {
+  std::vector<String> texts;
+  std::vector<const char *> items;
+  for (int i = 0; i < 10; ++i) {
+    texts.push_back(String("Producto ") + i);
+  }
+  for (const String &text : texts) {
+    items.push_back(text.c_str());
+  }
+  items.push_back(texts[0].c_str());
+  const ItemSet capped = collect(items, {}, 4);
+  TEST_ASSERT_EQUAL(11, capped.seen());
+  TEST_ASSERT_EQUAL(4, capped.digests().size());
+  TEST_ASSERT_TRUE(capped.truncated());
+
+  // Duplicates count once and a cap above LIST_MAX_ITEMS is clamped.
+  const ItemSet all = collect(items, {}, 60000);
+  TEST_ASSERT_EQUAL(10, all.digests().size());
+  TEST_ASSERT_FALSE(all.truncated());
+
+  // The head of a long item is cut at a character boundary.
+  const String longItem = String("Descripción ") + String(std::string(ItemSet::kHeadBytes - 14, 'x').c_str()) + "ñandú";
+  const ItemSet withLong = collect({longItem.c_str()}, all.digests());
+  TEST_ASSERT_EQUAL(ItemSet::kHeadBytes - 1, withLong.added()[0].head.length());
+}
+
+void test_list_items_come_from_one_pass() {
+  const String html =
+      "<html><body><div class=\"grid\">"
+      "<article class=\"card\"><h2>Uno</h2></article>"
+      "<article class=\"card\"><h2>Dos</h2></article>"
+      "<article class=\"ad\">anuncio</article>"
+      "<article class=\"card\"><h2>Tres</h2></article>"
+      "</div></body></html>";
+  SiteConfig config;
+  config.mode = "list";
+  config.extractMode = parseExtractMode(config.mode);
+  config.selectorCss = "article.card";
+  TEST_ASSERT_TRUE(config.extractMode == ExtractMode::List);
+
+  std::vector<String> items;
+  String error;
+  TEST_ASSERT_EQUAL(3, extractListItems(
+                           config, html.c_str(), html.length(),
+                           [&](const char *item, size_t length) { items.push_back(String(item, length)); }, error));
+  TEST_ASSERT_EQUAL_STRING("<h2>Dos</h2>", items[1].c_str());
+
+  config.selectorCss = "article.sold";
+  TEST_ASSERT_EQUAL(0, extractListItems(config, html.c_str(), html.length(), [](const char *, size_t) {}, error));
+  TEST_ASSERT_EQUAL_STRING("Selector sin coincidencias", error.c_str());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_added_and_removed_items_ignore_order);
+  RUN_TEST(test_cap_bounds_the_set);
+  RUN_TEST(test_list_items_come_from_one_pass);
+  return UNITY_END();
+}
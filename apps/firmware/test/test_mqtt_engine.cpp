@@ -0,0 +1,293 @@
+#include <Arduino.h>
+#include <MqttCodec.h>
+#include <MqttEngine.h>
+#include <unity.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace {
+// In-memory stream: the test plays the broker by queuing its packets in
+// `incoming` and reading back what the engine wrote.
+class ScriptedTransport : public MqttTransport {
+ public:
+  bool open(const char *, uint16_t) override {
+    state = State::Open;
+    ++opens;
+    return true;
+  }
+  State poll(uint32_t, bool) override { return state; }
+  int read(uint8_t *data, size_t length) override {
+    if (state != State::Open) {
+      return -1;
+    }
+    if (incoming.empty()) {
+      return 0;
+    }
+    const size_t n = std::min(length, incoming.size());
+    std::copy(incoming.begin(), incoming.begin() + n, data);
+    incoming.erase(incoming.begin(), incoming.begin() + n);
+    return static_cast<int>(n);
+  }
+  int write(const uint8_t *data, size_t length) override {
+    if (state != State::Open) {
+      return -1;
+    }
+    written.insert(written.end(), data, data + length);
+    return static_cast<int>(length);
+  }
+  void close() override { state = State::Closed; }
+  const char *error() const override { return "cerrado"; }
+
+  void drop() {
+    state = State::Failed;
+    incoming.clear();
+  }
+
+  State state = State::Closed;
+  int opens = 0;
+  std::deque<uint8_t> incoming;
+  mqtt::Bytes written;
+};
+
+struct Sent {
+  uint8_t type;
+  uint16_t packetId;
+  bool dup;
+  std::string payload;
+};
+
+// Decodes and clears everything the engine has written so far.
+std::vector<Sent> takeWritten(ScriptedTransport &transport) {
+  std::vector<Sent> sent;
+  mqtt::PacketReader reader(4096);
+  reader.feed(transport.written.data(), transport.written.size(), [&](const mqtt::Packet &packet) {
+    Sent item{packet.type(), 0, false, ""};
+    mqtt::PublishView publish;
+    if (mqtt::decodePublish(packet, publish)) {
+      item.packetId = publish.packetId;
+      item.dup = publish.dup;
+      item.payload.assign(publish.payload, publish.payloadLength);
+    } else if (packet.type() == mqtt::kSubscribe) {
+      mqtt::decodePacketId(packet, item.packetId);
+    }
+    sent.push_back(item);
+    return true;
+  });
+  transport.written.clear();
+  return sent;
+}
+
+void reply(ScriptedTransport &transport, const mqtt::Bytes &packet) {
+  transport.incoming.insert(transport.incoming.end(), packet.begin(), packet.end());
+}
+
+void connect(MqttEngine &engine, ScriptedTransport &transport) {
+  engine.poll(0);  // opens the transport
+  engine.poll(0);  // writes CONNECT
+  mqtt::Bytes connack;
+  mqtt::encodeConnack(connack, mqtt::kConnectAccepted);
+  reply(transport, connack);
+  engine.poll(0);
+}
+
+MqttOptions testOptions(size_t window) {
+  MqttOptions options;
+  options.host = "broker";
+  options.clientId = "test-device";
+  options.inflightWindow = window;
+  options.outboxSlots = 4;
+  options.keepAliveS = 0;
+  return options;
+}
+}  // namespace
+
+void test_reader_reassembles_split_packets() {
+  mqtt::Bytes wire;
+  const std::string payload(300, 'p');  // two-byte remaining length
+  mqtt::encodePublish(wire, "a/b", 3, payload.data(), payload.size(), 1, 42, true);
+  mqtt::encodeEmpty(wire, mqtt::kPingresp);
+
+  mqtt::PacketReader reader(1024);
+  std::vector<uint8_t> types;
+  mqtt::PublishView publish;
+  std::string topic;
+  std::string received;
+  for (uint8_t byte : wire) {
+    TEST_ASSERT_TRUE(reader.feed(&byte, 1, [&](const mqtt::Packet &packet) {
+      types.push_back(packet.type());
+      if (mqtt::decodePublish(packet, publish)) {
+        topic.assign(publish.topic, publish.topicLength);
+        received.assign(publish.payload, publish.payloadLength);
+      }
+      return true;
+    }) == mqtt::PacketReader::Status::Ok);
+  }
+  TEST_ASSERT_EQUAL(2, types.size());
+  TEST_ASSERT_EQUAL_UINT8(mqtt::kPublish, types[0]);
+  TEST_ASSERT_EQUAL_UINT8(mqtt::kPingresp, types[1]);
+  TEST_ASSERT_TRUE(topic == "a/b");
+  TEST_ASSERT_EQUAL_UINT16(42, publish.packetId);
+  TEST_ASSERT_EQUAL_UINT8(1, publish.qos);
+  TEST_ASSERT_TRUE(publish.dup);
+  TEST_ASSERT_TRUE(received == payload);
+
+  mqtt::PacketReader small(64);
+  TEST_ASSERT_TRUE(small.feed(wire.data(), wire.size(), [](const mqtt::Packet &) { return true; }) ==
+                   mqtt::PacketReader::Status::TooLarge);
+}
+
+void test_engine_keeps_window_in_flight() {
+  ScriptedTransport transport;
+  MqttEngine engine(transport);
+  engine.subscribe("devices/x/commands", 1);
+  TEST_ASSERT_FALSE(engine.publish("devices/x/events", "antes"));
+  engine.begin(testOptions(2));
+  connect(engine, transport);
+  TEST_ASSERT_TRUE(engine.connected());
+
+  std::vector<Sent> sent = takeWritten(transport);
+  TEST_ASSERT_EQUAL(2, sent.size());
+  TEST_ASSERT_EQUAL_UINT8(mqtt::kConnect, sent[0].type);
+  TEST_ASSERT_EQUAL_UINT8(mqtt::kSubscribe, sent[1].type);
+
+  for (const char *payload : {"e1", "e2", "e3", "e4"}) {
+    TEST_ASSERT_TRUE(engine.publish("devices/x/events", payload));
+  }
+  TEST_ASSERT_FALSE(engine.canPublish());
+  engine.poll(0);
+  sent = takeWritten(transport);
+  TEST_ASSERT_EQUAL(2, sent.size());
+  TEST_ASSERT_TRUE(sent[0].payload == "e1");
+  TEST_ASSERT_TRUE(sent[1].payload == "e2");
+  TEST_ASSERT_EQUAL(2, engine.inflight());
+
+  // Acks may come back in any order; each frees one slot of the window.
+  mqtt::Bytes ack;
+  mqtt::encodeAck(ack, mqtt::kPuback, sent[1].packetId);
+  reply(transport, ack);
+  engine.poll(0);
+  sent = takeWritten(transport);
+  TEST_ASSERT_EQUAL(1, sent.size());
+  TEST_ASSERT_TRUE(sent[0].payload == "e3");
+  TEST_ASSERT_EQUAL(3, engine.pending());
+  TEST_ASSERT_EQUAL_UINT32(1, engine.stats().acked);
+  TEST_ASSERT_EQUAL_UINT32(2, engine.stats().inflightPeak);
+}
+
+void test_engine_resends_unacked_after_reconnect() {
+  ScriptedTransport transport;
+  MqttEngine engine(transport);
+  MqttOptions options = testOptions(2);
+  // Reconnects at once; the backoff after drops has its own test.
+  options.reconnectMinMs = 0;
+  engine.begin(options);
+  connect(engine, transport);
+  TEST_ASSERT_TRUE(engine.publish("t", "e1"));
+  TEST_ASSERT_TRUE(engine.publish("t", "e2"));
+  TEST_ASSERT_TRUE(engine.publish("t", "e3"));
+  engine.poll(0);
+  std::vector<Sent> first = takeWritten(transport);
+  TEST_ASSERT_EQUAL(3, first.size());  // CONNECT + two PUBLISH
+
+  transport.drop();
+  engine.poll(0);
+  TEST_ASSERT_FALSE(engine.connected());
+  TEST_ASSERT_FALSE(engine.canPublish());
+  TEST_ASSERT_EQUAL(3, engine.pending());
+
+  connect(engine, transport);
+  TEST_ASSERT_EQUAL(2, transport.opens);
+  std::vector<Sent> resent = takeWritten(transport);
+  TEST_ASSERT_EQUAL(3, resent.size());
+  TEST_ASSERT_EQUAL_UINT8(mqtt::kConnect, resent[0].type);
+  TEST_ASSERT_TRUE(resent[1].payload == "e1");
+  TEST_ASSERT_TRUE(resent[1].dup);
+  TEST_ASSERT_EQUAL_UINT16(first[1].packetId, resent[1].packetId);
+  TEST_ASSERT_TRUE(resent[2].payload == "e2");
+  TEST_ASSERT_EQUAL_UINT32(2, engine.stats().retransmitted);
+  TEST_ASSERT_EQUAL_UINT32(1, engine.stats().disconnects);
+}
+
+void test_engine_acks_inbound_commands() {
+  ScriptedTransport transport;
+  MqttEngine engine(transport);
+  std::string command;
+  engine.onMessage([&](const char *, size_t, char *payload, size_t length) { command.assign(payload, length); });
+  MqttOptions options = testOptions(1);
+  options.reconnectMinMs = 30;
+  engine.begin(options);
+  connect(engine, transport);
+  takeWritten(transport);
+
+  mqtt::Bytes publish;
+  mqtt::encodePublish(publish, "devices/x/commands", 18, "{\"type\":\"CHECK_NOW\"}", 20, 1, 7, false);
+  reply(transport, publish);
+  engine.poll(0);
+  TEST_ASSERT_TRUE(command == "{\"type\":\"CHECK_NOW\"}");
+  std::vector<Sent> sent = takeWritten(transport);
+  TEST_ASSERT_EQUAL(1, sent.size());
+  TEST_ASSERT_EQUAL_UINT8(mqtt::kPuback, sent[0].type);
+
+  // A refused CONNECT backs off instead of retrying on every poll.
+  transport.drop();
+  engine.poll(0);
+  delay(options.reconnectMinMs);
+  engine.poll(0);
+  engine.poll(0);
+  mqtt::Bytes refused;
+  mqtt::encodeConnack(refused, mqtt::kServerUnavailable);
+  reply(transport, refused);
+  engine.poll(0);
+  engine.poll(0);
+  TEST_ASSERT_FALSE(engine.connected());
+  TEST_ASSERT_EQUAL_UINT32(1, engine.stats().connectFailures);
+  const int opens = transport.opens;
+  engine.poll(0);
+  TEST_ASSERT_EQUAL(opens, transport.opens);
+}
+
+void test_engine_backs_off_a_broker_that_keeps_dropping_it() {
+  ScriptedTransport transport;
+  MqttEngine engine(transport);
+  MqttOptions options = testOptions(1);
+  options.reconnectMinMs = 40;
+  options.reconnectMaxMs = 160;
+  options.stableSessionMs = 300;
+  engine.begin(options);
+  // Accepted and kicked right away, over and over: the delay keeps doubling.
+  const uint32_t expected[] = {40, 80, 160, 160};
+  for (uint32_t delayMs : expected) {
+    connect(engine, transport);
+    TEST_ASSERT_TRUE(engine.connected());
+    transport.drop();
+    engine.poll(0);
+    TEST_ASSERT_FALSE(engine.connected());
+    const int opens = transport.opens;
+    engine.poll(0);
+    TEST_ASSERT_EQUAL(opens, transport.opens);
+    TEST_ASSERT_TRUE(engine.idleMs() <= delayMs);
+    TEST_ASSERT_TRUE(engine.idleMs() + 20 > delayMs);
+    delay(delayMs);
+  }
+  TEST_ASSERT_EQUAL_UINT32(4, engine.stats().disconnects);
+
+  // A session that stayed up resets it.
+  connect(engine, transport);
+  delay(options.stableSessionMs);
+  transport.drop();
+  engine.poll(0);
+  TEST_ASSERT_TRUE(engine.idleMs() <= 40);
+  TEST_ASSERT_TRUE(engine.idleMs() > 20);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_reader_reassembles_split_packets);
+  RUN_TEST(test_engine_keeps_window_in_flight);
+  RUN_TEST(test_engine_resends_unacked_after_reconnect);
+  RUN_TEST(test_engine_acks_inbound_commands);
+  RUN_TEST(test_engine_backs_off_a_broker_that_keeps_dropping_it);
+  return UNITY_END();
+}
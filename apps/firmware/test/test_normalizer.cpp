@@ -0,0 +1,78 @@
+#include <Arduino.h>
+#include <ContentNormalizer.h>
+#include <unity.h>
+
+#include <cstring>
+
+namespace {
+String normalize(const char *input, NormalizeMode mode, size_t chunk = SIZE_MAX, const char *ignoreStart = "",
+                 const char *ignoreEnd = "") {
+  NormalizeOptions options;
+  options.mode = mode;
+  options.ignoreStart = ignoreStart;
+  options.ignoreEnd = ignoreEnd;
+  String out;
+  ContentNormalizer normalizer;
+  normalizer.begin(options, [&](const char *data, size_t length) { out.concat(data, length); });
+  const size_t length = strlen(input);
+  for (size_t offset = 0; offset < length; offset += chunk) {
+    normalizer.update(input + offset, std::min(chunk, length - offset));
+  }
+  normalizer.finish();
+  return out;
+}
+
+const char *kPage =
+    "<html><head><title>Tienda</title><style>p > a { color: red }</style>\n"
+    "<script>if (a < b && c > d) { document.write('</p>'); }</script></head>\n"
+    "<body><!-- build 8812 --><form><input type=\"hidden\" name=\"csrf\" value=\"a>b\"></form>\n"
+    "<p class='precio'>Precio:&nbsp;<b>1&#46;299&euro;</b></p>  <p>Envío &amp; devolución</p>\n"
+    "<p>a &lt; b &unknown; &#xZZ;</p></body></html>";
+
+const char *kPageText =
+    "Tienda Precio: 1.299\xE2\x82\xAC Envío & devolución a < b &unknown; &#xZZ;";
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_text_mode_reduces_markup_to_visible_text() {
+  TEST_ASSERT_EQUAL_STRING(kPageText, normalize(kPage, NormalizeMode::Text).c_str());
+}
+
+void test_output_does_not_depend_on_chunking() {
+  for (size_t chunk : {1, 2, 3, 7, 64}) {
+    TEST_ASSERT_EQUAL_STRING(kPageText, normalize(kPage, NormalizeMode::Text, chunk).c_str());
+  }
+}
+
+void test_whitespace_and_none_modes() {
+  const char *input = "  <b>a</b>\n\n\t b  ";
+  TEST_ASSERT_EQUAL_STRING("<b>a</b> b", normalize(input, NormalizeMode::Whitespace).c_str());
+  TEST_ASSERT_EQUAL_STRING(input, normalize(input, NormalizeMode::None, 3).c_str());
+}
+
+void test_ignore_regions_are_skipped_across_chunks() {
+  const char *input = "Hola <!--ign--><span>12:04:33</span><!--/ign--> mundo <!--ig<!--ign-->x<!--/ign-->!";
+  const char *page = "<p>Hola <!--ign--><span>12:04:33</span><!--/ign--> mundo</p>";
+  for (size_t chunk : {size_t{1}, size_t{4}, SIZE_MAX}) {
+    TEST_ASSERT_EQUAL_STRING("Hola  mundo <!--ig!",
+                             normalize(input, NormalizeMode::None, chunk, "<!--ign-->", "<!--/ign-->").c_str());
+    TEST_ASSERT_EQUAL_STRING("Hola mundo",
+                             normalize(page, NormalizeMode::Text, chunk, "<!--ign-->", "<!--/ign-->").c_str());
+  }
+  // A marker prefix that never completes is released unchanged; without an
+  // end marker the region runs to the end.
+  TEST_ASSERT_EQUAL_STRING("abab<!--ig", normalize("abab<!--ig", NormalizeMode::None, 1, "<!--ign-->").c_str());
+  TEST_ASSERT_EQUAL_STRING("aab", normalize("aababxyz", NormalizeMode::None, 1, "abx").c_str());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_text_mode_reduces_markup_to_visible_text);
+  RUN_TEST(test_output_does_not_depend_on_chunking);
+  RUN_TEST(test_whitespace_and_none_modes);
+  RUN_TEST(test_ignore_regions_are_skipped_across_chunks);
+  return UNITY_END();
+}
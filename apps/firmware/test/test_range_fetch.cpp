@@ -0,0 +1,165 @@
+#include <Arduino.h>
+#include <ContentExtractor.h>
+#include <FetchEngine.h>
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+
+namespace {
+// Answers one request with `response` and keeps the head it received.
+class OneShotServer {
+ public:
+  explicit OneShotServer(const String &response) : response_(response) {
+    listenFd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(listenFd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    ::listen(listenFd_, 1);
+    socklen_t len = sizeof(addr);
+    ::getsockname(listenFd_, reinterpret_cast<sockaddr *>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+    thread_ = std::thread([this]() { serve(); });
+  }
+
+  ~OneShotServer() {
+    thread_.join();
+    ::close(listenFd_);
+  }
+
+  String url() const { return String("http://127.0.0.1:") + port_ + "/page"; }
+  const String &head() const { return head_; }
+
+ private:
+  void serve() {
+    const int fd = ::accept(listenFd_, nullptr, nullptr);
+    char buffer[512];
+    while (head_.indexOf("\r\n\r\n") < 0) {
+      const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+      if (n <= 0) {
+        break;
+      }
+      head_.append(buffer, static_cast<size_t>(n));
+    }
+    ::send(fd, response_.c_str(), response_.length(), MSG_NOSIGNAL);
+    ::close(fd);
+  }
+
+  String response_;
+  String head_;
+  int listenFd_ = -1;
+  uint16_t port_ = 0;
+  std::thread thread_;
+};
+
+class BodySink : public FetchSink {
+ public:
+  bool onBody(const char *data, size_t length) override {
+    body.append(data, length);
+    return true;
+  }
+  void onComplete(const FetchResult &completed) override {
+    result = completed;
+    done = true;
+  }
+
+  String body;
+  FetchResult result;
+  bool done = false;
+};
+
+void fetchRange(const String &url, size_t start, size_t bytes, BodySink &sink) {
+  FetchEngine engine;
+  engine.begin(1, 0);
+  FetchRequest request;
+  request.url = url;
+  request.rangeStart = start;
+  request.rangeBytes = bytes;
+  TEST_ASSERT_TRUE(engine.start(request, sink));
+  const unsigned long startedAt = millis();
+  while (!sink.done && millis() - startedAt < 5000) {
+    engine.poll(50);
+  }
+  TEST_ASSERT_TRUE(sink.done);
+}
+
+SiteConfig markersConfig() {
+  SiteConfig config;
+  config.extractMode = ExtractMode::Markers;
+  config.startMarker = "<b>";
+  config.endMarker = "</b>";
+  return config;
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_partial_response_reports_its_place_in_the_page() {
+  OneShotServer server(
+      "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes 4096-4105/20000\r\n"
+      "Content-Length: 10\r\nConnection: close\r\n\r\n<b>12</b>x");
+  BodySink sink;
+  fetchRange(server.url(), 4096, 10, sink);
+  TEST_ASSERT_TRUE(server.head().indexOf("\r\nRange: bytes=4096-4105\r\n") > 0);
+  TEST_ASSERT_TRUE(sink.result.ok);
+  TEST_ASSERT_TRUE(sink.result.partial);
+  TEST_ASSERT_EQUAL(4096, sink.result.rangeStart);
+  TEST_ASSERT_EQUAL(20000, sink.result.totalBytes);
+  TEST_ASSERT_EQUAL_STRING("<b>12</b>x", sink.body.c_str());
+}
+
+void test_server_without_ranges_sends_the_whole_page() {
+  OneShotServer server("HTTP/1.1 200 OK\r\nContent-Length: 12\r\nConnection: close\r\n\r\nhola <b>1</b>");
+  BodySink sink;
+  fetchRange(server.url(), 100, 50, sink);
+  TEST_ASSERT_TRUE(sink.result.ok);
+  TEST_ASSERT_EQUAL(200, sink.result.statusCode);
+  TEST_ASSERT_FALSE(sink.result.partial);
+  TEST_ASSERT_EQUAL(12, sink.result.bodyBytes);
+}
+
+void test_marker_window_follows_the_last_position() {
+  const SiteConfig config = markersConfig();
+  // Streamed from page offset 5000: the offsets are the page's, not the body's.
+  ArenaBuffer out;
+  MarkerStream stream;
+  stream.begin(config, out, 1024, 5000);
+  const char body[] = "....<b> precio 10 </b>....";
+  stream.update(body, 12);
+  stream.update(body + 12, sizeof(body) - 13);
+  TEST_ASSERT_TRUE(stream.finish().ok);
+  TEST_ASSERT_EQUAL(5004, stream.markersStart());
+  TEST_ASSERT_EQUAL(5022, stream.markersEnd());
+
+  SiteState state;
+  state.markerAt = 5004;
+  state.markerBytes = 18;
+  state.pageBytes = 60000;
+  ByteWindow window = markerWindowFor(config, state);
+  TEST_ASSERT_EQUAL(5004 - MARKERS_RANGE_MARGIN, window.start);
+  TEST_ASSERT_EQUAL(18 + 2 * MARKERS_RANGE_MARGIN, window.bytes);
+
+  // Not worth it on small pages, nor once the server refused a Range.
+  state.pageBytes = 6000;
+  TEST_ASSERT_EQUAL(0, markerWindowFor(config, state).bytes);
+  state.pageBytes = 60000;
+  state.rangeRefused = true;
+  TEST_ASSERT_EQUAL(0, markerWindowFor(config, state).bytes);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_partial_response_reports_its_place_in_the_page);
+  RUN_TEST(test_server_without_ranges_sends_the_whole_page);
+  RUN_TEST(test_marker_window_follows_the_last_position);
+  return UNITY_END();
+}
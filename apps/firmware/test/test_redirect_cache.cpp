@@ -0,0 +1,148 @@
+#include <Arduino.h>
+#include <FetchEngine.h>
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
+namespace {
+// Answers one connection per response, in order.
+class ScriptedServer {
+ public:
+  explicit ScriptedServer(std::vector<String> responses) : responses_(std::move(responses)) {
+    listenFd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::bind(listenFd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    ::listen(listenFd_, 4);
+    socklen_t len = sizeof(addr);
+    ::getsockname(listenFd_, reinterpret_cast<sockaddr *>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+    thread_ = std::thread([this]() { serve(); });
+  }
+
+  ~ScriptedServer() {
+    thread_.join();
+    ::close(listenFd_);
+  }
+
+  String url(const char *path) const { return String("http://127.0.0.1:") + port_ + path; }
+
+ private:
+  void serve() {
+    for (const String &response : responses_) {
+      const int fd = ::accept(listenFd_, nullptr, nullptr);
+      String head;
+      char buffer[512];
+      while (head.indexOf("\r\n\r\n") < 0) {
+        const ssize_t n = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+          break;
+        }
+        head.append(buffer, static_cast<size_t>(n));
+      }
+      ::send(fd, response.c_str(), response.length(), MSG_NOSIGNAL);
+      ::close(fd);
+    }
+  }
+
+  std::vector<String> responses_;
+  int listenFd_ = -1;
+  uint16_t port_ = 0;
+  std::thread thread_;
+};
+
+class ResultSink : public FetchSink {
+ public:
+  bool onBody(const char *data, size_t length) override {
+    (void)data;
+    (void)length;
+    return true;
+  }
+  void onComplete(const FetchResult &completed) override {
+    result = completed;
+    done = true;
+  }
+
+  FetchResult result;
+  bool done = false;
+};
+
+void fetch(const String &url, FetchResult &result) {
+  FetchEngine engine;
+  engine.begin(1, 0);
+  FetchRequest request;
+  request.url = url;
+  request.timeoutMs = 2000;
+  ResultSink sink;
+  engine.start(request, sink);
+  const unsigned long startedAt = millis();
+  while (!sink.done && millis() - startedAt < 5000) {
+    engine.poll(50);
+  }
+  TEST_ASSERT_TRUE(sink.done);
+  result = sink.result;
+}
+
+const char kMoved[] = "HTTP/1.1 301 Moved Permanently\r\nLocation: /new\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_permanent_redirect_to_a_page_is_remembered() {
+  ScriptedServer server({kMoved, "HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\nok"});
+  FetchResult result;
+  fetch(server.url("/old"), result);
+  TEST_ASSERT_TRUE(result.ok);
+  TEST_ASSERT_EQUAL(200, result.statusCode);
+  String resolved;
+  rememberRedirect(result, resolved);
+  TEST_ASSERT_EQUAL_STRING(server.url("/new").c_str(), resolved.c_str());
+}
+
+void test_permanent_redirect_to_a_404_is_not_remembered() {
+  ScriptedServer server({kMoved, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"});
+  FetchResult result;
+  fetch(server.url("/old"), result);
+  TEST_ASSERT_EQUAL(404, result.statusCode);
+  TEST_ASSERT_FALSE(result.permanentUrl.isEmpty());
+  // A URL cached by an earlier check is dropped too.
+  String resolved = server.url("/new");
+  rememberRedirect(result, resolved);
+  TEST_ASSERT_TRUE(resolved.isEmpty());
+}
+
+void test_failed_fetch_forgets_the_redirect() {
+  FetchResult failed;
+  failed.ok = false;
+  failed.permanentUrl = "http://example.test/new";
+  String resolved = "http://example.test/new";
+  rememberRedirect(failed, resolved);
+  TEST_ASSERT_TRUE(resolved.isEmpty());
+
+  // A plain 200 without redirects keeps going to the cached URL.
+  FetchResult direct;
+  direct.ok = true;
+  direct.statusCode = 200;
+  resolved = "http://example.test/new";
+  rememberRedirect(direct, resolved);
+  TEST_ASSERT_EQUAL_STRING("http://example.test/new", resolved.c_str());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_permanent_redirect_to_a_page_is_remembered);
+  RUN_TEST(test_permanent_redirect_to_a_404_is_not_remembered);
+  RUN_TEST(test_failed_fetch_forgets_the_redirect);
+  return UNITY_END();
+}
@@ -36,11 +36,59 @@ void test_select_missing_returns_false() {
   TEST_ASSERT_FALSE(css.selectInnerText(html, "span.otra", text));
 }
 
+void test_select_nth_of_type_with_nested_children() {
+  const String html =
+      "<ul><li class=\"item\"><b>Uno</b><br></li><li class=\"item\"><b>Dos</b> <img src=\"x.png\"></li></ul>";
+  CssSelectMini css;
+  String text;
+  TEST_ASSERT_TRUE(css.selectInnerText(html, "li.item:nth-of-type(2)", text));
+  TEST_ASSERT_EQUAL_STRING("<b>Dos</b> <img src=\"x.png\">", text.c_str());
+}
+
+void test_select_skips_script_comments_and_quoted_gt() {
+  const String html =
+      "<script>if (a<b) { x = '<span id=\"price\">falso</span>'; }</script>"
+      "<!-- <span id=\"price\">comentario</span> -> -->"
+      "<a title=\"a > b\" data-x='<span id=price>'>enlace</a>"
+      "<input disabled class=\"qty\" value=\"3\">"
+      "<span data-tip=\"1 > 0\" id=\"price\">$ 5</span>";
+  CssSelectMini css;
+  String text;
+  TEST_ASSERT_TRUE(css.selectInnerText(html, "#price", text));
+  TEST_ASSERT_EQUAL_STRING("$ 5", text.c_str());
+  TEST_ASSERT_TRUE(css.selectInnerText(html, "input.qty", text));
+  TEST_ASSERT_EQUAL_STRING("", text.c_str());
+}
+
+void test_select_each_visits_every_match_once() {
+  const String html =
+      "<ul><li class=\"item\">Uno</li><li>otro</li><li class=\"item\"> Dos <ul><li class=\"item\">anidado</li></ul>"
+      "</li><li class=\"item\">Tres</li></ul>";
+  CssSelectMini css;
+  std::vector<String> items;
+  TEST_ASSERT_TRUE(css.selectEach(html.c_str(), html.length(), "li.item", [&](size_t start, size_t length) {
+    items.push_back(String(html.c_str() + start, length));
+    return true;
+  }));
+  // The nested match is part of the item around it.
+  TEST_ASSERT_EQUAL(3, items.size());
+  TEST_ASSERT_EQUAL_STRING("Uno", items[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("Dos <ul><li class=\"item\">anidado</li></ul>", items[1].c_str());
+  TEST_ASSERT_EQUAL_STRING("Tres", items[2].c_str());
+
+  size_t visited = 0;
+  css.selectEach(html.c_str(), html.length(), "li.item", [&](size_t, size_t) { return ++visited < 2; });
+  TEST_ASSERT_EQUAL(2, visited);
+}
+
 int main(int, char **) {
   UNITY_BEGIN();
   RUN_TEST(test_select_by_id);
   RUN_TEST(test_select_by_class_case_insensitive);
   RUN_TEST(test_select_nth_of_type);
   RUN_TEST(test_select_missing_returns_false);
+  RUN_TEST(test_select_nth_of_type_with_nested_children);
+  RUN_TEST(test_select_skips_script_comments_and_quoted_gt);
+  RUN_TEST(test_select_each_visits_every_match_once);
   return UNITY_END();
 }
@@ -0,0 +1,97 @@
+#include <Arduino.h>
+#include <LoadMonitor.h>
+#include <ShardAssignment.h>
+#include <unity.h>
+
+namespace {
+SiteRecord siteWith(const char *id, uint32_t intervalSeconds) {
+  SiteRecord record;
+  record.config.id = id;
+  record.config.intervalSeconds = intervalSeconds;
+  return record;
+}
+}  // namespace
+
+void test_load_monitor_flags_a_schedule_the_slots_cannot_keep() {
+  LoadMonitor monitor;
+  LoadMonitor::Options options;
+  options.minHeapBytes = 16 * 1024;
+  monitor.begin(2, options);
+  SiteList sites;
+  for (int i = 0; i < 10; ++i) {
+    sites.push_back(siteWith("s", 60));
+  }
+  sites.back().config.paused = true;
+  monitor.checkFinished(2000);
+  monitor.noteFreeHeap(40 * 1024);
+  LoadReport report = monitor.report(sites, 1000);
+  TEST_ASSERT_EQUAL_UINT32(1, report.seq);
+  TEST_ASSERT_EQUAL(9, report.active);
+  TEST_ASSERT_EQUAL_UINT32(9000, report.cycleMs);
+  // 9 checks of 2 s every 60 s on 2 slots.
+  TEST_ASSERT_EQUAL_UINT16(15, report.utilizationPct);
+  TEST_ASSERT_NULL(report.overload);
+
+  for (int i = 0; i < 100; ++i) {
+    monitor.checkFinished(14000);
+  }
+  report = monitor.report(sites, 2000);
+  TEST_ASSERT_EQUAL_STRING("utilization", report.overload);
+  TEST_ASSERT_EQUAL_UINT32(100, report.checks);
+}
+
+void test_load_monitor_reports_lag_and_heap_pressure() {
+  LoadMonitor monitor;
+  LoadMonitor::Options options;
+  options.overloadLagMs = 30000;
+  options.minHeapBytes = 16 * 1024;
+  monitor.begin(4, options);
+  SiteList sites;
+  sites.push_back(siteWith("a", 60));
+  monitor.checkStarted(45000);
+  TEST_ASSERT_EQUAL_STRING("lag", monitor.report(sites, 0).overload);
+  // Still waiting right now counts as well, even with no check started.
+  sites[0].state.checkedSinceBoot = true;
+  sites[0].state.lastCheckAt = 0;
+  const LoadReport waiting = monitor.report(sites, 100000);
+  TEST_ASSERT_EQUAL_UINT32(40000, waiting.lagMs);
+  sites[0].state.lastCheckAt = 100000;
+  monitor.noteFreeHeap(12 * 1024);
+  const LoadReport pressed = monitor.report(sites, 100000);
+  TEST_ASSERT_EQUAL_STRING("heap", pressed.overload);
+  TEST_ASSERT_EQUAL(12 * 1024, pressed.minFreeHeap);
+  TEST_ASSERT_NULL(monitor.report(sites, 100000).overload);
+}
+
+void test_shard_assignment_applies_complete_epochs_only() {
+  ShardAssignment shard;
+  TEST_ASSERT_TRUE(shard.owns("cualquiera"));
+  TEST_ASSERT_TRUE(shard.add(3, 0, 2, {"b", "d"}) == ShardAssignment::Result::Collecting);
+  TEST_ASSERT_FALSE(shard.assigned());
+  TEST_ASSERT_TRUE(shard.add(3, 1, 2, {"a"}) == ShardAssignment::Result::Applied);
+  TEST_ASSERT_EQUAL_UINT32(3, shard.epoch());
+  TEST_ASSERT_TRUE(shard.owns("a"));
+  TEST_ASSERT_FALSE(shard.owns("c"));
+
+  // A lost part drops the whole epoch; older epochs never replace a newer one.
+  TEST_ASSERT_TRUE(shard.add(4, 0, 3, {"c"}) == ShardAssignment::Result::Collecting);
+  TEST_ASSERT_TRUE(shard.add(4, 2, 3, {"e"}) == ShardAssignment::Result::Rejected);
+  TEST_ASSERT_TRUE(shard.add(2, 0, 1, {"c"}) == ShardAssignment::Result::Rejected);
+  TEST_ASSERT_FALSE(shard.owns("c"));
+
+  SiteList sites;
+  sites.push_back(siteWith("d", 60));
+  sites.push_back(siteWith("z", 60));
+  const std::vector<String> missing = shard.missing(sites);
+  TEST_ASSERT_EQUAL(2, missing.size());
+  TEST_ASSERT_EQUAL_STRING("a", missing[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("b", missing[1].c_str());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_load_monitor_flags_a_schedule_the_slots_cannot_keep);
+  RUN_TEST(test_load_monitor_reports_lag_and_heap_pressure);
+  RUN_TEST(test_shard_assignment_applies_complete_epochs_only);
+  return UNITY_END();
+}
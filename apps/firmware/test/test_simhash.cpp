@@ -0,0 +1,82 @@
+#include <Arduino.h>
+#include <SimHash.h>
+#include <unity.h>
+
+#include <cstring>
+
+namespace {
+uint64_t fingerprint(const String &text, size_t chunk = SIZE_MAX) {
+  SimHash simhash;
+  simhash.begin();
+  const size_t length = text.length();
+  for (size_t offset = 0; offset < length; offset += chunk) {
+    simhash.update(text.c_str() + offset, std::min(chunk, length - offset));
+  }
+  return simhash.finish();
+}
+
+// A long article whose only difference between versions is a counter and an
+// ad slot, as a full-page check sees it after text normalization.
+String article(const char *visits, const char *ad) {
+  String text = "Noticias del día. ";
+  for (int i = 0; i < 40; ++i) {
+    text += "El ayuntamiento aprobó el presupuesto número ";
+    text += String(i);
+    text += " tras una sesión larga con vecinos y comerciantes de la zona centro. ";
+  }
+  text += "Visitas: ";
+  text += visits;
+  text += ". Publicidad: ";
+  text += ad;
+  return text;
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_fingerprint_ignores_case_punctuation_and_chunking() {
+  const uint64_t whole = fingerprint("Precio final: 1.299 EUR, envío gratis");
+  TEST_ASSERT_TRUE(whole != 0);
+  for (size_t chunk : {size_t{1}, size_t{3}, size_t{7}}) {
+    TEST_ASSERT_TRUE(whole == fingerprint("Precio final: 1.299 EUR, envío gratis", chunk));
+  }
+  TEST_ASSERT_TRUE(whole == fingerprint("precio  FINAL 1 299 eur envío\n gratis!"));
+  TEST_ASSERT_TRUE(fingerprint("   ...  ") == 0);
+  TEST_ASSERT_TRUE(fingerprint("hola") != 0);
+}
+
+void test_small_edits_stay_close_and_rewrites_do_not() {
+  const uint64_t base = fingerprint(article("10231", "Zapatillas -20%"));
+  const uint64_t counter = fingerprint(article("10232", "Zapatillas -20%"));
+  const uint64_t ad = fingerprint(article("10290", "Hipotecas a tipo fijo"));
+  String rewritten;
+  for (int i = 0; i < 40; ++i) {
+    rewritten += "Resultados de la jornada ";
+    rewritten += String(i);
+    rewritten += " con goles en el último minuto y el estadio lleno. ";
+  }
+  const uint64_t other = fingerprint(rewritten);
+  TEST_ASSERT_LESS_OR_EQUAL(3, SimHash::distance(base, counter));
+  TEST_ASSERT_LESS_OR_EQUAL(6, SimHash::distance(base, ad));
+  TEST_ASSERT_GREATER_THAN(16, SimHash::distance(base, other));
+}
+
+void test_hex_round_trip() {
+  uint64_t parsed = 0;
+  TEST_ASSERT_EQUAL_STRING("00ff00000000a1b2", SimHash::toHex(0x00ff00000000a1b2ULL).c_str());
+  TEST_ASSERT_TRUE(SimHash::fromHex("00FF00000000A1B2", parsed));
+  TEST_ASSERT_TRUE(parsed == 0x00ff00000000a1b2ULL);
+  TEST_ASSERT_FALSE(SimHash::fromHex("", parsed));
+  TEST_ASSERT_FALSE(SimHash::fromHex("null", parsed));
+  TEST_ASSERT_FALSE(SimHash::fromHex("00ff00000000a1bz", parsed));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fingerprint_ignores_case_punctuation_and_chunking);
+  RUN_TEST(test_small_edits_stay_close_and_rewrites_do_not);
+  RUN_TEST(test_hex_round_trip);
+  return UNITY_END();
+}
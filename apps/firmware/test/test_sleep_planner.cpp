@@ -0,0 +1,103 @@
+#include <Arduino.h>
+#include <SleepPlanner.h>
+#include <unity.h>
+
+namespace {
+SleepPlanner::Options optionsFor(PowerPolicy policy) {
+  SleepPlanner::Options options;
+  options.policy = policy;
+  options.minSleepMs = 1000;
+  options.batchWindowMs = 5000;
+  options.deepSleepMinMs = 60000;
+  options.deepSleepMaxMs = 300000;
+  options.wakeLeadMs = 4000;
+  return options;
+}
+
+IdleState idleFor(uint32_t nextCheckMs) {
+  IdleState idle;
+  idle.nextCheckMs = nextCheckMs;
+  idle.nextReportMs = 50000;
+  idle.mqttIdleMs = 15000;
+  idle.retainable = true;
+  return idle;
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_light_sleep_ends_before_the_next_work() {
+  SleepPlanner planner;
+  planner.begin(optionsFor(PowerPolicy::AlwaysOn));
+  TEST_ASSERT_EQUAL(SleepKind::Awake, planner.plan(idleFor(600000)).kind);
+  TEST_ASSERT_EQUAL_UINT32(0, planner.batchWindowMs());
+
+  planner.begin(optionsFor(PowerPolicy::LightSleep));
+  TEST_ASSERT_EQUAL_UINT32(5000, planner.batchWindowMs());
+  // The MQTT keepalive comes first.
+  SleepPlan plan = planner.plan(idleFor(600000));
+  TEST_ASSERT_EQUAL(SleepKind::Light, plan.kind);
+  TEST_ASSERT_EQUAL_UINT32(15000, plan.durationMs);
+  plan = planner.plan(idleFor(7000));
+  TEST_ASSERT_EQUAL_UINT32(7000, plan.durationMs);
+
+  TEST_ASSERT_EQUAL(SleepKind::Awake, planner.plan(idleFor(999)).kind);
+  IdleState busy = idleFor(600000);
+  busy.busy = true;
+  TEST_ASSERT_EQUAL(SleepKind::Awake, planner.plan(busy).kind);
+}
+
+void test_deep_sleep_only_for_long_retainable_gaps() {
+  SleepPlanner planner;
+  planner.begin(optionsFor(PowerPolicy::DeepSleep));
+  // Wakes early to be online when the check is due; the LOAD report and the
+  // keepalive do not keep it up.
+  SleepPlan plan = planner.plan(idleFor(90000));
+  TEST_ASSERT_EQUAL(SleepKind::Deep, plan.kind);
+  TEST_ASSERT_EQUAL_UINT32(86000, plan.durationMs);
+  TEST_ASSERT_EQUAL_UINT32(300000, planner.plan(idleFor(3600000)).durationMs);
+
+  // Short gaps and state that would not survive fall back to light sleep.
+  plan = planner.plan(idleFor(30000));
+  TEST_ASSERT_EQUAL(SleepKind::Light, plan.kind);
+  TEST_ASSERT_EQUAL_UINT32(15000, plan.durationMs);
+  IdleState volatileState = idleFor(90000);
+  volatileState.retainable = false;
+  TEST_ASSERT_EQUAL(SleepKind::Light, planner.plan(volatileState).kind);
+}
+
+void test_awake_time_per_cycle_survives_deep_sleep() {
+  SleepPlanner planner;
+  planner.begin(optionsFor(PowerPolicy::DeepSleep));
+  planner.sleeping(300, SleepKind::Light);
+  planner.woke(10300);
+  planner.sleeping(10400, SleepKind::Light);
+  planner.woke(20400);
+  TEST_ASSERT_EQUAL_UINT32(2, planner.stats().cycles);
+  TEST_ASSERT_EQUAL_UINT32(100, planner.stats().awakeMsLast);
+  TEST_ASSERT_EQUAL_UINT32(300, planner.stats().awakeMsMax);
+  TEST_ASSERT_EQUAL_UINT32(200, planner.stats().awakeMsAvg());
+  TEST_ASSERT_EQUAL_UINT32(1, planner.stats().awakePct());
+
+  planner.sleeping(21400, SleepKind::Deep);
+  planner.retain(60000);
+  // The wake is a fresh boot that finds the stats in RTC memory, once.
+  SleepPlanner woken;
+  TEST_ASSERT_TRUE(woken.begin(optionsFor(PowerPolicy::DeepSleep)));
+  TEST_ASSERT_EQUAL_UINT32(3, woken.stats().cycles);
+  TEST_ASSERT_EQUAL_UINT32(1, woken.stats().deepSleeps);
+  TEST_ASSERT_EQUAL_UINT32(2, woken.stats().lightSleeps);
+  TEST_ASSERT_EQUAL_UINT32(80000, static_cast<uint32_t>(woken.stats().sleptMsTotal));
+  TEST_ASSERT_FALSE(woken.begin(optionsFor(PowerPolicy::DeepSleep)));
+  TEST_ASSERT_EQUAL_UINT32(0, woken.stats().cycles);
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_light_sleep_ends_before_the_next_work);
+  RUN_TEST(test_deep_sleep_only_for_long_retainable_gaps);
+  RUN_TEST(test_awake_time_per_cycle_survives_deep_sleep);
+  return UNITY_END();
+}
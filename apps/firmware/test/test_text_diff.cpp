@@ -0,0 +1,89 @@
+#include <Arduino.h>
+#include <Lzf.h>
+#include <TextDiff.h>
+#include <unity.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+std::string oldPart(const std::string &text, const DiffHunk &hunk) { return text.substr(hunk.oldOffset, hunk.oldLength); }
+std::string newPart(const std::string &text, const DiffHunk &hunk) { return text.substr(hunk.newOffset, hunk.newLength); }
+
+DiffResult diff(const std::string &before, const std::string &after) {
+  return diffWords(before.data(), before.size(), after.data(), after.size());
+}
+}  // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_price_change_is_a_single_word_hunk() {
+  const std::string before = "Zapatilla Runner X Precio: 1.299€ Antes 1.499€ Stock: 12 unidades Envío gratis";
+  const std::string after = "Zapatilla Runner X Precio: 1.199€ Antes 1.499€ Stock: 12 unidades Envío gratis";
+  const DiffResult result = diff(before, after);
+  TEST_ASSERT_TRUE(result.exact);
+  TEST_ASSERT_EQUAL(1, result.hunks.size());
+  TEST_ASSERT_EQUAL_STRING("1.299€", oldPart(before, result.hunks[0]).c_str());
+  TEST_ASSERT_EQUAL_STRING("1.199€", newPart(after, result.hunks[0]).c_str());
+  TEST_ASSERT_EQUAL(0, diff(before, before).hunks.size());
+}
+
+void test_insertions_deletions_and_separate_hunks() {
+  const std::string before = "Stock: 12 unidades | Talla 42 agotada | Color rojo";
+  const std::string after = "Stock: 3 unidades | Talla 42 | Color rojo y azul";
+  const DiffResult result = diff(before, after);
+  TEST_ASSERT_TRUE(result.exact);
+  TEST_ASSERT_EQUAL(3, result.hunks.size());
+  TEST_ASSERT_EQUAL_STRING("12", oldPart(before, result.hunks[0]).c_str());
+  TEST_ASSERT_EQUAL_STRING("3", newPart(after, result.hunks[0]).c_str());
+  TEST_ASSERT_EQUAL_STRING("agotada", oldPart(before, result.hunks[1]).c_str());
+  TEST_ASSERT_EQUAL(0, result.hunks[1].newLength);
+  TEST_ASSERT_EQUAL(0, result.hunks[2].oldLength);
+  TEST_ASSERT_EQUAL_STRING("y azul", newPart(after, result.hunks[2]).c_str());
+}
+
+void test_budget_exhaustion_falls_back_to_one_span() {
+  std::string before;
+  std::string after;
+  for (int i = 0; i < 80; ++i) {
+    before += "a" + std::to_string(i) + " ";
+    after += "b" + std::to_string(i) + " ";
+  }
+  before = "Inicio " + before + "Fin";
+  after = "Inicio " + after + "Fin";
+  const DiffResult result = diff(before, after);
+  TEST_ASSERT_FALSE(result.exact);
+  TEST_ASSERT_EQUAL(1, result.hunks.size());
+  TEST_ASSERT_EQUAL_STRING("a0", oldPart(before, result.hunks[0]).substr(0, 2).c_str());
+  TEST_ASSERT_EQUAL_STRING("b79", newPart(after, result.hunks[0]).substr(newPart(after, result.hunks[0]).size() - 3).c_str());
+}
+
+void test_lzf_round_trip() {
+  std::string text;
+  for (int i = 0; i < 50; ++i) {
+    text += "<li class=\"item\">Producto " + std::to_string(i) + " - Precio 19,99€ - Stock 3</li>\n";
+  }
+  std::vector<uint8_t> packed(text.size());
+  const size_t packedLength = lzf::compress(reinterpret_cast<const uint8_t *>(text.data()), text.size(),
+                                            packed.data(), packed.size());
+  TEST_ASSERT_GREATER_THAN(0, packedLength);
+  TEST_ASSERT_LESS_THAN(text.size() / 3, packedLength);
+  std::vector<uint8_t> unpacked(text.size());
+  TEST_ASSERT_EQUAL(text.size(), lzf::decompress(packed.data(), packedLength, unpacked.data(), unpacked.size()));
+  TEST_ASSERT_EQUAL(0, memcmp(unpacked.data(), text.data(), text.size()));
+  TEST_ASSERT_EQUAL(0, lzf::decompress(packed.data(), packedLength, unpacked.data(), text.size() - 1));
+  const uint8_t random[] = {0x11, 0x93, 0x27, 0xA5};
+  TEST_ASSERT_EQUAL(0, lzf::compress(random, sizeof(random), packed.data(), 3));
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_price_change_is_a_single_word_hunk);
+  RUN_TEST(test_insertions_deletions_and_separate_hunks);
+  RUN_TEST(test_budget_exhaustion_falls_back_to_one_span);
+  RUN_TEST(test_lzf_round_trip);
+  return UNITY_END();
+}
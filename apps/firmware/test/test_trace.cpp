@@ -0,0 +1,92 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <TraceRing.h>
+#include <unity.h>
+
+#include <vector>
+
+void test_ring_keeps_the_newest_records() {
+  TraceRing ring;
+  for (uint32_t i = 0; i < TRACE_RING_RECORDS + 10; ++i) {
+    ring.record(TraceEvent::Heap, 0, 0, i, 0);
+  }
+  TEST_ASSERT_EQUAL_UINT32(TRACE_RING_RECORDS + 10, ring.written());
+  TEST_ASSERT_EQUAL_UINT32(10, ring.oldest());
+
+  TraceRecord records[4];
+  TEST_ASSERT_EQUAL(0, ring.copy(9, 4, records));
+  TEST_ASSERT_EQUAL(4, ring.copy(10, 4, records));
+  TEST_ASSERT_EQUAL_UINT32(10, records[0].a);
+  TEST_ASSERT_EQUAL_UINT32(13, records[3].a);
+  TEST_ASSERT_EQUAL(2, ring.copy(ring.written() - 2, 4, records));
+  TEST_ASSERT_EQUAL_UINT32(TRACE_RING_RECORDS + 9, records[1].a);
+}
+
+void test_records_round_trip_through_a_part() {
+  TraceRing ring;
+  ring.record(TraceEvent::CheckEnd, traceSiteTag("sitio-1"), 2, 1234, 404);
+  ring.record(TraceEvent::FetchDone, 0xbeef, 1, 70000, 0xfffffff0u);
+
+  TraceDumper dumper;
+  dumper.begin(ring, 3);
+  StaticJsonDocument<1024> doc;
+  TEST_ASSERT_TRUE(dumper.next(ring, "esp32-a", doc.to<JsonObject>()));
+  TEST_ASSERT_EQUAL_UINT32(3, doc["dump"].as<uint32_t>());
+  TEST_ASSERT_EQUAL(1, doc["parts"].as<int>());
+  TEST_ASSERT_EQUAL(2, doc["records"].as<int>());
+
+  std::vector<TraceRecord> decoded;
+  TEST_ASSERT_TRUE(decodeTracePart(doc["data"] | "", decoded));
+  TEST_ASSERT_EQUAL(2, decoded.size());
+  TEST_ASSERT_EQUAL_STRING("CHECK_END", traceEventName(decoded[0].event));
+  TEST_ASSERT_EQUAL(traceSiteTag("sitio-1"), decoded[0].site);
+  TEST_ASSERT_EQUAL(2, decoded[0].flags);
+  TEST_ASSERT_EQUAL_UINT32(1234, decoded[0].a);
+  TEST_ASSERT_EQUAL_UINT32(404, decoded[0].b);
+  TEST_ASSERT_EQUAL(0xbeef, decoded[1].site);
+  TEST_ASSERT_EQUAL_UINT32(0xfffffff0u, decoded[1].b);
+  TEST_ASSERT_FALSE(dumper.next(ring, "esp32-a", doc.to<JsonObject>()));
+  TEST_ASSERT_FALSE(decodeTracePart("AAAA", decoded));
+}
+
+void test_dump_reports_records_overwritten_while_streaming() {
+  TraceRing ring;
+  for (uint32_t i = 0; i < TRACE_RING_RECORDS; ++i) {
+    ring.record(TraceEvent::Heap, 0, 0, i, 0);
+  }
+  TraceDumper dumper;
+  dumper.begin(ring, 1);
+  StaticJsonDocument<2048> doc;
+  TEST_ASSERT_TRUE(dumper.next(ring, "esp32-a", doc.to<JsonObject>()));
+  TEST_ASSERT_EQUAL(0, doc["lost"].as<int>());
+  const int parts = doc["parts"].as<int>();
+  TEST_ASSERT_EQUAL((TRACE_RING_RECORDS + TRACE_RECORDS_PER_PART - 1) / TRACE_RECORDS_PER_PART, parts);
+
+  // The device keeps running: the second part's records are partly gone.
+  for (uint32_t i = 0; i < TRACE_RECORDS_PER_PART + 5; ++i) {
+    ring.record(TraceEvent::CheckStart, 0, 0, 0, 0);
+  }
+  TEST_ASSERT_TRUE(dumper.next(ring, "esp32-a", doc.to<JsonObject>()));
+  TEST_ASSERT_EQUAL(5, doc["lost"].as<int>());
+  TEST_ASSERT_EQUAL(TRACE_RECORDS_PER_PART - 5, doc["records"].as<int>());
+  TEST_ASSERT_EQUAL_UINT32(TRACE_RECORDS_PER_PART + 5, doc["seq"].as<uint32_t>());
+
+  // A part that could not be published goes out again.
+  dumper.retry();
+  TEST_ASSERT_TRUE(dumper.next(ring, "esp32-a", doc.to<JsonObject>()));
+  TEST_ASSERT_EQUAL(1, doc["part"].as<int>());
+  int sent = 2;
+  while (dumper.next(ring, "esp32-a", doc.to<JsonObject>())) {
+    ++sent;
+  }
+  TEST_ASSERT_EQUAL(parts, sent);
+  TEST_ASSERT_FALSE(dumper.active());
+}
+
+int main(int, char **) {
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_keeps_the_newest_records);
+  RUN_TEST(test_records_round_trip_through_a_part);
+  RUN_TEST(test_dump_reports_records_overwritten_while_streaming);
+  return UNITY_END();
+}
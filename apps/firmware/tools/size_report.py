@@ -0,0 +1,68 @@
+# Flash and RAM use of each ESP32 build profile. Runs after every link
+# (extra_scripts in platformio.ini), keeps the figures of each environment in
+# .pio/build/size-report.json and prints all profiles built so far side by
+# side, so dropping an extraction mode shows what it saves.
+import json
+import os
+import re
+import subprocess
+
+Import("env")  # noqa: F821 (provided by PlatformIO)
+
+# Same sections PlatformIO's own size check counts for the ESP32.
+DEFAULT_FLASH = r"^(?:\.iram0\.text|\.iram0\.vectors|\.dram0\.data|\.flash\.text|\.flash\.rodata)\s+([0-9]+).*"
+DEFAULT_RAM = r"^(?:\.dram0\.data|\.dram0\.bss|\.noinit)\s+([0-9]+).*"
+MODES = ("FULL", "SELECTOR", "MARKERS", "REGEX", "LIST")
+
+
+def section_total(output, pattern):
+    regex = re.compile(pattern)
+    total = 0
+    for line in output.splitlines():
+        match = regex.search(line)
+        if match:
+            total += int(match.group(1))
+    return total
+
+
+def defines(env):
+    values = {}
+    for define in env.get("CPPDEFINES", []):
+        if isinstance(define, (list, tuple)):
+            values[define[0]] = str(define[1]) if len(define) > 1 else "1"
+        else:
+            values[str(define)] = "1"
+    return values
+
+
+def enabled_modes(env):
+    values = defines(env)
+    return [mode.lower() for mode in MODES if values.get("EXTRACT_MODE_" + mode, "1") != "0"]
+
+
+def report(target, source, env):
+    elf = str(target[0])
+    output = subprocess.check_output([env.subst("$SIZETOOL"), "-A", "-d", elf], universal_newlines=True)
+    flash = section_total(output, env.get("SIZEPROGREGEXP") or DEFAULT_FLASH)
+    ram = section_total(output, env.get("SIZEDATAREGEXP") or DEFAULT_RAM)
+
+    path = os.path.join(env.subst("$PROJECT_BUILD_DIR"), "size-report.json")
+    profiles = {}
+    if os.path.isfile(path):
+        with open(path) as handle:
+            try:
+                profiles = json.load(handle)
+            except ValueError:
+                profiles = {}
+    profiles[env.subst("$PIOENV")] = {"flash": flash, "ram": ram, "modes": enabled_modes(env)}
+    with open(path, "w") as handle:
+        json.dump(profiles, handle, indent=2, sort_keys=True)
+
+    print("Tamaño por perfil (%s):" % path)
+    print("  %-22s %10s %10s  %s" % ("entorno", "flash", "RAM", "modos"))
+    for name in sorted(profiles):
+        profile = profiles[name]
+        print("  %-22s %10d %10d  %s" % (name, profile["flash"], profile["ram"], ",".join(profile["modes"])))
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report)  # noqa: F821
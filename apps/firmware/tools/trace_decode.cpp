@@ -0,0 +1,242 @@
+// Renders DUMP_TRACE dumps as a timeline:
+//   mosquitto_sub -v -t 'devices/+/trace' > trace.log   (then send DUMP_TRACE)
+//   pio run -e native_trace_decode && .pio/build/native_trace_decode/program [--sites=sites.json] trace.log
+// Reads stdin without files. Each line is one message, optionally preceded by
+// its topic as `mosquitto_sub -v` prints it. With --sites (a JSON array of
+// sites with `id`, like scripts/seed-sites.json) site tags show their ids.
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <FetchGovernor.h>
+#include <TraceRing.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Part {
+  uint16_t part = 0;
+  uint32_t seq = 0;
+  uint32_t lost = 0;
+  uint32_t nowMs = 0;
+  std::vector<TraceRecord> records;
+};
+
+struct Dump {
+  std::string device;
+  uint32_t number = 0;
+  uint16_t parts = 0;
+  std::map<uint16_t, Part> received;
+};
+
+const char *kEventKinds[] = {"STATUS", "ERROR", "CHANGE"};
+const char *kCommands[] = {"?",         "UPSERT_SITE",  "DELETE_SITE", "PAUSE_SITE", "RESUME_SITE",
+                           "CHECK_NOW", "ASSIGN_SHARD", "DUMP_TRACE",  "HISTORY",    "?"};
+
+std::string siteLabel(uint16_t tag, const std::multimap<uint16_t, std::string> &sites) {
+  char hex[8];
+  std::snprintf(hex, sizeof(hex), "%04x", tag);
+  const auto range = sites.equal_range(tag);
+  if (range.first == range.second) {
+    return std::string("#") + hex;
+  }
+  std::string label;
+  for (auto it = range.first; it != range.second; ++it) {
+    label += (label.empty() ? "" : "|") + it->second;
+  }
+  return label;
+}
+
+std::string details(const TraceRecord &r) {
+  char text[160];
+  switch (static_cast<TraceEvent>(r.event)) {
+    case TraceEvent::Boot:
+      std::snprintf(text, sizeof(text), "%s, heap libre %u B", r.flags ? "en caliente" : "en frío", r.b);
+      break;
+    case TraceEvent::CheckStart:
+      std::snprintf(text, sizeof(text), "%s, retraso %u ms, esperados %u B",
+                    fetchStrategyName(static_cast<FetchStrategy>(r.flags)), r.a, r.b);
+      break;
+    case TraceEvent::CheckDeferred:
+      std::snprintf(text, sizeof(text), "bloque libre %u B, esperados %u B", r.a, r.b);
+      break;
+    case TraceEvent::CheckEnd:
+      std::snprintf(text, sizeof(text), "%s, HTTP %d, descarga %u ms", r.flags < 3 ? kEventKinds[r.flags] : "?",
+                    static_cast<int>(r.b), r.a);
+      break;
+    case TraceEvent::FetchStart:
+      std::snprintf(text, sizeof(text), "DNS%s + socket %u ms%s", r.flags ? " en caché" : "", r.a,
+                    r.b > 0 ? " (tras redirección)" : "");
+      break;
+    case TraceEvent::FetchConnected:
+    case TraceEvent::FetchTls:
+    case TraceEvent::FetchFirstByte:
+      std::snprintf(text, sizeof(text), "+%u ms", r.a);
+      break;
+    case TraceEvent::FetchDone:
+      std::snprintf(text, sizeof(text), "%s, +%u ms, %u B", r.flags ? "ok" : "error", r.a, r.b);
+      break;
+    case TraceEvent::MqttConnected:
+      std::snprintf(text, sizeof(text), "%u eventos en cola", r.a);
+      break;
+    case TraceEvent::MqttDisconnected:
+      std::snprintf(text, sizeof(text), "%u sin PUBACK", r.a);
+      break;
+    case TraceEvent::EventQueued:
+      std::snprintf(text, sizeof(text), "%s, profundidad %u", r.flags < 3 ? kEventKinds[r.flags] : "?", r.a);
+      break;
+    case TraceEvent::Persist:
+      std::snprintf(text, sizeof(text), "%s, %u sitios en %u ms", r.flags ? "ok" : "falló", r.a, r.b);
+      break;
+    case TraceEvent::Heap:
+      std::snprintf(text, sizeof(text), "libre %u B, bloque mayor %u B", r.a, r.b);
+      break;
+    case TraceEvent::ArenaOverflow:
+      std::snprintf(text, sizeof(text), "%u B al heap, %u chequeos excedidos", r.a, r.b);
+      break;
+    case TraceEvent::LoadReport:
+      std::snprintf(text, sizeof(text), "uso %u%%, retraso %u ms%s", r.a, r.b, r.flags ? ", sobrecargado" : "");
+      break;
+    case TraceEvent::Command:
+      std::snprintf(text, sizeof(text), "%s, %u B", kCommands[std::min<size_t>(r.flags, 9)], r.a);
+      break;
+    case TraceEvent::TraceDump:
+      std::snprintf(text, sizeof(text), "volcado %u, %u registros", r.b, r.a);
+      break;
+    case TraceEvent::Sleep:
+      std::snprintf(text, sizeof(text), "sueño %s de %u ms tras %u ms despierto", r.flags == 2 ? "profundo" : "ligero",
+                    r.b, r.a);
+      break;
+    default:
+      std::snprintf(text, sizeof(text), "flags %u, a %u, b %u", r.flags, r.a, r.b);
+      break;
+  }
+  return text;
+}
+
+void loadSites(const char *path, std::multimap<uint16_t, std::string> &sites) {
+  std::ifstream file(path);
+  std::stringstream content;
+  content << file.rdbuf();
+  DynamicJsonDocument doc(1 << 20);
+  if (!file || deserializeJson(doc, content.str())) {
+    std::fprintf(stderr, "No se pudo leer la lista de sitios %s\n", path);
+    return;
+  }
+  JsonArray list = doc.is<JsonArray>() ? doc.as<JsonArray>() : doc["sites"].as<JsonArray>();
+  for (JsonVariant site : list) {
+    const char *id = site["id"] | "";
+    if (*id) {
+      sites.emplace(traceSiteTag(id), id);
+    }
+  }
+}
+
+void readParts(std::istream &in, std::map<std::string, Dump> &dumps) {
+  std::string line;
+  while (std::getline(in, line)) {
+    const size_t brace = line.find('{');
+    if (brace == std::string::npos) {
+      continue;
+    }
+    DynamicJsonDocument doc(4096);
+    if (deserializeJson(doc, line.c_str() + brace) || strcmp(doc["type"] | "", "TRACE") != 0) {
+      continue;
+    }
+    JsonObject payload = doc["payload"];
+    Dump &dump = dumps[std::string(payload["id"] | "?") + "/" + std::to_string(payload["dump"] | 0u)];
+    dump.device = payload["id"] | "?";
+    dump.number = payload["dump"] | 0u;
+    dump.parts = payload["parts"] | 0;
+    Part part;
+    part.part = payload["part"] | 0;
+    part.seq = payload["seq"] | 0u;
+    part.lost = payload["lost"] | 0u;
+    part.nowMs = payload["now_ms"] | 0u;
+    if (!decodeTracePart(payload["data"] | "", part.records)) {
+      std::fprintf(stderr, "Parte %u del volcado %u de %s ilegible\n", part.part, dump.number, dump.device.c_str());
+      continue;
+    }
+    dump.received[part.part] = part;
+  }
+}
+
+void printDump(const Dump &dump, const std::multimap<uint16_t, std::string> &sites) {
+  uint32_t lost = 0;
+  size_t records = 0;
+  uint32_t startedAt = 0;
+  for (const auto &entry : dump.received) {
+    lost += entry.second.lost;
+    records += entry.second.records.size();
+    if (startedAt == 0 || entry.second.nowMs < startedAt) {
+      startedAt = entry.second.nowMs;
+    }
+  }
+  std::printf("Volcado %u de %s: %zu registros, %u perdidos, %zu/%u partes, pedido en t=%.3f s\n", dump.number,
+              dump.device.c_str(), records, lost, dump.received.size(), dump.parts, startedAt / 1000.0);
+  uint32_t previousAt = 0;
+  bool first = true;
+  for (const auto &entry : dump.received) {
+    if (entry.second.lost > 0) {
+      std::printf("  ... %u registros sobrescritos antes de enviarse\n", entry.second.lost);
+    }
+    for (const TraceRecord &record : entry.second.records) {
+      const uint32_t delta = first ? 0 : record.atMs - previousAt;
+      std::printf("  %10.3f s  %+8.3f s  +%-6u %-18s %-14s %s\n", record.atMs / 1000.0,
+                  -static_cast<double>(static_cast<int32_t>(startedAt - record.atMs)) / 1000.0, delta,
+                  traceEventName(record.event), record.site ? siteLabel(record.site, sites).c_str() : "",
+                  details(record).c_str());
+      previousAt = record.atMs;
+      first = false;
+    }
+  }
+  for (uint16_t part = 0; part < dump.parts; ++part) {
+    if (!dump.received.count(part)) {
+      std::printf("  falta la parte %u\n", part);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::multimap<uint16_t, std::string> sites;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    if (arg.rfind("--sites=", 0) == 0) {
+      loadSites(arg.c_str() + 8, sites);
+    } else if (arg.rfind("--", 0) == 0) {
+      std::fprintf(stderr, "Argumento desconocido: %s\n", argv[i]);
+      return 1;
+    } else {
+      files.push_back(arg);
+    }
+  }
+  std::map<std::string, Dump> dumps;
+  if (files.empty()) {
+    readParts(std::cin, dumps);
+  }
+  for (const std::string &path : files) {
+    std::ifstream file(path);
+    if (!file) {
+      std::fprintf(stderr, "No se pudo abrir %s\n", path.c_str());
+      return 1;
+    }
+    readParts(file, dumps);
+  }
+  if (dumps.empty()) {
+    std::fprintf(stderr, "No hay mensajes TRACE en la entrada\n");
+    return 1;
+  }
+  for (const auto &entry : dumps) {
+    printDump(entry.second, sites);
+  }
+  return 0;
+}
@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+# Builds the firmware's extraction libraries to WebAssembly for the web
+# preview: apps/web/server/assets/extractor.wasm. Needs emcc (Emscripten).
+set -euo pipefail
+
+firmware_dir="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+out="${1:-$firmware_dir/../web/server/assets/extractor.wasm}"
+libs=(AllocProfile CheckArena ContentExtractor ContentNormalizer CssSelectMini ExtractPreview)
+
+includes=(-I"$firmware_dir/test/arduino_shim" -I"$firmware_dir/include")
+sources=("$firmware_dir/wasm/preview_wasm.cpp")
+for lib in "${libs[@]}"; do
+  includes+=(-I"$firmware_dir/lib/$lib")
+  sources+=("$firmware_dir"/lib/"$lib"/*.cpp)
+done
+
+mkdir -p "$(dirname "$out")"
+# Standalone: the module only imports a few WASI calls (clock, exit), which
+# extractor.ts provides; wasm exceptions keep std::regex errors catchable
+# without JS glue.
+emcc -std=gnu++17 -O2 -DARDUINO=100 -fwasm-exceptions "${includes[@]}" "${sources[@]}" \
+  -sSTANDALONE_WASM=1 --no-entry -sALLOW_MEMORY_GROWTH=1 -sINITIAL_MEMORY=4MB \
+  -sEXPORTED_FUNCTIONS=_preview_alloc,_preview_free,_preview_run \
+  -o "$out"
+printf 'extractor.wasm: %s (%s bytes)\n' "$out" "$(wc -c < "$out")"
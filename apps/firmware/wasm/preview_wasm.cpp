@@ -0,0 +1,96 @@
+// WebAssembly entry points of the extraction preview, called by
+// apps/web/server/utils/extractor.ts. Built by wasm/build.sh as a standalone
+// module: no Emscripten JS glue, only linear memory and these exports.
+//
+// The caller copies the site fields and the body into buffers from
+// preview_alloc() and reads the result through the PreviewAbi pointer, which
+// stays valid until the next preview_run().
+#include <Arduino.h>
+#include <ExtractPreview.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/emscripten.h>
+#else
+#define EMSCRIPTEN_KEEPALIVE
+#endif
+
+namespace {
+// Little-endian uint32 fields read by offset from JS; append only.
+struct PreviewAbi {
+  uint32_t ok;
+  uint32_t start;
+  uint32_t length;
+  uint32_t bodyBytes;
+  uint32_t truncated;
+  uint32_t scannedBytes;
+  uint32_t elapsedUs;
+  uint32_t normalized;
+  uint32_t normalizedLength;
+  uint32_t normalizedBytes;
+  uint32_t error;
+  uint32_t errorLength;
+};
+
+ExtractionPreview lastPreview;
+PreviewAbi lastAbi;
+
+// `fields` holds mode, selector_css, start_marker, end_marker, regex,
+// normalize, ignore_start, ignore_end and max_bytes, each ended by '\0'.
+SiteConfig configFromFields(const char *fields, size_t length) {
+  String values[9];
+  size_t index = 0;
+  const char *end = fields + length;
+  for (const char *p = fields; p < end && index < 9; ++index) {
+    const char *stop = static_cast<const char *>(memchr(p, '\0', static_cast<size_t>(end - p)));
+    stop = stop ? stop : end;
+    values[index] = String(p, static_cast<size_t>(stop - p));
+    p = stop + 1;
+  }
+  SiteConfig config;
+  config.mode = values[0].isEmpty() ? String("selector") : values[0];
+  config.extractMode = parseExtractMode(config.mode);
+  config.selectorCss = values[1];
+  config.startMarker = values[2];
+  config.endMarker = values[3];
+  config.regex = values[4];
+  config.normalize = values[5];
+  config.ignoreStartMarker = values[6];
+  config.ignoreEndMarker = values[7];
+  config.maxBytes = static_cast<uint32_t>(strtoul(values[8].c_str(), nullptr, 10));
+  return config;
+}
+
+uint32_t address(const void *pointer) { return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(pointer)); }
+}  // namespace
+
+extern "C" {
+
+EMSCRIPTEN_KEEPALIVE void *preview_alloc(size_t length) { return malloc(length ? length : 1); }
+
+EMSCRIPTEN_KEEPALIVE void preview_free(void *pointer) { free(pointer); }
+
+EMSCRIPTEN_KEEPALIVE const PreviewAbi *preview_run(const char *fields, size_t fieldsLength, const char *body,
+                                                   size_t length) {
+  lastPreview = previewExtraction(configFromFields(fields, fieldsLength), body, length);
+  const ExtractionOutcome &outcome = lastPreview.outcome;
+  lastAbi = PreviewAbi();
+  lastAbi.ok = outcome.ok;
+  lastAbi.start = outcome.ok ? static_cast<uint32_t>(outcome.data - body) : 0;
+  lastAbi.length = static_cast<uint32_t>(outcome.length);
+  lastAbi.bodyBytes = static_cast<uint32_t>(lastPreview.bodyBytes);
+  lastAbi.truncated = lastPreview.truncated;
+  lastAbi.scannedBytes = static_cast<uint32_t>(lastPreview.scannedBytes);
+  lastAbi.elapsedUs = lastPreview.elapsedUs;
+  lastAbi.normalized = address(lastPreview.normalized.c_str());
+  lastAbi.normalizedLength = static_cast<uint32_t>(lastPreview.normalized.length());
+  lastAbi.normalizedBytes = static_cast<uint32_t>(lastPreview.normalizedBytes);
+  lastAbi.error = address(outcome.errorMessage.c_str());
+  lastAbi.errorLength = static_cast<uint32_t>(outcome.errorMessage.length());
+  return &lastAbi;
+}
+
+}  // extern "C"
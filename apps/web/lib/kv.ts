@@ -1,6 +1,11 @@
 import { kvDel, kvGet, kvScan, kvSet } from '~/server/utils/kv'
+import type { LoadReport } from '~/server/utils/mqtt'
 
-export type SiteMode = 'full' | 'selector' | 'markers' | 'regex'
+export type SiteMode = 'full' | 'selector' | 'markers' | 'regex' | 'list'
+
+export type SiteNormalize = 'none' | 'whitespace' | 'text'
+
+export type SiteFingerprint = 'sha256' | 'simhash'
 
 export interface SiteConfig {
   id: string
@@ -11,18 +16,46 @@ export interface SiteConfig {
   start_marker?: string
   end_marker?: string
   regex?: string
+  normalize?: SiteNormalize
+  ignore_start?: string
+  ignore_end?: string
+  fingerprint?: SiteFingerprint
+  simhash_threshold?: number
   headers?: Record<string, string>
+  max_bytes?: number
+  max_items?: number
   paused?: boolean
+  // Device the site was last sent to; see server/utils/shard.ts.
+  device?: string
   createdAt: number
   updatedAt: number
 }
 
+export type DeviceShardStatus = 'ok' | 'overloaded' | 'silent'
+
+// What the server remembers about one device between rebalances.
+export interface DeviceShard {
+  deviceId: string
+  // Share of the hash ring, 1 = full; lowered while the device is overloaded.
+  weight: number
+  // Epoch of the last ASSIGN_SHARD sent, and the sites it listed.
+  epoch: number
+  sites: string[]
+  status: DeviceShardStatus
+  // Last LOAD report seen, and when its `seq` last moved.
+  load?: LoadReport
+  lastSeq: number
+  lastReportAt: number
+  updatedAt: number
+}
+
 export interface TelegramSettings {
   chatId: string
   updatedAt: number
 }
 
 const SITE_PREFIX = ['sites'] as const
+const SHARD_PREFIX = ['shards'] as const
 const TELEGRAM_KEY = ['config', 'telegram'] as const
 
 type Prefix = readonly (string | number | boolean)[]
@@ -68,6 +101,18 @@ export const deleteSite = async (id: string): Promise<void> => {
   await kvDel([...SITE_PREFIX, id])
 }
 
+export const listDeviceShards = async (): Promise<DeviceShard[]> => {
+  const shards: DeviceShard[] = []
+  for await (const shard of kvScan<DeviceShard>(asMutable(SHARD_PREFIX))) {
+    shards.push(shard)
+  }
+  return shards.sort((a, b) => a.deviceId.localeCompare(b.deviceId))
+}
+
+export const saveDeviceShard = async (shard: DeviceShard): Promise<void> => {
+  await kvSet([...SHARD_PREFIX, shard.deviceId], shard)
+}
+
 const defaultTelegram = (): TelegramSettings => ({
   chatId: envText('TELEGRAM_CHAT_ID'),
   updatedAt: Date.now()
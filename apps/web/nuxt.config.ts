@@ -1,9 +1,16 @@
 import { defineNuxtConfig } from 'nuxt/config'
+import { SHARD_REBALANCE_CRON } from './server/utils/ring'
 
 export default defineNuxtConfig({
   ssr: true,
   nitro: {
-    preset: 'vercel'
+    preset: 'vercel',
+    experimental: {
+      tasks: true
+    },
+    scheduledTasks: {
+      [SHARD_REBALANCE_CRON]: ['shards:rebalance']
+    }
   },
   typescript: {
     strict: true,
@@ -14,6 +21,7 @@ export default defineNuxtConfig({
   runtimeConfig: {
     mqttUrlWss: process.env.MQTT_URL_WSS ?? '',
     deviceId: process.env.DEVICE_ID ?? '',
+    deviceIds: process.env.DEVICE_IDS ?? '',
     deviceSecret: process.env.DEVICE_SECRET ?? '',
     telegramBotToken: process.env.TELEGRAM_BOT_TOKEN ?? '',
     telegramChatId: process.env.TELEGRAM_CHAT_ID ?? '',
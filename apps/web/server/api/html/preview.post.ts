@@ -1,9 +1,13 @@
 import { defineEventHandler, readBody, createError } from 'h3'
 import { z } from 'zod'
+import { extractionSiteSchema, runDeviceExtraction, type DeviceExtraction } from '~/server/utils/extractor'
 
 const requestSchema = z.object({
   url: z.string().url(),
-  headers: z.record(z.string()).optional()
+  headers: z.record(z.string()).optional(),
+  // With the site's extraction settings the response also carries what the
+  // device would extract from this same download.
+  site: extractionSiteSchema.optional()
 })
 
 const MAX_BYTES = 400_000
@@ -84,7 +88,7 @@ export default defineEventHandler(async (event) => {
     }
   }
 
-  const rawHtml = reader
+  const rawBytes = reader
     ? (() => {
         const merged = new Uint8Array(received)
         let offset = 0
@@ -92,9 +96,22 @@ export default defineEventHandler(async (event) => {
           merged.set(chunk, offset)
           offset += chunk.byteLength
         }
-        return new TextDecoder('utf-8', { fatal: false }).decode(merged)
+        return merged
       })()
-    : await response.text()
+    : new Uint8Array(await response.arrayBuffer())
+  const rawHtml = new TextDecoder('utf-8', { fatal: false }).decode(rawBytes)
+  let device: DeviceExtraction | null = null
+  if (parsed.site) {
+    try {
+      device = await runDeviceExtraction(parsed.site, rawBytes)
+    } catch (error) {
+      throw createError({
+        statusCode: 503,
+        statusMessage: 'El extractor del firmware no está disponible',
+        data: { message: (error as Error).message }
+      })
+    }
+  }
 
   const sanitized = sanitizeHtml(rawHtml)
   const url = new URL(parsed.url)
@@ -106,6 +123,7 @@ export default defineEventHandler(async (event) => {
     html: sanitized,
     baseHref,
     status: response.status,
-    srcdoc
+    srcdoc,
+    device
   }
 })
@@ -1,6 +1,7 @@
 import { defineEventHandler, readBody, createError } from 'h3'
 import { z } from 'zod'
-import { commandSchema, publishCommand, type MqttConfig } from '~/server/utils/mqtt'
+import { commandSchema, parseDeviceIds, publishCommand, type MqttConfig } from '~/server/utils/mqtt'
+import { routeSite } from '~/server/utils/shard'
 
 type CommandInput = z.infer<typeof commandSchema>
 
@@ -21,13 +22,17 @@ export default defineEventHandler(async (event) => {
   const runtimeConfig: MqttConfig = {
     mqttUrlWss: config.mqttUrlWss,
     deviceId: config.deviceId,
-    deviceSecret: config.deviceSecret
+    deviceSecret: config.deviceSecret,
+    deviceIds: parseDeviceIds(config.deviceIds)
   }
   ensureConfig(runtimeConfig)
 
   const body = (await readBody(event)) as CommandInput
   const parsed = commandSchema.parse(body)
-  const result = await publishCommand(parsed, runtimeConfig)
+  // ASSIGN_SHARD and DUMP_TRACE name their device; site commands go to the site's device.
+  const deviceCommand = parsed.type === 'ASSIGN_SHARD' || parsed.type === 'DUMP_TRACE'
+  const deviceId = deviceCommand ? parsed.payload.id : await routeSite(parsed.payload.id, runtimeConfig)
+  const result = await publishCommand(parsed, { ...runtimeConfig, deviceId })
 
   return { ok: true, topic: result.topic, ts: result.command.ts }
 })
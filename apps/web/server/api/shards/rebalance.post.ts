@@ -0,0 +1,21 @@
+import { defineEventHandler, createError } from 'h3'
+import { parseDeviceIds, type MqttConfig } from '~/server/utils/mqtt'
+import { rebalanceShards } from '~/server/utils/shard'
+
+export default defineEventHandler(async (event) => {
+  const config = useRuntimeConfig(event)
+  const runtimeConfig: MqttConfig = {
+    mqttUrlWss: config.mqttUrlWss,
+    deviceId: config.deviceId,
+    deviceSecret: config.deviceSecret,
+    deviceIds: parseDeviceIds(config.deviceIds)
+  }
+  try {
+    return { ok: true, ...(await rebalanceShards(runtimeConfig)) }
+  } catch (error) {
+    throw createError({
+      statusCode: 500,
+      statusMessage: error instanceof Error ? error.message : 'Error repartiendo sitios entre dispositivos'
+    })
+  }
+})
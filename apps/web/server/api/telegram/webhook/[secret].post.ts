@@ -6,9 +6,11 @@ import {
   listSites,
   saveTelegramSettings,
   upsertSite,
-  getTelegramSettings
+  getTelegramSettings,
+  listDeviceShards
 } from '~/lib/kv'
-import { commandPayloadSchema, publishCommand, type MqttConfig } from '~/server/utils/mqtt'
+import { commandPayloadSchema, parseDeviceIds, publishCommand, type MqttConfig } from '~/server/utils/mqtt'
+import { routeSite } from '~/server/utils/shard'
 
 const telegramUpdateSchema = z.object({
   message: z
@@ -90,8 +92,14 @@ export default defineEventHandler(async (event) => {
   const runtimeMqtt: MqttConfig = {
     mqttUrlWss: config.mqttUrlWss,
     deviceId: config.deviceId,
-    deviceSecret: config.deviceSecret
+    deviceSecret: config.deviceSecret,
+    deviceIds: parseDeviceIds(config.deviceIds)
   }
+  // Each site's commands go to the device that owns it.
+  const toSiteDevice = async (id: string): Promise<MqttConfig> => ({
+    ...runtimeMqtt,
+    deviceId: await routeSite(id, runtimeMqtt)
+  })
 
   const update = telegramUpdateSchema.parse(await readBody(event))
   const message = update.message
@@ -123,8 +131,8 @@ export default defineEventHandler(async (event) => {
       case 'add': {
         const payload = buildSitePayload(normalizedCommand)
         const mode = payload.mode ?? 'selector'
-        if (mode === 'selector' && !payload.selector_css) {
-          throw new Error('Proporciona selector=".clase" para modo selector')
+        if ((mode === 'selector' || mode === 'list') && !payload.selector_css) {
+          throw new Error(`Proporciona selector=".clase" para modo ${mode}`)
         }
         if (mode === 'markers' && (!payload.start_marker || !payload.end_marker)) {
           throw new Error('Modo markers requiere start="..." y end="..."')
@@ -142,13 +150,15 @@ export default defineEventHandler(async (event) => {
           headers: payload.headers ?? {},
           paused: payload.paused ?? false
         }
+        const siteMqtt = await toSiteDevice(commandPayload.id)
         await upsertSite({
           ...commandPayload,
           mode: commandPayload.mode as any,
+          device: siteMqtt.deviceId,
           createdAt: Date.now(),
           updatedAt: Date.now()
         })
-        await publishCommand({ type: 'UPSERT_SITE', payload: commandPayload }, runtimeMqtt)
+        await publishCommand({ type: 'UPSERT_SITE', payload: commandPayload }, siteMqtt)
         await respond(`Sitio ${commandPayload.id} actualizado y enviado al ESP32.`)
         break
       }
@@ -158,8 +168,9 @@ export default defineEventHandler(async (event) => {
         if (!id) {
           throw new Error('Uso: /remove <id>')
         }
+        const siteMqtt = await toSiteDevice(id)
         await deleteSite(id)
-        await publishCommand({ type: 'DELETE_SITE', payload: { id } }, runtimeMqtt)
+        await publishCommand({ type: 'DELETE_SITE', payload: { id } }, siteMqtt)
         await respond(`Sitio ${id} eliminado.`)
         break
       }
@@ -177,7 +188,7 @@ export default defineEventHandler(async (event) => {
         await upsertSite({ ...existing, paused })
         await publishCommand(
           { type: paused ? 'PAUSE_SITE' : 'RESUME_SITE', payload: { id } },
-          runtimeMqtt
+          await toSiteDevice(id)
         )
         await respond(`Sitio ${id} ${paused ? 'pausado' : 'reactivado'}.`)
         break
@@ -187,7 +198,7 @@ export default defineEventHandler(async (event) => {
         if (!id) {
           throw new Error('Uso: /checknow <id>')
         }
-        await publishCommand({ type: 'CHECK_NOW', payload: { id } }, runtimeMqtt)
+        await publishCommand({ type: 'CHECK_NOW', payload: { id } }, await toSiteDevice(id))
         await respond(`Se solicitó revisión inmediata de ${id}.`)
         break
       }
@@ -206,8 +217,16 @@ export default defineEventHandler(async (event) => {
       }
       case 'status': {
         const sites = await listSites()
+        const shards = await listDeviceShards()
+        const devices = shards
+          .map((shard) => {
+            const load = shard.load ? `, ${shard.load.utilization}% de uso` : ''
+            return `• ${shard.deviceId}: ${shard.status} (${shard.sites.length} sitios${load})`
+          })
+          .join('\n')
         await respond(
-          `ESP32 Web Monitor activo. Sitios configurados: ${sites.length}. Usa /list o /add para gestionar.`
+          `ESP32 Web Monitor activo. Sitios configurados: ${sites.length}. Usa /list o /add para gestionar.` +
+            (devices ? `\nDispositivos:\n${devices}` : '')
         )
         break
       }
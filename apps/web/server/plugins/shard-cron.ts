@@ -0,0 +1,19 @@
+import { SHARD_REBALANCE_CRON } from '~/server/utils/ring'
+
+type DenoCron = (name: string, schedule: string, handler: () => Promise<void>) => Promise<void>
+
+// Nitro's scheduler does not run on Deno Deploy, so the same task is
+// registered with Deno.cron there.
+export default defineNitroPlugin(() => {
+  const deno = (globalThis as { Deno?: { cron?: DenoCron } }).Deno
+  if (!process.env.DENO_DEPLOYMENT_ID || typeof deno?.cron !== 'function') {
+    return
+  }
+  deno.cron('shards:rebalance', SHARD_REBALANCE_CRON, async () => {
+    try {
+      await runTask('shards:rebalance')
+    } catch (error) {
+      console.error('Error repartiendo sitios entre dispositivos', error)
+    }
+  })
+})
@@ -0,0 +1,21 @@
+import { parseDeviceIds, type MqttConfig } from '~/server/utils/mqtt'
+import { rebalanceShards } from '~/server/utils/shard'
+
+// Run on SHARD_REBALANCE_CRON (nuxt.config.ts), or on Deno Deploy by
+// server/plugins/shard-cron.ts.
+export default defineTask({
+  meta: {
+    name: 'shards:rebalance',
+    description: 'Reparte los sitios entre dispositivos según sus informes LOAD'
+  },
+  async run() {
+    const config = useRuntimeConfig()
+    const runtimeConfig: MqttConfig = {
+      mqttUrlWss: config.mqttUrlWss,
+      deviceId: config.deviceId,
+      deviceSecret: config.deviceSecret,
+      deviceIds: parseDeviceIds(config.deviceIds)
+    }
+    return { result: await rebalanceShards(runtimeConfig) }
+  }
+})
@@ -0,0 +1,146 @@
+import { z } from 'zod'
+
+// The firmware's extraction (CssSelectMini, markers, regex and the
+// normalizer) built to WebAssembly by apps/firmware/wasm/build.sh, so the
+// preview extracts exactly what the device would. Without
+// server/assets/extractor.wasm asking for this result fails, saying why.
+
+export const extractionSiteSchema = z.object({
+  mode: z.enum(['full', 'selector', 'markers', 'regex', 'list']).default('selector'),
+  selector_css: z.string().optional(),
+  start_marker: z.string().optional(),
+  end_marker: z.string().optional(),
+  regex: z.string().optional(),
+  normalize: z.enum(['none', 'whitespace', 'text']).optional(),
+  ignore_start: z.string().optional(),
+  ignore_end: z.string().optional(),
+  max_bytes: z.number().int().min(0).optional()
+})
+
+export type ExtractionSite = z.infer<typeof extractionSiteSchema>
+
+export type DeviceExtraction = {
+  ok: boolean
+  error: string | null
+  // Start of the extracted content, and its full size.
+  content: string
+  contentBytes: number
+  offset: number
+  // Bytes the device keeps (max_bytes applied) and how far it has to read.
+  bodyBytes: number
+  truncated: boolean
+  scannedBytes: number
+  elapsedUs: number
+  // Start of the normalized text that gets fingerprinted, and its full size.
+  normalized: string
+  normalizedBytes: number
+}
+
+type ExtractorExports = {
+  memory: WebAssembly.Memory
+  _initialize?: () => void
+  preview_alloc: (length: number) => number
+  preview_free: (pointer: number) => void
+  preview_run: (fields: number, fieldsLength: number, body: number, length: number) => number
+}
+
+// Fields of PreviewAbi in wasm/preview_wasm.cpp, in order.
+const ABI_FIELDS = 12
+const CONTENT_CHARS = 2000
+const WASI_ENOSYS = 52
+
+const encoder = new TextEncoder()
+const decoder = new TextDecoder('utf-8', { fatal: false })
+
+let extractor: Promise<ExtractorExports> | null = null
+
+// Every import the module does not really need answers ENOSYS, so a newer
+// Emscripten asking for one more WASI call does not break instantiation.
+const withFallback = (functions: Record<string, unknown>) =>
+  new Proxy(functions, { get: (target, name) => target[name as string] ?? (() => WASI_ENOSYS) })
+
+// The module only needs a clock, for its timings.
+const wasiImports = (memory: () => WebAssembly.Memory) => ({
+  wasi_snapshot_preview1: withFallback({
+    clock_time_get: (_clock: number, _precision: bigint, out: number) => {
+      new DataView(memory().buffer).setBigUint64(out, process.hrtime.bigint(), true)
+      return 0
+    },
+    proc_exit: (code: number) => {
+      throw new Error(`extractor.wasm terminó con código ${code}`)
+    }
+  }),
+  env: withFallback({ emscripten_notify_memory_growth: () => {} })
+})
+
+const loadExtractor = (): Promise<ExtractorExports> => {
+  extractor ??= (async () => {
+    const bytes = await useStorage('assets:server').getItemRaw('extractor.wasm')
+    if (!bytes) {
+      throw new Error('extractor.wasm no está desplegado; ejecuta apps/firmware/wasm/build.sh antes de compilar la web')
+    }
+    let exports: ExtractorExports | null = null
+    const { instance } = await WebAssembly.instantiate(
+      bytes as Uint8Array,
+      wasiImports(() => (exports as ExtractorExports).memory)
+    )
+    exports = instance.exports as unknown as ExtractorExports
+    exports._initialize?.()
+    return exports
+  })().catch((error) => {
+    console.error('No se pudo cargar extractor.wasm', error)
+    throw error
+  })
+  return extractor
+}
+
+const fieldsFor = (site: ExtractionSite): Uint8Array =>
+  encoder.encode(
+    [
+      site.mode,
+      site.selector_css ?? '',
+      site.start_marker ?? '',
+      site.end_marker ?? '',
+      site.regex ?? '',
+      site.normalize ?? '',
+      site.ignore_start ?? '',
+      site.ignore_end ?? '',
+      String(site.max_bytes ?? 0)
+    ]
+      .map((field) => `${field}\0`)
+      .join('')
+  )
+
+// Runs the device's extraction over the raw body, as downloaded. Throws when
+// the WebAssembly build is not deployed or does not load.
+export const runDeviceExtraction = async (site: ExtractionSite, body: Uint8Array): Promise<DeviceExtraction> => {
+  const wasm = await loadExtractor()
+  const fields = fieldsFor(site)
+  const fieldsPointer = wasm.preview_alloc(fields.length)
+  const bodyPointer = wasm.preview_alloc(body.length)
+  try {
+    // Views are taken after every allocation: growing memory detaches them.
+    new Uint8Array(wasm.memory.buffer, fieldsPointer, fields.length).set(fields)
+    new Uint8Array(wasm.memory.buffer, bodyPointer, body.length).set(body)
+    const result = wasm.preview_run(fieldsPointer, fields.length, bodyPointer, body.length)
+    const [ok, start, length, bodyBytes, truncated, scannedBytes, elapsedUs, normalized, normalizedLength, normalizedBytes, error, errorLength] =
+      Array.from(new Uint32Array(wasm.memory.buffer, result, ABI_FIELDS))
+    const text = (pointer: number, size: number) => decoder.decode(new Uint8Array(wasm.memory.buffer, pointer, size))
+    return {
+      ok: ok === 1,
+      error: errorLength > 0 ? text(error, errorLength) : null,
+      content: decoder.decode(body.subarray(start, start + Math.min(length, CONTENT_CHARS * 4))).slice(0, CONTENT_CHARS),
+      contentBytes: length,
+      offset: start,
+      bodyBytes,
+      truncated: truncated === 1,
+      scannedBytes,
+      elapsedUs,
+      normalized: text(normalized, normalizedLength),
+      normalizedBytes
+    }
+  } finally {
+    wasm.preview_free(bodyPointer)
+    wasm.preview_free(fieldsPointer)
+  }
+}
@@ -6,27 +6,119 @@ export const commandPayloadSchema = z.object({
   id: z.string().min(1),
   url: z.string().url().optional(),
   interval_s: z.number().int().positive().optional(),
-  mode: z.enum(['full', 'selector', 'markers', 'regex']).optional(),
+  mode: z.enum(['full', 'selector', 'markers', 'regex', 'list']).optional(),
   selector_css: z.string().optional(),
   start_marker: z.string().optional(),
   end_marker: z.string().optional(),
   regex: z.string().optional(),
+  normalize: z.enum(['none', 'whitespace', 'text']).optional(),
+  ignore_start: z.string().optional(),
+  ignore_end: z.string().optional(),
+  fingerprint: z.enum(['sha256', 'simhash']).optional(),
+  simhash_threshold: z.number().int().min(0).max(64).optional(),
   headers: z.record(z.string()).optional(),
-  paused: z.boolean().optional()
+  max_bytes: z.number().int().min(0).optional(),
+  max_items: z.number().int().min(0).optional(),
+  paused: z.boolean().optional(),
+  // ASSIGN_SHARD: `id` is the device, `sites` the ids it owns in `epoch`,
+  // split in `parts` messages. DUMP_TRACE: `id` is the device.
+  epoch: z.number().int().min(0).optional(),
+  part: z.number().int().min(0).optional(),
+  parts: z.number().int().positive().optional(),
+  sites: z.array(z.string()).optional(),
+  // HISTORY: up to `limit` checks of the site from seq `from`.
+  from: z.number().int().min(0).optional(),
+  limit: z.number().int().positive().optional()
 })
 
 export const commandSchema = z.object({
-  type: z.enum(['UPSERT_SITE', 'DELETE_SITE', 'PAUSE_SITE', 'RESUME_SITE', 'CHECK_NOW']),
+  type: z.enum([
+    'UPSERT_SITE',
+    'DELETE_SITE',
+    'PAUSE_SITE',
+    'RESUME_SITE',
+    'CHECK_NOW',
+    'ASSIGN_SHARD',
+    'DUMP_TRACE',
+    'HISTORY'
+  ]),
   payload: commandPayloadSchema,
   ts: z.number().optional()
 })
 
 export type CommandInput = z.infer<typeof commandSchema>
 
+export const loadReportSchema = z.object({
+  type: z.literal('LOAD'),
+  payload: z.object({
+    id: z.string(),
+    seq: z.number().int(),
+    epoch: z.number().int(),
+    sites: z.number().int(),
+    active: z.number().int(),
+    missing: z.array(z.string()).default([]),
+    missing_total: z.number().int().default(0),
+    checks: z.number().int(),
+    check_ms: z.number().int(),
+    cycle_ms: z.number().int(),
+    lag_ms: z.number().int(),
+    utilization: z.number().int(),
+    heap_free: z.number().int(),
+    heap_min: z.number().int(),
+    largest_block: z.number().int(),
+    queue_depth: z.number().int(),
+    in_flight: z.number().int(),
+    dns: z
+      .object({
+        entries: z.number().int(),
+        hits: z.number().int(),
+        misses: z.number().int(),
+        stale: z.number().int(),
+        prefetches: z.number().int(),
+        failures: z.number().int(),
+        hit_pct: z.number().int(),
+        lookup_ms_avg: z.number().int(),
+        lookup_ms_max: z.number().int()
+      })
+      .optional(),
+    power: z
+      .object({
+        policy: z.enum(['always_on', 'light', 'deep']),
+        cycles: z.number().int(),
+        awake_ms_last: z.number().int(),
+        awake_ms_avg: z.number().int(),
+        awake_ms_max: z.number().int(),
+        awake_pct: z.number().int(),
+        light_sleeps: z.number().int(),
+        deep_sleeps: z.number().int()
+      })
+      .optional(),
+    overloaded: z.boolean(),
+    overload: z.enum(['utilization', 'lag', 'heap']).optional()
+  }),
+  ts: z.number().optional()
+})
+
+export type LoadReport = z.infer<typeof loadReportSchema>['payload']
+
 export interface MqttConfig {
   mqttUrlWss: string
   deviceId: string
   deviceSecret: string
+  // Devices sharing DEVICE_SECRET that split the sites; just deviceId if empty.
+  deviceIds?: string[]
+}
+
+export const parseDeviceIds = (value: string | undefined): string[] => {
+  return (value ?? '')
+    .split(',')
+    .map((id) => id.trim())
+    .filter(Boolean)
+}
+
+export interface DeviceCommand {
+  deviceId: string
+  command: CommandInput
 }
 
 const connectClient = (url: string, options: IClientOptions): Promise<MqttClient> => {
@@ -61,6 +153,33 @@ const publishAsync = (client: MqttClient, topic: string, payload: string): Promi
   })
 }
 
+const deviceTopic = async (deviceId: string, secret: string, channel: 'commands' | 'events' | 'load') => {
+  const suffix = await deriveTopicSuffix(deviceId, secret)
+  return `devices/${deviceId}-${suffix}/${channel}`
+}
+
+const connectAdmin = (config: MqttConfig) => {
+  const clientId = `admin-${crypto.randomUUID().slice(0, 8)}`
+  return connectClient(config.mqttUrlWss, {
+    clientId,
+    protocolVersion: 5,
+    clean: true,
+    reconnectPeriod: 0,
+    rejectUnauthorized: true
+  })
+}
+
+const signCommand = async (commandInput: CommandInput, secret: string) => {
+  const parsed = commandSchema.parse(commandInput)
+  const command = {
+    type: parsed.type,
+    payload: parsed.payload,
+    ts: parsed.ts ?? Date.now()
+  }
+  const hmac = await hmacSha256Base64(secret, JSON.stringify(command))
+  return { ...command, hmac }
+}
+
 const ensureConfig = (config: MqttConfig) => {
   if (!config.mqttUrlWss) {
     throw new Error('MQTT_URL_WSS no definido')
@@ -77,34 +196,87 @@ export const publishCommand = async (
   commandInput: CommandInput,
   config: MqttConfig
 ): Promise<{ topic: string; command: CommandInput & { hmac: string; ts: number } }> => {
+  const [result] = await publishCommands([{ deviceId: config.deviceId, command: commandInput }], config)
+  return result
+}
+
+// Sends the commands in order over a single connection, each to its device.
+export const publishCommands = async (
+  commands: DeviceCommand[],
+  config: MqttConfig
+): Promise<{ topic: string; command: CommandInput & { hmac: string; ts: number } }[]> => {
   ensureConfig(config)
-  const parsed = commandSchema.parse(commandInput)
-  const command = {
-    type: parsed.type,
-    payload: parsed.payload,
-    ts: parsed.ts ?? Date.now()
+  const signed = await Promise.all(
+    commands.map(async ({ deviceId, command }) => ({
+      topic: await deviceTopic(deviceId, config.deviceSecret, 'commands'),
+      command: await signCommand(command, config.deviceSecret)
+    }))
+  )
+  if (signed.length === 0) {
+    return signed
   }
 
-  const message = JSON.stringify(command)
-  const hmac = await hmacSha256Base64(config.deviceSecret, message)
-  const commandWithHmac = { ...command, hmac }
-  const suffix = await deriveTopicSuffix(config.deviceId, config.deviceSecret)
-  const topic = `devices/${config.deviceId}-${suffix}/commands`
+  const client = await connectAdmin(config)
+  try {
+    for (const { topic, command } of signed) {
+      await publishAsync(client, topic, JSON.stringify(command))
+    }
+  } finally {
+    client.end(true)
+  }
 
-  const clientId = `admin-${crypto.randomUUID().slice(0, 8)}`
-  const client = await connectClient(config.mqttUrlWss, {
-    clientId,
-    protocolVersion: 5,
-    clean: true,
-    reconnectPeriod: 0,
-    rejectUnauthorized: true
-  })
+  return signed
+}
+
+// Collects the retained LOAD report of each device; a device that never
+// reported is absent from the result.
+export const readLoadReports = async (
+  deviceIds: string[],
+  config: MqttConfig,
+  waitMs = 2000
+): Promise<Map<string, LoadReport>> => {
+  ensureConfig(config)
+  const topics = new Map<string, string>()
+  for (const deviceId of deviceIds) {
+    topics.set(await deviceTopic(deviceId, config.deviceSecret, 'load'), deviceId)
+  }
+  const reports = new Map<string, LoadReport>()
+  if (topics.size === 0) {
+    return reports
+  }
 
+  const client = await connectAdmin(config)
   try {
-    await publishAsync(client, topic, JSON.stringify(commandWithHmac))
+    await new Promise<void>((resolve, reject) => {
+      const timer = setTimeout(resolve, waitMs)
+      client.on('message', (topic, message) => {
+        let body: unknown
+        try {
+          body = JSON.parse(message.toString())
+        } catch {
+          return
+        }
+        const deviceId = topics.get(topic)
+        const parsed = loadReportSchema.safeParse(body)
+        if (!deviceId || !parsed.success || parsed.data.payload.id !== deviceId) {
+          return
+        }
+        reports.set(deviceId, parsed.data.payload)
+        if (reports.size === topics.size) {
+          clearTimeout(timer)
+          resolve()
+        }
+      })
+      client.subscribe([...topics.keys()], { qos: 1 }, (error) => {
+        if (error) {
+          clearTimeout(timer)
+          reject(error)
+        }
+      })
+    })
   } finally {
     client.end(true)
   }
 
-  return { topic, command: commandWithHmac }
+  return reports
 }
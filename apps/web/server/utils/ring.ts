@@ -0,0 +1,102 @@
+import type { DeviceShard, SiteConfig } from '~/lib/kv'
+import type { LoadReport } from '~/server/utils/mqtt'
+
+// Points per device on the hash ring; more points spread sites more evenly.
+const RING_POINTS = 64
+// The firmware reports every minute; ten minutes without a new `seq` is silence.
+const SILENT_MS = 10 * 60_000
+// How often the server rebalances, well inside SILENT_MS so a device that
+// stops reporting loses its sites within one more run.
+export const SHARD_REBALANCE_CRON = '*/5 * * * *'
+// An overloaded device halves its share down to this, and recovers it while
+// below RECOVER_UTILIZATION so it does not bounce between two states.
+const MIN_WEIGHT = 0.25
+const RECOVER_UTILIZATION = 60
+
+export interface RingPoint {
+  point: number
+  deviceId: string
+}
+
+// FNV-1a plus the murmur3 finalizer: stable across runtimes and cheap. Plain
+// FNV leaves ids like "site-1"/"site-2" too close together on the ring.
+const hash32 = (text: string): number => {
+  let hash = 0x811c9dc5
+  for (let i = 0; i < text.length; i++) {
+    hash ^= text.charCodeAt(i)
+    hash = Math.imul(hash, 0x01000193)
+  }
+  hash ^= hash >>> 16
+  hash = Math.imul(hash, 0x85ebca6b)
+  hash ^= hash >>> 13
+  hash = Math.imul(hash, 0xc2b2ae35)
+  hash ^= hash >>> 16
+  return hash >>> 0
+}
+
+export const buildRing = (weights: Map<string, number>): RingPoint[] => {
+  const ring: RingPoint[] = []
+  for (const [deviceId, weight] of weights) {
+    const points = Math.max(1, Math.round(RING_POINTS * weight))
+    for (let i = 0; i < points; i++) {
+      ring.push({ point: hash32(`${deviceId}#${i}`), deviceId })
+    }
+  }
+  return ring.sort((a, b) => a.point - b.point || a.deviceId.localeCompare(b.deviceId))
+}
+
+export const ringOwner = (ring: RingPoint[], siteId: string): string | undefined => {
+  if (ring.length === 0) {
+    return undefined
+  }
+  const key = hash32(siteId)
+  let low = 0
+  let high = ring.length
+  while (low < high) {
+    const mid = (low + high) >>> 1
+    if (ring[mid].point < key) {
+      low = mid + 1
+    } else {
+      high = mid
+    }
+  }
+  return ring[low % ring.length].deviceId
+}
+
+const activeWeights = (shards: DeviceShard[]): Map<string, number> => {
+  return new Map(shards.filter((shard) => shard.status !== 'silent').map((shard) => [shard.deviceId, shard.weight]))
+}
+
+// Folds the device's latest LOAD report into what the server knew about it.
+export const nextDeviceShard = (
+  deviceId: string,
+  previous: DeviceShard | undefined,
+  report: LoadReport | undefined,
+  now: number
+): DeviceShard => {
+  const shard: DeviceShard = previous
+    ? { ...previous }
+    : { deviceId, weight: 1, epoch: 0, sites: [], status: 'ok', lastSeq: -1, lastReportAt: now, updatedAt: now }
+  // A retained report that has not changed says nothing new; only fresh ones
+  // move the weight, however often the rebalance runs.
+  if (report && report.seq !== shard.lastSeq) {
+    shard.load = report
+    shard.lastSeq = report.seq
+    shard.lastReportAt = now
+    if (report.overloaded) {
+      shard.weight = Math.max(MIN_WEIGHT, shard.weight / 2)
+    } else if (report.utilization < RECOVER_UTILIZATION) {
+      shard.weight = Math.min(1, shard.weight * 1.5)
+    }
+  }
+  shard.status = now - shard.lastReportAt > SILENT_MS ? 'silent' : shard.load?.overloaded ? 'overloaded' : 'ok'
+  shard.updatedAt = now
+  return shard
+}
+
+// Owner of every site on the ring of the devices still reporting. With none
+// left, sites stay where they are rather than all landing on a silent device.
+export const planShards = (sites: SiteConfig[], shards: DeviceShard[]): Map<string, string | undefined> => {
+  const ring = buildRing(activeWeights(shards))
+  return new Map(sites.map((site) => [site.id, ring.length ? ringOwner(ring, site.id) : site.device]))
+}
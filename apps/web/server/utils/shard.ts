@@ -0,0 +1,134 @@
+import { getSite, listDeviceShards, listSites, saveDeviceShard, upsertSite, type DeviceShard, type SiteConfig } from '~/lib/kv'
+import { publishCommands, readLoadReports, type DeviceCommand, type MqttConfig } from '~/server/utils/mqtt'
+import { buildRing, nextDeviceShard, planShards, ringOwner } from '~/server/utils/ring'
+
+// Keeps each ASSIGN_SHARD well under the firmware's 2 KB MQTT packets.
+const IDS_PER_PART = 40
+
+export interface RebalanceResult {
+  devices: Pick<DeviceShard, 'deviceId' | 'status' | 'weight' | 'epoch'>[]
+  sites: Record<string, number>
+  moved: number
+  commands: number
+}
+
+export const shardDevices = (config: MqttConfig): string[] => {
+  return config.deviceIds?.length ? config.deviceIds : [config.deviceId]
+}
+
+const sitePayload = (site: SiteConfig) => {
+  const { createdAt: _createdAt, updatedAt: _updatedAt, device: _device, ...payload } = site
+  return payload
+}
+
+const assignCommands = (shard: DeviceShard): DeviceCommand[] => {
+  const parts = Math.max(1, Math.ceil(shard.sites.length / IDS_PER_PART))
+  return Array.from({ length: parts }, (_, part) => ({
+    deviceId: shard.deviceId,
+    command: {
+      type: 'ASSIGN_SHARD' as const,
+      payload: {
+        id: shard.deviceId,
+        epoch: shard.epoch,
+        part,
+        parts,
+        sites: shard.sites.slice(part * IDS_PER_PART, (part + 1) * IDS_PER_PART)
+      }
+    }
+  }))
+}
+
+const sameIds = (a: string[], b: string[]) => a.length === b.length && a.every((id, index) => id === b[index])
+
+// Device a command about `siteId` goes to: where the site already lives, or
+// its place on the ring for a new one.
+export const routeSite = async (siteId: string, config: MqttConfig): Promise<string> => {
+  const devices = shardDevices(config)
+  const existing = await getSite(siteId)
+  if (existing?.device && devices.includes(existing.device)) {
+    return existing.device
+  }
+  const known = new Map((await listDeviceShards()).map((shard) => [shard.deviceId, shard]))
+  const weights = new Map<string, number>()
+  for (const deviceId of devices) {
+    const shard = known.get(deviceId)
+    if (shard?.status !== 'silent') {
+      weights.set(deviceId, shard?.weight ?? 1)
+    }
+  }
+  return ringOwner(buildRing(weights), siteId) ?? devices[0]
+}
+
+// Reads every device's LOAD report, moves sites off silent and overloaded
+// devices (consistent hashing moves only their share) and tells each device
+// whose site list changed. New owners get UPSERT_SITE before old owners get
+// the ASSIGN_SHARD that drops the site, so no check is lost in between.
+export const rebalanceShards = async (config: MqttConfig, now = Date.now()): Promise<RebalanceResult> => {
+  const devices = shardDevices(config)
+  const reports = await readLoadReports(devices, config)
+  const previous = new Map((await listDeviceShards()).map((shard) => [shard.deviceId, shard]))
+  const shards = devices.map((deviceId) => nextDeviceShard(deviceId, previous.get(deviceId), reports.get(deviceId), now))
+  const sites = await listSites()
+  const owners = planShards(sites, shards)
+
+  const upserts: DeviceCommand[] = []
+  const movedSites: SiteConfig[] = []
+  const upserted = new Set<string>()
+  for (const site of sites) {
+    const owner = owners.get(site.id)
+    // Sites from before sharding live on DEVICE_ID.
+    if (!owner || owner === (site.device ?? config.deviceId)) {
+      continue
+    }
+    upserts.push({ deviceId: owner, command: { type: 'UPSERT_SITE', payload: sitePayload(site) } })
+    upserted.add(site.id)
+    movedSites.push({ ...site, device: owner })
+  }
+  const moved = movedSites.length
+  for (const site of sites) {
+    if (!site.device && owners.get(site.id) === config.deviceId) {
+      movedSites.push({ ...site, device: config.deviceId })
+    }
+  }
+
+  const assignments: DeviceCommand[] = []
+  const sitesById = new Map(sites.map((site) => [site.id, site]))
+  for (const shard of shards) {
+    const owned = sites.filter((site) => owners.get(site.id) === shard.deviceId).map((site) => site.id).sort()
+    const report = reports.get(shard.deviceId)
+    const changed = !sameIds(owned, shard.sites)
+    // Rebooted, or lost a part: its epoch no longer matches what was sent.
+    const stale = shard.status !== 'silent' && report !== undefined && report.epoch !== shard.epoch
+    if (changed || stale) {
+      shard.epoch = Math.max(shard.epoch, report?.epoch ?? 0) + 1
+      shard.sites = owned
+      if (shard.status !== 'silent') {
+        assignments.push(...assignCommands(shard))
+      }
+    } else if (report) {
+      // On the current epoch but never got these sites' configuration.
+      for (const id of report.missing) {
+        const site = sitesById.get(id)
+        if (site && !upserted.has(id) && owners.get(id) === shard.deviceId) {
+          upserts.push({ deviceId: shard.deviceId, command: { type: 'UPSERT_SITE', payload: sitePayload(site) } })
+          upserted.add(id)
+        }
+      }
+    }
+  }
+
+  await publishCommands([...upserts, ...assignments], config)
+  for (const site of movedSites) {
+    await upsertSite(site)
+  }
+  for (const shard of shards) {
+    await saveDeviceShard(shard)
+  }
+
+  return {
+    devices: shards.map(({ deviceId, status, weight, epoch }) => ({ deviceId, status, weight, epoch })),
+    sites: Object.fromEntries(shards.map((shard) => [shard.deviceId, shard.sites.length])),
+    moved,
+    commands: upserts.length + assignments.length
+  }
+}
@@ -0,0 +1,104 @@
+import assert from 'node:assert/strict'
+import { test } from 'node:test'
+import type { DeviceShard, SiteConfig } from '../lib/kv.ts'
+import type { LoadReport } from '../server/utils/mqtt.ts'
+import { nextDeviceShard, planShards } from '../server/utils/ring.ts'
+
+const MINUTE = 60_000
+const DEVICES = ['esp-a', 'esp-b', 'esp-c']
+
+const sites: SiteConfig[] = Array.from({ length: 300 }, (_, i) => ({
+  id: `site-${i}`,
+  url: `https://example.com/${i}`,
+  interval_s: 300,
+  mode: 'full',
+  createdAt: 0,
+  updatedAt: 0
+}))
+
+const report = (id: string, seq: number, overloaded: boolean): LoadReport => ({
+  id,
+  seq,
+  epoch: 1,
+  sites: 100,
+  active: 100,
+  missing: [],
+  missing_total: 0,
+  checks: 100,
+  check_ms: 800,
+  cycle_ms: 60_000,
+  lag_ms: overloaded ? 90_000 : 0,
+  utilization: overloaded ? 100 : 40,
+  heap_free: 120_000,
+  heap_min: 90_000,
+  largest_block: 60_000,
+  queue_depth: 0,
+  in_flight: 0,
+  overloaded
+})
+
+const owned = (owners: Map<string, string | undefined>, deviceId: string) =>
+  [...owners].filter(([, owner]) => owner === deviceId).map(([id]) => id)
+
+// Every device reporting normally since `start`.
+const healthyShards = (start: number): DeviceShard[] =>
+  DEVICES.map((id) => nextDeviceShard(id, undefined, report(id, 1, false), start))
+
+test('a silent device loses all its sites and the others keep theirs', () => {
+  const start = 1_000_000
+  const before = healthyShards(start)
+  const ownersBefore = planShards(sites, before)
+  for (const id of DEVICES) {
+    assert.ok(owned(ownersBefore, id).length > 0)
+  }
+
+  // esp-b stops publishing; the others send fresh reports.
+  const now = start + 11 * MINUTE
+  const after = before.map((shard) => {
+    const fresh = shard.deviceId === 'esp-b' ? undefined : report(shard.deviceId, 2, false)
+    return nextDeviceShard(shard.deviceId, shard, fresh, now)
+  })
+  assert.equal(after[1].status, 'silent')
+  const ownersAfter = planShards(sites, after)
+  assert.deepEqual(owned(ownersAfter, 'esp-b'), [])
+  for (const id of ['esp-a', 'esp-c']) {
+    for (const siteId of owned(ownersBefore, id)) {
+      assert.equal(ownersAfter.get(siteId), id)
+    }
+  }
+})
+
+test('an overloaded device sheds sites to the others', () => {
+  const start = 1_000_000
+  let shards = healthyShards(start)
+  const ownersBefore = planShards(sites, shards)
+  // esp-a reports overloaded twice in a row.
+  for (let seq = 2; seq <= 3; seq++) {
+    const now = start + seq * MINUTE
+    shards = shards.map((shard) =>
+      nextDeviceShard(shard.deviceId, shard, report(shard.deviceId, seq, shard.deviceId === 'esp-a'), now)
+    )
+  }
+  assert.equal(shards[0].status, 'overloaded')
+  assert.equal(shards[0].weight, 0.25)
+  const ownersAfter = planShards(sites, shards)
+  const kept = owned(ownersAfter, 'esp-a')
+  assert.ok(kept.length < owned(ownersBefore, 'esp-a').length / 2)
+  // Only its sites move; what it still has, it had before.
+  for (const siteId of kept) {
+    assert.equal(ownersBefore.get(siteId), 'esp-a')
+  }
+  for (const id of ['esp-b', 'esp-c']) {
+    for (const siteId of owned(ownersBefore, id)) {
+      assert.equal(ownersAfter.get(siteId), id)
+    }
+  }
+})
+
+test('with every device silent the sites stay where they are', () => {
+  const start = 1_000_000
+  const now = start + 11 * MINUTE
+  const shards = healthyShards(start).map((shard) => nextDeviceShard(shard.deviceId, shard, undefined, now))
+  const owners = planShards([{ ...sites[0], device: 'esp-c' }], shards)
+  assert.equal(owners.get('site-0'), 'esp-c')
+})